@@ -0,0 +1,96 @@
+#include "asset_pack.h"
+
+#include <cstring>
+
+#include "log.h"
+
+static int asset_pack_validate(struct asset_pack* pack, const char* name) {
+    const struct platform_mapping* mapping = &pack->mapping;
+    if (mapping->size < sizeof(struct asset_pack_header)) {
+        LOGE("asset pack %s: truncated header", name);
+        return -1;
+    }
+    const auto* header = (const struct asset_pack_header*)mapping->data;
+    if (header->magic != ASSET_PACK_MAGIC || header->version != ASSET_PACK_VERSION) {
+        LOGE("asset pack %s: bad magic or version %u", name, header->version);
+        return -1;
+    }
+    if (header->file_size != mapping->size ||
+        (uint64_t)header->entry_count * sizeof(struct asset_pack_entry) >
+                mapping->size - sizeof(struct asset_pack_header)) {
+        LOGE("asset pack %s: size mismatch (%zu bytes, header says %llu)", name, mapping->size,
+             (unsigned long long)header->file_size);
+        return -1;
+    }
+    pack->entries = (const struct asset_pack_entry*)(header + 1);
+    pack->entry_count = header->entry_count;
+
+    for (uint32_t i = 0; i < pack->entry_count; i++) {
+        const struct asset_pack_entry* entry = &pack->entries[i];
+        uint32_t alignment = entry->alignment;
+        if (alignment == 0 || (alignment & (alignment - 1)) != 0 || entry->offset % alignment != 0 ||
+            entry->offset > mapping->size || entry->size > mapping->size - entry->offset ||
+            entry->name[ASSET_NAME_SIZE - 1] != '\0' ||
+            (i > 0 && entry->name_hash < pack->entries[i - 1].name_hash)) {
+            LOGE("asset pack %s: bad entry %u", name, i);
+            return -1;
+        }
+    }
+    // Blob offsets are aligned within the file. An APK only guarantees 4
+    // byte alignment for stored assets, so the mapping itself may not be.
+    if (((uintptr_t)mapping->data & 63) != 0) {
+        LOGW("asset pack %s: mapped at %p, blobs lose their 64 byte alignment", name, mapping->data);
+    }
+    return 0;
+}
+
+int asset_pack_open(struct asset_pack* pack, const char* name) {
+    *pack = {};
+    if (platform_map_asset(name, &pack->mapping) != 0) {
+        return -1;
+    }
+    if (asset_pack_validate(pack, name) != 0) {
+        asset_pack_close(pack);
+        return -1;
+    }
+    return 0;
+}
+
+void asset_pack_close(struct asset_pack* pack) {
+    platform_unmap_asset(&pack->mapping);
+    *pack = {};
+}
+
+const struct asset_pack_entry* asset_pack_find(const struct asset_pack* pack, const char* name) {
+    uint64_t hash = asset_name_hash(name);
+    uint32_t lo = 0;
+    uint32_t hi = pack->entry_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (pack->entries[mid].name_hash < hash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    // the builder rejects colliding names, the compare guards against
+    // looking up a name that was never packed
+    if (lo < pack->entry_count && pack->entries[lo].name_hash == hash &&
+        strncmp(pack->entries[lo].name, name, ASSET_NAME_SIZE) == 0) {
+        return &pack->entries[lo];
+    }
+    return nullptr;
+}
+
+const void* asset_pack_get(const struct asset_pack* pack, const char* name, enum asset_type type,
+                           size_t* size) {
+    const struct asset_pack_entry* entry = asset_pack_find(pack, name);
+    if (entry == nullptr || entry->type != type) {
+        LOGE("asset %s: %s", name, entry == nullptr ? "not in pack" : "wrong type");
+        return nullptr;
+    }
+    if (size != nullptr) {
+        *size = (size_t)entry->size;
+    }
+    return asset_pack_data(pack, entry);
+}
@@ -0,0 +1,96 @@
+#ifndef ENGINE_ASSET_PACK_H
+#define ENGINE_ASSET_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "platform.h"
+
+/**
+ * Packed asset archive, written by tools/pack_assets.py:
+ *
+ *     asset_pack_header
+ *     asset_pack_entry[entry_count]    sorted by name_hash
+ *     blobs, each at a multiple of its entry's alignment
+ *
+ * The file is mapped as-is and loaders get pointers straight into the
+ * mapping, so opening a pack only reads the header and table of contents.
+ * All fields are little-endian.
+ */
+
+#define ASSET_PACK_MAGIC 0x4b415045u // "EPAK"
+#define ASSET_PACK_VERSION 1u
+#define ASSET_NAME_SIZE 32
+
+enum asset_type : uint32_t {
+    ASSET_BLOB = 0,
+    ASSET_MESH = 1,
+    ASSET_TEXTURE = 2,
+    ASSET_SHADER = 3,
+};
+
+struct asset_pack_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t reserved;
+    uint64_t file_size;
+    uint64_t reserved2;
+};
+
+struct asset_pack_entry {
+    uint64_t name_hash;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t type;
+    // 16 for plain data, 64 for meshes and textures so they can be
+    // copied to the GPU or read with SIMD loads without realigning
+    uint32_t alignment;
+    char name[ASSET_NAME_SIZE];
+};
+
+static_assert(sizeof(struct asset_pack_header) == 32, "header layout is part of the file format");
+static_assert(sizeof(struct asset_pack_entry) == 64, "entry layout is part of the file format");
+
+/**
+ * FNV-1a, the hash the pack builder sorts the table of contents by.
+ */
+constexpr uint64_t asset_name_hash(const char* name, uint64_t hash = 0xcbf29ce484222325ull) {
+    return *name == '\0' ? hash
+                         : asset_name_hash(name + 1, (hash ^ (uint8_t)*name) * 0x100000001b3ull);
+}
+
+struct asset_pack {
+    struct platform_mapping mapping;
+    const struct asset_pack_entry* entries;
+    uint32_t entry_count;
+};
+
+/**
+ * Map a pack through platform_map_asset and validate its table of
+ * contents. Returns 0 on success.
+ */
+int asset_pack_open(struct asset_pack* pack, const char* name);
+
+void asset_pack_close(struct asset_pack* pack);
+
+/**
+ * Binary search of the table of contents; nullptr when missing.
+ */
+const struct asset_pack_entry* asset_pack_find(const struct asset_pack* pack, const char* name);
+
+/**
+ * Pointer into the mapping, valid until asset_pack_close.
+ */
+inline const void* asset_pack_data(const struct asset_pack* pack, const struct asset_pack_entry* entry) {
+    return (const uint8_t*)pack->mapping.data + entry->offset;
+}
+
+/**
+ * Find an asset of the given type and return its data, nullptr (with a
+ * log) when missing or of a different type.
+ */
+const void* asset_pack_get(const struct asset_pack* pack, const char* name, enum asset_type type,
+                           size_t* size);
+
+#endif // ENGINE_ASSET_PACK_H
@@ -0,0 +1,27 @@
+#ifndef ENGINE_BENCH_H
+#define ENGINE_BENCH_H
+
+/**
+ * Host-only microbenchmarks, selected with engine-host --bench <name>.
+ * Each returns 0 on success.
+ */
+int bench_jobs();
+int bench_math();
+int bench_ecs();
+int bench_input();
+int bench_pacer();
+int bench_profiler();
+int bench_assets();
+int bench_gpu_memory();
+int bench_gpu_defrag();
+int bench_record();
+int bench_render_graph();
+int bench_cull();
+int bench_gpu_cull();
+int bench_batching();
+int bench_texture_stream();
+int bench_lod();
+int bench_mesh();
+int bench_dynamic_resolution();
+
+#endif // ENGINE_BENCH_H
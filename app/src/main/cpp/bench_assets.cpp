@@ -0,0 +1,211 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "asset_pack.h"
+#include "frame_stats.h"
+#include "log.h"
+#include "platform.h"
+
+static const uint32_t ASSETS = 256;
+static const int RUNS = 10;
+
+/**
+ * Write a pack in the pack_assets.py layout: ASSETS blobs of 4 KB to 512 KB,
+ * every other one 64 byte aligned like meshes and textures.
+ */
+static int write_pack(const char* path, size_t* total_bytes) {
+    std::vector<struct asset_pack_entry> entries(ASSETS);
+    uint64_t offset = sizeof(struct asset_pack_header) + sizeof(struct asset_pack_entry) * ASSETS;
+    uint32_t rng = 3;
+    for (uint32_t i = 0; i < ASSETS; i++) {
+        struct asset_pack_entry* entry = &entries[i];
+        snprintf(entry->name, sizeof(entry->name), "asset_%u", i);
+        entry->name_hash = asset_name_hash(entry->name);
+        entry->type = i & 1 ? ASSET_TEXTURE : ASSET_BLOB;
+        entry->alignment = i & 1 ? 64 : 16;
+        rng = rng * 1664525u + 1013904223u;
+        entry->size = (4096 + (rng >> 8) % (508 * 1024)) & ~15ull;
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const struct asset_pack_entry& a, const struct asset_pack_entry& b) {
+                  return a.name_hash < b.name_hash;
+              });
+    for (struct asset_pack_entry& entry : entries) {
+        offset = (offset + entry.alignment - 1) & ~(uint64_t)(entry.alignment - 1);
+        entry.offset = offset;
+        offset += entry.size;
+    }
+
+    struct asset_pack_header header{};
+    header.magic = ASSET_PACK_MAGIC;
+    header.version = ASSET_PACK_VERSION;
+    header.entry_count = ASSETS;
+    header.file_size = offset;
+
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        LOGE("assets: cannot write %s", path);
+        return -1;
+    }
+    std::vector<uint8_t> image(offset);
+    memcpy(image.data(), &header, sizeof(header));
+    memcpy(image.data() + sizeof(header), entries.data(), sizeof(struct asset_pack_entry) * ASSETS);
+    for (size_t i = sizeof(header) + sizeof(struct asset_pack_entry) * ASSETS; i < image.size(); i++) {
+        image[i] = (uint8_t)(i * 131u);
+    }
+    size_t written = fwrite(image.data(), 1, image.size(), file);
+    fclose(file);
+    *total_bytes = image.size();
+    return written == image.size() ? 0 : -1;
+}
+
+/**
+ * Stands in for a loader consuming the asset: reads every byte once.
+ */
+static uint64_t checksum(const void* data, size_t size) {
+    const auto* words = (const uint64_t*)data;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < size / sizeof(uint64_t); i++) {
+        sum += words[i];
+    }
+    return sum;
+}
+
+/**
+ * Drop the pack from the page cache so the next run reads from storage.
+ */
+static void evict(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+/**
+ * Zero-copy: map, look every asset up and read it in place. lookup_ns is
+ * the time until every pointer is available.
+ */
+static uint64_t load_mapped(int64_t* lookup_ns) {
+    int64_t start = platform_time_ns();
+    struct asset_pack pack;
+    if (asset_pack_open(&pack, "bench.pak") != 0) {
+        return 0;
+    }
+    const void* data[ASSETS];
+    size_t sizes[ASSETS];
+    for (uint32_t i = 0; i < ASSETS; i++) {
+        char name[ASSET_NAME_SIZE];
+        snprintf(name, sizeof(name), "asset_%u", i);
+        data[i] = asset_pack_get(&pack, name, i & 1 ? ASSET_TEXTURE : ASSET_BLOB, &sizes[i]);
+    }
+    *lookup_ns = platform_time_ns() - start;
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < ASSETS; i++) {
+        sum += data[i] != nullptr ? checksum(data[i], sizes[i]) : 0;
+    }
+    asset_pack_close(&pack);
+    return sum;
+}
+
+/**
+ * Naive loading: read the table of contents, then malloc and fread every
+ * asset before using it.
+ */
+static uint64_t load_fread(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return 0;
+    }
+    struct asset_pack_header header;
+    std::vector<struct asset_pack_entry> entries;
+    uint64_t sum = 0;
+    if (fread(&header, sizeof(header), 1, file) == 1) {
+        entries.resize(header.entry_count);
+        if (fread(entries.data(), sizeof(struct asset_pack_entry), entries.size(), file) != entries.size()) {
+            entries.clear();
+        }
+    }
+    for (uint32_t i = 0; i < ASSETS; i++) {
+        char name[ASSET_NAME_SIZE];
+        snprintf(name, sizeof(name), "asset_%u", i);
+        for (const struct asset_pack_entry& entry : entries) {
+            if (strcmp(entry.name, name) != 0) {
+                continue;
+            }
+            void* data = malloc(entry.size);
+            fseek(file, (long)entry.offset, SEEK_SET);
+            if (fread(data, 1, entry.size, file) == entry.size) {
+                sum += checksum(data, entry.size);
+            }
+            free(data);
+            break;
+        }
+    }
+    fclose(file);
+    return sum;
+}
+
+int bench_assets() {
+    char dir[] = "/tmp/engine-assets-XXXXXX";
+    if (mkdtemp(dir) == nullptr) {
+        LOGE("assets: cannot create a temporary directory");
+        return -1;
+    }
+    char path[sizeof(dir) + 16];
+    snprintf(path, sizeof(path), "%s/bench.pak", dir);
+    size_t total_bytes = 0;
+    if (write_pack(path, &total_bytes) != 0) {
+        rmdir(dir);
+        return -1;
+    }
+    platform_set_asset_source(dir);
+
+    int result = 0;
+    for (int cold = 0; cold < 2; cold++) {
+        struct frame_stats mapped;
+        struct frame_stats lookup;
+        struct frame_stats naive;
+        uint64_t mapped_sum = 0;
+        uint64_t naive_sum = 0;
+        for (int run = 0; run < RUNS; run++) {
+            if (cold) {
+                evict(path);
+            }
+            int64_t lookup_ns = 0;
+            int64_t start = platform_time_ns();
+            mapped_sum = load_mapped(&lookup_ns);
+            frame_stats_add(&mapped, platform_time_ns() - start);
+            frame_stats_add(&lookup, lookup_ns);
+
+            if (cold) {
+                evict(path);
+            }
+            start = platform_time_ns();
+            naive_sum = load_fread(path);
+            frame_stats_add(&naive, platform_time_ns() - start);
+        }
+        if (mapped_sum != naive_sum || mapped_sum == 0) {
+            LOGE("assets: mapped and fread loads disagree");
+            result = -1;
+        }
+        const char* cache = cold ? "cold" : "warm";
+        LOGI("assets: %u assets, %.1f MB, %s page cache", ASSETS, (double)total_bytes / (1 << 20), cache);
+        frame_stats_report(&lookup, "  mmap open + lookup");
+        frame_stats_report(&mapped, "  mmap + read in place");
+        frame_stats_report(&naive, "  fread into malloc");
+    }
+
+    unlink(path);
+    rmdir(dir);
+    return result;
+}
@@ -0,0 +1,185 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "cull.h"
+#include "frame_stats.h"
+#include "log.h"
+#include "memory.h"
+#include "platform.h"
+#include "scene.h"
+#include "scene_renderer.h"
+
+static const uint32_t ENTITIES = 100000;
+static const int FRAMES = 100;
+static const int SORTS = 20;
+
+static struct mat4 camera(const struct scene* scene, int frame) {
+    float angle = (float)frame * 0.01f;
+    float distance = scene->bounds * 2.5f;
+    struct vec3 eye = { sinf(angle) * distance, scene->bounds * 0.8f, cosf(angle) * distance };
+    struct mat4 view = mat4_look_at(eye, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+    struct mat4 proj = mat4_perspective(1.0f, 16.0f / 9.0f, 1.0f, distance * 3.0f);
+    return mat4_mul(&proj, &view);
+}
+
+/**
+ * radix_sort against std::stable_sort on keys shaped like the renderer's,
+ * which it must match exactly, and std::sort for speed.
+ */
+static int check_radix_sort() {
+    std::vector<uint64_t> keys(ENTITIES);
+    std::vector<uint32_t> values(ENTITIES);
+    uint32_t rng = 7;
+    for (uint32_t i = 0; i < ENTITIES; i++) {
+        rng = rng * 1664525u + 1013904223u;
+        uint32_t material = (rng >> 8) % SCENE_DEMO_MATERIALS;
+        keys[i] = draw_key_make(SCENE_PASS_MAIN, material >= 6, material, 0,
+                                draw_depth_bucket((float)(rng >> 12) * 0.001f));
+        values[i] = i;
+    }
+    std::vector<std::pair<uint64_t, uint32_t>> pairs(ENTITIES);
+    std::vector<uint64_t> sorted_keys(ENTITIES);
+    std::vector<uint32_t> sorted_values(ENTITIES);
+    std::vector<uint64_t> key_scratch(ENTITIES);
+    std::vector<uint32_t> value_scratch(ENTITIES);
+    auto by_key = [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) {
+        return a.first < b.first;
+    };
+
+    int64_t radix_ns = 0;
+    int64_t std_ns = 0;
+    for (int i = 0; i < SORTS; i++) {
+        sorted_keys = keys;
+        sorted_values = values;
+        int64_t start = platform_time_ns();
+        radix_sort(sorted_keys.data(), sorted_values.data(), key_scratch.data(), value_scratch.data(), ENTITIES);
+        radix_ns += platform_time_ns() - start;
+
+        for (uint32_t j = 0; j < ENTITIES; j++) {
+            pairs[j] = { keys[j], values[j] };
+        }
+        start = platform_time_ns();
+        std::sort(pairs.begin(), pairs.end(), by_key);
+        std_ns += platform_time_ns() - start;
+    }
+    LOGI("batching: radix sort %.3f ms, std::sort %.3f ms for %u keys", (double)radix_ns / SORTS * 1e-6,
+         (double)std_ns / SORTS * 1e-6, ENTITIES);
+
+    for (uint32_t j = 0; j < ENTITIES; j++) {
+        pairs[j] = { keys[j], values[j] };
+    }
+    std::stable_sort(pairs.begin(), pairs.end(), by_key);
+    for (uint32_t j = 0; j < ENTITIES; j++) {
+        if (pairs[j].first != sorted_keys[j] || pairs[j].second != sorted_values[j]) {
+            LOGE("batching: radix sort differs from std::stable_sort at %u", j);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Every visible entity appears once, in key order, and batches tile the
+ * sorted items with one pipeline, material and mesh each.
+ */
+static int check_batches(const struct scene_renderer* sr, const struct scene_cull* cull,
+                         std::vector<uint8_t>* marks) {
+    const struct draw_batcher* batcher = &sr->batcher;
+    marks->assign(cull->object_count, 0);
+    for (uint32_t i = 0; i < cull->visible_count; i++) {
+        (*marks)[cull->visible[i]] = 1;
+    }
+    for (uint32_t i = 0; i < sr->instance_count; i++) {
+        if (i > 0 && batcher->keys[i - 1] > batcher->keys[i]) {
+            LOGE("batching: keys out of order at %u", i);
+            return -1;
+        }
+        if ((*marks)[batcher->items[i]]-- != 1) {
+            LOGE("batching: item %u is not visible or sorted twice", batcher->items[i]);
+            return -1;
+        }
+    }
+    uint32_t next = 0;
+    for (uint32_t b = 0; b < batcher->batch_count; b++) {
+        const struct draw_batch* batch = &batcher->batches[b];
+        if (batch->first_instance != next || batch->instance_count == 0) {
+            LOGE("batching: batch %u does not follow the previous one", b);
+            return -1;
+        }
+        for (uint32_t i = batch->first_instance; i < batch->first_instance + batch->instance_count; i++) {
+            const struct renderable* renderable = cull->renderables[batcher->items[i]];
+            if (renderable->material != batch->material || renderable->mesh != batch->mesh ||
+                sr->materials[renderable->material].pipeline != (enum scene_pipeline)batch->pipeline) {
+                LOGE("batching: instance %u does not match batch %u", i, b);
+                return -1;
+            }
+        }
+        next += batch->instance_count;
+    }
+    if (next != sr->instance_count || batcher->batch_count > SCENE_DEMO_MATERIALS ||
+        batcher->batched.pipeline_binds > SCENE_PIPELINE_COUNT) {
+        LOGE("batching: %u batches over %u of %u instances, %u pipeline binds", batcher->batch_count, next,
+             sr->instance_count, batcher->batched.pipeline_binds);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Sort keying and batching of a 100k entity scene in eight materials over
+ * two pipelines, seen whole by an orbiting camera, without a device:
+ * times the per-frame sort, checks its batches and reports state changes
+ * with and without batching. Also checks radix_sort against the standard
+ * library's sorts.
+ */
+int bench_batching() {
+    if (check_radix_sort() != 0) {
+        return -1;
+    }
+    struct job_system jobs{};
+    job_system_init(&jobs, 0);
+    static struct scene scene;
+    if (scene_init(&scene) != 0) {
+        job_system_shutdown(&jobs);
+        return -1;
+    }
+    scene_spawn_demo(&scene, ENTITIES, 1);
+    static struct scene_cull cull;
+    static struct scene_renderer sr;
+    scene_renderer_init_batching(&sr, ENTITIES);
+    struct frame_memory frame_memory{};
+    if (frame_memory_init(&frame_memory, FRAME_ARENA_SIZE) != 0) {
+        scene_destroy(&scene);
+        job_system_shutdown(&jobs);
+        return -1;
+    }
+
+    struct frame_stats sort_stats;
+    std::vector<uint8_t> marks;
+    int result = 0;
+    for (int i = 0; i < FRAMES && result == 0; i++) {
+        frame_memory_begin(&frame_memory, (uint64_t)i);
+        scene_update(&scene, &jobs, 1.0f / 60.0f);
+        struct mat4 view_proj = camera(&scene, i);
+        scene_cull_update(&cull, &scene, &jobs, &view_proj);
+        int64_t start = platform_time_ns();
+        scene_renderer_sort(&sr, &jobs, &cull, &view_proj, frame_arena(&frame_memory));
+        frame_stats_add(&sort_stats, platform_time_ns() - start);
+        result = check_batches(&sr, &cull, &marks);
+    }
+    frame_stats_report(&sort_stats, "batching: key and sort");
+    const struct draw_batch_stats* unbatched = &sr.batcher.unbatched;
+    const struct draw_batch_stats* batched = &sr.batcher.batched;
+    LOGI("batching: %u workers, last frame %u draws, %u pipeline binds, %u material binds; "
+         "unbatched %u, %u and %u", jobs.worker_count, batched->draws, batched->pipeline_binds,
+         batched->material_binds, unbatched->draws, unbatched->pipeline_binds, unbatched->material_binds);
+
+    sr = {};
+    frame_memory_destroy(&frame_memory);
+    scene_cull_destroy(&cull);
+    scene_destroy(&scene);
+    job_system_shutdown(&jobs);
+    return result;
+}
@@ -0,0 +1,124 @@
+#include "bench.h"
+
+#include <vector>
+
+#include "cull.h"
+#include "frame_stats.h"
+#include "log.h"
+#include "platform.h"
+#include "scene.h"
+
+static const uint32_t ENTITIES = 100000;
+static const int FRAMES = 300;
+
+/**
+ * A camera inside the box of entities, turning around its center, so
+ * most of the scene is behind or beside it.
+ */
+static struct mat4 camera(const struct scene* scene, int frame) {
+    float angle = (float)frame * 0.02f;
+    struct vec3 eye = { sinf(angle) * scene->bounds * 0.5f, 0.0f, cosf(angle) * scene->bounds * 0.5f };
+    struct vec3 target = { sinf(angle + 2.0f) * scene->bounds, 0.0f, cosf(angle + 2.0f) * scene->bounds };
+    struct mat4 view = mat4_look_at(eye, target, { 0.0f, 1.0f, 0.0f });
+    struct mat4 proj = mat4_perspective(1.0f, 16.0f / 9.0f, 0.5f, scene->bounds * 3.0f);
+    return mat4_mul(&proj, &view);
+}
+
+static struct aabb scale_box(const struct aabb* box, float grow) {
+    struct vec3 center = vec3_scale(vec3_add(box->min, box->max), 0.5f);
+    struct vec3 extent = vec3_scale(vec3_sub(box->max, box->min), 0.5f);
+    struct vec3 delta = vec3_add(vec3_scale(extent, grow), { grow * 10.0f, grow * 10.0f, grow * 10.0f });
+    extent = vec3_max(vec3_add(extent, delta), { 0.0f, 0.0f, 0.0f });
+    return { vec3_sub(center, extent), vec3_add(center, extent) };
+}
+
+/**
+ * Compare against testing every box on its own. Boxes within rounding
+ * distance of a plane may go either way; anything clearly visible must be
+ * reported, exactly once, and nothing clearly outside.
+ */
+static int check_visible(const struct scene_cull* cull, const struct frustum* frustum,
+                         std::vector<uint8_t>* marks, int64_t* brute_force_ns) {
+    marks->assign(cull->object_count, 0);
+    int duplicates = 0;
+    for (uint32_t i = 0; i < cull->visible_count; i++) {
+        duplicates += (*marks)[cull->visible[i]]++ != 0;
+    }
+
+    int64_t start = platform_time_ns();
+    uint32_t expected = 0;
+    for (uint32_t i = 0; i < cull->object_count; i++) {
+        expected += frustum_intersects_aabb(frustum, &cull->bounds[i]);
+    }
+    *brute_force_ns = platform_time_ns() - start;
+
+    int missed = 0;
+    int extra = 0;
+    for (uint32_t i = 0; i < cull->object_count; i++) {
+        struct aabb inner = scale_box(&cull->bounds[i], -1e-4f);
+        struct aabb outer = scale_box(&cull->bounds[i], 1e-4f);
+        missed += !(*marks)[i] && frustum_intersects_aabb(frustum, &inner);
+        extra += (*marks)[i] && !frustum_intersects_aabb(frustum, &outer);
+    }
+    if (duplicates != 0 || missed != 0 || extra != 0) {
+        LOGE("cull: %u visible against %u brute force: %d missed, %d outside, %d duplicated",
+             cull->visible_count, expected, missed, extra, duplicates);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Frustum culling of a 100k entity scene (a quarter static, the rest
+ * moving) against a camera that turns every frame: the moving tree is
+ * refit every frame and culled together with the static one, and every
+ * frame is checked against a brute-force scalar test of each box.
+ */
+int bench_cull() {
+    struct job_system jobs{};
+    job_system_init(&jobs, 0);
+    static struct scene scene;
+    if (scene_init(&scene) != 0) {
+        job_system_shutdown(&jobs);
+        return -1;
+    }
+    scene_spawn_demo(&scene, ENTITIES, 1);
+
+    static struct scene_cull cull;
+    struct mat4 view_proj = camera(&scene, 0);
+    int64_t start = platform_time_ns();
+    scene_cull_update(&cull, &scene, &jobs, &view_proj);
+    LOGI("cull: built both trees over %u objects in %.2f ms", cull.object_count,
+         (double)(platform_time_ns() - start) * 1e-6);
+
+    struct frame_stats refit_stats;
+    struct frame_stats cull_stats;
+    struct frame_stats brute_force_stats;
+    std::vector<uint8_t> marks;
+    uint64_t visible = 0;
+    int result = 0;
+    for (int i = 1; i <= FRAMES && result == 0; i++) {
+        scene_update(&scene, &jobs, 1.0f / 60.0f);
+        view_proj = camera(&scene, i);
+        scene_cull_update(&cull, &scene, &jobs, &view_proj);
+        frame_stats_add(&refit_stats, cull.refit_ns);
+        frame_stats_add(&cull_stats, cull.cull_ns);
+        visible += cull.visible_count;
+
+        struct frustum frustum = frustum_from_matrix(&view_proj);
+        int64_t brute_force_ns;
+        result = check_visible(&cull, &frustum, &marks, &brute_force_ns);
+        frame_stats_add(&brute_force_stats, brute_force_ns);
+    }
+
+    frame_stats_report(&refit_stats, "cull: refit");
+    frame_stats_report(&cull_stats, "cull: bvh cull");
+    frame_stats_report(&brute_force_stats, "cull: brute force, one thread");
+    LOGI("cull: %u workers, %.1f%% visible on average, %u rebuilds of the moving tree", jobs.worker_count,
+         100.0 * (double)visible / ((double)FRAMES * cull.object_count), cull.rebuilds);
+
+    scene_cull_destroy(&cull);
+    scene_destroy(&scene);
+    job_system_shutdown(&jobs);
+    return result;
+}
@@ -0,0 +1,162 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "dynamic_resolution.h"
+#include "frame_stats.h"
+#include "log.h"
+
+static const int FRAMES = 3600;
+static const int64_t BUDGET_NS = 12000000;
+static const float MIN_SCALE = 0.5f;
+// measurements arrive this many frames late, like timestamps read back
+// once a frame slot's fence signals
+static const int LATENCY = 2;
+// part of the main pass that does not shrink with the resolution
+static const double FIXED_NS = 1.0e6;
+
+/**
+ * A GPU load over time: the main pass cost at full resolution for every
+ * frame, per pixel cost and fixed cost together.
+ */
+struct gpu_trace {
+    const char* name;
+    // the load does not move, so neither should the resolution
+    int steady;
+    std::vector<double> full_ns;
+};
+
+static double noise(uint32_t* rng) {
+    *rng = *rng * 1664525u + 1013904223u;
+    return (double)(*rng >> 8) / 16777216.0 - 0.5;
+}
+
+/**
+ * Traces shaped like timestamp captures: a level that moves with the
+ * scene, 5% frame to frame noise, and the odd single-frame hitch.
+ */
+static std::vector<struct gpu_trace> make_traces() {
+    std::vector<struct gpu_trace> traces(5);
+    uint32_t rng = 17;
+    for (struct gpu_trace& trace : traces) {
+        trace.full_ns.resize(FRAMES);
+    }
+    traces[0].name = "steady";
+    traces[0].steady = 1;
+    traces[1].name = "heavy";
+    traces[1].steady = 1;
+    traces[2].name = "spike";
+    traces[3].name = "ramp";
+    traces[4].name = "hitches";
+    for (int i = 0; i < FRAMES; i++) {
+        double t = (double)i / FRAMES;
+        // under the budget with room to spare
+        traces[0].full_ns[i] = 9.5e6;
+        // nearly twice the budget all along
+        traces[1].full_ns[i] = 22.0e6;
+        // an explosion filling the screen for two seconds
+        traces[2].full_ns[i] = i >= 1200 && i < 1320 ? 26.0e6 : 9.0e6;
+        // walking into a dense area and back out
+        traces[3].full_ns[i] = 6.0e6 + 24.0e6 * (1.0 - fabs(2.0 * t - 1.0));
+        // shader compiles and uploads: one frame in a hundred triples
+        traces[4].full_ns[i] = 9.0e6;
+        for (struct gpu_trace& trace : traces) {
+            trace.full_ns[i] *= 1.0 + 0.1 * noise(&rng);
+        }
+        if (noise(&rng) > 0.49) {
+            traces[4].full_ns[i] *= 3.0;
+        }
+    }
+    return traces;
+}
+
+static int64_t frame_ns(double full_ns, float scale) {
+    double pixels = full_ns - FIXED_NS;
+    return (int64_t)(FIXED_NS + pixels * (double)scale * (double)scale);
+}
+
+/**
+ * Replay a trace through the controller. Returns 0 when the scale stayed
+ * within its bounds and the resolution held still under a steady load.
+ */
+static int replay(const struct gpu_trace* trace) {
+    struct dynamic_resolution dr;
+    dynamic_resolution_init(&dr, BUDGET_NS, MIN_SCALE, 1.0f);
+    std::vector<float> scales(FRAMES);
+    std::vector<int64_t> gpu(FRAMES);
+    struct frame_stats fixed_stats;
+    struct frame_stats scaled_stats;
+    uint32_t fixed_over = 0;
+    uint32_t scaled_over = 0;
+    double scale_sum = 0.0;
+    float min_scale = 1.0f;
+    double travel = 0.0;
+    int result = 0;
+    for (int i = 0; i < FRAMES; i++) {
+        scales[i] = dr.scale;
+        gpu[i] = frame_ns(trace->full_ns[i], scales[i]);
+        int64_t fixed = frame_ns(trace->full_ns[i], 1.0f);
+        frame_stats_add(&fixed_stats, fixed);
+        frame_stats_add(&scaled_stats, gpu[i]);
+        fixed_over += fixed > BUDGET_NS;
+        scaled_over += gpu[i] > BUDGET_NS;
+        scale_sum += scales[i];
+        min_scale = std::min(min_scale, scales[i]);
+        if (i > 0) {
+            travel += fabs((double)scales[i] - (double)scales[i - 1]);
+        }
+        if (scales[i] < MIN_SCALE || scales[i] > 1.0f) {
+            LOGE("dynamic_resolution: %s: scale %.3f out of [%.2f, 1]", trace->name, (double)scales[i],
+                 (double)MIN_SCALE);
+            result = -1;
+        }
+        if (i >= LATENCY) {
+            dynamic_resolution_update(&dr, gpu[i - LATENCY], scales[i - LATENCY]);
+        }
+    }
+    if (scaled_over > fixed_over) {
+        LOGE("dynamic_resolution: %s: %u frames over budget, %u at full resolution", trace->name, scaled_over,
+             fixed_over);
+        result = -1;
+    }
+    if (trace->steady) {
+        uint32_t changes = 0;
+        for (int i = FRAMES / 2; i < FRAMES; i++) {
+            changes += scales[i] != scales[i - 1];
+        }
+        if (changes > 2) {
+            LOGE("dynamic_resolution: %s: %u resolution changes under a steady load", trace->name, changes);
+            result = -1;
+        }
+    }
+
+    struct frame_stats_summary fixed = frame_stats_summarize(&fixed_stats);
+    struct frame_stats_summary scaled = frame_stats_summarize(&scaled_stats);
+    LOGI("dynamic_resolution: %-7s full res %4u frames over, p99 %5.2f ms; scaled %4u over, p99 %5.2f ms, "
+         "scale avg %.2f min %.2f, %u down %u up, travel %.2f",
+         trace->name, fixed_over, fixed.p99_ms, scaled_over, scaled.p99_ms, scale_sum / FRAMES,
+         (double)min_scale, dr.stats.decreases, dr.stats.increases, travel);
+    return result;
+}
+
+/**
+ * The resolution controller against a minute each of five GPU loads at
+ * 60 Hz with a 12 ms main pass budget, without a device: measurements
+ * arrive two frames late, and a frame's cost is 1 ms plus the rest of its
+ * full-resolution cost times its pixel fraction. Reports frames over
+ * budget and p99 GPU time at full and at dynamic resolution, the scales
+ * used and how much they moved. Checks that the scale stays within its
+ * bounds, never loses against full resolution, and holds still under
+ * steady loads.
+ */
+int bench_dynamic_resolution() {
+    int result = 0;
+    for (const struct gpu_trace& trace : make_traces()) {
+        if (replay(&trace) != 0) {
+            result = -1;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,112 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "jobs.h"
+#include "log.h"
+#include "platform.h"
+#include "scene.h"
+
+/**
+ * What the ECS replaces: one heap object per entity, reached via pointers
+ * in allocation-shuffled order, with every field interleaved.
+ */
+struct legacy_object {
+    struct transform transform;
+    struct velocity velocity;
+    struct spin spin;
+    struct local_to_world local_to_world;
+    char name[64];
+    struct legacy_object* parent;
+};
+
+// the same bounce as scene_update's
+static inline void bounce(float* position, float* velocity, float bounds) {
+    if (*position > bounds) {
+        *position = bounds;
+        if (*velocity > 0.0f) *velocity = -*velocity;
+    } else if (*position < -bounds) {
+        *position = -bounds;
+        if (*velocity < 0.0f) *velocity = -*velocity;
+    }
+}
+
+static void update_legacy(std::vector<struct legacy_object*>& objects, float dt, float b) {
+    for (struct legacy_object* o : objects) {
+        struct transform* t = &o->transform;
+        t->position = vec3_add(t->position, vec3_scale(o->velocity.linear, dt));
+        bounce(&t->position.x, &o->velocity.linear.x, b);
+        bounce(&t->position.y, &o->velocity.linear.y, b);
+        bounce(&t->position.z, &o->velocity.linear.z, b);
+        struct quat delta = quat_from_axis_angle(o->spin.axis, o->spin.radians_per_second * dt);
+        t->rotation = quat_normalize(quat_mul(delta, t->rotation));
+        o->local_to_world.matrix = mat4_from_trs(t->position, t->rotation, { t->scale, t->scale, t->scale });
+    }
+}
+
+int bench_ecs() {
+    const uint32_t count = 100000;
+    const float dt = 1.0f / 60.0f;
+
+    struct job_system jobs{};
+    job_system_init(&jobs, 0);
+
+    struct scene scene{};
+    if (scene_init(&scene) != 0) {
+        job_system_shutdown(&jobs);
+        return -1;
+    }
+    scene_spawn_demo(&scene, count, 1234);
+    LOGI("ecs: %u entities, %zu archetypes", scene.world.live_entities, scene.world.archetypes.size());
+
+    // single-threaded pass over the same chunks for reference
+    struct job_system serial{};
+    int64_t best_parallel = INT64_MAX;
+    int64_t best_serial = INT64_MAX;
+    for (int rep = 0; rep < 20; rep++) {
+        int64_t start = platform_time_ns();
+        scene_update(&scene, &jobs, dt);
+        best_parallel = std::min(best_parallel, platform_time_ns() - start);
+    }
+    job_system_shutdown(&jobs);
+    job_system_init(&serial, 1);
+    for (int rep = 0; rep < 20; rep++) {
+        int64_t start = platform_time_ns();
+        scene_update(&scene, &serial, dt);
+        best_serial = std::min(best_serial, platform_time_ns() - start);
+    }
+    job_system_shutdown(&serial);
+
+    // same number of moving objects as the scene has
+    uint32_t moving = count - (count + 3) / 4;
+    std::vector<struct legacy_object*> objects(moving);
+    for (uint32_t i = 0; i < moving; i++) {
+        objects[i] = new legacy_object();
+        objects[i]->transform.rotation = quat_identity();
+        objects[i]->transform.scale = 1.0f;
+        objects[i]->spin.axis = { 0.0f, 1.0f, 0.0f };
+        objects[i]->spin.radians_per_second = 1.0f;
+        objects[i]->velocity.linear = { 1.0f, 0.5f, 0.25f };
+    }
+    uint32_t rng = 42;
+    for (uint32_t i = moving - 1; i > 0; i--) {
+        rng = rng * 1664525u + 1013904223u;
+        std::swap(objects[i], objects[rng % (i + 1)]);
+    }
+    int64_t best_legacy = INT64_MAX;
+    for (int rep = 0; rep < 20; rep++) {
+        int64_t start = platform_time_ns();
+        update_legacy(objects, dt, scene.bounds);
+        best_legacy = std::min(best_legacy, platform_time_ns() - start);
+    }
+    for (struct legacy_object* o : objects) {
+        delete o;
+    }
+
+    LOGI("update %u moving entities: ecs parallel %.3f ms, ecs 1 thread %.3f ms, "
+         "pointer objects %.3f ms", moving, best_parallel / 1e6, best_serial / 1e6, best_legacy / 1e6);
+
+    scene_destroy(&scene);
+    return 0;
+}
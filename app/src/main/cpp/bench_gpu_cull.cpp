@@ -0,0 +1,117 @@
+#include "bench.h"
+
+#include <cstdlib>
+
+#include "engine.h"
+#include "frame_stats.h"
+#include "log.h"
+#include "platform.h"
+
+static const uint32_t ENTITY_COUNTS[] = { 10000, 100000 };
+static const int WARMUP = 30;
+static const int FRAMES = 200;
+
+/**
+ * What the GPU counted in the last frame, against the CPU culling the
+ * same matrices with the same view. Boxes touching a plane may go either
+ * way with different rounding, so a few objects of slack are allowed.
+ * The CPU has no occlusion test, so it is compared with what the GPU
+ * found in the frustum; every one of those has to be either occluded or
+ * drawn within its material's range, and a material is drawn exactly
+ * when it has instances.
+ */
+static int check_visible(struct engine* engine) {
+    vkDeviceWaitIdle(engine->vk.device);
+    const struct renderer* renderer = &engine->renderer;
+    const struct gpu_cull* gc = &engine->gpu_cull;
+    uint32_t last = (renderer->frame + renderer->frames_in_flight - 1) % renderer->frames_in_flight;
+    const auto* mapped = (const uint8_t*)gc->frames[last].draws_memory.mapped;
+    const auto* counts = (const struct gpu_cull_counts*)mapped;
+    uint32_t drawn = 0;
+    for (uint32_t m = 0; m < SCENE_DEMO_MATERIALS; m++) {
+        const auto* draws = (const struct gpu_cull_draws*)(mapped + gpu_cull_draws_offset(m));
+        uint32_t end = m + 1 < SCENE_DEMO_MATERIALS ? gc->material_first[m + 1] : gc->object_count;
+        const VkDrawIndirectCommand* command = &draws->command;
+        if (command->firstInstance != gc->material_first[m] || command->firstInstance + command->instanceCount > end ||
+            (command->instanceCount > 0) != (draws->draw_count == 1)) {
+            LOGE("gpu_cull: material %u drew %u instances from %u with draw count %u, its range ends at %u", m,
+                 command->instanceCount, command->firstInstance, draws->draw_count, end);
+            return -1;
+        }
+        drawn += command->instanceCount;
+    }
+
+    static struct scene_cull reference;
+    scene_cull_update(&reference, &engine->scene, engine->jobs, &engine->view_proj);
+    uint32_t cpu = reference.visible_count;
+    scene_cull_destroy(&reference);
+
+    uint32_t slack = 2 + cpu / 1000;
+    LOGI("gpu_cull: %u in the frustum on the GPU, %u on the CPU; %u occluded, %u drawn", counts->in_frustum, cpu,
+         counts->occluded, drawn);
+    if ((uint32_t)abs((int)counts->in_frustum - (int)cpu) > slack) {
+        LOGE("gpu_cull: GPU and CPU frustum culling disagree");
+        return -1;
+    }
+    if (drawn + counts->occluded != counts->in_frustum) {
+        LOGE("gpu_cull: %u drawn and %u occluded of %u in the frustum", drawn, counts->occluded,
+             counts->in_frustum);
+        return -1;
+    }
+    return 0;
+}
+
+static int run(struct job_system* jobs, uint32_t entities, int gpu_culling) {
+    struct engine engine{};
+    engine.jobs = jobs;
+    engine.width = 1280;
+    engine.height = 720;
+    engine.scene_entities = entities;
+    engine.record_threads = 1;
+    engine.gpu_culling = gpu_culling;
+    engine.animating = 1;
+    if (engine_init(&engine) != 0) {
+        LOGE("gpu_cull: engine_init failed (no Vulkan device?)");
+        return -1;
+    }
+
+    struct frame_stats record_stats;
+    struct frame_stats cull_stats;
+    record_stats.samples_ns.reserve(FRAMES);
+    cull_stats.samples_ns.reserve(FRAMES);
+    for (int i = 0; i < WARMUP + FRAMES; i++) {
+        engine_draw(&engine);
+        if (i >= WARMUP) {
+            frame_stats_add(&record_stats, engine.stats.record_ns);
+            frame_stats_add(&cull_stats, engine.stats.cull_ns);
+        }
+    }
+    struct frame_stats_summary record = frame_stats_summarize(&record_stats);
+    struct frame_stats_summary cull = frame_stats_summarize(&cull_stats);
+    LOGI("gpu_cull: %6u entities, %s culling: %4u draws, record avg %.3f ms, cull avg %.3f ms",
+         entities, gpu_culling ? "GPU" : "CPU", engine.stats.draws, record.avg_ms, cull.avg_ms);
+
+    int result = gpu_culling ? check_visible(&engine) : 0;
+    engine_destroy(&engine);
+    return result;
+}
+
+/**
+ * CPU culling and batching against GPU culling with one indirect draw
+ * per material, for 10k and 100k entities, recorded on one thread.
+ * Reports recording time, draws and CPU culling cost (the matrix upload
+ * with GPU culling), and checks the GPU's counts and draws against the
+ * CPU culling the same frame. Needs a Vulkan device.
+ */
+int bench_gpu_cull() {
+    struct job_system jobs{};
+    job_system_init(&jobs, 0);
+    int result = 0;
+    for (uint32_t entities : ENTITY_COUNTS) {
+        for (int gpu_culling = 0; gpu_culling < 2 && result == 0; gpu_culling++) {
+            result = run(&jobs, entities, gpu_culling);
+        }
+    }
+    job_system_shutdown(&jobs);
+    return result;
+}
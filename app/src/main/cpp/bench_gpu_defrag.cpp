@@ -0,0 +1,181 @@
+#include "bench.h"
+
+#include <cstring>
+#include <vector>
+
+#include "engine.h"
+#include "gpu_memory.h"
+#include "log.h"
+#include "platform.h"
+
+// requests of a power of two size, at least this many to a block
+static const uint32_t PER_BLOCK = 16;
+static const uint32_t COUNT = PER_BLOCK * 3;
+
+static const VkMemoryPropertyFlags HOST_MEMORY =
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+static int alloc(struct gpu_allocator* allocator, VkDeviceSize size, uint32_t flags,
+                 struct gpu_allocation* allocation) {
+    VkMemoryRequirements requirements{};
+    requirements.size = size;
+    requirements.alignment = GPU_GRANULARITY;
+    requirements.memoryTypeBits = ~0u;
+    return gpu_alloc(allocator, &requirements, HOST_MEMORY, GPU_LINEAR, flags, allocation);
+}
+
+/**
+ * The heap's stats against what the test expects to be live.
+ */
+static int check_stats(struct gpu_allocator* allocator, uint32_t heap, const char* step, uint32_t blocks,
+                       uint32_t dedicated, uint32_t allocations, VkDeviceSize used) {
+    struct gpu_stats stats;
+    gpu_allocator_stats(allocator, &stats);
+    const struct gpu_heap_stats* h = &stats.heaps[heap];
+    LOGI("gpu_defrag: %-12s %u blocks + %u dedicated, %u allocations, %.1f MB used, %.1f MB free, "
+         "%u device allocations", step, h->blocks, h->dedicated, h->allocations, (double)h->used / (1 << 20),
+         (double)h->free / (1 << 20), stats.device_allocations);
+    if (h->blocks != blocks || h->dedicated != dedicated || h->allocations != allocations || h->used != used ||
+        stats.device_allocations != blocks + dedicated) {
+        LOGE("gpu_defrag: after %s expected %u blocks + %u dedicated, %u allocations, %llu bytes used", step,
+             blocks, dedicated, allocations, (unsigned long long)used);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Each live allocation starts and ends with its index, so a move that
+ * lost or misplaced data shows up.
+ */
+static void mark(struct gpu_allocation* allocation, uint32_t index) {
+    memcpy(allocation->mapped, &index, sizeof(index));
+    memcpy((uint8_t*)allocation->mapped + allocation->size - sizeof(index), &index, sizeof(index));
+}
+
+static bool marked(const struct gpu_allocation* allocation, uint32_t index) {
+    uint32_t first;
+    uint32_t last;
+    memcpy(&first, allocation->mapped, sizeof(first));
+    memcpy(&last, (const uint8_t*)allocation->mapped + allocation->size - sizeof(last), sizeof(last));
+    return first == index && last == index;
+}
+
+static int run(struct gpu_allocator* allocator) {
+    // the first allocation picks the memory type and creates its block,
+    // which is kept once empty and filled first afterwards
+    struct gpu_allocation probe;
+    if (alloc(allocator, GPU_GRANULARITY, 0, &probe) != 0 || probe.mapped == nullptr) {
+        LOGE("gpu_defrag: no host visible memory");
+        return -1;
+    }
+    VkDeviceSize size = 1;
+    while (size * 2 <= probe.block->size / PER_BLOCK) {
+        size *= 2;
+    }
+    // exactly PER_BLOCK when the block size is a power of two
+    uint32_t per_block = (uint32_t)(probe.block->size / size);
+    uint32_t blocks = (COUNT + per_block - 1) / per_block;
+    uint32_t heap = allocator->memory_properties.memoryTypes[probe.block->memory_type].heapIndex;
+    gpu_free(allocator, &probe);
+    if (check_stats(allocator, heap, "probe freed", 1, 0, 0, 0) != 0) {
+        return -1;
+    }
+
+    // allocations must stay put while live, so never grow this
+    std::vector<struct gpu_allocation> allocations(COUNT);
+    for (uint32_t i = 0; i < COUNT; i++) {
+        if (alloc(allocator, size, 0, &allocations[i]) != 0) {
+            return -1;
+        }
+        mark(&allocations[i], i);
+    }
+    if (check_stats(allocator, heap, "filled", blocks, 0, COUNT, size * COUNT) != 0) {
+        return -1;
+    }
+
+    struct gpu_allocation dedicated;
+    if (alloc(allocator, size, GPU_ALLOC_DEDICATED, &dedicated) != 0 ||
+        check_stats(allocator, heap, "dedicated", blocks, 1, COUNT + 1, size * (COUNT + 1)) != 0) {
+        return -1;
+    }
+    gpu_free(allocator, &dedicated);
+
+    // keep one in four, so every block stays in use but mostly free
+    uint32_t live = 0;
+    for (uint32_t i = 0; i < COUNT; i++) {
+        if (i % 4 != 0) {
+            gpu_free(allocator, &allocations[i]);
+        } else {
+            live++;
+        }
+    }
+    if (check_stats(allocator, heap, "sparse", blocks, 0, live, size * live) != 0) {
+        return -1;
+    }
+
+    // the copies a real caller records on the GPU, done through the mapping
+    std::vector<struct gpu_move> moves(COUNT);
+    int64_t start = platform_time_ns();
+    uint32_t count = gpu_defragment_plan(allocator, moves.data(), COUNT, ~0ull);
+    int64_t planned = platform_time_ns();
+    for (uint32_t i = 0; i < count; i++) {
+        const struct gpu_move* move = &moves[i];
+        memcpy(move->dst_block->mapped + move->dst_offset, move->allocation->mapped, move->size);
+    }
+    gpu_defragment_finish(allocator, moves.data(), count);
+    LOGI("gpu_defrag: %u moves planned in %.3f ms, finished in %.3f ms", count,
+         (double)(planned - start) * 1e-6, (double)(platform_time_ns() - planned) * 1e-6);
+    // a quarter of three blocks' worth fits in one
+    if (check_stats(allocator, heap, "defragmented", 1, 0, live, size * live) != 0) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < COUNT; i += 4) {
+        if (allocations[i].block == nullptr || !marked(&allocations[i], i)) {
+            LOGE("gpu_defrag: allocation %u lost its data in the move", i);
+            return -1;
+        }
+    }
+
+    for (uint32_t i = 0; i < COUNT; i += 4) {
+        gpu_free(allocator, &allocations[i]);
+    }
+    if (check_stats(allocator, heap, "freed", 1, 0, 0, 0) != 0) {
+        return -1;
+    }
+    if (gpu_defragment_plan(allocator, moves.data(), COUNT, ~0ull) != 0) {
+        LOGE("gpu_defrag: planned moves with nothing allocated");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * The block allocator on a real device: sub-allocates three blocks' worth
+ * of host visible memory, a dedicated allocation, frees three requests in
+ * four, then defragments, copying through the mapping, and checks the
+ * allocator's stats after each step and that every survivor kept its
+ * data. Needs a Vulkan device.
+ */
+int bench_gpu_defrag() {
+    struct job_system jobs{};
+    job_system_init(&jobs, 0);
+    struct engine engine{};
+    engine.jobs = &jobs;
+    engine.width = 64;
+    engine.height = 64;
+    engine.scene_entities = 1;
+    if (engine_init(&engine) != 0) {
+        LOGE("gpu_defrag: engine_init failed (no Vulkan device?)");
+        job_system_shutdown(&jobs);
+        return -1;
+    }
+    // its own allocator, so the engine's resources do not show up in the stats
+    struct gpu_allocator allocator;
+    gpu_allocator_init(&allocator, engine.vk.physical_device, engine.vk.device);
+    int result = run(&allocator);
+    gpu_allocator_destroy(&allocator);
+    engine_destroy(&engine);
+    job_system_shutdown(&jobs);
+    return result;
+}
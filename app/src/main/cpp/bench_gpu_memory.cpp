@@ -0,0 +1,131 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "log.h"
+#include "platform.h"
+#include "tlsf.h"
+
+static const uint64_t BLOCK_SIZE = 256ull << 20;
+static const uint64_t GRANULARITY = 256;
+static const uint32_t LIVE = 4096;
+static const uint32_t OPERATIONS = 1u << 20;
+
+/**
+ * Walk the physical chain: ranges must tile the block exactly, free
+ * neighbours must have been merged and every live allocation must be
+ * aligned as requested.
+ */
+static bool validate(const struct tlsf* tlsf, const std::vector<uint32_t>& live,
+                     const std::vector<uint64_t>& alignments) {
+    uint64_t expected = 0;
+    uint64_t used = 0;
+    uint32_t prev = TLSF_NULL;
+    bool prev_free = false;
+    for (uint32_t index = 0; index != TLSF_NULL; index = tlsf_get(tlsf, index)->next_phys) {
+        const struct tlsf_node* node = tlsf_get(tlsf, index);
+        if (node->offset != expected || node->prev_phys != prev || (prev_free && node->free)) {
+            LOGE("gpu_memory: broken chain at node %u (offset %llu, expected %llu)", index,
+                 (unsigned long long)node->offset, (unsigned long long)expected);
+            return false;
+        }
+        if (!node->free) {
+            used += node->size;
+        }
+        expected += node->size;
+        prev = index;
+        prev_free = node->free != 0;
+    }
+    if (expected != tlsf->size || used != tlsf->used_bytes) {
+        LOGE("gpu_memory: ranges cover %llu of %llu bytes", (unsigned long long)expected,
+             (unsigned long long)tlsf->size);
+        return false;
+    }
+    for (size_t i = 0; i < live.size(); i++) {
+        if (live[i] != TLSF_NULL && tlsf_get(tlsf, live[i])->offset % alignments[i] != 0) {
+            LOGE("gpu_memory: misaligned allocation");
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Sizes skewed like real resources: many small uniform and vertex
+ * buffers, fewer large textures.
+ */
+static uint64_t random_size(uint32_t* rng, uint64_t* alignment) {
+    *rng = *rng * 1664525u + 1013904223u;
+    uint32_t r = *rng >> 8;
+    uint32_t bucket = r % 100;
+    *alignment = 1ull << (4 + (r >> 8) % 13);
+    if (bucket < 70) {
+        return 64 + (r >> 12) % (64 << 10);
+    }
+    if (bucket < 95) {
+        return (64 << 10) + (r >> 12) % (1 << 20);
+    }
+    return (1 << 20) + (r >> 12) % (8 << 20);
+}
+
+int bench_gpu_memory() {
+    struct tlsf tlsf;
+    tlsf_init(&tlsf, BLOCK_SIZE, GRANULARITY);
+    std::vector<uint32_t> live(LIVE, TLSF_NULL);
+    std::vector<uint64_t> alignments(LIVE, 1);
+    std::vector<uint64_t> requested(LIVE, 0);
+    uint32_t rng = 11;
+    uint32_t failed = 0;
+    uint64_t requested_bytes = 0;
+
+    int64_t start = platform_time_ns();
+    for (uint32_t op = 0; op < OPERATIONS; op++) {
+        rng = rng * 1664525u + 1013904223u;
+        uint32_t slot = (rng >> 8) % LIVE;
+        if (live[slot] != TLSF_NULL) {
+            tlsf_free(&tlsf, live[slot]);
+            live[slot] = TLSF_NULL;
+            requested_bytes -= requested[slot];
+            continue;
+        }
+        uint64_t alignment;
+        uint64_t size = random_size(&rng, &alignment);
+        live[slot] = tlsf_alloc(&tlsf, size, alignment);
+        if (live[slot] == TLSF_NULL) {
+            failed++;
+            continue;
+        }
+        alignments[slot] = alignment;
+        requested[slot] = size;
+        requested_bytes += size;
+    }
+    int64_t elapsed = platform_time_ns() - start;
+    if (!validate(&tlsf, live, alignments)) {
+        return -1;
+    }
+
+    uint64_t free_bytes = tlsf.size - tlsf.used_bytes;
+    uint64_t largest = tlsf_largest_free(&tlsf);
+    LOGI("gpu_memory: %u alloc/free in %.1f ms, %.0f ns per operation, %u failed",
+         OPERATIONS, (double)elapsed * 1e-6, (double)elapsed / OPERATIONS, failed);
+    LOGI("gpu_memory: %u live, %.1f MB requested, %.1f MB used (%.1f%% rounding waste), "
+         "%.1f MB free, largest free %.1f MB (%.1f%% fragmented)",
+         tlsf.allocation_count, (double)requested_bytes / (1 << 20), (double)tlsf.used_bytes / (1 << 20),
+         100.0 * (double)(tlsf.used_bytes - requested_bytes) / (double)std::max<uint64_t>(tlsf.used_bytes, 1),
+         (double)free_bytes / (1 << 20), (double)largest / (1 << 20),
+         100.0 * (1.0 - (double)largest / (double)std::max<uint64_t>(free_bytes, 1)));
+
+    // freeing everything must merge back into a single range
+    for (uint32_t node : live) {
+        if (node != TLSF_NULL) {
+            tlsf_free(&tlsf, node);
+        }
+    }
+    int result = tlsf_largest_free(&tlsf) == tlsf.size && tlsf.allocation_count == 0 ? 0 : -1;
+    if (result != 0) {
+        LOGE("gpu_memory: free ranges did not merge back");
+    }
+    tlsf_destroy(&tlsf);
+    return result;
+}
@@ -0,0 +1,94 @@
+#include "bench.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include "frame_stats.h"
+#include "input.h"
+#include "log.h"
+#include "platform.h"
+
+struct consumer_check {
+    int64_t last_time_ns;
+    uint64_t out_of_order;
+    struct frame_stats latency;
+};
+
+static void check_event(const struct input_event* event, void* data) {
+    auto* check = (struct consumer_check*)data;
+    if (event->time_ns < check->last_time_ns) {
+        check->out_of_order++;
+    }
+    check->last_time_ns = event->time_ns;
+}
+
+/**
+ * Synthetic ten-finger gesture sampled at 1 kHz and delivered in batches
+ * every 4 ms, roughly what a high-rate touch panel produces, while a
+ * simulation thread consumes at 120 Hz. Verifies nothing is lost or
+ * reordered and reports how long samples wait before the simulation sees
+ * them.
+ */
+int bench_input() {
+    static struct input_queue queue;
+    const int64_t duration_ns = 2000000000LL;
+    const int64_t sample_period_ns = 1000000;
+    const int64_t batch_period_ns = 4000000;
+    const int64_t frame_period_ns = 8333333;
+    std::atomic<int> done{0};
+
+    std::thread producer([&] {
+        int64_t start = platform_time_ns();
+        int64_t next_sample = start;
+        uint32_t sample_index = 0;
+        while (platform_time_ns() - start < duration_ns) {
+            int64_t now = platform_time_ns();
+            // deliver every sample that was "taken" since the last batch
+            while (next_sample <= now) {
+                struct input_event event{};
+                event.time_ns = next_sample;
+                event.type = sample_index == 0 ? INPUT_TOUCH_DOWN : INPUT_TOUCH_MOVE;
+                event.pointer_count = INPUT_MAX_POINTERS;
+                for (uint32_t p = 0; p < INPUT_MAX_POINTERS; p++) {
+                    float phase = (float)sample_index * 0.01f + (float)p;
+                    event.pointers[p] = { (int32_t)p, 500.0f + 300.0f * cosf(phase),
+                                          900.0f + 300.0f * sinf(phase), 1.0f };
+                }
+                input_push(&queue, &event);
+                next_sample += sample_period_ns;
+                sample_index++;
+            }
+            std::this_thread::sleep_for(std::chrono::nanoseconds(batch_period_ns));
+        }
+        done.store(1, std::memory_order_release);
+    });
+
+    struct input_state state{};
+    struct consumer_check check{};
+    check.latency.samples_ns.reserve(512);
+    uint32_t frames = 0;
+    for (;;) {
+        bool finished = done.load(std::memory_order_acquire) != 0;
+        int64_t now = platform_time_ns();
+        input_update(&queue, &state, now, check_event, &check);
+        if (state.events > 0) {
+            frame_stats_add(&check.latency, state.max_latency_ns);
+        }
+        frames++;
+        if (finished && spsc_size(&queue.ring) == 0) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::nanoseconds(frame_period_ns));
+    }
+    producer.join();
+
+    uint64_t pushed = queue.pushed.load();
+    uint64_t dropped = queue.dropped.load();
+    LOGI("input: %u frames, %llu samples pushed, %llu consumed, %llu dropped, %llu out of order",
+         frames, (unsigned long long)pushed, (unsigned long long)state.total_events,
+         (unsigned long long)dropped, (unsigned long long)check.out_of_order);
+    frame_stats_report(&check.latency, "oldest sample age at consume");
+    return dropped == 0 && check.out_of_order == 0 && pushed == state.total_events ? 0 : -1;
+}
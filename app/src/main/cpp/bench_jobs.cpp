@@ -0,0 +1,108 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "jobs.h"
+#include "log.h"
+#include "platform.h"
+
+static void empty_job(void*, uint32_t, uint32_t) {
+}
+
+/**
+ * Enough arithmetic per element that scaling is limited by the scheduler
+ * rather than memory bandwidth.
+ */
+static void compute_job(void* data, uint32_t begin, uint32_t end) {
+    auto* out = (float*)data;
+    for (uint32_t i = begin; i < end; i++) {
+        float x = (float)i * 0.001f;
+        for (int k = 0; k < 64; k++) {
+            x = x * 0.999f + std::sin(x) * 0.001f;
+        }
+        out[i] = x;
+    }
+}
+
+/**
+ * Cost of queuing and running a job on one thread: no stealing involved.
+ */
+static void bench_spawn(uint32_t job_count) {
+    struct job_system js{};
+    job_system_init(&js, 1);
+
+    struct job job{};
+    job.func = empty_job;
+    int64_t start = platform_time_ns();
+    for (uint32_t i = 0; i < job_count; i++) {
+        struct job_counter counter;
+        job_run(&js, &job, 1, &counter);
+        job_wait(&js, &counter);
+    }
+    int64_t elapsed = platform_time_ns() - start;
+    LOGI("spawn+run+wait: %.1f ns/job", (double)elapsed / job_count);
+
+    job_system_shutdown(&js);
+}
+
+/**
+ * Main thread queues empty jobs in batches; workers have to steal them.
+ */
+static void bench_steal(uint32_t threads, uint32_t job_count) {
+    struct job_system js{};
+    job_system_init(&js, threads);
+
+    struct job jobs[256];
+    for (struct job& job : jobs) {
+        job = {};
+        job.func = empty_job;
+    }
+    int64_t start = platform_time_ns();
+    struct job_counter counter;
+    for (uint32_t i = 0; i < job_count; i += 256) {
+        job_run(&js, jobs, 256, &counter);
+        job_wait(&js, &counter);
+    }
+    int64_t elapsed = platform_time_ns() - start;
+    LOGI("batched 256, %u threads: %.1f ns/job", threads, (double)elapsed / job_count);
+
+    job_system_shutdown(&js);
+}
+
+static double run_scaling(uint32_t threads, float* data, uint32_t count) {
+    struct job_system js{};
+    job_system_init(&js, threads);
+    // one warmup pass to wake every worker
+    job_parallel_for(&js, count, 256, compute_job, data);
+    int64_t best = INT64_MAX;
+    for (int rep = 0; rep < 5; rep++) {
+        int64_t start = platform_time_ns();
+        job_parallel_for(&js, count, 256, compute_job, data);
+        best = std::min(best, platform_time_ns() - start);
+    }
+    job_system_shutdown(&js);
+    return (double)best / 1e6;
+}
+
+int bench_jobs() {
+    bench_spawn(1000000);
+
+    uint32_t max_threads = std::min((uint32_t)MAX_JOB_WORKERS,
+                                    std::max(1u, std::thread::hardware_concurrency()));
+    for (uint32_t threads = 2; threads <= max_threads; threads *= 2) {
+        bench_steal(threads, 1u << 20);
+    }
+
+    const uint32_t count = 1u << 18;
+    auto* data = new float[count];
+    double base = run_scaling(1, data, count);
+    LOGI("parallel_for 1 thread: %.3f ms", base);
+    for (uint32_t threads = 2; threads <= max_threads; threads++) {
+        double ms = run_scaling(threads, data, count);
+        LOGI("parallel_for %u threads: %.3f ms (%.2fx)", threads, ms, base / ms);
+    }
+    delete[] data;
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include "bench.h"
+
+#include <vector>
+
+#include "log.h"
+#include "mesh.h"
+#include "torus_mesh.h"
+#include "vecmath.h"
+
+static const uint32_t INSTANCES = 20000;
+// instances thin out with distance, evenly spread over log distance, so
+// every LOD covers a sizeable band of the visible set
+static const float NEAREST = 4.0f;
+static const float FURTHEST = 100.0f;
+static const int FRAMES = 1800;
+static const float FOVY = 1.0f;
+static const float SCREEN_HEIGHT = 1080.0f;
+static const float THRESHOLD_PIXELS = 1.0f;
+static const float HYSTERESIS = 0.25f;
+// a switch back within this many frames of the last one is a pop
+static const int POP_FRAMES = 30;
+// each LOD is drawn for at least this share of visible instances
+static const double MIN_LOD_SHARE = 0.05;
+
+/**
+ * An instance's LOD under one selection policy, and its last switch.
+ */
+struct lod_state {
+    uint32_t lod;
+    int direction;
+    int switched_frame;
+};
+
+struct lod_instance {
+    struct vec3 position;
+    float scale;
+    struct lod_state hysteresis;
+    struct lod_state plain;
+};
+
+struct lod_counts {
+    uint64_t switches;
+    uint64_t pops;
+};
+
+static void lod_switch(struct lod_state* state, uint32_t lod, int frame, struct lod_counts* counts) {
+    if (lod == state->lod) {
+        return;
+    }
+    int direction = lod > state->lod ? 1 : -1;
+    counts->switches++;
+    if (direction != state->direction && frame - state->switched_frame < POP_FRAMES) {
+        counts->pops++;
+    }
+    state->lod = lod;
+    state->direction = direction;
+    state->switched_frame = frame;
+}
+
+/**
+ * Standing in the middle of the field at head height, turning around once
+ * over the run while swaying and bobbing, so distances to everything
+ * wobble a little every frame like they do under a real camera.
+ */
+static void camera(int frame, struct mat4* view_proj) {
+    float t = (float)frame / 60.0f;
+    float bob = sinf(t * 9.0f) * 0.15f;
+    float heading = 2.0f * (float)M_PI * (float)frame / (float)FRAMES;
+    struct vec3 eye = { sinf(t * 0.7f) * 0.5f, 1.7f + bob, cosf(t * 0.5f) * 0.5f };
+    struct vec3 target = { eye.x + sinf(heading), 1.5f, eye.z + cosf(heading) };
+    struct mat4 view = mat4_look_at(eye, target, { 0.0f, 1.0f, 0.0f });
+    struct mat4 proj = mat4_perspective(FOVY, 16.0f / 9.0f, 0.1f, 500.0f);
+    *view_proj = mat4_mul(&proj, &view);
+}
+
+/**
+ * A field of 20000 demo tori from 4 to 100 units away, looked around for
+ * 30 seconds with LODs picked by projected error (1 pixel) and no device. The LOD table
+ * is the one build_mesh.py --demo torus writes, embedded at build time
+ * and read with mesh_parse. Reports triangles submitted per frame with
+ * and without LODs, and how often instances switch LOD, and switch
+ * straight back, with and without hysteresis. Also checks that the
+ * selection never draws an LOD whose error is visibly off, and that every
+ * LOD is drawn for at least 5% of the visible instances.
+ */
+int bench_lod() {
+    struct mesh_data torus;
+    if (mesh_parse(torus_mesh, sizeof(torus_mesh), &torus) != 0) {
+        return -1;
+    }
+    const struct mesh_lod* lods = torus.lods;
+    LOGI("lod: demo torus has %u LODs, %u to %u triangles", torus.lod_count, lods[0].index_count / 3,
+         lods[torus.lod_count - 1].index_count / 3);
+
+    std::vector<struct lod_instance> instances(INSTANCES);
+    uint32_t rng = 5;
+    for (struct lod_instance& instance : instances) {
+        rng = rng * 1664525u + 1013904223u;
+        float distance = NEAREST * powf(FURTHEST / NEAREST, (float)(rng >> 8) / 16777216.0f);
+        rng = rng * 1664525u + 1013904223u;
+        float angle = (float)(rng >> 8) / 16777216.0f * 2.0f * (float)M_PI;
+        rng = rng * 1664525u + 1013904223u;
+        instance.scale = 0.5f + (float)(rng >> 8) / 16777216.0f * 2.5f;
+        instance.position = { sinf(angle) * distance, instance.scale * 0.35f, cosf(angle) * distance };
+        instance.hysteresis = { 0, 0, -POP_FRAMES };
+        instance.plain = instance.hysteresis;
+    }
+
+    const float focal = SCREEN_HEIGHT * 0.5f / tanf(FOVY * 0.5f);
+    uint64_t full_triangles = 0;
+    uint64_t lod_triangles = 0;
+    struct lod_counts with_hysteresis{};
+    struct lod_counts without_hysteresis{};
+    uint64_t visible = 0;
+    uint64_t lod_histogram[MESH_MAX_LODS] = {};
+    int result = 0;
+    for (int frame = 0; frame < FRAMES; frame++) {
+        struct mat4 view_proj;
+        camera(frame, &view_proj);
+        for (struct lod_instance& instance : instances) {
+            struct vec4 clip = mat4_mul_vec4(&view_proj, vec4_from_vec3(instance.position, 1.0f));
+            float radius = instance.scale * 1.35f;
+            float margin = clip.w + radius * 2.0f;
+            if (clip.w < -radius || fabsf(clip.x) > margin || fabsf(clip.y) > margin) {
+                continue;
+            }
+            // up close the nearest point is what matters
+            float depth = fmaxf(clip.w - radius, 0.1f);
+            float pixels_per_unit = focal * instance.scale / depth;
+            uint32_t lod = mesh_lod_select(lods, torus.lod_count, instance.hysteresis.lod, pixels_per_unit,
+                                           THRESHOLD_PIXELS, HYSTERESIS);
+            uint32_t plain = mesh_lod_select(lods, torus.lod_count, instance.plain.lod, pixels_per_unit,
+                                             THRESHOLD_PIXELS, 0.0f);
+            if (lods[lod].error * pixels_per_unit > THRESHOLD_PIXELS * (1.0f + HYSTERESIS)) {
+                LOGE("lod: LOD %u is %.2f pixels off", lod, (double)(lods[lod].error * pixels_per_unit));
+                result = -1;
+            }
+            lod_switch(&instance.hysteresis, lod, frame, &with_hysteresis);
+            lod_switch(&instance.plain, plain, frame, &without_hysteresis);
+            full_triangles += lods[0].index_count / 3;
+            lod_triangles += lods[lod].index_count / 3;
+            lod_histogram[lod]++;
+            visible++;
+        }
+    }
+
+    LOGI("lod: %.0f instances visible per frame, %.2fM triangles per frame without LODs, %.2fM with "
+         "(%.1fx fewer)", (double)visible / FRAMES, (double)full_triangles / FRAMES * 1e-6,
+         (double)lod_triangles / FRAMES * 1e-6, (double)full_triangles / (double)lod_triangles);
+    for (uint32_t i = 0; i < torus.lod_count; i++) {
+        double share = (double)lod_histogram[i] / (double)visible;
+        LOGI("lod: LOD %u (%u triangles) drawn for %.1f%% of visible instances", i, lods[i].index_count / 3,
+             100.0 * share);
+        if (share < MIN_LOD_SHARE) {
+            LOGE("lod: LOD %u drawn for under %.0f%% of visible instances", i, MIN_LOD_SHARE * 100.0);
+            result = -1;
+        }
+    }
+    LOGI("lod: %.0f%% hysteresis: %.1f LOD switches per frame, %llu popped back within %d frames; "
+         "without: %.1f and %llu", HYSTERESIS * 100.0, (double)with_hysteresis.switches / FRAMES,
+         (unsigned long long)with_hysteresis.pops, POP_FRAMES, (double)without_hysteresis.switches / FRAMES,
+         (unsigned long long)without_hysteresis.pops);
+    return result;
+}
@@ -0,0 +1,102 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "log.h"
+#include "platform.h"
+#include "vecmath.h"
+
+static const char* simd_name() {
+#if VECMATH_NEON
+    return "NEON";
+#elif VECMATH_SSE
+    return "SSE";
+#else
+    return "scalar";
+#endif
+}
+
+template <typename F>
+static double best_of(int reps, F&& f) {
+    int64_t best = INT64_MAX;
+    for (int i = 0; i < reps; i++) {
+        int64_t start = platform_time_ns();
+        f();
+        best = std::min(best, platform_time_ns() - start);
+    }
+    return (double)best;
+}
+
+static float max_error(const std::vector<struct vec4>& a, const std::vector<struct vec4>& b) {
+    float error = 0.0f;
+    for (size_t i = 0; i < a.size(); i++) {
+        error = std::max(error, fabsf(a[i].x - b[i].x));
+        error = std::max(error, fabsf(a[i].y - b[i].y));
+        error = std::max(error, fabsf(a[i].z - b[i].z));
+        error = std::max(error, fabsf(a[i].w - b[i].w));
+    }
+    return error;
+}
+
+int bench_math() {
+    const size_t count = 1 << 20;
+    struct mat4 view = mat4_look_at({ 3.0f, 4.0f, 5.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+    struct mat4 proj = mat4_perspective(1.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+    struct mat4 model = mat4_from_trs({ 1.0f, 2.0f, 3.0f },
+                                      quat_from_axis_angle({ 0.0f, 1.0f, 0.0f }, 0.7f),
+                                      { 2.0f, 2.0f, 2.0f });
+    struct mat4 view_proj = mat4_mul(&proj, &view);
+    struct mat4 mvp = mat4_mul(&view_proj, &model);
+
+    std::vector<struct vec3> points(count);
+    std::vector<struct vec4> vectors(count);
+    for (size_t i = 0; i < count; i++) {
+        float f = (float)i;
+        points[i] = { sinf(f), cosf(f * 0.5f), f * 1e-5f };
+        vectors[i] = vec4_from_vec3(points[i], 1.0f);
+    }
+    std::vector<struct vec4> out_simd(count);
+    std::vector<struct vec4> out_scalar(count);
+
+    LOGI("math: %s kernels, %zu elements", simd_name(), count);
+
+    double simd = best_of(10, [&] { mat4_transform_points(&mvp, points.data(), out_simd.data(), count); });
+    double scalar = best_of(10, [&] { mat4_transform_points_scalar(&mvp, points.data(), out_scalar.data(), count); });
+    LOGI("transform_points: %.2f ns/point vs scalar %.2f ns/point (%.2fx), max error %g",
+         simd / count, scalar / count, scalar / simd, max_error(out_simd, out_scalar));
+
+    simd = best_of(10, [&] { mat4_transform_vec4(&mvp, vectors.data(), out_simd.data(), count); });
+    scalar = best_of(10, [&] { mat4_transform_vec4_scalar(&mvp, vectors.data(), out_scalar.data(), count); });
+    LOGI("transform_vec4: %.2f ns/vector vs scalar %.2f ns/vector (%.2fx), max error %g",
+         simd / count, scalar / count, scalar / simd, max_error(out_simd, out_scalar));
+
+    // chained so the compiler cannot hoist the multiply out of the loop
+    const int muls = 1 << 20;
+    struct mat4 acc_simd = mat4_identity();
+    struct mat4 acc_scalar = mat4_identity();
+    struct mat4 step = mat4_from_quat(quat_from_axis_angle({ 1.0f, 1.0f, 0.0f }, 1e-3f));
+    simd = best_of(3, [&] {
+        for (int i = 0; i < muls; i++) {
+            acc_simd = mat4_mul(&acc_simd, &step);
+        }
+    });
+    scalar = best_of(3, [&] {
+        for (int i = 0; i < muls; i++) {
+            acc_scalar = mat4_mul_scalar(&acc_scalar, &step);
+        }
+    });
+    LOGI("mat4_mul: %.2f ns vs scalar %.2f ns (%.2fx), check %g", simd / muls, scalar / muls,
+         scalar / simd, fabsf(acc_simd.cols[0].x - acc_scalar.cols[0].x));
+
+    struct mat4 inverse = mat4_inverse(&mvp);
+    struct mat4 product = mat4_mul(&inverse, &mvp);
+    struct mat4 identity = mat4_identity();
+    float error = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        error = std::max(error, fabsf((&product.cols[0].x)[i] - (&identity.cols[0].x)[i]));
+    }
+    LOGI("mat4_inverse: max |M^-1 M - I| = %g", error);
+    return error < 1e-3f && max_error(out_simd, out_scalar) < 1e-3f ? 0 : -1;
+}
@@ -0,0 +1,148 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "log.h"
+#include "mesh.h"
+#include "mesh_shader.h"
+#include "torus_mesh.h"
+#include "vecmath.h"
+
+// build_mesh.py's demo_torus: ring radius 1 around y, tube radius 0.35
+static const float TORUS_MAJOR = 1.0f;
+static const float TORUS_MINOR = 0.35f;
+// half float positions across the bounds are good to about 1e-3 of the
+// extent; normals are compared with the torus' normal at the rounded
+// position, which is itself a little off
+static const float MAX_RADIUS_ERROR = 0.001f;
+static const float MAX_NORMAL_DEGREES = 0.5f;
+static const float MAX_CLIP_ERROR = 1e-4f;
+
+static struct vec3 vec3_from_vec4(struct vec4 v) {
+    return { v.x, v.y, v.z };
+}
+
+/**
+ * Every LOD indexes inside the vertex buffer, and within the vertices of
+ * the LOD before it, so each LOD's vertices are a prefix.
+ */
+static int check_indices(const struct mesh_data* mesh) {
+    const auto* indices = (const uint16_t*)mesh->indices;
+    uint32_t prefix = mesh->vertex_count;
+    for (uint32_t lod = 0; lod < mesh->lod_count; lod++) {
+        uint32_t used = 0;
+        for (uint32_t i = 0; i < mesh->lods[lod].index_count; i++) {
+            used = std::max(used, (uint32_t)indices[mesh->lods[lod].first_index + i] + 1);
+        }
+        LOGI("mesh: LOD %u: %u triangles over %u vertices, error %.5f", lod, mesh->lods[lod].index_count / 3, used,
+             (double)mesh->lods[lod].error);
+        if (used > prefix) {
+            LOGE("mesh: LOD %u uses %u vertices, more than the %u of the LOD before", lod, used, prefix);
+            return -1;
+        }
+        prefix = used;
+    }
+    return 0;
+}
+
+/**
+ * Decoded positions against the torus' surface and decoded normals
+ * against its analytic normals.
+ */
+static int check_vertices(const struct mesh_data* mesh) {
+    float min_radius = INFINITY;
+    float max_radius = 0.0f;
+    float max_length_error = 0.0f;
+    float min_cos = 1.0f;
+    for (uint32_t v = 0; v < mesh->vertex_count; v++) {
+        struct vec3 p = mesh_decode_position(mesh, v);
+        float ring = sqrtf(p.x * p.x + p.z * p.z);
+        float outward = ring - TORUS_MAJOR;
+        float radius = sqrtf(outward * outward + p.y * p.y);
+        min_radius = fminf(min_radius, radius);
+        max_radius = fmaxf(max_radius, radius);
+
+        struct vec3 n = mesh_decode_normal(mesh, v);
+        struct vec3 expected = vec3_normalize({ outward * p.x / ring, p.y, outward * p.z / ring });
+        max_length_error = fmaxf(max_length_error, fabsf(vec3_length(n) - 1.0f));
+        min_cos = fminf(min_cos, vec3_dot(n, expected));
+    }
+    float max_degrees = acosf(fminf(min_cos, 1.0f)) * 180.0f / (float)M_PI;
+    LOGI("mesh: %u vertices, tube radius %.4f to %.4f, normals up to %.3f degrees off and %.1e off unit length",
+         mesh->vertex_count, (double)min_radius, (double)max_radius, (double)max_degrees,
+         (double)max_length_error);
+    if (min_radius < TORUS_MINOR - MAX_RADIUS_ERROR || max_radius > TORUS_MINOR + MAX_RADIUS_ERROR ||
+        max_degrees > MAX_NORMAL_DEGREES || max_length_error > 1e-5f) {
+        LOGE("mesh: decoded vertices are not on the torus");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * What mesh.vert computes from the push constants and the encoded
+ * position, against transforming the decoded position directly.
+ */
+static int check_push_constants(const struct mesh_data* mesh) {
+    struct mat4 view_proj = mat4_perspective(1.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+    struct mat4 view = mat4_look_at({ 2.0f, 3.0f, 6.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+    view_proj = mat4_mul(&view_proj, &view);
+    struct quat rotation = quat_from_axis_angle({ 0.0f, 0.0f, 1.0f }, 0.7f);
+    struct mat4 model = mat4_from_trs({ 0.5f, -0.25f, 1.0f }, rotation, { 1.5f, 1.5f, 1.5f });
+    struct mesh_push_constants push;
+    mesh_push_constants(mesh, &view_proj, &model, &push);
+    struct mat4 clip_from_model = mat4_mul(&view_proj, &model);
+
+    const struct mesh_header* h = mesh->header;
+    float max_error = 0.0f;
+    float min_cos = 1.0f;
+    for (uint32_t v = 0; v < mesh->vertex_count; v++) {
+        struct vec3 p = mesh_decode_position(mesh, v);
+        struct vec3 encoded = { (p.x - h->position_center[0]) / h->position_extent[0],
+                                (p.y - h->position_center[1]) / h->position_extent[1],
+                                (p.z - h->position_center[2]) / h->position_extent[2] };
+        struct vec4 clip = mat4_mul_vec4(&push.clip_from_mesh, vec4_from_vec3(encoded, 1.0f));
+        struct vec4 expected = mat4_mul_vec4(&clip_from_model, vec4_from_vec3(p, 1.0f));
+        float error = fmaxf(fmaxf(fabsf(clip.x - expected.x), fabsf(clip.y - expected.y)),
+                            fmaxf(fabsf(clip.z - expected.z), fabsf(clip.w - expected.w)));
+        max_error = fmaxf(max_error, error / fmaxf(fabsf(expected.w), 1.0f));
+
+        struct vec3 n = mesh_decode_normal(mesh, v);
+        struct vec3 world = vec3_scale(vec3_from_vec4(push.normal_matrix[0]), n.x);
+        world = vec3_add(world, vec3_scale(vec3_from_vec4(push.normal_matrix[1]), n.y));
+        world = vec3_add(world, vec3_scale(vec3_from_vec4(push.normal_matrix[2]), n.z));
+        min_cos = fminf(min_cos, vec3_dot(vec3_normalize(world), quat_rotate(rotation, n)));
+    }
+    LOGI("mesh: push constants: clip positions within %.1e, normals within %.1e of the reference",
+         (double)max_error, (double)(1.0f - min_cos));
+    if (max_error > MAX_CLIP_ERROR || 1.0f - min_cos > 1e-5f) {
+        LOGE("mesh: mesh_push_constants does not match transforming the decoded mesh");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * The demo torus as tools/build_mesh.py writes it, embedded at build
+ * time: parses it with mesh_parse, checks the LOD ranges, that decoded
+ * positions and normals lie on the torus, and that the push constants
+ * mesh.vert draws with place every vertex where the model matrix does.
+ * Keeps the C++ side of the format from drifting from the tool's.
+ */
+int bench_mesh() {
+    struct mesh_data mesh;
+    if (mesh_parse(torus_mesh, sizeof(torus_mesh), &mesh) != 0) {
+        return -1;
+    }
+    if (mesh.index_type != VK_INDEX_TYPE_UINT16 || mesh.lod_count < 2 || mesh.lods[0].first_index != 0 ||
+        mesh.lods[0].error != 0.0f) {
+        LOGE("mesh: expected 16-bit indices and a LOD chain starting with the input, got %u LODs",
+             mesh.lod_count);
+        return -1;
+    }
+    if (check_indices(&mesh) != 0 || check_vertices(&mesh) != 0 || check_push_constants(&mesh) != 0) {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "frame_pacer.h"
+#include "frame_stats.h"
+#include "log.h"
+
+/**
+ * Virtual-time display: vsyncs every refresh_ns, frames cost a noisy amount
+ * of time with the odd spike, and a frame is shown at the first vsync after
+ * it is ready (and not before its requested vsync).
+ */
+struct sim_display {
+    int64_t refresh_ns;
+    uint32_t rng;
+};
+
+static int64_t sim_vsync_after(const struct sim_display* display, int64_t t) {
+    return (t + display->refresh_ns - 1) / display->refresh_ns * display->refresh_ns;
+}
+
+static int64_t sim_work(struct sim_display* display, int64_t mean_ns) {
+    display->rng = display->rng * 1664525u + 1013904223u;
+    double u = (double)(display->rng >> 8) / 16777216.0;
+    int64_t jitter = (int64_t)((u - 0.5) * 0.3 * (double)mean_ns);
+    // one frame in fifty takes twice as long
+    if ((display->rng >> 4) % 50 == 0) {
+        jitter += mean_ns;
+    }
+    return mean_ns + jitter;
+}
+
+struct sim_result {
+    struct frame_stats jitter;
+    struct frame_stats latency;
+    uint32_t missed;
+};
+
+static void simulate(double display_hz, double target_hz, int64_t work_mean_ns, bool paced,
+                     struct sim_result* result) {
+    const int frames = 2000;
+    // the real display runs slightly off nominal, the pacer has to find it
+    struct sim_display display{ (int64_t)(1e9 / (display_hz * 0.999)), 7 };
+    struct frame_pacer pacer;
+    frame_pacer_init(&pacer, display_hz, target_hz);
+    int64_t target_period = display.refresh_ns * pacer.interval;
+
+    int64_t now = 0;
+    int64_t previous_present = 0;
+    result->jitter.samples_ns.reserve(frames);
+    result->latency.samples_ns.reserve(frames);
+    for (int i = 0; i < frames; i++) {
+        int64_t start;
+        int64_t desired = 0;
+        if (paced) {
+            start = frame_pacer_begin_frame(&pacer, now);
+            desired = frame_pacer_target_vsync(&pacer);
+        } else {
+            // classic loop: start right away, throttled only by a two-deep
+            // swapchain queue
+            start = std::max(now, previous_present - display.refresh_ns);
+        }
+        int64_t ready = start + sim_work(&display, work_mean_ns);
+        int64_t present = sim_vsync_after(&display, std::max(ready, desired));
+        if (previous_present != 0) {
+            present = std::max(present, previous_present + display.refresh_ns);
+        }
+
+        if (paced) {
+            frame_pacer_frame_done(&pacer, ready - start);
+            frame_pacer_presented(&pacer, present);
+        }
+        if (i > 100 && previous_present != 0) {
+            int64_t interval = present - previous_present;
+            frame_stats_add(&result->jitter, std::abs(interval - target_period));
+            frame_stats_add(&result->latency, present - start);
+            if (interval > target_period + display.refresh_ns / 2) {
+                result->missed++;
+            }
+        }
+        previous_present = present;
+        now = ready;
+    }
+}
+
+static void report(const char* label, double display_hz, double target_hz, int64_t work_ns, bool paced) {
+    struct sim_result result{};
+    simulate(display_hz, target_hz, work_ns, paced, &result);
+    struct frame_stats_summary jitter = frame_stats_summarize(&result.jitter);
+    struct frame_stats_summary latency = frame_stats_summarize(&result.latency);
+    LOGI("%-7s %3.0f Hz on %3.0f Hz, work %4.1f ms: interval jitter p50 %.3f p95 %.3f p99 %.3f ms, "
+         "start-to-present p50 %.2f p99 %.2f ms, %u missed",
+         label, target_hz, display_hz, work_ns / 1e6, jitter.p50_ms, jitter.p95_ms, jitter.p99_ms,
+         latency.p50_ms, latency.p99_ms, result.missed);
+}
+
+int bench_pacer() {
+    const struct {
+        double display_hz;
+        double target_hz;
+        int64_t work_ns;
+    } cases[] = {
+        { 60.0, 30.0, 12000000 },
+        { 60.0, 60.0, 6000000 },
+        { 90.0, 90.0, 5000000 },
+        { 120.0, 120.0, 4000000 },
+        { 120.0, 60.0, 8000000 },
+    };
+    for (const auto& c : cases) {
+        if (c.display_hz == c.target_hz) {
+            report("vsync", c.display_hz, c.target_hz, c.work_ns, false);
+        }
+        report("paced", c.display_hz, c.target_hz, c.work_ns, true);
+    }
+    return 0;
+}
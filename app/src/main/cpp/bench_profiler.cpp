@@ -0,0 +1,127 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "log.h"
+#include "platform.h"
+#include "profiler.h"
+
+static const uint32_t BATCHES = 64;
+// stays under PROFILER_RING_CAPACITY so nothing is dropped between drains
+static const uint32_t ZONES_PER_BATCH = 4096;
+static const uint32_t THREADS = 4;
+// what recording a zone may cost beyond reading the clock twice
+static const double MAX_ZONE_NS = 50.0;
+
+static inline void compiler_barrier() {
+    asm volatile("" ::: "memory");
+}
+
+/**
+ * ns per iteration of a loop that opens and closes one zone (or, for the
+ * baseline, nothing). The ring is drained between batches, like the frame
+ * marker does once per frame.
+ */
+static double time_zones(bool zones, bool drain) {
+    int64_t total = 0;
+    for (uint32_t batch = 0; batch < BATCHES; batch++) {
+        int64_t start = platform_time_ns();
+        for (uint32_t i = 0; i < ZONES_PER_BATCH; i++) {
+            if (zones) {
+                profile_scope scope("bench_zone");
+                compiler_barrier();
+            } else {
+                compiler_barrier();
+            }
+        }
+        total += platform_time_ns() - start;
+        if (drain) {
+            profiler_frame_mark();
+        }
+    }
+    return (double)total / (double)(BATCHES * ZONES_PER_BATCH);
+}
+
+/**
+ * ns per profiler_ticks() call. Under virtualization the cycle counter can
+ * trap, which then dominates zone cost.
+ */
+static double time_ticks() {
+    const uint32_t count = BATCHES * ZONES_PER_BATCH;
+    uint64_t sink = 0;
+    int64_t start = platform_time_ns();
+    for (uint32_t i = 0; i < count; i++) {
+        sink += profiler_ticks();
+    }
+    int64_t elapsed = platform_time_ns() - start;
+    compiler_barrier();
+    return sink != 0 ? (double)elapsed / (double)count : 0.0;
+}
+
+/**
+ * Cost of a zone with the profiler idle, recording, and recording on
+ * several threads at once, and writes the capture. Fails when recording
+ * a zone costs more than 50 ns on top of its two timestamps: those are
+ * the clock's cost rather than the profiler's, and under virtualization
+ * reading the clock can trap and take most of that budget by itself.
+ */
+int bench_profiler() {
+    profiler_set_thread_name("main");
+    // warm up the thread's ring and the clock
+    time_zones(true, false);
+
+    double ticks = time_ticks();
+    double baseline = time_zones(false, false);
+    double idle = time_zones(true, false);
+
+    profiler_begin_capture(BATCHES * (ZONES_PER_BATCH + 1) * (THREADS + 1));
+    double recording = time_zones(true, true);
+
+    // concurrent producers, each on its own ring; the main thread drains
+    std::atomic<uint32_t> finished{0};
+    std::vector<double> thread_ns(THREADS);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < THREADS; t++) {
+        threads.emplace_back([&, t] {
+            profiler_set_thread_name("bench producer");
+            int64_t total = 0;
+            for (uint32_t batch = 0; batch < BATCHES; batch++) {
+                int64_t start = platform_time_ns();
+                for (uint32_t i = 0; i < ZONES_PER_BATCH / 4; i++) {
+                    profile_scope scope("bench_zone");
+                    compiler_barrier();
+                }
+                total += platform_time_ns() - start;
+                std::this_thread::yield();
+            }
+            thread_ns[t] = (double)total / (double)(BATCHES * ZONES_PER_BATCH / 4);
+            finished.fetch_add(1, std::memory_order_release);
+        });
+    }
+    while (finished.load(std::memory_order_acquire) < THREADS) {
+        profiler_frame_mark();
+        std::this_thread::yield();
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    int result = profiler_end_capture("profiler_bench.json");
+
+    double contended = 0.0;
+    for (double ns : thread_ns) {
+        contended = std::max(contended, ns);
+    }
+    LOGI("profiler: timestamp %.1f ns, empty loop %.1f ns, idle zone %.1f ns, recording zone %.1f ns, "
+         "%u threads recording %.1f ns (worst)", ticks, baseline, idle, recording, THREADS, contended);
+    double cost = recording - baseline - 2.0 * ticks;
+    LOGI("profiler: %.1f ns per zone on top of its two timestamps", cost);
+    if (cost > MAX_ZONE_NS) {
+        LOGE("profiler: recording a zone costs %.1f ns on top of its timestamps, above the %.0f ns budget", cost,
+             MAX_ZONE_NS);
+        return -1;
+    }
+    return result;
+}
@@ -0,0 +1,86 @@
+#include "bench.h"
+
+#include <vector>
+
+#include "engine.h"
+#include "frame_stats.h"
+#include "log.h"
+#include "platform.h"
+
+static const uint32_t ENTITIES = 20000;
+static const int WARMUP = 30;
+static const int FRAMES = 200;
+// the camera sees nearly every entity, each drawn on its own
+static const uint32_t MIN_DRAWS = ENTITIES / 2;
+// what splitting the recording across every worker has to gain at least
+static const double MIN_SPEEDUP = 1.3;
+
+/**
+ * Main pass recording time against the number of recording threads, on
+ * the headless surface. Unlike the other benches this one needs a Vulkan
+ * device (lavapipe will do). Batching would merge the scene into one
+ * instanced draw per material, leaving nothing to split, so every entity
+ * gets a draw of its own: fails unless that is thousands of draws and
+ * the most threads record them at least MIN_SPEEDUP times faster than
+ * one.
+ */
+int bench_record() {
+    struct job_system jobs{};
+    job_system_init(&jobs, 0);
+
+    struct engine engine{};
+    engine.jobs = &jobs;
+    engine.width = 1280;
+    engine.height = 720;
+    engine.scene_entities = ENTITIES;
+    engine.record_threads = 1;
+    engine.animating = 1;
+    if (engine_init(&engine) != 0) {
+        LOGE("record: engine_init failed (no Vulkan device?)");
+        job_system_shutdown(&jobs);
+        return -1;
+    }
+    engine.scene_renderer.batcher.per_item = 1;
+
+    std::vector<uint32_t> thread_counts;
+    for (uint32_t threads = 1; threads < jobs.worker_count; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(jobs.worker_count);
+
+    double single_ms = 0.0;
+    double speedup = 0.0;
+    uint32_t draws = 0;
+    for (uint32_t threads : thread_counts) {
+        engine.record_threads = threads;
+        struct frame_stats stats;
+        stats.samples_ns.reserve(FRAMES);
+        for (int i = 0; i < WARMUP + FRAMES; i++) {
+            engine_draw(&engine);
+            if (i >= WARMUP) {
+                frame_stats_add(&stats, engine.stats.record_ns);
+            }
+        }
+        struct frame_stats_summary summary = frame_stats_summarize(&stats);
+        if (threads == 1) {
+            single_ms = summary.avg_ms;
+        }
+        speedup = summary.avg_ms > 0.0 ? single_ms / summary.avg_ms : 0.0;
+        draws = engine.stats.draws;
+        LOGI("record: %2u threads, %u draws: avg %.3f ms, p95 %.3f ms (%.2fx)", threads, draws,
+             summary.avg_ms, summary.p95_ms, speedup);
+    }
+
+    engine_destroy(&engine);
+    job_system_shutdown(&jobs);
+    if (draws < MIN_DRAWS) {
+        LOGE("record: only %u draws, expected at least %u", draws, MIN_DRAWS);
+        return -1;
+    }
+    if (thread_counts.back() > 1 && speedup < MIN_SPEEDUP) {
+        LOGE("record: %u threads are only %.2fx faster than one, expected %.2fx", thread_counts.back(), speedup,
+             MIN_SPEEDUP);
+        return -1;
+    }
+    return 0;
+}
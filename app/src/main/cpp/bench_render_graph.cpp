@@ -0,0 +1,157 @@
+#include "bench.h"
+
+#include "log.h"
+#include "platform.h"
+#include "render_graph.h"
+
+static const uint32_t WIDTH = 1920;
+static const uint32_t HEIGHT = 1080;
+static const int COMPILES = 10000;
+
+static void execute_nothing(void*, VkCommandBuffer, const struct rg_pass*) {}
+
+/**
+ * A deferred frame: gbuffer, lighting, half resolution bloom and tonemap
+ * into the backbuffer, plus a debug overlay nothing reads. Lighting reads
+ * the gbuffer through textures, or as input attachments.
+ */
+struct deferred_images {
+    uint32_t normal;
+    uint32_t hdr;
+    uint32_t bloom;
+};
+
+static void build_deferred(struct render_graph* graph, bool input_attachments, struct deferred_images* images) {
+    const VkClearValue clear{};
+    render_graph_reset(graph);
+    uint32_t backbuffer = rg_import_image(graph, "backbuffer", VK_FORMAT_B8G8R8A8_UNORM, WIDTH, HEIGHT,
+                                          VK_IMAGE_LAYOUT_UNDEFINED,
+                                          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    rg_mark_output(graph, backbuffer, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    uint32_t depth = rg_create_image(graph, "depth", VK_FORMAT_D32_SFLOAT, WIDTH, HEIGHT);
+    uint32_t albedo = rg_create_image(graph, "albedo", VK_FORMAT_R8G8B8A8_UNORM, WIDTH, HEIGHT);
+    uint32_t normal = rg_create_image(graph, "normal", VK_FORMAT_R16G16B16A16_SFLOAT, WIDTH, HEIGHT);
+    uint32_t hdr = rg_create_image(graph, "hdr", VK_FORMAT_R16G16B16A16_SFLOAT, WIDTH, HEIGHT);
+    uint32_t bloom = rg_create_image(graph, "bloom", VK_FORMAT_R16G16B16A16_SFLOAT, WIDTH / 2, HEIGHT / 2);
+    uint32_t debug = rg_create_image(graph, "debug", VK_FORMAT_R8G8B8A8_UNORM, WIDTH, HEIGHT);
+    images->normal = normal;
+    images->hdr = hdr;
+    images->bloom = bloom;
+
+    uint32_t pass = rg_add_pass(graph, "gbuffer", RG_GRAPHICS, execute_nothing, nullptr);
+    rg_use(graph, pass, albedo, RG_COLOR_ATTACHMENT, &clear);
+    rg_use(graph, pass, normal, RG_COLOR_ATTACHMENT, &clear);
+    rg_use(graph, pass, depth, RG_DEPTH_ATTACHMENT, &clear);
+
+    pass = rg_add_pass(graph, "lighting", RG_GRAPHICS, execute_nothing, nullptr);
+    enum rg_access gbuffer_read = input_attachments ? RG_INPUT_ATTACHMENT : RG_SAMPLED;
+    rg_use(graph, pass, albedo, gbuffer_read);
+    rg_use(graph, pass, normal, gbuffer_read);
+    rg_use(graph, pass, depth, RG_DEPTH_READ);
+    rg_use(graph, pass, hdr, RG_COLOR_ATTACHMENT, &clear);
+
+    pass = rg_add_pass(graph, "bloom", RG_GRAPHICS, execute_nothing, nullptr);
+    rg_use(graph, pass, hdr, RG_SAMPLED);
+    rg_use(graph, pass, bloom, RG_COLOR_ATTACHMENT, &clear);
+
+    pass = rg_add_pass(graph, "debug_overlay", RG_GRAPHICS, execute_nothing, nullptr);
+    rg_use(graph, pass, depth, RG_SAMPLED);
+    rg_use(graph, pass, debug, RG_COLOR_ATTACHMENT, &clear);
+
+    pass = rg_add_pass(graph, "tonemap", RG_GRAPHICS, execute_nothing, nullptr);
+    rg_use(graph, pass, hdr, RG_SAMPLED);
+    rg_use(graph, pass, bloom, RG_SAMPLED);
+    rg_use(graph, pass, backbuffer, RG_COLOR_ATTACHMENT, &clear);
+}
+
+/**
+ * The tiler variant: lighting becomes a subpass of the gbuffer render
+ * pass, so the gbuffer and depth are cleared, consumed and discarded
+ * without leaving tile memory, and only hdr and bloom need real memory.
+ */
+static int check_subpasses() {
+    static struct render_graph graph;
+    struct deferred_images images;
+    build_deferred(&graph, true, &images);
+    graph.lazy_memory = 1;
+    render_graph_compile(&graph);
+    render_graph_log(&graph);
+
+    const struct rg_stats* stats = &graph.stats;
+    // hdr, bloom and the backbuffer
+    VkDeviceSize stored = (VkDeviceSize)WIDTH * HEIGHT * 8 + (WIDTH / 2) * (HEIGHT / 2) * 8 + WIDTH * HEIGHT * 4;
+    int result = 0;
+    if (stats->render_passes != 3 || stats->subpasses != 4 || graph.passes[1].group != 0) {
+        LOGE("render_graph: expected lighting merged into gbuffer, %u render passes with %u subpasses",
+             stats->render_passes, stats->subpasses);
+        result = -1;
+    }
+    VkDeviceSize expected_peak = graph.resources[images.hdr].size + graph.resources[images.bloom].size;
+    if (stats->tile_only_images != 3 || stats->peak_bytes != expected_peak) {
+        LOGE("render_graph: expected gbuffer and depth tile only, %u are", stats->tile_only_images);
+        result = -1;
+    }
+    if (stats->barriers != 9 || stats->barrier_batches != 4) {
+        LOGE("render_graph: expected 9 barriers in 4 batches, got %u in %u", stats->barriers,
+             stats->barrier_batches);
+        result = -1;
+    }
+    if (stats->attachment_loads != 0 || stats->attachment_clears != 6 || stats->attachment_stores != 3 ||
+        stats->attachment_discards != 3 || stats->store_bytes != stored) {
+        LOGE("render_graph: expected 6 clears, 3 stores of %llu bytes and 3 discards, got %u loads, "
+             "%u clears, %u stores of %llu bytes, %u discards",
+             (unsigned long long)stored, stats->attachment_loads, stats->attachment_clears,
+             stats->attachment_stores, (unsigned long long)stats->store_bytes, stats->attachment_discards);
+        result = -1;
+    }
+    return result;
+}
+
+/**
+ * Compiles the graph without a device and checks what it derived: the
+ * overlay is culled, 12 barriers go out in 5 vkCmdPipelineBarrier calls
+ * (the tonemap pass reads hdr without one, bloom already made it
+ * visible), and bloom lands in the memory of the gbuffer normals. Then
+ * the same with input attachments.
+ */
+int bench_render_graph() {
+    static struct render_graph graph;
+    struct deferred_images images;
+    build_deferred(&graph, false, &images);
+
+    int64_t start = platform_time_ns();
+    for (int i = 0; i < COMPILES; i++) {
+        render_graph_compile(&graph);
+    }
+    int64_t elapsed = platform_time_ns() - start;
+    render_graph_log(&graph);
+    LOGI("render_graph: compile %.2f us", (double)elapsed / COMPILES * 1e-3);
+
+    const struct rg_stats* stats = &graph.stats;
+    // everything but bloom (and the culled debug image) is alive during lighting
+    VkDeviceSize expected_peak = stats->transient_bytes - graph.resources[images.bloom].size;
+    int result = 0;
+    if (stats->culled_passes != 1 || !graph.passes[3].culled) {
+        LOGE("render_graph: expected debug_overlay alone to be culled, %u culled", stats->culled_passes);
+        result = -1;
+    }
+    if (stats->barriers != 12 || stats->barrier_batches != 5) {
+        LOGE("render_graph: expected 12 barriers in 5 batches, got %u in %u", stats->barriers,
+             stats->barrier_batches);
+        result = -1;
+    }
+    if (stats->transient_images != 5 || stats->peak_bytes != expected_peak ||
+        stats->peak_bytes >= stats->transient_bytes) {
+        LOGE("render_graph: expected 5 transients peaking at %llu bytes, got %u peaking at %llu",
+             (unsigned long long)expected_peak, stats->transient_images,
+             (unsigned long long)stats->peak_bytes);
+        result = -1;
+    }
+    const struct rg_resource* a = &graph.resources[images.bloom];
+    const struct rg_resource* b = &graph.resources[images.normal];
+    if (a->offset < b->offset || a->offset + a->size > b->offset + b->size) {
+        LOGE("render_graph: expected bloom to alias the gbuffer normals");
+        result = -1;
+    }
+    return check_subpasses() == 0 ? result : -1;
+}
@@ -0,0 +1,205 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "frame_stats.h"
+#include "log.h"
+#include "platform.h"
+#include "texture_stream.h"
+#include "vecmath.h"
+
+static const uint32_t TEXTURES = 512;
+static const uint32_t GRID = 64;
+static const float SPACING = 8.0f;
+static const float RADIUS = 2.0f;
+static const int FRAMES = 3600;
+static const float FOVY = 1.0f;
+static const float SCREEN_HEIGHT = 1080.0f;
+// uploads land this many frames after they are issued, like the streamer's
+static const uint64_t UPLOAD_LATENCY = 2;
+static const uint64_t UPLOAD_PER_FRAME = 4ull << 20;
+
+struct stream_object {
+    struct vec3 center;
+    uint32_t texture;
+};
+
+struct inflight_load {
+    struct texture_stream_load load;
+    uint64_t lands;
+};
+
+/**
+ * A low flight over the grid along a Lissajous curve, looking where it is
+ * heading, so textures come close, pass and fall behind.
+ */
+static struct mat4 camera(int frame) {
+    float extent = (float)GRID * SPACING * 0.45f;
+    float t = (float)frame / 60.0f;
+    struct vec3 eye = { sinf(t * 0.21f) * extent, 3.0f, sinf(t * 0.13f + 1.0f) * extent };
+    struct vec3 ahead = { sinf((t + 0.5f) * 0.21f) * extent, 3.0f, sinf((t + 0.5f) * 0.13f + 1.0f) * extent };
+    struct mat4 view = mat4_look_at(eye, ahead, { 0.0f, 1.0f, 0.0f });
+    struct mat4 proj = mat4_perspective(FOVY, 16.0f / 9.0f, 0.1f, 1000.0f);
+    return mat4_mul(&proj, &view);
+}
+
+/**
+ * Resident bytes recounted from every texture's levels, and whether each
+ * texture's residency is within its chain.
+ */
+static bool check_residency(const struct texture_streamer* streamer) {
+    uint64_t resident = 0;
+    uint64_t pending = 0;
+    for (const struct streamed_texture& t : streamer->textures) {
+        if (t.resident < t.mip_count && t.resident > t.tail) {
+            LOGE("texture_stream: resident level %u is past the tail %u", t.resident, t.tail);
+            return false;
+        }
+        resident += t.level_offset[t.mip_count] - t.level_offset[std::min(t.resident, t.mip_count)];
+        if (t.loading != TEXTURE_STREAM_NONE) {
+            pending += t.level_offset[t.resident] - t.level_offset[t.loading];
+        }
+    }
+    if (resident != streamer->stats.resident_bytes || pending != streamer->stats.pending_bytes) {
+        LOGE("texture_stream: %llu resident and %llu pending bytes counted, %llu and %llu recounted",
+             (unsigned long long)streamer->stats.resident_bytes, (unsigned long long)streamer->stats.pending_bytes,
+             (unsigned long long)resident, (unsigned long long)pending);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * One flight through the world under budget bytes. Returns 0 when the
+ * books balanced every frame and memory never went over the budget.
+ */
+static int fly(const std::vector<struct stream_object>& objects, uint64_t budget) {
+    struct texture_streamer streamer{};
+    texture_streamer_init(&streamer, budget, UPLOAD_PER_FRAME);
+    uint32_t rng = 1;
+    for (uint32_t i = 0; i < TEXTURES; i++) {
+        rng = rng * 1664525u + 1013904223u;
+        // one in eight 2048, three in eight 1024, the rest 512
+        uint32_t pick = (rng >> 8) % 8;
+        uint32_t size = pick == 0 ? 2048 : pick < 4 ? 1024 : 512;
+        uint32_t mips = 1;
+        while (size >> mips != 0) {
+            mips++;
+        }
+        texture_streamer_add(&streamer, TEXTURE_ASTC_4X4, size, size, mips, nullptr);
+    }
+
+    const float focal = SCREEN_HEIGHT * 0.5f / tanf(FOVY * 0.5f);
+    std::vector<struct inflight_load> inflight;
+    inflight.reserve(TEXTURES);
+    struct frame_stats update_stats;
+    uint64_t peak_frame_bytes = 0;
+    uint64_t missing_levels = 0;
+    uint32_t over_budget_frames = 0;
+    int result = 0;
+    for (int frame = 0; frame < FRAMES && result == 0; frame++) {
+        struct mat4 view_proj = camera(frame);
+        for (const struct stream_object& object : objects) {
+            struct vec4 clip = mat4_mul_vec4(&view_proj, vec4_from_vec3(object.center, 1.0f));
+            // w is the view depth; a margin keeps objects about to enter
+            // the view requested
+            float margin = clip.w * 1.2f + RADIUS;
+            if (clip.w < 0.1f || fabsf(clip.x) > margin || fabsf(clip.y) > margin) {
+                continue;
+            }
+            const struct streamed_texture* t = &streamer.textures[object.texture];
+            float pixels = 2.0f * RADIUS * focal / clip.w;
+            texture_streamer_request(&streamer, object.texture,
+                                     texture_stream_mip_for_size(t->width, t->height, t->mip_count, pixels, 0.0f));
+        }
+
+        int64_t start = platform_time_ns();
+        texture_streamer_update(&streamer);
+        frame_stats_add(&update_stats, platform_time_ns() - start);
+        const struct texture_stream_stats* stats = &streamer.stats;
+        for (uint32_t i = 0; i < streamer.load_count; i++) {
+            inflight.push_back({ streamer.loads[i], (uint64_t)frame + UPLOAD_LATENCY });
+        }
+        // tails may go over an undersized budget, the rest must not
+        if (frame > 0) {
+            peak_frame_bytes = std::max(peak_frame_bytes, stats->load_bytes);
+            if (stats->resident_bytes + stats->pending_bytes > budget) {
+                LOGE("texture_stream: %llu bytes in use over a %llu byte budget",
+                     (unsigned long long)(stats->resident_bytes + stats->pending_bytes),
+                     (unsigned long long)budget);
+                result = -1;
+            }
+        }
+        missing_levels += stats->missing_levels;
+        over_budget_frames += stats->over_budget != 0;
+
+        size_t kept = 0;
+        for (size_t i = 0; i < inflight.size(); i++) {
+            if (inflight[i].lands <= (uint64_t)frame) {
+                texture_streamer_complete(&streamer, &inflight[i].load);
+            } else {
+                inflight[kept++] = inflight[i];
+            }
+        }
+        inflight.resize(kept);
+        if (!check_residency(&streamer)) {
+            result = -1;
+        }
+    }
+
+    const struct texture_stream_stats* stats = &streamer.stats;
+    struct frame_stats_summary update = frame_stats_summarize(&update_stats);
+    double seconds = (double)FRAMES / 60.0;
+    LOGI("texture_stream: %3llu MB budget: peak %6.1f MB of %.1f MB, uploaded %7.1f MB (%5.1f MB/s at 60 Hz, "
+         "peak %.1f MB/frame), evicted %7.1f MB, %.1f levels missing per frame, %u frames over budget, "
+         "update %.3f ms avg %.3f ms max",
+         (unsigned long long)(budget >> 20), (double)stats->peak_bytes / (1 << 20),
+         (double)stats->full_bytes / (1 << 20), (double)stats->uploaded_bytes / (1 << 20),
+         (double)stats->uploaded_bytes / (1 << 20) / seconds, (double)peak_frame_bytes / (1 << 20),
+         (double)stats->evicted_bytes / (1 << 20), (double)missing_levels / FRAMES, over_budget_frames,
+         update.avg_ms, update.max_ms);
+    texture_streamer_destroy(&streamer);
+    return result;
+}
+
+/**
+ * Mip residency of 512 ASTC textures (512 to 2048 texels, 660 MB with
+ * every level resident) on 4096 objects, along a minute of camera flight
+ * low over them, without a device: uploads land two frames after they are
+ * issued, at most 4 MB a frame. Reports peak memory, upload bandwidth,
+ * evictions and how far residency lags behind what is on screen for
+ * several budgets, and checks the accounting every frame. Also checks
+ * that a texture without mips is turned away.
+ */
+int bench_texture_stream() {
+    // a chain without levels has no tail to keep resident
+    struct texture_streamer empty{};
+    texture_streamer_init(&empty, 1 << 20, UPLOAD_PER_FRAME);
+    uint32_t rejected = texture_streamer_add(&empty, TEXTURE_ASTC_4X4, 64, 64, 0, nullptr);
+    texture_streamer_destroy(&empty);
+    if (rejected != TEXTURE_STREAM_NONE) {
+        LOGE("texture_stream: registered a texture without mips");
+        return -1;
+    }
+
+    std::vector<struct stream_object> objects;
+    objects.reserve(GRID * GRID);
+    uint32_t rng = 99;
+    float origin = -(float)GRID * SPACING * 0.5f;
+    for (uint32_t z = 0; z < GRID; z++) {
+        for (uint32_t x = 0; x < GRID; x++) {
+            rng = rng * 1664525u + 1013904223u;
+            struct vec3 center = { origin + (float)x * SPACING, RADIUS, origin + (float)z * SPACING };
+            objects.push_back({ center, (rng >> 8) % TEXTURES });
+        }
+    }
+    int result = 0;
+    const uint64_t budgets[] = { 48ull << 20, 96ull << 20, 192ull << 20 };
+    for (uint64_t budget : budgets) {
+        if (fly(objects, budget) != 0) {
+            result = -1;
+        }
+    }
+    return result;
+}
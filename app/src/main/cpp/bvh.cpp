@@ -0,0 +1,469 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "profiler.h"
+
+static struct vec4 matrix_row(const struct mat4* m, int row) {
+    const float* c0 = &m->cols[0].x;
+    const float* c1 = &m->cols[1].x;
+    const float* c2 = &m->cols[2].x;
+    const float* c3 = &m->cols[3].x;
+    return { c0[row], c1[row], c2[row], c3[row] };
+}
+
+struct frustum frustum_from_matrix(const struct mat4* view_proj) {
+    // Vulkan clip space: -w <= x, y <= w and 0 <= z <= w
+    struct vec4 x = matrix_row(view_proj, 0);
+    struct vec4 y = matrix_row(view_proj, 1);
+    struct vec4 z = matrix_row(view_proj, 2);
+    struct vec4 w = matrix_row(view_proj, 3);
+    struct frustum frustum;
+    frustum.planes[0] = vec4_add(w, x);
+    frustum.planes[1] = vec4_sub(w, x);
+    frustum.planes[2] = vec4_add(w, y);
+    frustum.planes[3] = vec4_sub(w, y);
+    frustum.planes[4] = z;
+    frustum.planes[5] = vec4_sub(w, z);
+    return frustum;
+}
+
+bool frustum_intersects_aabb(const struct frustum* frustum, const struct aabb* box) {
+    struct vec3 center = vec3_scale(vec3_add(box->min, box->max), 0.5f);
+    struct vec3 extent = vec3_scale(vec3_sub(box->max, box->min), 0.5f);
+    for (const struct vec4& plane : frustum->planes) {
+        float d = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        float r = fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+        if (d + r < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// --- build -------------------------------------------------------------------
+
+/**
+ * Partition items so the lower count / 2 have the smaller centers along
+ * the longest axis.
+ */
+static void split_median(struct bvh_build_item* items, uint32_t count) {
+    float lo[3] = { INFINITY, INFINITY, INFINITY };
+    float hi[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (uint32_t i = 0; i < count; i++) {
+        for (int axis = 0; axis < 3; axis++) {
+            lo[axis] = std::min(lo[axis], items[i].center[axis]);
+            hi[axis] = std::max(hi[axis], items[i].center[axis]);
+        }
+    }
+    float size[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+    int axis = size[0] >= size[1] && size[0] >= size[2] ? 0 : (size[1] >= size[2] ? 1 : 2);
+    std::nth_element(items, items + count / 2, items + count,
+                     [axis](const struct bvh_build_item& a, const struct bvh_build_item& b) {
+                         return a.center[axis] < b.center[axis];
+                     });
+}
+
+/**
+ * Sizes of a node's child groups, which only depend on its item count:
+ * two levels of median splits, or one item per child for small nodes.
+ */
+static uint32_t group_sizes(uint32_t count, uint32_t sizes[BVH_WIDTH]) {
+    if (count <= BVH_WIDTH) {
+        for (uint32_t i = 0; i < count; i++) {
+            sizes[i] = 1;
+        }
+        return count;
+    }
+    uint32_t left = count / 2;
+    sizes[0] = left / 2;
+    sizes[1] = left - sizes[0];
+    sizes[2] = (count - left) / 2;
+    sizes[3] = count - left - sizes[2];
+    return BVH_WIDTH;
+}
+
+/**
+ * Nodes in a subtree over count items. Knowing it up front places every
+ * subtree in the node array before it is built, so task subtrees can be
+ * built in parallel and still come out in depth-first order.
+ */
+static uint32_t subtree_nodes(uint32_t count) {
+    uint32_t sizes[BVH_WIDTH];
+    uint32_t groups = group_sizes(count, sizes);
+    uint32_t nodes = 1;
+    for (uint32_t g = 0; g < groups; g++) {
+        nodes += sizes[g] > 1 ? subtree_nodes(sizes[g]) : 0;
+    }
+    return nodes;
+}
+
+/**
+ * Partition items[first, first + count) and fill node index, whose
+ * subtree takes the nodes right after it. Above the task depth subtrees
+ * are recursed into here; at it they are recorded as tasks and left for
+ * build_tasks.
+ */
+static void build_node(struct bvh* bvh, uint32_t index, uint32_t first, uint32_t count, uint32_t depth) {
+    struct bvh_node* node = &bvh->nodes[index];
+    node->first_item = first;
+    node->item_count = count;
+    node->task = BVH_NONE;
+    if (depth == BVH_TASK_DEPTH) {
+        node->task = (uint32_t)bvh->tasks.size();
+        bvh->tasks.push_back({ index, index + subtree_nodes(count), first, count, 0.0f, BVH_OUTSIDE, 0 });
+        return;
+    }
+    if (depth < BVH_TASK_DEPTH) {
+        bvh->top_nodes.push_back(index);
+    }
+
+    uint32_t sizes[BVH_WIDTH];
+    uint32_t groups = group_sizes(count, sizes);
+    if (count > BVH_WIDTH) {
+        struct bvh_build_item* items = bvh->build_items.data() + first;
+        uint32_t left = count / 2;
+        split_median(items, count);
+        split_median(items, left);
+        split_median(items + left, count - left);
+    }
+    node->child_count = groups;
+    for (uint32_t i = groups; i < BVH_WIDTH; i++) {
+        // unused lanes drop out of unions and are masked out of tests
+        node->extent_x[i] = -INFINITY;
+        node->extent_y[i] = -INFINITY;
+        node->extent_z[i] = -INFINITY;
+    }
+    uint32_t next = index + 1;
+    uint32_t group_first = first;
+    for (uint32_t g = 0; g < groups; g++) {
+        if (sizes[g] == 1) {
+            node->children[g] = BVH_LEAF | group_first;
+        } else {
+            node->children[g] = next;
+            build_node(bvh, next, group_first, sizes[g], depth + 1);
+            next += subtree_nodes(sizes[g]);
+        }
+        group_first += sizes[g];
+    }
+}
+
+static void build_tasks(void* data, uint32_t begin, uint32_t end) {
+    PROFILE_SCOPE("bvh_build_task");
+    auto* bvh = (struct bvh*)data;
+    for (uint32_t t = begin; t < end; t++) {
+        const struct bvh_task* task = &bvh->tasks[t];
+        // past the task depth nothing touches the shared task lists
+        uint32_t task_index = bvh->nodes[task->node].task;
+        build_node(bvh, task->node, task->first_item, task->item_count, BVH_TASK_DEPTH + 1);
+        bvh->nodes[task->node].task = task_index;
+    }
+}
+
+void bvh_build(struct bvh* bvh, struct job_system* jobs, const uint32_t* ids, uint32_t count,
+               const struct aabb* bounds) {
+    PROFILE_SCOPE("bvh_build");
+    bvh->tasks.clear();
+    bvh->top_nodes.clear();
+    bvh->top_visible.clear();
+    bvh->build_items.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const struct aabb* box = &bounds[ids[i]];
+        bvh->build_items[i] = { { box->min.x + box->max.x, box->min.y + box->max.y, box->min.z + box->max.z },
+                                ids[i] };
+    }
+    bvh->nodes.resize(count > 0 ? subtree_nodes(count) : 0);
+    if (count > 0) {
+        build_node(bvh, 0, 0, count, 0);
+    }
+    job_parallel_for(jobs, (uint32_t)bvh->tasks.size(), 1, build_tasks, bvh);
+    bvh->ids.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        bvh->ids[i] = bvh->build_items[i].id;
+    }
+    // items hanging directly off top nodes
+    bvh->top_visible.reserve(bvh->top_nodes.size() * BVH_WIDTH);
+    bvh_refit(bvh, jobs, bounds);
+    bvh->build_area = bvh->area;
+}
+
+// --- refit -------------------------------------------------------------------
+
+static float min4(const float* v) {
+    return std::min(std::min(v[0], v[1]), std::min(v[2], v[3]));
+}
+
+static float max4(const float* v) {
+    return std::max(std::max(v[0], v[1]), std::max(v[2], v[3]));
+}
+
+/**
+ * Union of the node's child boxes; unused lanes have -inf extents and drop
+ * out of the min and max.
+ */
+static struct aabb node_bounds(const struct bvh_node* node) {
+    simd4 cx = simd_load(node->center_x);
+    simd4 cy = simd_load(node->center_y);
+    simd4 cz = simd_load(node->center_z);
+    simd4 ex = simd_load(node->extent_x);
+    simd4 ey = simd_load(node->extent_y);
+    simd4 ez = simd_load(node->extent_z);
+    alignas(16) float lo[3][BVH_WIDTH];
+    alignas(16) float hi[3][BVH_WIDTH];
+    simd_store(lo[0], simd_sub(cx, ex));
+    simd_store(lo[1], simd_sub(cy, ey));
+    simd_store(lo[2], simd_sub(cz, ez));
+    simd_store(hi[0], simd_add(cx, ex));
+    simd_store(hi[1], simd_add(cy, ey));
+    simd_store(hi[2], simd_add(cz, ez));
+    return { { min4(lo[0]), min4(lo[1]), min4(lo[2]) }, { max4(hi[0]), max4(hi[1]), max4(hi[2]) } };
+}
+
+static float surface_area(const struct aabb* box) {
+    struct vec3 size = vec3_sub(box->max, box->min);
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+/**
+ * Refresh the child boxes of one node whose child nodes are already up to
+ * date; returns their summed surface area.
+ */
+static float refit_node(struct bvh* bvh, uint32_t index, const struct aabb* bounds) {
+    struct bvh_node* node = &bvh->nodes[index];
+    float area = 0.0f;
+    for (uint32_t i = 0; i < node->child_count; i++) {
+        uint32_t child = node->children[i];
+        struct aabb box;
+        if (child & BVH_LEAF) {
+            box = bounds[bvh->ids[child & ~BVH_LEAF]];
+        } else {
+            box = node_bounds(&bvh->nodes[child]);
+            area += surface_area(&box);
+        }
+        node->center_x[i] = (box.min.x + box.max.x) * 0.5f;
+        node->center_y[i] = (box.min.y + box.max.y) * 0.5f;
+        node->center_z[i] = (box.min.z + box.max.z) * 0.5f;
+        node->extent_x[i] = (box.max.x - box.min.x) * 0.5f;
+        node->extent_y[i] = (box.max.y - box.min.y) * 0.5f;
+        node->extent_z[i] = (box.max.z - box.min.z) * 0.5f;
+    }
+    return area;
+}
+
+struct refit_params {
+    struct bvh* bvh;
+    const struct aabb* bounds;
+};
+
+static void refit_tasks(void* data, uint32_t begin, uint32_t end) {
+    PROFILE_SCOPE("bvh_refit_task");
+    auto* params = (const struct refit_params*)data;
+    for (uint32_t t = begin; t < end; t++) {
+        struct bvh_task* task = &params->bvh->tasks[t];
+        float area = 0.0f;
+        for (uint32_t n = task->node_end; n-- > task->node;) {
+            area += refit_node(params->bvh, n, params->bounds);
+        }
+        task->area = area;
+    }
+}
+
+/**
+ * Task subtrees, then the nodes above them, children always before their
+ * parents.
+ */
+static void refit_top(struct bvh* bvh, const struct aabb* bounds) {
+    float area = 0.0f;
+    for (const struct bvh_task& task : bvh->tasks) {
+        area += task.area;
+    }
+    for (size_t i = bvh->top_nodes.size(); i-- > 0;) {
+        area += refit_node(bvh, bvh->top_nodes[i], bounds);
+    }
+    bvh->area = area;
+}
+
+void bvh_refit(struct bvh* bvh, struct job_system* jobs, const struct aabb* bounds) {
+    PROFILE_SCOPE("bvh_refit");
+    struct refit_params params{ bvh, bounds };
+    job_parallel_for(jobs, (uint32_t)bvh->tasks.size(), 1, refit_tasks, &params);
+    refit_top(bvh, bounds);
+}
+
+// --- cull --------------------------------------------------------------------
+
+/**
+ * The frustum planes with each component splat across a register, and
+ * the absolute values of the normals for the box extents.
+ */
+struct frustum_lanes {
+    simd4 nx[6], ny[6], nz[6], w[6];
+    simd4 ax[6], ay[6], az[6];
+};
+
+static void frustum_lanes_init(struct frustum_lanes* lanes, const struct frustum* frustum) {
+    for (int p = 0; p < 6; p++) {
+        const struct vec4* plane = &frustum->planes[p];
+        lanes->nx[p] = simd_set1(plane->x);
+        lanes->ny[p] = simd_set1(plane->y);
+        lanes->nz[p] = simd_set1(plane->z);
+        lanes->w[p] = simd_set1(plane->w);
+        lanes->ax[p] = simd_set1(fabsf(plane->x));
+        lanes->ay[p] = simd_set1(fabsf(plane->y));
+        lanes->az[p] = simd_set1(fabsf(plane->z));
+    }
+}
+
+/**
+ * Test the node's four children at once. Returns the mask of children that
+ * intersect the frustum; those entirely inside it are also in *inside.
+ */
+static inline int test_children(const struct bvh_node* node, const struct frustum_lanes* f, int* inside) {
+    simd4 cx = simd_load(node->center_x);
+    simd4 cy = simd_load(node->center_y);
+    simd4 cz = simd_load(node->center_z);
+    simd4 ex = simd_load(node->extent_x);
+    simd4 ey = simd_load(node->extent_y);
+    simd4 ez = simd_load(node->extent_z);
+    int outside = 0;
+    int crossing = 0;
+    for (int p = 0; p < 6; p++) {
+        // signed distance of the center, and the box's reach along the normal
+        simd4 d = simd_madd(simd_madd(simd_madd(f->w[p], f->nx[p], cx), f->ny[p], cy), f->nz[p], cz);
+        simd4 r = simd_madd(simd_madd(simd_mul(f->ax[p], ex), f->ay[p], ey), f->az[p], ez);
+        outside |= simd_lt_mask(simd_add(d, r), simd_set1(0.0f));
+        crossing |= simd_lt_mask(d, r);
+    }
+    int visible = ((1 << node->child_count) - 1) & ~outside;
+    *inside = visible & ~crossing;
+    return visible;
+}
+
+/**
+ * Every item below child slot i of node.
+ */
+static uint32_t emit_child(const struct bvh* bvh, const struct bvh_node* node, uint32_t i, uint32_t* out) {
+    uint32_t child = node->children[i];
+    if (child & BVH_LEAF) {
+        *out = bvh->ids[child & ~BVH_LEAF];
+        return 1;
+    }
+    const struct bvh_node* sub = &bvh->nodes[child];
+    memcpy(out, &bvh->ids[sub->first_item], sub->item_count * sizeof(uint32_t));
+    return sub->item_count;
+}
+
+struct cull_params {
+    struct bvh* bvh;
+    struct frustum_lanes lanes;
+    uint32_t* visible;
+};
+
+// deeper than any median split tree over 2^32 items needs
+#define BVH_STACK_SIZE 128
+
+static void cull_tasks(void* data, uint32_t begin, uint32_t end) {
+    PROFILE_SCOPE("bvh_cull_task");
+    auto* params = (const struct cull_params*)data;
+    const struct bvh* bvh = params->bvh;
+    for (uint32_t t = begin; t < end; t++) {
+        struct bvh_task* task = &params->bvh->tasks[t];
+        // each task owns the slice of visible matching its items
+        uint32_t* out = params->visible + task->first_item;
+        uint32_t count = 0;
+        if (task->visibility == BVH_INSIDE) {
+            memcpy(out, &bvh->ids[task->first_item], task->item_count * sizeof(uint32_t));
+            count = task->item_count;
+        } else if (task->visibility == BVH_PARTIAL) {
+            uint32_t stack[BVH_STACK_SIZE];
+            uint32_t depth = 0;
+            stack[depth++] = task->node;
+            while (depth > 0) {
+                const struct bvh_node* node = &bvh->nodes[stack[--depth]];
+                int inside;
+                int visible = test_children(node, &params->lanes, &inside);
+                for (uint32_t i = 0; i < node->child_count; i++) {
+                    if (!(visible & (1 << i))) {
+                        continue;
+                    }
+                    uint32_t child = node->children[i];
+                    if ((inside & (1 << i)) || (child & BVH_LEAF)) {
+                        count += emit_child(bvh, node, i, out + count);
+                    } else {
+                        stack[depth++] = child;
+                    }
+                }
+            }
+        }
+        task->visible_count = count;
+    }
+}
+
+/**
+ * Walk the nodes above the tasks on the calling thread, deciding which
+ * tasks need to run and collecting items that hang off top nodes.
+ */
+static void cull_top(struct bvh* bvh, const struct frustum_lanes* lanes) {
+    bvh->top_visible.clear();
+    for (struct bvh_task& task : bvh->tasks) {
+        task.visibility = BVH_OUTSIDE;
+    }
+    if (bvh->nodes.empty()) {
+        return;
+    }
+    // node index, with BVH_LEAF marking subtrees known to be inside
+    uint32_t stack[BVH_STACK_SIZE];
+    uint32_t depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        uint32_t entry = stack[--depth];
+        const struct bvh_node* node = &bvh->nodes[entry & ~BVH_LEAF];
+        bool node_inside = (entry & BVH_LEAF) != 0;
+        if (node->task != BVH_NONE) {
+            bvh->tasks[node->task].visibility = node_inside ? BVH_INSIDE : BVH_PARTIAL;
+            continue;
+        }
+        int inside = (1 << node->child_count) - 1;
+        int visible = inside;
+        if (!node_inside) {
+            visible = test_children(node, lanes, &inside);
+        }
+        for (uint32_t i = 0; i < node->child_count; i++) {
+            if (!(visible & (1 << i))) {
+                continue;
+            }
+            uint32_t child = node->children[i];
+            if (child & BVH_LEAF) {
+                bvh->top_visible.push_back(bvh->ids[child & ~BVH_LEAF]);
+            } else {
+                stack[depth++] = child | ((inside & (1 << i)) ? BVH_LEAF : 0);
+            }
+        }
+    }
+}
+
+uint32_t bvh_cull(struct bvh* bvh, struct job_system* jobs, const struct frustum* frustum,
+                  uint32_t* visible) {
+    PROFILE_SCOPE("bvh_cull");
+    struct cull_params params;
+    params.bvh = bvh;
+    params.visible = visible;
+    frustum_lanes_init(&params.lanes, frustum);
+    cull_top(bvh, &params.lanes);
+    job_parallel_for(jobs, (uint32_t)bvh->tasks.size(), 1, cull_tasks, &params);
+
+    // close the gaps between the task slices; tasks are in item order, so
+    // every slice moves towards the front
+    uint32_t count = 0;
+    for (const struct bvh_task& task : bvh->tasks) {
+        if (task.visible_count > 0) {
+            memmove(visible + count, visible + task.first_item, task.visible_count * sizeof(uint32_t));
+            count += task.visible_count;
+        }
+    }
+    for (uint32_t id : bvh->top_visible) {
+        visible[count++] = id;
+    }
+    return count;
+}
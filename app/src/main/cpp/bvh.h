@@ -0,0 +1,142 @@
+#ifndef ENGINE_BVH_H
+#define ENGINE_BVH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "jobs.h"
+#include "vecmath.h"
+
+/**
+ * Bounding volume hierarchy for frustum culling. Every node holds the
+ * boxes of its four children as SoA lanes, so one node is tested against
+ * a plane in a handful of SIMD instructions. Items are the caller's ids;
+ * their boxes live in a caller-owned array indexed by id.
+ *
+ * Static content is built once. Moving content is refit every frame,
+ * which keeps the topology and only recomputes boxes, and rebuilt once
+ * refitting has made the tree much looser than it was when built.
+ */
+
+#define BVH_WIDTH 4
+// child slots with this bit reference an item (an index into bvh::ids)
+#define BVH_LEAF 0x80000000u
+#define BVH_NONE 0xffffffffu
+// subtrees rooted this deep are refit and culled as separate jobs
+#define BVH_TASK_DEPTH 3
+
+struct aabb {
+    struct vec3 min;
+    struct vec3 max;
+};
+
+/**
+ * Clip space planes of a view-projection matrix, pointing inwards: a point
+ * is inside when dot(plane.xyz, p) + plane.w >= 0 for all six.
+ */
+struct frustum {
+    struct vec4 planes[6];
+};
+
+struct frustum frustum_from_matrix(const struct mat4* view_proj);
+
+/**
+ * Scalar reference test, what bvh_cull must agree with.
+ */
+bool frustum_intersects_aabb(const struct frustum* frustum, const struct aabb* box);
+
+struct alignas(64) bvh_node {
+    // child boxes as centers and half extents, lane i for child i
+    float center_x[BVH_WIDTH];
+    float center_y[BVH_WIDTH];
+    float center_z[BVH_WIDTH];
+    float extent_x[BVH_WIDTH];
+    float extent_y[BVH_WIDTH];
+    float extent_z[BVH_WIDTH];
+    uint32_t children[BVH_WIDTH];
+    uint32_t child_count;
+    // the subtree's items are ids[first_item, first_item + item_count)
+    uint32_t first_item;
+    uint32_t item_count;
+    // index into bvh::tasks for task roots, BVH_NONE otherwise
+    uint32_t task;
+};
+
+enum bvh_visibility {
+    BVH_OUTSIDE,
+    BVH_PARTIAL,
+    BVH_INSIDE,
+};
+
+/**
+ * A subtree handled by one job. Its nodes are [node, node_end) in build
+ * order, so refitting walks them backwards to visit children first.
+ */
+struct bvh_task {
+    uint32_t node;
+    uint32_t node_end;
+    uint32_t first_item;
+    uint32_t item_count;
+    // refit: summed surface area of its nodes; cull: what the nodes above
+    // found, and how many of its items are visible
+    float area;
+    enum bvh_visibility visibility;
+    uint32_t visible_count;
+};
+
+/**
+ * Build input: an item's box center (doubled) next to its id, so
+ * partitioning does not chase ids into the bounds array.
+ */
+struct bvh_build_item {
+    float center[3];
+    uint32_t id;
+};
+
+struct bvh {
+    std::vector<struct bvh_node> nodes;
+    // caller ids in leaf order
+    std::vector<uint32_t> ids;
+    std::vector<struct bvh_task> tasks;
+    // nodes above the task roots, in build order
+    std::vector<uint32_t> top_nodes;
+    // visible items hanging directly off top nodes, found before the tasks run
+    std::vector<uint32_t> top_visible;
+    std::vector<struct bvh_build_item> build_items;
+    // summed surface area of every node, right after the build and after
+    // the last refit
+    float build_area;
+    float area;
+};
+
+/**
+ * Build over count ids with their boxes in bounds[id], splitting at the
+ * median along the longest axis; subtrees below the task depth are built
+ * as jobs. Reuses the bvh's storage, so rebuilding a tree of the same size
+ * does not allocate.
+ */
+void bvh_build(struct bvh* bvh, struct job_system* jobs, const uint32_t* ids, uint32_t count,
+               const struct aabb* bounds);
+
+/**
+ * Recompute every box from bounds[id] after items moved, one job per task.
+ */
+void bvh_refit(struct bvh* bvh, struct job_system* jobs, const struct aabb* bounds);
+
+/**
+ * Refitting has doubled the tree's surface area; culling is getting
+ * noticeably slower and a rebuild pays off.
+ */
+inline bool bvh_degraded(const struct bvh* bvh) {
+    return bvh->area > 2.0f * bvh->build_area;
+}
+
+/**
+ * Write the ids of items whose boxes intersect the frustum to visible,
+ * which has room for every item, and return their count. Subtrees fully
+ * inside are emitted without further tests. One job per task.
+ */
+uint32_t bvh_cull(struct bvh* bvh, struct job_system* jobs, const struct frustum* frustum,
+                  uint32_t* visible);
+
+#endif // ENGINE_BVH_H
@@ -0,0 +1,104 @@
+#include "cull.h"
+
+#include "log.h"
+#include "platform.h"
+#include "profiler.h"
+
+/**
+ * Bounds of the unit cube scene.vert draws, under matrix m.
+ */
+static struct aabb cube_bounds(const struct mat4* m) {
+    struct vec3 center = { m->cols[3].x, m->cols[3].y, m->cols[3].z };
+    struct vec3 extent = {
+        0.5f * (fabsf(m->cols[0].x) + fabsf(m->cols[1].x) + fabsf(m->cols[2].x)),
+        0.5f * (fabsf(m->cols[0].y) + fabsf(m->cols[1].y) + fabsf(m->cols[2].y)),
+        0.5f * (fabsf(m->cols[0].z) + fabsf(m->cols[1].z) + fabsf(m->cols[2].z)),
+    };
+    return { vec3_sub(center, extent), vec3_add(center, extent) };
+}
+
+static void collect_chunk(struct ecs_chunk* chunk, void* data) {
+    auto* cull = (struct scene_cull*)data;
+    const struct local_to_world* matrices = ecs_column<struct local_to_world>(chunk, COMPONENT_LOCAL_TO_WORLD);
+    const struct renderable* renderables = ecs_column<struct renderable>(chunk, COMPONENT_RENDERABLE);
+    for (uint32_t i = 0; i < chunk->count; i++) {
+        cull->matrices.push_back(&matrices[i]);
+        cull->renderables.push_back(&renderables[i]);
+    }
+}
+
+struct bounds_params {
+    struct scene_cull* cull;
+    uint32_t first;
+};
+
+static void update_bounds(void* data, uint32_t begin, uint32_t end) {
+    auto* params = (const struct bounds_params*)data;
+    struct scene_cull* cull = params->cull;
+    for (uint32_t i = params->first + begin; i < params->first + end; i++) {
+        cull->bounds[i] = cube_bounds(&cull->matrices[i]->matrix);
+    }
+}
+
+static void refresh_bounds(struct scene_cull* cull, struct job_system* jobs, uint32_t first) {
+    struct bounds_params params{ cull, first };
+    job_parallel_for(jobs, cull->object_count - first, 1024, update_bounds, &params);
+}
+
+/**
+ * Gather the objects and build both trees from scratch.
+ */
+static void build_trees(struct scene_cull* cull, struct scene* scene, struct job_system* jobs) {
+    const ecs_mask drawn = ECS_BIT(COMPONENT_LOCAL_TO_WORLD) | ECS_BIT(COMPONENT_RENDERABLE);
+    cull->matrices.clear();
+    cull->renderables.clear();
+    ecs_for_each_chunk(&scene->world, drawn, ECS_BIT(COMPONENT_VELOCITY), collect_chunk, cull);
+    cull->static_count = (uint32_t)cull->matrices.size();
+    ecs_for_each_chunk(&scene->world, drawn | ECS_BIT(COMPONENT_VELOCITY), 0, collect_chunk, cull);
+    cull->object_count = (uint32_t)cull->matrices.size();
+    cull->bounds.resize(cull->object_count);
+    cull->visible.resize(cull->object_count);
+    cull->ids.resize(cull->object_count);
+    for (uint32_t i = 0; i < cull->object_count; i++) {
+        cull->ids[i] = i;
+    }
+    refresh_bounds(cull, jobs, 0);
+    bvh_build(&cull->static_tree, jobs, cull->ids.data(), cull->static_count, cull->bounds.data());
+    bvh_build(&cull->dynamic_tree, jobs, cull->ids.data() + cull->static_count,
+              cull->object_count - cull->static_count, cull->bounds.data());
+    cull->built = 1;
+    cull->structure_version = scene->world.structure_version;
+    LOGI("cull: %u static and %u moving objects, %zu + %zu nodes", cull->static_count,
+         cull->object_count - cull->static_count, cull->static_tree.nodes.size(),
+         cull->dynamic_tree.nodes.size());
+}
+
+void scene_cull_update(struct scene_cull* cull, struct scene* scene, struct job_system* jobs,
+                       const struct mat4* view_proj) {
+    PROFILE_SCOPE("scene_cull");
+    int64_t start = platform_time_ns();
+    if (!cull->built || cull->structure_version != scene->world.structure_version) {
+        build_trees(cull, scene, jobs);
+    } else {
+        refresh_bounds(cull, jobs, cull->static_count);
+        bvh_refit(&cull->dynamic_tree, jobs, cull->bounds.data());
+        if (bvh_degraded(&cull->dynamic_tree)) {
+            bvh_build(&cull->dynamic_tree, jobs, cull->ids.data() + cull->static_count,
+                      cull->object_count - cull->static_count, cull->bounds.data());
+            cull->rebuilds++;
+        }
+    }
+    int64_t refit_end = platform_time_ns();
+
+    struct frustum frustum = frustum_from_matrix(view_proj);
+    uint32_t* visible = cull->visible.data();
+    uint32_t count = bvh_cull(&cull->static_tree, jobs, &frustum, visible);
+    count += bvh_cull(&cull->dynamic_tree, jobs, &frustum, visible + count);
+    cull->visible_count = count;
+    cull->refit_ns = refit_end - start;
+    cull->cull_ns = platform_time_ns() - refit_end;
+}
+
+void scene_cull_destroy(struct scene_cull* cull) {
+    *cull = {};
+}
@@ -0,0 +1,52 @@
+#ifndef ENGINE_CULL_H
+#define ENGINE_CULL_H
+
+#include <cstdint>
+#include <vector>
+
+#include "bvh.h"
+#include "jobs.h"
+#include "scene.h"
+#include "vecmath.h"
+
+/**
+ * Frustum culling of every renderable entity, each bounded by the box
+ * around its transformed unit cube. Entities without a velocity go into a
+ * tree built once; moving ones into a tree that is refit every frame. Both
+ * trees index one object table, which points straight at the matrices and
+ * renderables in the ECS chunks and is rebuilt (with both trees) whenever
+ * the world's structure changes.
+ */
+struct scene_cull {
+    struct bvh static_tree;
+    struct bvh dynamic_tree;
+    // per object, static ones first; the trees' ids index these
+    std::vector<const struct local_to_world*> matrices;
+    std::vector<const struct renderable*> renderables;
+    std::vector<struct aabb> bounds;
+    std::vector<uint32_t> ids;
+    uint32_t static_count;
+    uint32_t object_count;
+    int built;
+    uint32_t structure_version;
+    // objects to draw this frame
+    std::vector<uint32_t> visible;
+    uint32_t visible_count;
+    // last update: time spent refitting (or building) the trees and
+    // culling them, and dynamic tree rebuilds so far
+    int64_t refit_ns;
+    int64_t cull_ns;
+    uint32_t rebuilds;
+};
+
+/**
+ * Bring the trees up to date with the scene and cull them against
+ * view_proj. Call once the scene update is done; runs its work as jobs and
+ * does not allocate unless the world's structure changed.
+ */
+void scene_cull_update(struct scene_cull* cull, struct scene* scene, struct job_system* jobs,
+                       const struct mat4* view_proj);
+
+void scene_cull_destroy(struct scene_cull* cull);
+
+#endif // ENGINE_CULL_H
@@ -0,0 +1,117 @@
+#include "draw_batch.h"
+
+#include <cstring>
+
+#include "profiler.h"
+
+void radix_sort(uint64_t* keys, uint32_t* values, uint64_t* key_scratch, uint32_t* value_scratch,
+                uint32_t count) {
+    if (count < 2) {
+        return;
+    }
+    // all eight histograms in one read of the keys
+    uint32_t histograms[8][256] = {};
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t key = keys[i];
+        for (int byte = 0; byte < 8; byte++) {
+            histograms[byte][(key >> (byte * 8)) & 0xff]++;
+        }
+    }
+
+    uint64_t* src_keys = keys;
+    uint32_t* src_values = values;
+    uint64_t* dst_keys = key_scratch;
+    uint32_t* dst_values = value_scratch;
+    for (int byte = 0; byte < 8; byte++) {
+        uint32_t* histogram = histograms[byte];
+        uint32_t shift = (uint32_t)byte * 8;
+        if (histogram[(src_keys[0] >> shift) & 0xff] == count) {
+            continue;
+        }
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < 256; digit++) {
+            uint32_t n = histogram[digit];
+            histogram[digit] = offset;
+            offset += n;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t slot = histogram[(src_keys[i] >> shift) & 0xff]++;
+            dst_keys[slot] = src_keys[i];
+            dst_values[slot] = src_values[i];
+        }
+        uint64_t* k = src_keys;
+        src_keys = dst_keys;
+        dst_keys = k;
+        uint32_t* v = src_values;
+        src_values = dst_values;
+        dst_values = v;
+    }
+    if (src_keys != keys) {
+        memcpy(keys, src_keys, count * sizeof(uint64_t));
+        memcpy(values, src_values, count * sizeof(uint32_t));
+    }
+}
+
+void draw_batcher_reserve(struct draw_batcher* batcher, uint32_t max_items) {
+    batcher->keys.resize(max_items);
+    batcher->items.resize(max_items);
+    batcher->batches.resize(max_items);
+}
+
+/**
+ * What drawing keys[0, count) one by one would bind.
+ */
+static struct draw_batch_stats count_unbatched(const uint64_t* keys, uint32_t count) {
+    struct draw_batch_stats stats{};
+    uint32_t pipeline = UINT32_MAX;
+    uint32_t material = UINT32_MAX;
+    for (uint32_t i = 0; i < count; i++) {
+        stats.pipeline_binds += draw_key_pipeline(keys[i]) != pipeline;
+        stats.material_binds += draw_key_material(keys[i]) != material;
+        pipeline = draw_key_pipeline(keys[i]);
+        material = draw_key_material(keys[i]);
+    }
+    stats.draws = count;
+    return stats;
+}
+
+void draw_batcher_sort(struct draw_batcher* batcher, uint32_t count, struct arena* scratch) {
+    PROFILE_SCOPE("draw_batch");
+    uint64_t* keys = batcher->keys.data();
+    batcher->unbatched = count_unbatched(keys, count);
+    uint64_t* key_scratch = arena_alloc_array<uint64_t>(scratch, count);
+    uint32_t* item_scratch = arena_alloc_array<uint32_t>(scratch, count);
+    if (key_scratch != nullptr && item_scratch != nullptr) {
+        radix_sort(keys, batcher->items.data(), key_scratch, item_scratch, count);
+    }
+
+    // everything above the depth bucket has to match to share a draw
+    const uint64_t state_mask = ~(((uint64_t)1 << DRAW_KEY_MESH_SHIFT) - 1);
+    struct draw_batch_stats stats{};
+    struct draw_batch* batches = batcher->batches.data();
+    uint32_t batch_count = 0;
+    for (uint32_t first = 0; first < count;) {
+        uint64_t state = keys[first] & state_mask;
+        uint32_t end = first + 1;
+        while (!batcher->per_item && end < count && (keys[end] & state_mask) == state) {
+            end++;
+        }
+        struct draw_batch* batch = &batches[batch_count];
+        batch->pipeline = draw_key_pipeline(state);
+        batch->material = draw_key_material(state);
+        batch->mesh = draw_key_mesh(state);
+        batch->first_instance = first;
+        batch->instance_count = end - first;
+        if (batch_count == 0 || batches[batch_count - 1].pipeline != batch->pipeline) {
+            stats.pipeline_binds++;
+        }
+        if (batch_count == 0 || batches[batch_count - 1].material != batch->material) {
+            stats.material_binds++;
+        }
+        batch_count++;
+        first = end;
+    }
+    stats.draws = batch_count;
+    batcher->batch_count = batch_count;
+    batcher->batched = stats;
+}
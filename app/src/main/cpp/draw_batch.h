@@ -0,0 +1,141 @@
+#ifndef ENGINE_DRAW_BATCH_H
+#define ENGINE_DRAW_BATCH_H
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "memory.h"
+
+/**
+ * Draw ordering by 64-bit sort key. Every draw item gets a key made of
+ * the state it needs, most expensive to change first:
+ *
+ *   63..60 pass | 59..54 pipeline | 53..42 material | 41..32 mesh | 31..16 depth
+ *
+ * Sorting the keys groups items by pipeline, then material, then mesh;
+ * runs with the same pipeline, material and mesh become one instanced
+ * draw, its instances front to back. The low 16 bits are left zero, so
+ * the radix sort skips them.
+ */
+#define DRAW_KEY_PASS_SHIFT 60
+#define DRAW_KEY_PIPELINE_SHIFT 54
+#define DRAW_KEY_MATERIAL_SHIFT 42
+#define DRAW_KEY_MESH_SHIFT 32
+#define DRAW_KEY_DEPTH_SHIFT 16
+
+#define DRAW_MAX_PASSES 16
+#define DRAW_MAX_PIPELINES 64
+#define DRAW_MAX_MATERIALS 4096
+#define DRAW_MAX_MESHES 1024
+#define DRAW_MAX_DEPTH 65536
+
+/**
+ * Every field has to be below its DRAW_MAX_ limit. Debug builds assert
+ * it; otherwise a field out of range is masked, so the item sorts wrong
+ * instead of spilling into the fields above it.
+ */
+static inline uint64_t draw_key_make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh,
+                                     uint32_t depth) {
+    assert(pass < DRAW_MAX_PASSES);
+    assert(pipeline < DRAW_MAX_PIPELINES);
+    assert(material < DRAW_MAX_MATERIALS);
+    assert(mesh < DRAW_MAX_MESHES);
+    assert(depth < DRAW_MAX_DEPTH);
+    return (uint64_t)(pass & (DRAW_MAX_PASSES - 1)) << DRAW_KEY_PASS_SHIFT |
+           (uint64_t)(pipeline & (DRAW_MAX_PIPELINES - 1)) << DRAW_KEY_PIPELINE_SHIFT |
+           (uint64_t)(material & (DRAW_MAX_MATERIALS - 1)) << DRAW_KEY_MATERIAL_SHIFT |
+           (uint64_t)(mesh & (DRAW_MAX_MESHES - 1)) << DRAW_KEY_MESH_SHIFT |
+           (uint64_t)(depth & (DRAW_MAX_DEPTH - 1)) << DRAW_KEY_DEPTH_SHIFT;
+}
+
+static inline uint32_t draw_key_pipeline(uint64_t key) {
+    return (uint32_t)(key >> DRAW_KEY_PIPELINE_SHIFT) & (DRAW_MAX_PIPELINES - 1);
+}
+
+static inline uint32_t draw_key_material(uint64_t key) {
+    return (uint32_t)(key >> DRAW_KEY_MATERIAL_SHIFT) & (DRAW_MAX_MATERIALS - 1);
+}
+
+static inline uint32_t draw_key_mesh(uint64_t key) {
+    return (uint32_t)(key >> DRAW_KEY_MESH_SHIFT) & (DRAW_MAX_MESHES - 1);
+}
+
+/**
+ * 16-bit depth bucket of a view depth: the top bits of the float itself,
+ * which order like the value for positive floats and get finer close to
+ * the camera, without needing the depth range.
+ */
+static inline uint32_t draw_depth_bucket(float depth) {
+    if (!(depth > 0.0f)) {
+        return 0;
+    }
+    union {
+        float f;
+        uint32_t u;
+    } bits;
+    bits.f = depth;
+    return bits.u >> 16;
+}
+
+/**
+ * An instanced draw: instances [first_instance, first_instance +
+ * instance_count) of the sorted items, all with the same pipeline,
+ * material and mesh.
+ */
+struct draw_batch {
+    uint32_t pipeline;
+    uint32_t material;
+    uint32_t mesh;
+    uint32_t first_instance;
+    uint32_t instance_count;
+};
+
+/**
+ * State changes a frame costs, binding only what differs from the
+ * previous draw.
+ */
+struct draw_batch_stats {
+    uint32_t pipeline_binds;
+    uint32_t material_binds;
+    uint32_t draws;
+};
+
+struct draw_batcher {
+    // filled by the caller: keys[i] for items[i], the caller's id
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> items;
+    std::vector<struct draw_batch> batches;
+    uint32_t batch_count;
+    // set to give every item a draw of its own, still in sorted order, for
+    // measuring what recording costs per draw
+    int per_item;
+    // one draw per item in submission order, against the sorted batches
+    struct draw_batch_stats unbatched;
+    struct draw_batch_stats batched;
+};
+
+/**
+ * Size every array for up to max_items, so sorting never allocates.
+ */
+void draw_batcher_reserve(struct draw_batcher* batcher, uint32_t max_items);
+
+/**
+ * Sort keys[0, count) and items along with them, then merge the sorted
+ * items into batches (one per item with per_item set) and fill in both
+ * sets of stats. The sort's scratch
+ * arrays come from scratch, usually the frame arena; if it is exhausted
+ * the items stay unsorted and only equal neighbours share a draw.
+ */
+void draw_batcher_sort(struct draw_batcher* batcher, uint32_t count, struct arena* scratch);
+
+/**
+ * Stable LSD radix sort of count keys and their values, a byte per pass.
+ * Bytes every key shares are skipped, so keys with few distinct high
+ * fields take few passes. The scratch arrays hold count entries; the
+ * result ends up in keys and values.
+ */
+void radix_sort(uint64_t* keys, uint32_t* values, uint64_t* key_scratch, uint32_t* value_scratch,
+                uint32_t count);
+
+#endif // ENGINE_DRAW_BATCH_H
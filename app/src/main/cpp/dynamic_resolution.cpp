@@ -0,0 +1,63 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+// how much of each new measurement goes into the smoothed cost when it is
+// above and below it
+#define RISE_WEIGHT 0.5
+#define FALL_WEIGHT 0.1
+
+void dynamic_resolution_init(struct dynamic_resolution* dr, int64_t budget_ns, float min_scale, float max_scale) {
+    *dr = {};
+    dr->budget_ns = budget_ns;
+    dr->max_scale = std::min(std::max(max_scale, 0.01f), 1.0f);
+    dr->min_scale = std::min(std::max(min_scale, 0.01f), dr->max_scale);
+    dr->scale = dr->max_scale;
+    dr->since_change = DYNRES_SETTLE_FRAMES;
+    dr->stats.budget_ns = budget_ns;
+    dr->stats.scale = dr->scale;
+}
+
+float dynamic_resolution_update(struct dynamic_resolution* dr, int64_t gpu_ns, float frame_scale) {
+    struct dynamic_resolution_stats* stats = &dr->stats;
+    if (gpu_ns <= 0 || !(frame_scale > 0.0f)) {
+        return dr->scale;
+    }
+    stats->frames++;
+    stats->gpu_ns = gpu_ns;
+    stats->over_budget_frames += gpu_ns > dr->budget_ns;
+
+    // assumes the cost is all per pixel; what does not scale makes the
+    // estimate high at low scales, which errs toward staying low
+    double full = (double)gpu_ns / ((double)frame_scale * (double)frame_scale);
+    // a rise has to last two frames: a single slow frame is over before
+    // its measurement arrives, and dropping for it only blurs the next ones
+    double rise = std::min(full, dr->last_full_ns);
+    dr->last_full_ns = full;
+    if (dr->full_ns <= 0.0) {
+        dr->full_ns = full;
+    } else if (rise > dr->full_ns) {
+        dr->full_ns += (rise - dr->full_ns) * RISE_WEIGHT;
+    } else if (full < dr->full_ns) {
+        dr->full_ns += (full - dr->full_ns) * FALL_WEIGHT;
+    }
+    stats->full_ns = (int64_t)dr->full_ns;
+    dr->since_change++;
+
+    float fits = (float)sqrt((double)dr->budget_ns * DYNRES_HEADROOM / dr->full_ns);
+    fits = std::min(std::max(fits, dr->min_scale), dr->max_scale);
+    double current_ns = dr->full_ns * (double)dr->scale * (double)dr->scale;
+    if (current_ns > (double)dr->budget_ns * DYNRES_DROP && fits < dr->scale) {
+        dr->scale = fits;
+        dr->since_change = 0;
+        stats->decreases++;
+    } else if ((fits > dr->scale * DYNRES_MIN_GROWTH || (fits == dr->max_scale && fits > dr->scale)) &&
+               dr->since_change >= DYNRES_SETTLE_FRAMES) {
+        dr->scale = std::min(fits, dr->scale * DYNRES_MAX_GROWTH);
+        dr->since_change = 0;
+        stats->increases++;
+    }
+    stats->scale = dr->scale;
+    return dr->scale;
+}
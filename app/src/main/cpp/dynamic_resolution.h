@@ -0,0 +1,74 @@
+#ifndef ENGINE_DYNAMIC_RESOLUTION_H
+#define ENGINE_DYNAMIC_RESOLUTION_H
+
+#include <cstdint>
+
+// the scale aims this far under the budget, so ordinary frame to frame
+// noise does not push it over
+#define DYNRES_HEADROOM 0.9f
+// it drops as soon as the current scale is estimated to take this much of
+// the budget; between the two it holds
+#define DYNRES_DROP 0.95f
+// the scale only grows once it can grow by this much, and by at most
+// DYNRES_MAX_GROWTH per change
+#define DYNRES_MIN_GROWTH 1.04f
+#define DYNRES_MAX_GROWTH 1.1f
+// measurements to wait after a change before growing again
+#define DYNRES_SETTLE_FRAMES 8
+
+struct dynamic_resolution_stats {
+    int64_t budget_ns;
+    // per-axis scale the next frame renders at
+    float scale;
+    // the last measurement and the full-resolution cost it implies after
+    // smoothing
+    int64_t gpu_ns;
+    int64_t full_ns;
+    // totals since init: measurements, those over the budget, and scale
+    // changes down and up
+    uint64_t frames;
+    uint64_t over_budget_frames;
+    uint32_t decreases;
+    uint32_t increases;
+};
+
+/**
+ * Picks the render resolution that keeps a GPU time within budget. Each
+ * measurement is divided by the pixel fraction it was rendered at to
+ * estimate what full resolution would cost, smoothed (rises lasting two
+ * frames are taken quickly, single slow frames ignored, falls taken
+ * slowly), and the scale set to what that estimate says fits
+ * DYNRES_HEADROOM of the budget. Drops happen immediately;
+ * growth waits for the previous change to show up in the measurements
+ * and moves in bounded steps, so a load that sits near the budget does
+ * not make the resolution oscillate.
+ *
+ * Pure bookkeeping on durations; the caller measures (a frame or more
+ * late is fine, as long as each measurement comes with the scale that
+ * frame rendered at) and resizes.
+ */
+struct dynamic_resolution {
+    int64_t budget_ns;
+    float min_scale;
+    float max_scale;
+    float scale;
+    // smoothed full-resolution cost, 0 until the first measurement, and
+    // the last unsmoothed one
+    double full_ns;
+    double last_full_ns;
+    uint32_t since_change;
+    struct dynamic_resolution_stats stats;
+};
+
+/**
+ * Start at max_scale; scales are per axis, within (0, 1].
+ */
+void dynamic_resolution_init(struct dynamic_resolution* dr, int64_t budget_ns, float min_scale, float max_scale);
+
+/**
+ * Feed the GPU time of a frame rendered at frame_scale. Returns the scale
+ * to render the next frame at.
+ */
+float dynamic_resolution_update(struct dynamic_resolution* dr, int64_t gpu_ns, float frame_scale);
+
+#endif // ENGINE_DYNAMIC_RESOLUTION_H
@@ -0,0 +1,323 @@
+#include "ecs.h"
+
+#include <cstring>
+
+#include "log.h"
+
+static inline uint32_t entity_index(entity e) {
+    return (uint32_t)(e & 0xFFFFFFFFu);
+}
+
+static inline uint32_t entity_generation(entity e) {
+    return (uint32_t)(e >> 32);
+}
+
+static inline entity make_entity(uint32_t index, uint32_t generation) {
+    return ((uint64_t)generation << 32) | index;
+}
+
+static inline uint32_t align_up(uint32_t value, uint32_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+/**
+ * Lay out the component arrays for capacity entities; returns the bytes used.
+ */
+static uint32_t layout_archetype(const struct ecs_world* world, struct ecs_archetype* archetype,
+                                 uint32_t capacity) {
+    uint32_t offset = align_up((uint32_t)sizeof(struct ecs_chunk), 16);
+    for (uint32_t c = 0; c < world->component_count; c++) {
+        if (archetype->mask & ECS_BIT(c)) {
+            offset = align_up(offset, world->component_aligns[c]);
+            archetype->offsets[c] = offset;
+            offset += world->component_sizes[c] * capacity;
+        }
+    }
+    offset = align_up(offset, alignof(entity));
+    archetype->entity_offset = offset;
+    return offset + (uint32_t)sizeof(entity) * capacity;
+}
+
+static struct ecs_archetype* find_archetype(struct ecs_world* world, ecs_mask mask) {
+    for (struct ecs_archetype* archetype : world->archetypes) {
+        if (archetype->mask == mask) {
+            return archetype;
+        }
+    }
+
+    auto* archetype = new ecs_archetype();
+    archetype->mask = mask;
+    uint32_t stride = sizeof(entity);
+    for (uint32_t c = 0; c < world->component_count; c++) {
+        if (mask & ECS_BIT(c)) {
+            stride += world->component_sizes[c];
+        }
+    }
+    uint32_t capacity = (ECS_CHUNK_SIZE - 16) / stride;
+    // alignment padding may push the estimate over the chunk size
+    while (capacity > 1 && layout_archetype(world, archetype, capacity) > ECS_CHUNK_SIZE) {
+        capacity--;
+    }
+    archetype->capacity = capacity;
+    world->archetypes.push_back(archetype);
+    return archetype;
+}
+
+/**
+ * Chunk with a free row, allocating a new one when all are full. Chunks
+ * other than the last are kept full by swap-removal, so only the last one
+ * needs checking.
+ */
+static struct ecs_chunk* chunk_with_space(struct ecs_world* world, struct ecs_archetype* archetype) {
+    if (!archetype->chunks.empty()) {
+        struct ecs_chunk* last = archetype->chunks.back();
+        if (last->count < archetype->capacity) {
+            return last;
+        }
+    }
+    auto* chunk = (struct ecs_chunk*)pool_alloc(&world->chunk_pool);
+    if (chunk == nullptr) {
+        LOGE("ecs: out of chunks");
+        return nullptr;
+    }
+    chunk->archetype = archetype;
+    chunk->count = 0;
+    archetype->chunks.push_back(chunk);
+    return chunk;
+}
+
+/**
+ * Remove a row by moving the archetype's very last row into it.
+ */
+static void remove_row(struct ecs_world* world, struct ecs_chunk* chunk, uint32_t row) {
+    struct ecs_archetype* archetype = chunk->archetype;
+    struct ecs_chunk* last = archetype->chunks.back();
+    uint32_t last_row = last->count - 1;
+
+    if (last != chunk || last_row != row) {
+        for (uint32_t c = 0; c < world->component_count; c++) {
+            if (archetype->mask & ECS_BIT(c)) {
+                uint32_t size = world->component_sizes[c];
+                uint8_t* column = (uint8_t*)chunk + archetype->offsets[c];
+                uint8_t* last_column = (uint8_t*)last + archetype->offsets[c];
+                memcpy(column + row * size, last_column + last_row * size, size);
+            }
+        }
+        entity moved = ecs_entities(last)[last_row];
+        ecs_entities(chunk)[row] = moved;
+        struct ecs_record* record = &world->records[entity_index(moved)];
+        record->chunk = chunk;
+        record->row = row;
+    }
+
+    last->count--;
+    if (last->count == 0) {
+        archetype->chunks.pop_back();
+        pool_free(&world->chunk_pool, last);
+    }
+}
+
+int ecs_world_init(struct ecs_world* world, uint32_t max_chunks) {
+    world->component_count = 0;
+    world->live_entities = 0;
+    world->structure_version = 0;
+    // slot 0 is never handed out so that 0 can mean "no entity"
+    world->records.push_back({});
+    return pool_init(&world->chunk_pool, ECS_CHUNK_SIZE, max_chunks);
+}
+
+void ecs_world_destroy(struct ecs_world* world) {
+    for (struct ecs_archetype* archetype : world->archetypes) {
+        delete archetype;
+    }
+    world->archetypes.clear();
+    world->records.clear();
+    world->free_records.clear();
+    world->live_entities = 0;
+    world->structure_version = 0;
+    pool_destroy(&world->chunk_pool);
+}
+
+uint32_t ecs_register_component(struct ecs_world* world, uint32_t size, uint32_t align) {
+    if (world->component_count >= ECS_MAX_COMPONENTS || !world->archetypes.empty()) {
+        LOGE("ecs: components must be registered before entities are created");
+        return UINT32_MAX;
+    }
+    uint32_t id = world->component_count++;
+    world->component_sizes[id] = size;
+    world->component_aligns[id] = align < 4 ? 4 : align;
+    return id;
+}
+
+entity ecs_create(struct ecs_world* world, ecs_mask mask) {
+    struct ecs_archetype* archetype = find_archetype(world, mask);
+    struct ecs_chunk* chunk = chunk_with_space(world, archetype);
+    if (chunk == nullptr) {
+        return ECS_NULL_ENTITY;
+    }
+
+    uint32_t index;
+    if (!world->free_records.empty()) {
+        index = world->free_records.back();
+        world->free_records.pop_back();
+    } else {
+        index = (uint32_t)world->records.size();
+        world->records.push_back({ nullptr, 0, 1 });
+    }
+    struct ecs_record* record = &world->records[index];
+    record->chunk = chunk;
+    record->row = chunk->count++;
+
+    for (uint32_t c = 0; c < world->component_count; c++) {
+        if (mask & ECS_BIT(c)) {
+            uint32_t size = world->component_sizes[c];
+            memset((uint8_t*)chunk + archetype->offsets[c] + record->row * size, 0, size);
+        }
+    }
+    entity e = make_entity(index, record->generation);
+    ecs_entities(chunk)[record->row] = e;
+    world->live_entities++;
+    world->structure_version++;
+    return e;
+}
+
+bool ecs_alive(const struct ecs_world* world, entity e) {
+    uint32_t index = entity_index(e);
+    return index != 0 && index < world->records.size() &&
+           world->records[index].generation == entity_generation(e) &&
+           world->records[index].chunk != nullptr;
+}
+
+void ecs_destroy(struct ecs_world* world, entity e) {
+    if (!ecs_alive(world, e)) {
+        return;
+    }
+    struct ecs_record* record = &world->records[entity_index(e)];
+    remove_row(world, record->chunk, record->row);
+    record->chunk = nullptr;
+    record->generation++;
+    world->free_records.push_back(entity_index(e));
+    world->live_entities--;
+    world->structure_version++;
+}
+
+ecs_mask ecs_get_mask(const struct ecs_world* world, entity e) {
+    if (!ecs_alive(world, e)) {
+        return 0;
+    }
+    return world->records[entity_index(e)].chunk->archetype->mask;
+}
+
+void ecs_set_mask(struct ecs_world* world, entity e, ecs_mask mask) {
+    if (!ecs_alive(world, e)) {
+        return;
+    }
+    struct ecs_record* record = &world->records[entity_index(e)];
+    struct ecs_chunk* from = record->chunk;
+    struct ecs_archetype* from_archetype = from->archetype;
+    if (from_archetype->mask == mask) {
+        return;
+    }
+    struct ecs_archetype* to_archetype = find_archetype(world, mask);
+    struct ecs_chunk* to = chunk_with_space(world, to_archetype);
+    if (to == nullptr) {
+        return;
+    }
+    uint32_t from_row = record->row;
+    uint32_t to_row = to->count++;
+
+    for (uint32_t c = 0; c < world->component_count; c++) {
+        if (!(mask & ECS_BIT(c))) {
+            continue;
+        }
+        uint32_t size = world->component_sizes[c];
+        uint8_t* dst = (uint8_t*)to + to_archetype->offsets[c] + to_row * size;
+        if (from_archetype->mask & ECS_BIT(c)) {
+            memcpy(dst, (uint8_t*)from + from_archetype->offsets[c] + from_row * size, size);
+        } else {
+            memset(dst, 0, size);
+        }
+    }
+    ecs_entities(to)[to_row] = e;
+
+    // removing may move another entity into from_row; e itself is updated after
+    remove_row(world, from, from_row);
+    record->chunk = to;
+    record->row = to_row;
+    world->structure_version++;
+}
+
+void* ecs_get(struct ecs_world* world, entity e, uint32_t component) {
+    if (!ecs_alive(world, e)) {
+        return nullptr;
+    }
+    const struct ecs_record* record = &world->records[entity_index(e)];
+    const struct ecs_archetype* archetype = record->chunk->archetype;
+    if (!(archetype->mask & ECS_BIT(component))) {
+        return nullptr;
+    }
+    return (uint8_t*)record->chunk + archetype->offsets[component] +
+           record->row * world->component_sizes[component];
+}
+
+static inline bool matches(ecs_mask mask, ecs_mask required, ecs_mask excluded) {
+    return (mask & required) == required && (mask & excluded) == 0;
+}
+
+void ecs_for_each_chunk(struct ecs_world* world, ecs_mask required, ecs_mask excluded,
+                        ecs_chunk_func func, void* data) {
+    for (struct ecs_archetype* archetype : world->archetypes) {
+        if (!matches(archetype->mask, required, excluded)) {
+            continue;
+        }
+        for (struct ecs_chunk* chunk : archetype->chunks) {
+            func(chunk, data);
+        }
+    }
+}
+
+struct parallel_chunks {
+    struct ecs_chunk** chunks;
+    ecs_chunk_func func;
+    void* data;
+};
+
+static void run_chunks(void* data, uint32_t begin, uint32_t end) {
+    auto* work = (struct parallel_chunks*)data;
+    for (uint32_t i = begin; i < end; i++) {
+        work->func(work->chunks[i], work->data);
+    }
+}
+
+void ecs_parallel_for_chunks(struct ecs_world* world, struct job_system* jobs, ecs_mask required,
+                             ecs_mask excluded, ecs_chunk_func func, void* data) {
+    uint32_t count = 0;
+    for (struct ecs_archetype* archetype : world->archetypes) {
+        if (matches(archetype->mask, required, excluded)) {
+            count += (uint32_t)archetype->chunks.size();
+        }
+    }
+    if (count == 0) {
+        return;
+    }
+
+    size_t mark = scratch_mark();
+    auto* chunks = (struct ecs_chunk**)scratch_alloc(sizeof(struct ecs_chunk*) * count);
+    if (chunks == nullptr) {
+        ecs_for_each_chunk(world, required, excluded, func, data);
+        return;
+    }
+    uint32_t n = 0;
+    for (struct ecs_archetype* archetype : world->archetypes) {
+        if (matches(archetype->mask, required, excluded)) {
+            for (struct ecs_chunk* chunk : archetype->chunks) {
+                chunks[n++] = chunk;
+            }
+        }
+    }
+
+    struct parallel_chunks work{ chunks, func, data };
+    // a chunk is already a few hundred entities, so one chunk per job
+    job_parallel_for(jobs, count, 1, run_chunks, &work);
+    scratch_release(mark);
+}
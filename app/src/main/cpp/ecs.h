@@ -0,0 +1,136 @@
+#ifndef ENGINE_ECS_H
+#define ENGINE_ECS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "jobs.h"
+#include "memory.h"
+
+/**
+ * Archetype based entity-component system. Entities with the same set of
+ * components share an archetype; its entities live in fixed-size chunks
+ * where every component is stored as its own contiguous array (SoA), so
+ * systems stream through exactly the data they read.
+ *
+ * Structural changes (create/destroy/add/remove) must not happen while a
+ * query over the same world is running.
+ */
+#define ECS_MAX_COMPONENTS 64
+#define ECS_CHUNK_SIZE (16 * 1024)
+#define ECS_DEFAULT_MAX_CHUNKS 4096
+
+typedef uint64_t ecs_mask;
+// generation in the high 32 bits, slot index in the low 32 bits
+typedef uint64_t entity;
+
+#define ECS_NULL_ENTITY 0ull
+#define ECS_BIT(component) (1ull << (component))
+
+struct ecs_archetype;
+
+/**
+ * Chunk header, followed by the component arrays.
+ */
+struct ecs_chunk {
+    struct ecs_archetype* archetype;
+    uint32_t count;
+};
+
+struct ecs_archetype {
+    ecs_mask mask;
+    uint32_t capacity;
+    // byte offset of each component array from the chunk start, 0 if absent
+    uint32_t offsets[ECS_MAX_COMPONENTS];
+    uint32_t entity_offset;
+    std::vector<struct ecs_chunk*> chunks;
+};
+
+struct ecs_record {
+    struct ecs_chunk* chunk;
+    uint32_t row;
+    uint32_t generation;
+};
+
+struct ecs_world {
+    uint32_t component_count;
+    uint32_t component_sizes[ECS_MAX_COMPONENTS];
+    uint32_t component_aligns[ECS_MAX_COMPONENTS];
+    std::vector<struct ecs_archetype*> archetypes;
+    std::vector<struct ecs_record> records;
+    std::vector<uint32_t> free_records;
+    uint32_t live_entities;
+    // bumped by every structural change; whoever keeps pointers into
+    // chunks compares it to know when they went stale
+    uint32_t structure_version;
+    // chunk storage, one block per chunk
+    struct pool chunk_pool;
+};
+
+int ecs_world_init(struct ecs_world* world, uint32_t max_chunks = ECS_DEFAULT_MAX_CHUNKS);
+
+void ecs_world_destroy(struct ecs_world* world);
+
+/**
+ * Components are registered once at startup; the returned id indexes masks.
+ */
+uint32_t ecs_register_component(struct ecs_world* world, uint32_t size, uint32_t align);
+
+/**
+ * Create an entity with the components in mask, zero initialized.
+ */
+entity ecs_create(struct ecs_world* world, ecs_mask mask);
+
+void ecs_destroy(struct ecs_world* world, entity e);
+
+bool ecs_alive(const struct ecs_world* world, entity e);
+
+/**
+ * Move the entity to the archetype with the given mask, keeping the data
+ * of components present in both.
+ */
+void ecs_set_mask(struct ecs_world* world, entity e, ecs_mask mask);
+
+ecs_mask ecs_get_mask(const struct ecs_world* world, entity e);
+
+/**
+ * Pointer to the entity's component, nullptr if it does not have it.
+ * Invalidated by structural changes.
+ */
+void* ecs_get(struct ecs_world* world, entity e, uint32_t component);
+
+template <typename T>
+T* ecs_get(struct ecs_world* world, entity e, uint32_t component) {
+    return (T*)ecs_get(world, e, component);
+}
+
+/**
+ * Component array of a chunk; index it with 0..chunk->count-1.
+ */
+template <typename T>
+T* ecs_column(struct ecs_chunk* chunk, uint32_t component) {
+    return (T*)((uint8_t*)chunk + chunk->archetype->offsets[component]);
+}
+
+inline entity* ecs_entities(struct ecs_chunk* chunk) {
+    return (entity*)((uint8_t*)chunk + chunk->archetype->entity_offset);
+}
+
+typedef void (*ecs_chunk_func)(struct ecs_chunk* chunk, void* data);
+
+/**
+ * Call func for every non-empty chunk whose archetype has all components
+ * in required and none in excluded.
+ */
+void ecs_for_each_chunk(struct ecs_world* world, ecs_mask required, ecs_mask excluded,
+                        ecs_chunk_func func, void* data);
+
+/**
+ * Same as ecs_for_each_chunk, with chunks spread over the job system.
+ * func runs concurrently on different chunks.
+ */
+void ecs_parallel_for_chunks(struct ecs_world* world, struct job_system* jobs, ecs_mask required,
+                             ecs_mask excluded, ecs_chunk_func func, void* data);
+
+#endif // ENGINE_ECS_H
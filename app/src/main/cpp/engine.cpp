@@ -0,0 +1,540 @@
+#include "engine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "log.h"
+#include "pipeline_cache.h"
+#include "platform.h"
+#include "profiler.h"
+
+// timestamps engine_record_graph writes every frame, in order
+enum engine_timestamp {
+    TIMESTAMP_MAIN,
+    TIMESTAMP_UPSCALE,
+    TIMESTAMP_END,
+};
+
+static void engine_pipeline_cache_path(const struct engine* engine, char* path, size_t size) {
+    snprintf(path, size, "%s/pipeline_cache.bin",
+             engine->data_path != nullptr ? engine->data_path : ".");
+}
+
+/**
+ * Tear down whatever engine_init managed to create.
+ */
+static void engine_release(struct engine* engine) {
+    streamer_destroy(&engine->streamer);
+    gpu_cull_destroy(&engine->vk, &engine->gpu_cull);
+    upscaler_destroy(&engine->vk, &engine->upscaler);
+    scene_renderer_destroy(&engine->vk, &engine->scene_renderer);
+    gpu_timer_destroy(&engine->vk, &engine->gpu_timer);
+    renderer_destroy(&engine->vk, &engine->renderer);
+    // the renderer has waited for the device to go idle
+    render_graph_release(&engine->vk, &engine->graph);
+    vk_context_destroy(&engine->vk);
+    scene_cull_destroy(&engine->cull);
+    scene_destroy(&engine->scene);
+    frame_memory_destroy(&engine->frame_memory);
+    asset_pack_close(&engine->assets);
+}
+
+/**
+ * Create the pipeline cache and every pipeline, timing how long a cold or
+ * warm cache takes.
+ */
+static int engine_create_pipelines(struct engine* engine) {
+    char path[512];
+    engine_pipeline_cache_path(engine, path, sizeof(path));
+    size_t loaded_bytes = 0;
+    if (pipeline_cache_create(&engine->vk, path, &loaded_bytes) != 0) {
+        return -1;
+    }
+    int64_t start = platform_time_ns();
+    uint32_t entities = engine->scene.world.live_entities;
+    // with GPU culling the instances come from the cull pass instead
+    if (scene_renderer_init(&engine->vk, &engine->scene_renderer, &engine->renderer,
+                            engine->graph.passes[engine->main_pass].render_pass,
+                            engine->gpu_culling ? 1 : entities) != 0) {
+        return -1;
+    }
+    if (engine->gpu_culling &&
+        (gpu_cull_init(&engine->vk, &engine->gpu_cull, &engine->renderer, entities) != 0 ||
+         gpu_cull_set_depth(&engine->vk, &engine->gpu_cull, engine->graph.resources[engine->depth].view,
+                            engine->graph.resources[engine->depth].width,
+                            engine->graph.resources[engine->depth].height) != 0)) {
+        return -1;
+    }
+    if (upscaler_init(&engine->vk, &engine->upscaler, engine->graph.passes[engine->upscale_pass].render_pass) != 0) {
+        return -1;
+    }
+    upscaler_set_source(&engine->vk, &engine->upscaler, engine->graph.resources[engine->scene_color].view);
+    engine->stats.pipeline_create_ns = platform_time_ns() - start;
+    LOGI("pipelines: created in %.2f ms from a %s cache (%zu bytes)",
+         (double)engine->stats.pipeline_create_ns * 1e-6, loaded_bytes > 0 ? "warm" : "cold",
+         loaded_bytes);
+    return 0;
+}
+
+/**
+ * Names of the texture formats in mask, comma separated.
+ */
+static void format_names(uint32_t mask, char* names, size_t size) {
+    size_t length = 0;
+    names[0] = '\0';
+    for (uint32_t format = 0; format < TEXTURE_FORMAT_COUNT; format++) {
+        if ((mask & (1u << format)) != 0 && length < size) {
+            length += (size_t)snprintf(names + length, size - length, "%s%s", length > 0 ? ", " : "",
+                                       texture_format_name((enum texture_format)format));
+        }
+    }
+}
+
+/**
+ * Log which formats the device samples and which variant of every texture
+ * in the pack that selects.
+ */
+static void engine_select_textures(struct engine* engine) {
+    struct texture_support* support = &engine->texture_support;
+    texture_query_support(engine->vk.physical_device, support);
+    // sRGB textures select from the first set, linear ones from the second
+    char srgb[256];
+    char unorm[256];
+    format_names(support->srgb, srgb, sizeof(srgb));
+    format_names(support->unorm, unorm, sizeof(unorm));
+    LOGI("textures: device samples sRGB %s; linear %s", srgb, unorm);
+
+    const struct asset_pack* pack = &engine->assets;
+    for (uint32_t i = 0; i < pack->entry_count; i++) {
+        const struct asset_pack_entry* entry = &pack->entries[i];
+        struct texture_data texture;
+        if (entry->type != ASSET_TEXTURE || texture_load(pack, entry->name, &texture) != 0) {
+            continue;
+        }
+        int variant = texture_select(&texture, support);
+        if (variant < 0) {
+            LOGW("texture %s: none of its %u formats can be sampled", entry->name,
+                 texture.header->variant_count);
+            continue;
+        }
+        const struct texture_variant* selected = &texture.variants[variant];
+        LOGI("texture %s: %ux%u %s, %u of %zu bytes in the pack", entry->name, texture.header->width,
+             texture.header->height, texture_format_name((enum texture_format)selected->format),
+             selected->size, (size_t)entry->size);
+    }
+}
+
+static void engine_execute_main_pass(void* data, VkCommandBuffer cmd, const struct rg_pass* pass);
+static void engine_execute_pyramid_pass(void* data, VkCommandBuffer cmd, const struct rg_pass* pass);
+static void engine_execute_upscale_pass(void* data, VkCommandBuffer cmd, const struct rg_pass* pass);
+
+/**
+ * Declare the frame against the current swapchain and create its
+ * transient images and render passes.
+ */
+static int engine_build_graph(struct engine* engine) {
+    struct render_graph* graph = &engine->graph;
+    VkExtent2D extent = engine->renderer.swapchain.extent;
+    render_graph_reset(graph);
+    // the acquire semaphore is waited on at COLOR_ATTACHMENT_OUTPUT, so the
+    // layout transition of the swapchain image must wait for that stage
+    engine->backbuffer = rg_import_image(graph, "backbuffer", engine->renderer.swapchain.format,
+                                         extent.width, extent.height, VK_IMAGE_LAYOUT_UNDEFINED,
+                                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    rg_mark_output(graph, engine->backbuffer, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    // full size, so the render resolution can change without a rebuild
+    engine->scene_color = rg_create_image(graph, "scene_color", engine->renderer.swapchain.format,
+                                          extent.width, extent.height);
+    engine->depth = rg_create_image(graph, "depth", engine->renderer.depth_format, extent.width, extent.height);
+
+    // the color clear value is refreshed every frame
+    VkClearValue color_clear{};
+    VkClearValue depth_clear{};
+    depth_clear.depthStencil.depth = 1.0f;
+    engine->main_pass = rg_add_pass(graph, "main", RG_GRAPHICS, engine_execute_main_pass, engine);
+    rg_use(graph, engine->main_pass, engine->scene_color, RG_COLOR_ATTACHMENT, &color_clear);
+    rg_use(graph, engine->main_pass, engine->depth, RG_DEPTH_ATTACHMENT, &depth_clear);
+    // the next frame's cull pass tests occlusion against this one's depth;
+    // timed with the main pass, whose resolution it scales with
+    engine->depth_pyramid = RG_NONE;
+    if (engine->gpu_culling && gpu_cull_can_occlude(engine->vk.physical_device, engine->renderer.depth_format)) {
+        engine->depth_pyramid = rg_import_image(graph, "depth_pyramid", VK_FORMAT_R32_SFLOAT,
+                                                (extent.width + 1) / 2, (extent.height + 1) / 2,
+                                                VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        rg_mark_output(graph, engine->depth_pyramid, VK_IMAGE_LAYOUT_GENERAL);
+        uint32_t pass = rg_add_pass(graph, "depth_pyramid", RG_COMPUTE, engine_execute_pyramid_pass, engine);
+        rg_use(graph, pass, engine->depth, RG_SAMPLED);
+        rg_use(graph, pass, engine->depth_pyramid, RG_STORAGE_WRITE);
+    }
+    engine->upscale_pass = rg_add_pass(graph, "upscale", RG_GRAPHICS, engine_execute_upscale_pass, engine);
+    rg_use(graph, engine->upscale_pass, engine->scene_color, RG_SAMPLED);
+    rg_use(graph, engine->upscale_pass, engine->backbuffer, RG_COLOR_ATTACHMENT);
+
+    engine->graph_generation = engine->renderer.swapchain_generation;
+    if (render_graph_realize(&engine->vk, graph) != 0) {
+        return -1;
+    }
+    render_graph_log(graph);
+    // on a rebuild; the first build comes before the upscaler and the
+    // cull pass exist
+    if (engine->upscaler.set != VK_NULL_HANDLE) {
+        upscaler_set_source(&engine->vk, &engine->upscaler, graph->resources[engine->scene_color].view);
+    }
+    if (engine->gpu_cull.pipeline != VK_NULL_HANDLE &&
+        gpu_cull_set_depth(&engine->vk, &engine->gpu_cull, graph->resources[engine->depth].view, extent.width,
+                           extent.height) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Initialize engine
+ */
+int engine_init(struct engine* engine) {
+    if (engine->initialized) {
+        return 0;
+    }
+    uint32_t frames_in_flight = engine->frames_in_flight != 0
+                                ? engine->frames_in_flight : DEFAULT_FRAMES_IN_FLIGHT;
+    uint32_t entities = engine->scene_entities != 0 ? engine->scene_entities : DEFAULT_SCENE_ENTITIES;
+    // room for the draw sort's scratch arrays on top of everything else
+    size_t arena_size = FRAME_ARENA_SIZE + (size_t)entities * (sizeof(uint64_t) + sizeof(uint32_t)) + 64;
+    if (frame_memory_init(&engine->frame_memory, arena_size) != 0 ||
+        scene_init(&engine->scene) != 0) {
+        frame_memory_destroy(&engine->frame_memory);
+        return -1;
+    }
+    // optional until there are assets the engine cannot run without
+    if (asset_pack_open(&engine->assets, "engine.pak") == 0) {
+        LOGI("engine.pak: %u assets, %zu bytes mapped", engine->assets.entry_count,
+             engine->assets.mapping.size);
+    } else {
+        LOGI("no engine.pak, running with built-in assets only");
+    }
+    scene_spawn_demo(&engine->scene, entities, 1);
+    if (vk_context_init(&engine->vk, engine->window) != 0 ||
+        renderer_init(&engine->vk, &engine->renderer, (uint32_t)engine->width,
+                      (uint32_t)engine->height, frames_in_flight, engine->jobs->worker_count) != 0 ||
+        gpu_timer_init(&engine->vk, &engine->gpu_timer, &engine->renderer) != 0 ||
+        engine_build_graph(engine) != 0 ||
+        engine_create_pipelines(engine) != 0 ||
+        streamer_init(&engine->vk, &engine->streamer) != 0) {
+        engine_release(engine);
+        return -1;
+    }
+    dynamic_resolution_init(&engine->resolution, (int64_t)(engine->gpu_budget_ms * 1e6f),
+                            engine->min_render_scale > 0.0f ? engine->min_render_scale : DEFAULT_MIN_RENDER_SCALE,
+                            engine->max_render_scale > 0.0f ? engine->max_render_scale : 1.0f);
+    if (engine->gpu_budget_ms > 0.0f) {
+        if (engine->gpu_timer.pool == VK_NULL_HANDLE) {
+            LOGW("dynamic resolution: no GPU timestamps, the main pass stays at %.0f%% resolution",
+                 (double)engine->resolution.scale * 100.0);
+        } else {
+            LOGI("dynamic resolution: %.2f ms main pass budget, scale %.2f to %.2f", (double)engine->gpu_budget_ms,
+                 (double)engine->resolution.min_scale, (double)engine->resolution.max_scale);
+        }
+    }
+    gpu_allocator_log(&engine->vk.allocator);
+    engine_select_textures(engine);
+    if (engine->target_hz > 0.0f) {
+        float display_hz = engine->display_hz > 0.0f ? engine->display_hz : 60.0f;
+        frame_pacer_init(&engine->pacer, display_hz, engine->target_hz);
+        frame_pacer_set_refresh(&engine->pacer, renderer_refresh_duration(&engine->vk, &engine->renderer));
+    }
+    engine->initialized = 1;
+    engine->frame_index = 0;
+    engine->last_frame_ns = platform_time_ns();
+
+    LOGI("intialized");
+    return 0;
+}
+
+/**
+ * Apply one input event to the saved state.
+ */
+static void engine_apply_input(const struct input_event* event, void* data) {
+    auto* engine = (struct engine*)data;
+    if ((event->type == INPUT_TOUCH_DOWN || event->type == INPUT_TOUCH_MOVE) &&
+        event->pointer_count > 0) {
+        engine->state.counter++;
+        engine->state.x = (int32_t)event->pointers[0].x;
+        engine->state.y = (int32_t)event->pointers[0].y;
+    }
+}
+
+/**
+ * Simulation step for the frame.
+ */
+static void engine_update(void* data, uint32_t /*begin*/, uint32_t /*end*/) {
+    PROFILE_SCOPE("engine_update");
+    auto* engine = (struct engine*)data;
+    int64_t now = platform_time_ns();
+    // clamp so a stall (or a breakpoint) does not teleport everything
+    float dt = std::min((float)(now - engine->last_frame_ns) * 1e-9f, 0.1f);
+    engine->last_frame_ns = now;
+
+    input_update(&engine->input_queue, &engine->input, now, engine_apply_input, engine);
+    engine->stats.input_events = engine->input.events;
+    engine->stats.input_latency_ns = engine->input.max_latency_ns;
+    engine->stats.input_dropped = engine->input_queue.dropped.load(std::memory_order_relaxed);
+
+    scene_update(&engine->scene, engine->jobs, dt);
+
+    // slow orbit around the box the entities live in
+    engine->camera_yaw += dt * 0.2f;
+    float distance = engine->scene.bounds * 2.5f;
+    struct vec3 eye = { sinf(engine->camera_yaw) * distance, engine->scene.bounds * 0.8f,
+                        cosf(engine->camera_yaw) * distance };
+    struct mat4 view = mat4_look_at(eye, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+    float aspect = engine->height > 0 ? (float)engine->width / (float)engine->height : 1.0f;
+    struct mat4 proj = mat4_perspective(1.0f, aspect, 1.0f, distance * 3.0f);
+    engine->view_proj = mat4_mul(&proj, &view);
+    if (!engine->gpu_culling) {
+        scene_cull_update(&engine->cull, &engine->scene, engine->jobs, &engine->view_proj);
+        engine->stats.visible_objects = engine->cull.visible_count;
+        engine->stats.cull_ns = engine->cull.refit_ns + engine->cull.cull_ns;
+    }
+
+    engine->clear_color[0] = engine->width > 0 ? (float)engine->state.x / (float)engine->width : 0.0f;
+    engine->clear_color[1] = (float)(engine->frame_index % 256) / 255.0f;
+    engine->clear_color[2] = engine->height > 0 ? (float)engine->state.y / (float)engine->height : 0.0f;
+    engine->clear_color[3] = 1.0f;
+}
+
+static void engine_record_scene(void* data, VkCommandBuffer cmd, uint32_t begin, uint32_t end) {
+    auto* engine = (struct engine*)data;
+    scene_renderer_draw(&engine->scene_renderer, &engine->renderer, cmd, &engine->view_proj, begin, end);
+}
+
+static uint32_t engine_record_threads(const struct engine* engine) {
+    if (engine->gpu_culling) {
+        return 1;
+    }
+    return engine->record_threads != 0 ? engine->record_threads : engine->jobs->worker_count;
+}
+
+/**
+ * Record the main pass, split across the job workers unless a single
+ * thread was asked for. GPU culling leaves one indirect draw per
+ * material, recorded inline.
+ */
+static void engine_execute_main_pass(void* data, VkCommandBuffer cmd, const struct rg_pass* pass) {
+    auto* engine = (struct engine*)data;
+    if (engine->gpu_culling) {
+        const struct gpu_cull_frame* frame = &engine->gpu_cull.frames[engine->renderer.frame];
+        engine->stats.batched = scene_renderer_draw_indirect(&engine->vk, &engine->scene_renderer, cmd,
+                                                             &engine->view_proj, frame->visible, frame->draws);
+        engine->stats.unbatched = engine->stats.batched;
+        engine->stats.draws = engine->stats.batched.draws;
+        return;
+    }
+    uint32_t draws = engine->scene_renderer.batcher.batch_count;
+    uint32_t threads = engine_record_threads(engine);
+    if (threads > 1) {
+        renderer_record_parallel(&engine->vk, &engine->renderer, engine->jobs, pass, draws, threads,
+                                 engine_record_scene, engine);
+    } else {
+        engine_record_scene(engine, cmd, 0, draws);
+    }
+    engine->stats.draws = draws;
+}
+
+/**
+ * Reduce what the main pass rendered of the depth buffer into the depth
+ * pyramid.
+ */
+static void engine_execute_pyramid_pass(void* data, VkCommandBuffer cmd, const struct rg_pass* /*pass*/) {
+    auto* engine = (struct engine*)data;
+    gpu_cull_build_pyramid(&engine->gpu_cull, cmd, &engine->view_proj, engine->render_extent);
+}
+
+/**
+ * Stretch what the main pass rendered over the swapchain image.
+ */
+static void engine_execute_upscale_pass(void* data, VkCommandBuffer cmd, const struct rg_pass* /*pass*/) {
+    auto* engine = (struct engine*)data;
+    // waits for everything before it, the main pass included
+    gpu_timer_write(&engine->gpu_timer, &engine->renderer, cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    const struct rg_resource* source = &engine->graph.resources[engine->scene_color];
+    upscaler_draw(&engine->upscaler, cmd, source->width, source->height, engine->render_extent);
+}
+
+/**
+ * Read back the GPU times of the frame last recorded in this slot, feed
+ * the main pass's to the resolution controller and size this frame's main
+ * pass by what it returns. Without a budget the main pass renders at
+ * full size.
+ */
+static void engine_update_resolution(struct engine* engine, VkCommandBuffer cmd) {
+    struct gpu_timer* timer = &engine->gpu_timer;
+    uint32_t slot = engine->renderer.frame;
+    gpu_timer_begin_frame(&engine->vk, timer, &engine->renderer, cmd);
+    int64_t main_ns = gpu_timer_elapsed_ns(timer, TIMESTAMP_MAIN, TIMESTAMP_UPSCALE);
+    engine->stats.gpu_main_ns = main_ns;
+    engine->stats.gpu_upscale_ns = gpu_timer_elapsed_ns(timer, TIMESTAMP_UPSCALE, TIMESTAMP_END);
+
+    float scale = 1.0f;
+    if (engine->gpu_budget_ms > 0.0f) {
+        scale = dynamic_resolution_update(&engine->resolution, main_ns, engine->slot_scales[slot]);
+    }
+    engine->slot_scales[slot] = scale;
+    VkExtent2D extent = engine->renderer.swapchain.extent;
+    engine->render_extent.width = std::max(1u, (uint32_t)lroundf((float)extent.width * scale));
+    engine->render_extent.height = std::max(1u, (uint32_t)lroundf((float)extent.height * scale));
+    engine->stats.render_width = engine->render_extent.width;
+    engine->stats.render_height = engine->render_extent.height;
+    engine->stats.resolution = engine->resolution.stats;
+}
+
+/**
+ * Record the frame graph into cmd, first rebuilding it if the swapchain
+ * was recreated.
+ */
+static void engine_record_graph(struct engine* engine, VkCommandBuffer cmd) {
+    PROFILE_SCOPE("record_graph");
+    if (engine->graph_generation != engine->renderer.swapchain_generation) {
+        // older frames may still be rendering into the transients
+        vkDeviceWaitIdle(engine->vk.device);
+        render_graph_release(&engine->vk, &engine->graph);
+        if (engine_build_graph(engine) != 0) {
+            LOGE("cannot rebuild the render graph");
+            return;
+        }
+    }
+    int64_t start = platform_time_ns();
+    const struct swapchain* swapchain = &engine->renderer.swapchain;
+    uint32_t image = engine->renderer.image_index;
+    rg_set_image(&engine->graph, engine->backbuffer, swapchain->images[image], swapchain->views[image]);
+    if (engine->depth_pyramid != RG_NONE) {
+        rg_set_image(&engine->graph, engine->depth_pyramid, engine->gpu_cull.pyramid, engine->gpu_cull.pyramid_view);
+    }
+    struct rg_pass* main_pass = &engine->graph.passes[engine->main_pass];
+    main_pass->contents = engine_record_threads(engine) > 1 ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                                                            : VK_SUBPASS_CONTENTS_INLINE;
+    main_pass->render_area = engine->render_extent;
+    for (int i = 0; i < 4; i++) {
+        main_pass->uses[0].clear_value.color.float32[i] = engine->clear_color[i];
+    }
+    if (engine->gpu_culling) {
+        gpu_cull_record(&engine->gpu_cull, &engine->renderer, cmd, &engine->view_proj);
+    }
+    // bottom of pipe: each timestamp waits for the work before it, so the
+    // main pass is not charged for the previous frame's tail
+    gpu_timer_write(&engine->gpu_timer, &engine->renderer, cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    render_graph_execute(&engine->vk, &engine->graph, cmd);
+    gpu_timer_write(&engine->gpu_timer, &engine->renderer, cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    engine->stats.record_ns = platform_time_ns() - start;
+}
+
+/**
+ * Draw frame
+ */
+void engine_draw(struct engine* engine) {
+    if (!engine->initialized) {
+        return;
+    }
+    struct heap_counters heap_start = memory_heap_counters();
+
+    // Hold the frame back so it starts just in time for its vsync; input
+    // and simulation then see the freshest possible state.
+    bool paced = engine->target_hz > 0.0f;
+    int64_t frame_start = platform_time_ns();
+    if (paced) {
+        PROFILE_SCOPE("pacing_wait");
+        int64_t wake = frame_pacer_begin_frame(&engine->pacer, frame_start);
+        platform_sleep_until_ns(wake);
+        engine->stats.pacing_wait_ns = wake - frame_start;
+        engine->stats.target_vsync_ns = frame_pacer_target_vsync(&engine->pacer);
+        frame_start = platform_time_ns();
+    }
+    PROFILE_SCOPE("engine_draw");
+    frame_memory_begin(&engine->frame_memory, engine->frame_index);
+
+    // Kick the simulation off to the workers; this thread meanwhile waits
+    // for the frame slot and acquires the swapchain image.
+    struct job_counter update_done;
+    struct job update{};
+    update.func = engine_update;
+    update.data = engine;
+    job_run(engine->jobs, &update, 1, &update_done);
+
+    VkCommandBuffer cmd = renderer_begin_frame(&engine->vk, &engine->renderer);
+    job_wait(engine->jobs, &update_done);
+    // uploads recorded by the streamer since the last frame, when they
+    // have to go through the graphics queue
+    streamer_update(&engine->streamer);
+    engine->stats.stream_pending_bytes = streamer_pending_bytes(&engine->streamer);
+    if (cmd == VK_NULL_HANDLE) {
+        return;
+    }
+    engine_update_resolution(engine, cmd);
+    if (engine->gpu_culling) {
+        int64_t start = platform_time_ns();
+        gpu_cull_upload(&engine->gpu_cull, &engine->renderer, engine->jobs, &engine->scene);
+        engine->stats.visible_objects = engine->gpu_cull.visible_count;
+        engine->stats.cull_ns = platform_time_ns() - start;
+    } else {
+        scene_renderer_upload(&engine->scene_renderer, &engine->renderer, engine->jobs, &engine->cull,
+                              &engine->view_proj, frame_arena(&engine->frame_memory));
+        engine->stats.unbatched = engine->scene_renderer.batcher.unbatched;
+        engine->stats.batched = engine->scene_renderer.batcher.batched;
+    }
+    engine_record_graph(engine, cmd);
+    if (paced) {
+        frame_pacer_frame_done(&engine->pacer, platform_time_ns() - frame_start);
+    }
+    renderer_end_frame(&engine->vk, &engine->renderer,
+                       paced ? frame_pacer_target_vsync(&engine->pacer) : 0);
+    if (paced) {
+        int64_t presents[8];
+        uint32_t count = renderer_past_presents(&engine->vk, &engine->renderer, presents, 8);
+        for (uint32_t i = 0; i < count; i++) {
+            frame_pacer_presented(&engine->pacer, presents[i]);
+        }
+        if (!engine->vk.has_display_timing) {
+            // no present feedback: the acquire returning is the closest
+            // thing to a vsync signal we have
+            frame_pacer_presented(&engine->pacer, engine->renderer.acquired_ns);
+        }
+    }
+    engine->frame_index++;
+
+    engine->stats.heap_allocations = memory_heap_counters().allocations - heap_start.allocations;
+    engine->stats.frame_arena_bytes =
+            frame_arena(&engine->frame_memory)->offset.load(std::memory_order_relaxed);
+    PROFILE_COUNTER("heap allocations", engine->stats.heap_allocations);
+    PROFILE_COUNTER("frame arena bytes", engine->stats.frame_arena_bytes);
+    PROFILE_COUNTER("input events", engine->stats.input_events);
+    PROFILE_COUNTER("visible objects", engine->stats.visible_objects);
+    PROFILE_COUNTER("draws", engine->stats.batched.draws);
+    PROFILE_COUNTER("pipeline binds", engine->stats.batched.pipeline_binds);
+    PROFILE_COUNTER("material binds", engine->stats.batched.material_binds);
+    PROFILE_COUNTER("stream pending bytes", engine->stats.stream_pending_bytes);
+    PROFILE_COUNTER("gpu main pass ns", engine->stats.gpu_main_ns);
+    PROFILE_COUNTER("render width", engine->stats.render_width);
+}
+
+/**
+ * Destroy engine
+ */
+void engine_destroy(struct engine* engine) {
+    if (!engine->initialized) {
+        return;
+    }
+    engine_release(engine);
+    engine->initialized = 0;
+}
+
+/**
+ * Persist caches
+ */
+void engine_save_caches(struct engine* engine) {
+    if (!engine->initialized) {
+        return;
+    }
+    char path[512];
+    engine_pipeline_cache_path(engine, path, sizeof(path));
+    pipeline_cache_save(&engine->vk, path);
+}
@@ -0,0 +1,185 @@
+#ifndef ENGINE_ENGINE_H
+#define ENGINE_ENGINE_H
+
+#include <cstdint>
+
+#include "asset_pack.h"
+#include "cull.h"
+#include "draw_batch.h"
+#include "dynamic_resolution.h"
+#include "frame_pacer.h"
+#include "gpu_cull.h"
+#include "gpu_timer.h"
+#include "input.h"
+#include "jobs.h"
+#include "memory.h"
+#include "render_graph.h"
+#include "renderer.h"
+#include "scene.h"
+#include "scene_renderer.h"
+#include "streamer.h"
+#include "texture.h"
+#include "upscaler.h"
+#include "vk_context.h"
+
+/**
+ * Our saved state data.
+ */
+struct saved_state {
+    uint32_t counter;
+    int32_t x;
+    int32_t y;
+};
+
+#define DEFAULT_SCENE_ENTITIES 10000
+#define DEFAULT_MIN_RENDER_SCALE 0.5f
+
+/**
+ * Per-frame counters, refreshed by every engine_draw.
+ */
+struct engine_stats {
+    // operator new calls made during the last frame; 0 in steady state
+    uint64_t heap_allocations;
+    size_t frame_arena_bytes;
+    // input events consumed by the last update and how long the oldest
+    // one waited between being sampled and reaching the simulation
+    uint32_t input_events;
+    int64_t input_latency_ns;
+    uint64_t input_dropped;
+    // time the pacer held the frame back, and the vsync it aims for
+    int64_t pacing_wait_ns;
+    int64_t target_vsync_ns;
+    // uploads queued on the streamer that have not reached the GPU yet
+    uint64_t stream_pending_bytes;
+    // entities that survived frustum culling, and the time spent updating
+    // the culling trees and culling them; with GPU culling the count is
+    // frames_in_flight frames old and the time is the matrix upload
+    uint32_t visible_objects;
+    int64_t cull_ns;
+    // state changes of the main pass after sorting and instancing, and
+    // what drawing every visible entity on its own would have cost
+    struct draw_batch_stats batched;
+    struct draw_batch_stats unbatched;
+    // draws in the main pass and the time taken to record them
+    uint32_t draws;
+    int64_t record_ns;
+    // GPU time of the main pass and of the upscale into the swapchain
+    // image, from timestamps frames_in_flight frames old; 0 when the
+    // device has no timestamps
+    int64_t gpu_main_ns;
+    int64_t gpu_upscale_ns;
+    // the size the main pass renders at this frame, and the controller
+    // that picked it
+    uint32_t render_width;
+    uint32_t render_height;
+    struct dynamic_resolution_stats resolution;
+    // set once by engine_init: pipeline creation time, lower with a warm
+    // pipeline cache
+    int64_t pipeline_create_ns;
+};
+
+/**
+ * Shared state for our app.
+ */
+struct engine {
+    // ANativeWindow* on Android, nullptr on the headless host
+    void* window;
+    // writable directory for caches, the working directory when nullptr
+    const char* data_path;
+    int initialized;
+    int animating;
+    int32_t width;
+    int32_t height;
+    // 0 selects DEFAULT_FRAMES_IN_FLIGHT
+    uint32_t frames_in_flight;
+    // frame pacing, target_hz 0 disables it (draw as fast as vsync allows)
+    float target_hz;
+    float display_hz;
+    struct frame_pacer pacer;
+    // entities spawned into the demo scene, 0 selects DEFAULT_SCENE_ENTITIES
+    uint32_t scene_entities;
+    // secondary command buffers the main pass is recorded into, in parallel
+    // on the job workers; 0 uses one per worker, 1 records inline on the
+    // render thread
+    uint32_t record_threads;
+    // cull on the GPU, occlusion included, and draw the scene with one
+    // indirect draw per material instead
+    int gpu_culling;
+    // GPU time the main pass should fit in; its resolution scales to keep
+    // it there. 0 always renders at full resolution
+    float gpu_budget_ms;
+    // per-axis bounds of that scale, 0 selects DEFAULT_MIN_RENDER_SCALE and 1
+    float min_render_scale;
+    float max_render_scale;
+    uint64_t frame_index;
+    int64_t last_frame_ns;
+    struct saved_state state;
+    // owned by the platform main loop, outlives engine_init/engine_destroy
+    struct job_system* jobs;
+    // written by the update job, read by render preparation
+    float clear_color[4];
+    struct mat4 view_proj;
+    float camera_yaw;
+    struct engine_stats stats;
+    // filled by the platform thread, drained by the update job
+    struct input_queue input_queue;
+    struct input_state input;
+    struct scene scene;
+    // what of the scene the camera sees, refreshed by the update job
+    struct scene_cull cull;
+    // engine.pak, mapped for as long as the engine is initialized
+    struct asset_pack assets;
+    // transient per-frame allocations, reset at the top of engine_draw
+    struct frame_memory frame_memory;
+    struct vk_context vk;
+    // compressed formats the device samples, what textures are picked by
+    struct texture_support texture_support;
+    struct renderer renderer;
+    // the frame: main pass into the top left render_extent of swapchain
+    // sized color and depth transients, with GPU culling the depth pyramid
+    // built from that depth, then the upscale pass stretching the color
+    // over the swapchain image; rebuilt when the swapchain is
+    struct render_graph graph;
+    uint32_t backbuffer;
+    uint32_t scene_color;
+    uint32_t depth;
+    // RG_NONE without occlusion culling
+    uint32_t depth_pyramid;
+    uint32_t main_pass;
+    uint32_t upscale_pass;
+    uint32_t graph_generation;
+    VkExtent2D render_extent;
+    struct scene_renderer scene_renderer;
+    struct upscaler upscaler;
+    // timestamps around the main and upscale passes, and the scale each
+    // frame slot was last rendered at so they can be fed to the controller
+    struct gpu_timer gpu_timer;
+    float slot_scales[MAX_FRAMES_IN_FLIGHT];
+    struct dynamic_resolution resolution;
+    // only created with gpu_culling
+    struct gpu_cull gpu_cull;
+    // background uploads, fed from the render thread
+    struct streamer streamer;
+};
+
+/**
+ * Initialize engine
+ */
+int engine_init(struct engine* engine);
+
+/**
+ * Draw frame
+ */
+void engine_draw(struct engine* engine);
+
+/**
+ * Destroy engine
+ */
+void engine_destroy(struct engine* engine);
+
+/**
+ * Write the pipeline cache to data_path. Called when the app may be killed.
+ */
+void engine_save_caches(struct engine* engine);
+
+#endif // ENGINE_ENGINE_H
@@ -0,0 +1,84 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <cmath>
+
+void frame_pacer_init(struct frame_pacer* pacer, double refresh_hz, double target_hz) {
+    *pacer = {};
+    pacer->refresh_ns = (int64_t)(1e9 / refresh_hz);
+    pacer->interval = std::max(1u, (uint32_t)lround(refresh_hz / target_hz));
+    pacer->margin_ns = 1000000;
+}
+
+void frame_pacer_set_refresh(struct frame_pacer* pacer, int64_t refresh_ns) {
+    if (refresh_ns > 0) {
+        pacer->refresh_ns = refresh_ns;
+    }
+}
+
+int64_t frame_pacer_vsync_after(const struct frame_pacer* pacer, int64_t t) {
+    int64_t since = t - pacer->vsync_ns;
+    int64_t periods = since >= 0 ? (since + pacer->refresh_ns - 1) / pacer->refresh_ns
+                                 : -((-since) / pacer->refresh_ns);
+    return pacer->vsync_ns + periods * pacer->refresh_ns;
+}
+
+/**
+ * 90th percentile of recent frame costs: tolerates the odd spike without
+ * starting every frame early because of it.
+ */
+static int64_t predicted_work(const struct frame_pacer* pacer) {
+    if (pacer->work_count == 0) {
+        return pacer->refresh_ns * pacer->interval / 2;
+    }
+    uint32_t n = std::min(pacer->work_count, (uint32_t)FRAME_PACER_HISTORY);
+    int64_t sorted[FRAME_PACER_HISTORY];
+    std::copy(pacer->work_ns, pacer->work_ns + n, sorted);
+    std::sort(sorted, sorted + n);
+    return sorted[(n * 9) / 10];
+}
+
+int64_t frame_pacer_begin_frame(struct frame_pacer* pacer, int64_t now_ns) {
+    int64_t work = predicted_work(pacer) + pacer->margin_ns;
+    int64_t period = pacer->refresh_ns * pacer->interval;
+
+    // earliest vsync that keeps the interval since the last present and
+    // that the frame can still make if it starts now
+    int64_t earliest = std::max(now_ns + work,
+                                pacer->last_present_ns != 0
+                                ? pacer->last_present_ns + period - pacer->refresh_ns / 2 : 0);
+    int64_t target = frame_pacer_vsync_after(pacer, earliest);
+    pacer->target_vsync_ns = target;
+    return std::max(now_ns, target - work);
+}
+
+int64_t frame_pacer_target_vsync(const struct frame_pacer* pacer) {
+    return pacer->target_vsync_ns;
+}
+
+void frame_pacer_frame_done(struct frame_pacer* pacer, int64_t work_ns) {
+    pacer->work_ns[pacer->work_count % FRAME_PACER_HISTORY] = work_ns;
+    pacer->work_count++;
+}
+
+void frame_pacer_presented(struct frame_pacer* pacer, int64_t present_ns) {
+    if (pacer->vsync_ns == 0) {
+        pacer->vsync_ns = present_ns;
+    } else {
+        // phase-locked loop: pull the prediction a fraction of the way
+        // towards the observed vsync, and the period a smaller fraction
+        int64_t predicted = frame_pacer_vsync_after(pacer, present_ns - pacer->refresh_ns / 2);
+        int64_t error = present_ns - predicted;
+        pacer->vsync_ns = predicted + error / 4;
+        if (pacer->last_present_ns != 0) {
+            int64_t elapsed = present_ns - pacer->last_present_ns;
+            int64_t periods = std::max<int64_t>(1, (elapsed + pacer->refresh_ns / 2) / pacer->refresh_ns);
+            int64_t observed = elapsed / periods;
+            // ignore wild observations (missed timestamps, suspend)
+            if (std::abs(observed - pacer->refresh_ns) < pacer->refresh_ns / 10) {
+                pacer->refresh_ns += (observed - pacer->refresh_ns) / 16;
+            }
+        }
+    }
+    pacer->last_present_ns = present_ns;
+}
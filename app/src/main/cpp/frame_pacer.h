@@ -0,0 +1,71 @@
+#ifndef ENGINE_FRAME_PACER_H
+#define ENGINE_FRAME_PACER_H
+
+#include <cstdint>
+
+#define FRAME_PACER_HISTORY 32
+
+/**
+ * Predicts display vsyncs from observed present timestamps and decides when
+ * the next frame should start, so that it finishes just before the vsync it
+ * targets. Starting as late as possible means input is sampled as late as
+ * possible; targeting every Nth vsync gives stable 30/60/90/120 Hz.
+ *
+ * Pure bookkeeping on timestamps; the caller measures and sleeps.
+ */
+struct frame_pacer {
+    // display refresh period and the time of one vsync, both refined from
+    // present timestamps
+    int64_t refresh_ns;
+    int64_t vsync_ns;
+    // present every interval-th vsync
+    uint32_t interval;
+    // duration from frame start to present-ready for recent frames
+    int64_t work_ns[FRAME_PACER_HISTORY];
+    uint32_t work_count;
+    // the vsync the frame being produced is aiming for
+    int64_t target_vsync_ns;
+    int64_t last_present_ns;
+    // extra slack on top of the predicted frame cost
+    int64_t margin_ns;
+};
+
+/**
+ * refresh_hz is the display's rate (a first guess is fine), target_hz the
+ * desired frame rate; it is rounded to a whole number of refresh periods.
+ */
+void frame_pacer_init(struct frame_pacer* pacer, double refresh_hz, double target_hz);
+
+/**
+ * Replace the refresh period, e.g. once the driver reports it.
+ */
+void frame_pacer_set_refresh(struct frame_pacer* pacer, int64_t refresh_ns);
+
+/**
+ * Time at which the next frame should start (sample input, simulate),
+ * never earlier than now_ns. Also fixes the vsync that frame targets.
+ */
+int64_t frame_pacer_begin_frame(struct frame_pacer* pacer, int64_t now_ns);
+
+/**
+ * Vsync the current frame targets, usable as a desired present time.
+ */
+int64_t frame_pacer_target_vsync(const struct frame_pacer* pacer);
+
+/**
+ * Report how long the frame took from start to ready-to-present.
+ */
+void frame_pacer_frame_done(struct frame_pacer* pacer, int64_t work_ns);
+
+/**
+ * Report when a frame actually reached the display (or the best
+ * approximation available). Snaps the vsync prediction to it.
+ */
+void frame_pacer_presented(struct frame_pacer* pacer, int64_t present_ns);
+
+/**
+ * Nearest vsync at or after t according to the current prediction.
+ */
+int64_t frame_pacer_vsync_after(const struct frame_pacer* pacer, int64_t t);
+
+#endif // ENGINE_FRAME_PACER_H
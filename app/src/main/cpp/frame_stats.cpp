@@ -0,0 +1,42 @@
+#include "frame_stats.h"
+
+#include <algorithm>
+
+#include "log.h"
+
+void frame_stats_add(struct frame_stats* stats, int64_t duration_ns) {
+    stats->samples_ns.push_back(duration_ns);
+}
+
+static double percentile_ms(const std::vector<int64_t>& sorted, double p) {
+    size_t index = (size_t)(p * (double)(sorted.size() - 1) + 0.5);
+    return (double)sorted[index] / 1e6;
+}
+
+struct frame_stats_summary frame_stats_summarize(const struct frame_stats* stats) {
+    struct frame_stats_summary summary{};
+    if (stats->samples_ns.empty()) {
+        return summary;
+    }
+    std::vector<int64_t> sorted = stats->samples_ns;
+    std::sort(sorted.begin(), sorted.end());
+
+    int64_t total = 0;
+    for (int64_t sample : sorted) {
+        total += sample;
+    }
+    summary.count = (int64_t)sorted.size();
+    summary.min_ms = (double)sorted.front() / 1e6;
+    summary.avg_ms = (double)total / (double)sorted.size() / 1e6;
+    summary.p50_ms = percentile_ms(sorted, 0.50);
+    summary.p95_ms = percentile_ms(sorted, 0.95);
+    summary.p99_ms = percentile_ms(sorted, 0.99);
+    summary.max_ms = (double)sorted.back() / 1e6;
+    return summary;
+}
+
+void frame_stats_report(const struct frame_stats* stats, const char* label) {
+    struct frame_stats_summary s = frame_stats_summarize(stats);
+    LOGI("%s: %lld frames, min %.3f avg %.3f p50 %.3f p95 %.3f p99 %.3f max %.3f ms",
+         label, (long long)s.count, s.min_ms, s.avg_ms, s.p50_ms, s.p95_ms, s.p99_ms, s.max_ms);
+}
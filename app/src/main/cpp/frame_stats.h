@@ -0,0 +1,33 @@
+#ifndef ENGINE_FRAME_STATS_H
+#define ENGINE_FRAME_STATS_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Collects per-frame durations and reports their distribution.
+ */
+struct frame_stats {
+    std::vector<int64_t> samples_ns;
+};
+
+struct frame_stats_summary {
+    int64_t count;
+    double min_ms;
+    double avg_ms;
+    double p50_ms;
+    double p95_ms;
+    double p99_ms;
+    double max_ms;
+};
+
+void frame_stats_add(struct frame_stats* stats, int64_t duration_ns);
+
+struct frame_stats_summary frame_stats_summarize(const struct frame_stats* stats);
+
+/**
+ * Log the summary on one line, prefixed with label.
+ */
+void frame_stats_report(const struct frame_stats* stats, const char* label);
+
+#endif // ENGINE_FRAME_STATS_H
@@ -0,0 +1,539 @@
+#include "gpu_cull.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "bvh.h"
+#include "cull_shader.h"
+#include "depth_pyramid_shader.h"
+#include "log.h"
+#include "profiler.h"
+
+static_assert(sizeof(struct local_to_world) == 64, "cull.comp reads objects as mat4");
+static_assert(sizeof(struct gpu_cull_draws) == 20, "cull.comp's struct draw");
+static_assert(sizeof(struct gpu_cull_counts) == 8, "cull.comp's draws_block");
+static_assert(CULL_DESCRIPTOR_SET_COUNT == 1, "cull.comp uses one descriptor set");
+static_assert(DEPTH_PYRAMID_DESCRIPTOR_SET_COUNT == 1, "depth_pyramid.comp uses one descriptor set");
+
+#define CULL_GROUP_SIZE 64
+#define PYRAMID_GROUP_SIZE 8
+// objects, buckets, visible and draws, then the occlusion block and the
+// pyramid
+#define CULL_STORAGE_BUFFERS 4
+#define CULL_BINDINGS 6
+
+/**
+ * cull.comp's occlusion_block, std140.
+ */
+struct gpu_cull_occlusion {
+    struct mat4 view_proj;
+    float width;
+    float height;
+    uint32_t levels;
+    uint32_t padding;
+};
+
+static int create_pipeline(struct vk_context* vk, const struct shader_program* program,
+                           VkDescriptorSetLayout* set_layouts, VkPipelineLayout* layout, VkPipeline* pipeline) {
+    if (shader_program_create_layout(vk, program, set_layouts, layout) != 0) {
+        return -1;
+    }
+    VkShaderModule modules[SHADER_MAX_STAGES];
+    VkPipelineShaderStageCreateInfo stages[SHADER_MAX_STAGES];
+    if (shader_program_create_stages(vk, program, modules, stages) != 0) {
+        return -1;
+    }
+    VkComputePipelineCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    info.stage = stages[0];
+    info.layout = *layout;
+    VkResult result = vkCreateComputePipelines(vk->device, vk->pipeline_cache, 1, &info, nullptr, pipeline);
+    shader_program_destroy_modules(vk, program, modules);
+    VK_CHECK(result);
+    return 0;
+}
+
+static int create_frame(struct vk_context* vk, struct gpu_cull* gc, struct gpu_cull_frame* frame) {
+    VkDeviceSize matrices = (VkDeviceSize)gc->max_objects * sizeof(struct local_to_world);
+    const VkMemoryPropertyFlags host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    if (vk_create_buffer(vk, matrices, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host,
+                         &frame->objects, &frame->objects_memory) != 0 ||
+        vk_create_buffer(vk, (VkDeviceSize)gc->max_objects * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                         host, &frame->buckets, &frame->buckets_memory) != 0 ||
+        vk_create_buffer(vk, matrices, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &frame->visible, &frame->visible_memory) != 0 ||
+        vk_create_buffer(vk, gpu_cull_draws_offset(SCENE_DEMO_MATERIALS),
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                         VK_BUFFER_USAGE_TRANSFER_DST_BIT, host, &frame->draws, &frame->draws_memory) != 0 ||
+        vk_create_buffer(vk, sizeof(struct gpu_cull_occlusion), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, host,
+                         &frame->occlusion, &frame->occlusion_memory) != 0) {
+        return -1;
+    }
+
+    VkDescriptorSetAllocateInfo allocate{};
+    allocate.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate.descriptorPool = gc->descriptor_pool;
+    allocate.descriptorSetCount = 1;
+    allocate.pSetLayouts = &gc->set_layouts[0];
+    VK_CHECK(vkAllocateDescriptorSets(vk->device, &allocate, &frame->set));
+
+    // the pyramid is written by gpu_cull_set_depth
+    const VkDescriptorBufferInfo buffers[CULL_BINDINGS - 1] = {
+        { frame->objects, 0, VK_WHOLE_SIZE },
+        { frame->buckets, 0, VK_WHOLE_SIZE },
+        { frame->visible, 0, VK_WHOLE_SIZE },
+        { frame->draws, 0, VK_WHOLE_SIZE },
+        { frame->occlusion, 0, VK_WHOLE_SIZE },
+    };
+    VkWriteDescriptorSet writes[CULL_BINDINGS - 1];
+    for (uint32_t i = 0; i < CULL_BINDINGS - 1; i++) {
+        writes[i] = {};
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = frame->set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = i < CULL_STORAGE_BUFFERS ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+                                                            : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        writes[i].pBufferInfo = &buffers[i];
+    }
+    vkUpdateDescriptorSets(vk->device, CULL_BINDINGS - 1, writes, 0, nullptr);
+    return 0;
+}
+
+int gpu_cull_can_occlude(VkPhysicalDevice physical_device, VkFormat depth_format) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physical_device, depth_format, &properties);
+    return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+int gpu_cull_init(struct vk_context* vk, struct gpu_cull* gc, const struct renderer* renderer,
+                  uint32_t max_objects) {
+    if (create_pipeline(vk, &cull_program, gc->set_layouts, &gc->layout, &gc->pipeline) != 0 ||
+        create_pipeline(vk, &depth_pyramid_program, gc->pyramid_set_layouts, &gc->pyramid_layout,
+                        &gc->pyramid_pipeline) != 0) {
+        return -1;
+    }
+    const VkDescriptorPoolSize pool_sizes[] = {
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, CULL_STORAGE_BUFFERS * MAX_FRAMES_IN_FLIGHT },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, MAX_FRAMES_IN_FLIGHT },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_FRAMES_IN_FLIGHT },
+    };
+    VkDescriptorPoolCreateInfo pool{};
+    pool.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool.maxSets = MAX_FRAMES_IN_FLIGHT;
+    pool.poolSizeCount = 3;
+    pool.pPoolSizes = pool_sizes;
+    VK_CHECK(vkCreateDescriptorPool(vk->device, &pool, nullptr, &gc->descriptor_pool));
+    // a level's set is rewritten whenever the pyramid is resized
+    const VkDescriptorPoolSize pyramid_sizes[] = {
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, GPU_CULL_MAX_PYRAMID_LEVELS },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, GPU_CULL_MAX_PYRAMID_LEVELS },
+    };
+    pool.maxSets = GPU_CULL_MAX_PYRAMID_LEVELS;
+    pool.poolSizeCount = 2;
+    pool.pPoolSizes = pyramid_sizes;
+    VK_CHECK(vkCreateDescriptorPool(vk->device, &pool, nullptr, &gc->pyramid_pool));
+
+    // depth is fetched texel by texel, the sampler only has to exist
+    VkSamplerCreateInfo sampler{};
+    sampler.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler.magFilter = VK_FILTER_NEAREST;
+    sampler.minFilter = VK_FILTER_NEAREST;
+    sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler.maxLod = VK_LOD_CLAMP_NONE;
+    VK_CHECK(vkCreateSampler(vk->device, &sampler, nullptr, &gc->sampler));
+    gc->occlusion = gpu_cull_can_occlude(vk->physical_device, renderer->depth_format);
+
+    gc->max_objects = max_objects > 0 ? max_objects : 1;
+    for (uint32_t i = 0; i < renderer->frames_in_flight; i++) {
+        if (create_frame(vk, gc, &gc->frames[i]) != 0) {
+            return -1;
+        }
+    }
+    LOGI("gpu_cull: %u objects, %u material draws, %s, %s", gc->max_objects, SCENE_DEMO_MATERIALS,
+         vk->has_draw_indirect_count ? "vkCmdDrawIndirectCount" : "vkCmdDrawIndirect fallback",
+         gc->occlusion ? "occlusion culled against the previous frame's depth" : "no sampleable depth, "
+         "frustum culling only");
+    return 0;
+}
+
+static void destroy_pyramid(struct vk_context* vk, struct gpu_cull* gc) {
+    for (uint32_t i = 0; i < gc->pyramid_level_count; i++) {
+        vkDestroyImageView(vk->device, gc->pyramid_levels[i], nullptr);
+        gc->pyramid_levels[i] = VK_NULL_HANDLE;
+    }
+    if (gc->pyramid_view != VK_NULL_HANDLE) {
+        vkDestroyImageView(vk->device, gc->pyramid_view, nullptr);
+    }
+    if (gc->pyramid != VK_NULL_HANDLE) {
+        vkDestroyImage(vk->device, gc->pyramid, nullptr);
+    }
+    gpu_free(&vk->allocator, &gc->pyramid_memory);
+    gc->pyramid_view = VK_NULL_HANDLE;
+    gc->pyramid = VK_NULL_HANDLE;
+    gc->pyramid_level_count = 0;
+}
+
+static VkImageView create_pyramid_view(struct vk_context* vk, const struct gpu_cull* gc, uint32_t level,
+                                       uint32_t count) {
+    VkImageViewCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    info.image = gc->pyramid;
+    info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    info.format = VK_FORMAT_R32_SFLOAT;
+    info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    info.subresourceRange.baseMipLevel = level;
+    info.subresourceRange.levelCount = count;
+    info.subresourceRange.layerCount = 1;
+    VkImageView view = VK_NULL_HANDLE;
+    if (vkCreateImageView(vk->device, &info, nullptr, &view) != VK_SUCCESS) {
+        LOGE("gpu_cull: cannot create a view of the depth pyramid");
+    }
+    return view;
+}
+
+/**
+ * Point level's set at what it reads, the depth buffer or the level
+ * below, and the level it writes.
+ */
+static void write_pyramid_set(struct vk_context* vk, struct gpu_cull* gc, uint32_t level, VkImageView depth) {
+    VkDescriptorImageInfo source{};
+    source.sampler = gc->sampler;
+    source.imageView = level == 0 ? depth : gc->pyramid_levels[level - 1];
+    source.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+    VkDescriptorImageInfo destination{};
+    destination.imageView = gc->pyramid_levels[level];
+    destination.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    VkWriteDescriptorSet writes[2] = {};
+    for (uint32_t i = 0; i < 2; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = gc->pyramid_sets[level];
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+    }
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[0].pImageInfo = &source;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[1].pImageInfo = &destination;
+    vkUpdateDescriptorSets(vk->device, 2, writes, 0, nullptr);
+}
+
+int gpu_cull_set_depth(struct vk_context* vk, struct gpu_cull* gc, VkImageView view, uint32_t width,
+                       uint32_t height) {
+    destroy_pyramid(vk, gc);
+    gc->pyramid_width = std::max(1u, (width + 1) / 2);
+    gc->pyramid_height = std::max(1u, (height + 1) / 2);
+    // down to a single texel
+    uint32_t levels = 1;
+    uint32_t size = std::max(gc->pyramid_width, gc->pyramid_height);
+    while (size >> levels != 0 && levels < GPU_CULL_MAX_PYRAMID_LEVELS) {
+        levels++;
+    }
+
+    VkImageCreateInfo image{};
+    image.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image.imageType = VK_IMAGE_TYPE_2D;
+    image.format = VK_FORMAT_R32_SFLOAT;
+    image.extent = { gc->pyramid_width, gc->pyramid_height, 1 };
+    image.mipLevels = levels;
+    image.arrayLayers = 1;
+    image.samples = VK_SAMPLE_COUNT_1_BIT;
+    image.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VK_CHECK(vkCreateImage(vk->device, &image, nullptr, &gc->pyramid));
+    if (gpu_alloc_image(&vk->allocator, gc->pyramid, image.tiling, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                        &gc->pyramid_memory) != 0) {
+        return -1;
+    }
+    gc->pyramid_level_count = levels;
+    gc->pyramid_view = create_pyramid_view(vk, gc, 0, levels);
+    for (uint32_t i = 0; i < levels; i++) {
+        gc->pyramid_levels[i] = create_pyramid_view(vk, gc, i, 1);
+        if (gc->pyramid_levels[i] == VK_NULL_HANDLE) {
+            return -1;
+        }
+    }
+    if (gc->pyramid_view == VK_NULL_HANDLE) {
+        return -1;
+    }
+    gc->pyramid_initialized = 0;
+    gc->pyramid_built = 0;
+
+    VkDescriptorImageInfo pyramid{};
+    pyramid.sampler = gc->sampler;
+    pyramid.imageView = gc->pyramid_view;
+    pyramid.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    for (struct gpu_cull_frame& frame : gc->frames) {
+        if (frame.set == VK_NULL_HANDLE) {
+            continue;
+        }
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = frame.set;
+        write.dstBinding = CULL_BINDINGS - 1;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &pyramid;
+        vkUpdateDescriptorSets(vk->device, 1, &write, 0, nullptr);
+    }
+    // without a sampleable depth buffer the pyramid is never built, and
+    // only there for the cull pass's set to be complete
+    if (!gc->occlusion) {
+        return 0;
+    }
+    VK_CHECK(vkResetDescriptorPool(vk->device, gc->pyramid_pool, 0));
+    VkDescriptorSetLayout layouts[GPU_CULL_MAX_PYRAMID_LEVELS];
+    std::fill(layouts, layouts + levels, gc->pyramid_set_layouts[0]);
+    VkDescriptorSetAllocateInfo allocate{};
+    allocate.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate.descriptorPool = gc->pyramid_pool;
+    allocate.descriptorSetCount = levels;
+    allocate.pSetLayouts = layouts;
+    VK_CHECK(vkAllocateDescriptorSets(vk->device, &allocate, gc->pyramid_sets));
+    for (uint32_t i = 0; i < levels; i++) {
+        write_pyramid_set(vk, gc, i, view);
+    }
+    return 0;
+}
+
+static void collect_chunk(struct ecs_chunk* chunk, void* data) {
+    auto* gc = (struct gpu_cull*)data;
+    struct gpu_cull_chunk entry;
+    entry.matrices = ecs_column<struct local_to_world>(chunk, COMPONENT_LOCAL_TO_WORLD);
+    entry.renderables = ecs_column<struct renderable>(chunk, COMPONENT_RENDERABLE);
+    entry.first = gc->object_count;
+    entry.count = std::min(chunk->count, gc->max_objects - gc->object_count);
+    gc->dropped += chunk->count - entry.count;
+    if (entry.count > 0) {
+        gc->chunks.push_back(entry);
+        gc->object_count += entry.count;
+    }
+}
+
+static uint32_t object_material(const struct renderable* renderable) {
+    return renderable->material < SCENE_DEMO_MATERIALS ? renderable->material : 0;
+}
+
+/**
+ * Same split as scene_cull: entities without a velocity never move, so
+ * their matrices only need uploading once per slot. Every material gets
+ * room in the instance buffer for all of its objects.
+ */
+static void gather_chunks(struct gpu_cull* gc, struct scene* scene) {
+    const ecs_mask drawn = ECS_BIT(COMPONENT_LOCAL_TO_WORLD) | ECS_BIT(COMPONENT_RENDERABLE);
+    gc->chunks.clear();
+    gc->object_count = 0;
+    gc->dropped = 0;
+    ecs_for_each_chunk(&scene->world, drawn, ECS_BIT(COMPONENT_VELOCITY), collect_chunk, gc);
+    gc->static_chunks = (uint32_t)gc->chunks.size();
+    gc->static_count = gc->object_count;
+    ecs_for_each_chunk(&scene->world, drawn | ECS_BIT(COMPONENT_VELOCITY), 0, collect_chunk, gc);
+    gc->structure_version = scene->world.structure_version;
+    gc->gathered = 1;
+    if (gc->dropped > 0) {
+        LOGW("gpu_cull: %u entities past the %u the object buffer holds are not drawn", gc->dropped,
+             gc->max_objects);
+    }
+
+    uint32_t counts[SCENE_DEMO_MATERIALS] = {};
+    for (const struct gpu_cull_chunk& chunk : gc->chunks) {
+        for (uint32_t i = 0; i < chunk.count; i++) {
+            counts[object_material(&chunk.renderables[i])]++;
+        }
+    }
+    uint32_t first = 0;
+    for (uint32_t m = 0; m < SCENE_DEMO_MATERIALS; m++) {
+        gc->material_first[m] = first;
+        first += counts[m];
+    }
+}
+
+struct upload_params {
+    const struct gpu_cull_chunk* chunks;
+    struct local_to_world* out;
+    uint32_t* buckets;
+};
+
+static void upload_chunks(void* data, uint32_t begin, uint32_t end) {
+    auto* params = (const struct upload_params*)data;
+    for (uint32_t i = begin; i < end; i++) {
+        const struct gpu_cull_chunk* chunk = &params->chunks[i];
+        memcpy(params->out + chunk->first, chunk->matrices, chunk->count * sizeof(struct local_to_world));
+        uint32_t* buckets = params->buckets + chunk->first;
+        for (uint32_t j = 0; j < chunk->count; j++) {
+            buckets[j] = object_material(&chunk->renderables[j]);
+        }
+    }
+}
+
+void gpu_cull_upload(struct gpu_cull* gc, const struct renderer* renderer, struct job_system* jobs,
+                     struct scene* scene) {
+    PROFILE_SCOPE("gpu_cull_upload");
+    struct gpu_cull_frame* frame = &gc->frames[renderer->frame];
+    // the slot's fence has signalled, so its counts are final
+    if (frame->recorded) {
+        const auto* mapped = (const uint8_t*)frame->draws_memory.mapped;
+        const auto* counts = (const struct gpu_cull_counts*)mapped;
+        gc->frustum_count = counts->in_frustum;
+        gc->occluded_count = counts->occluded;
+        gc->visible_count = 0;
+        for (uint32_t m = 0; m < SCENE_DEMO_MATERIALS; m++) {
+            const auto* draws = (const struct gpu_cull_draws*)(mapped + gpu_cull_draws_offset(m));
+            gc->visible_count += draws->command.instanceCount;
+        }
+    }
+    if (!gc->gathered || gc->structure_version != scene->world.structure_version) {
+        gather_chunks(gc, scene);
+    }
+    uint32_t first = 0;
+    if (frame->static_valid && frame->static_version == gc->structure_version) {
+        first = gc->static_chunks;
+    }
+    struct upload_params params{};
+    params.chunks = gc->chunks.data() + first;
+    params.out = (struct local_to_world*)frame->objects_memory.mapped;
+    params.buckets = (uint32_t*)frame->buckets_memory.mapped;
+    job_parallel_for(jobs, (uint32_t)gc->chunks.size() - first, 16, upload_chunks, &params);
+    frame->static_valid = 1;
+    frame->static_version = gc->structure_version;
+}
+
+void gpu_cull_record(struct gpu_cull* gc, const struct renderer* renderer, VkCommandBuffer cmd,
+                     const struct mat4* view_proj) {
+    PROFILE_SCOPE("gpu_cull_record");
+    struct gpu_cull_frame* frame = &gc->frames[renderer->frame];
+    // 36 vertices of the unit cube at the start of each material's range,
+    // no instances and no draw until the first visible object turns up
+    struct {
+        struct gpu_cull_counts counts;
+        struct gpu_cull_draws draws[SCENE_DEMO_MATERIALS];
+    } reset{};
+    static_assert(sizeof(reset) == sizeof(reset.counts) + sizeof(reset.draws), "laid out like the draws buffer");
+    for (uint32_t m = 0; m < SCENE_DEMO_MATERIALS; m++) {
+        reset.draws[m].command.vertexCount = 36;
+        reset.draws[m].command.firstInstance = gc->material_first[m];
+    }
+    vkCmdUpdateBuffer(cmd, frame->draws, 0, sizeof(reset), &reset);
+
+    // the occlusion test uses what the pyramid was last built from, the
+    // previous frame, if there is one
+    auto* occlusion = (struct gpu_cull_occlusion*)frame->occlusion_memory.mapped;
+    occlusion->view_proj = gc->pyramid_view_proj;
+    occlusion->width = (float)gc->pyramid_extent.width;
+    occlusion->height = (float)gc->pyramid_extent.height;
+    occlusion->levels = gc->occlusion && gc->pyramid_built ? gc->pyramid_level_count : 0;
+
+    // the pyramid's first use, before any frame has built it
+    bool initializing = !gc->pyramid_initialized;
+    VkImageMemoryBarrier initialize{};
+    if (initializing) {
+        initialize.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        initialize.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        initialize.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        initialize.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        initialize.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        initialize.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        initialize.image = gc->pyramid;
+        initialize.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        initialize.subresourceRange.levelCount = gc->pyramid_level_count;
+        initialize.subresourceRange.layerCount = 1;
+        gc->pyramid_initialized = 1;
+    }
+    // the reset, and the previous frame building the pyramid
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr,
+                         initializing ? 1 : 0, &initialize);
+
+    struct cull_push_constants push{};
+    push.object_count = gc->object_count;
+    struct frustum frustum = frustum_from_matrix(view_proj);
+    for (int i = 0; i < 6; i++) {
+        push.planes[i] = frustum.planes[i];
+    }
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, gc->pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, gc->layout, 0, 1, &frame->set, 0, nullptr);
+    vkCmdPushConstants(cmd, gc->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+    if (gc->object_count > 0) {
+        vkCmdDispatch(cmd, (gc->object_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    }
+
+    // the draw reads the command and the instances; the CPU reads the
+    // count back once the slot's fence signals
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                            VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                         VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    frame->recorded = 1;
+}
+
+void gpu_cull_build_pyramid(struct gpu_cull* gc, VkCommandBuffer cmd, const struct mat4* view_proj,
+                            VkExtent2D extent) {
+    PROFILE_SCOPE("gpu_cull_build_pyramid");
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, gc->pyramid_pipeline);
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    // the rendered part of each level is half of the one below, rounded up
+    struct depth_pyramid_push_constants push{};
+    push.source_width = extent.width;
+    push.source_height = extent.height;
+    for (uint32_t level = 0; level < gc->pyramid_level_count; level++) {
+        if (level > 0) {
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                                 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+        uint32_t width = (push.source_width + 1) / 2;
+        uint32_t height = (push.source_height + 1) / 2;
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, gc->pyramid_layout, 0, 1,
+                                &gc->pyramid_sets[level], 0, nullptr);
+        vkCmdPushConstants(cmd, gc->pyramid_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+        vkCmdDispatch(cmd, (width + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+                      (height + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+        push.source_width = width;
+        push.source_height = height;
+    }
+    gc->pyramid_built = 1;
+    gc->pyramid_view_proj = *view_proj;
+    gc->pyramid_extent = extent;
+}
+
+void gpu_cull_destroy(struct vk_context* vk, struct gpu_cull* gc) {
+    for (struct gpu_cull_frame& frame : gc->frames) {
+        vk_destroy_buffer(vk, &frame.objects, &frame.objects_memory);
+        vk_destroy_buffer(vk, &frame.buckets, &frame.buckets_memory);
+        vk_destroy_buffer(vk, &frame.visible, &frame.visible_memory);
+        vk_destroy_buffer(vk, &frame.draws, &frame.draws_memory);
+        vk_destroy_buffer(vk, &frame.occlusion, &frame.occlusion_memory);
+    }
+    destroy_pyramid(vk, gc);
+    if (gc->descriptor_pool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(vk->device, gc->descriptor_pool, nullptr);
+    }
+    if (gc->pyramid_pool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(vk->device, gc->pyramid_pool, nullptr);
+    }
+    if (gc->sampler != VK_NULL_HANDLE) {
+        vkDestroySampler(vk->device, gc->sampler, nullptr);
+    }
+    if (gc->pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(vk->device, gc->pipeline, nullptr);
+    }
+    if (gc->pyramid_pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(vk->device, gc->pyramid_pipeline, nullptr);
+    }
+    shader_program_destroy_layout(vk, &cull_program, gc->set_layouts, gc->layout);
+    shader_program_destroy_layout(vk, &depth_pyramid_program, gc->pyramid_set_layouts, gc->pyramid_layout);
+    *gc = {};
+}
@@ -0,0 +1,204 @@
+#ifndef ENGINE_GPU_CULL_H
+#define ENGINE_GPU_CULL_H
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "jobs.h"
+#include "renderer.h"
+#include "scene.h"
+#include "shader_program.h"
+#include "vecmath.h"
+#include "vk_context.h"
+
+// mips of the depth pyramid, enough for 64k pixels across
+#define GPU_CULL_MAX_PYRAMID_LEVELS 16
+
+/**
+ * What the cull pass counts besides the draws: objects inside the
+ * frustum, and how many of those were hidden behind the previous
+ * frame's depth.
+ */
+struct gpu_cull_counts {
+    uint32_t in_frustum;
+    uint32_t occluded;
+};
+
+/**
+ * One material's indirect draw, followed by the draw count
+ * vkCmdDrawIndirectCountKHR reads. The draws buffer holds a
+ * gpu_cull_counts, then one of these per material.
+ */
+struct gpu_cull_draws {
+    VkDrawIndirectCommand command;
+    uint32_t draw_count;
+};
+
+static inline VkDeviceSize gpu_cull_draws_offset(uint32_t material) {
+    return sizeof(struct gpu_cull_counts) + (VkDeviceSize)material * sizeof(struct gpu_cull_draws);
+}
+
+/**
+ * A chunk's local_to_world and renderable columns and where they land in
+ * the object buffers.
+ */
+struct gpu_cull_chunk {
+    const struct local_to_world* matrices;
+    const struct renderable* renderables;
+    uint32_t first;
+    uint32_t count;
+};
+
+/**
+ * Buffers of one frame slot, reused once its fence has signalled.
+ */
+struct gpu_cull_frame {
+    // every object's matrix and material, static objects first. They are
+    // only rewritten when the world's structure changed since the slot
+    // last saw it
+    VkBuffer objects;
+    struct gpu_allocation objects_memory;
+    VkBuffer buckets;
+    struct gpu_allocation buckets_memory;
+    int static_valid;
+    uint32_t static_version;
+    // matrices of the visible objects, written by the cull pass and read
+    // as instance data by the draws; every material has its own range
+    VkBuffer visible;
+    struct gpu_allocation visible_memory;
+    // host visible, so the CPU can read back how many objects were drawn
+    VkBuffer draws;
+    struct gpu_allocation draws_memory;
+    // the view and size of the depth the pyramid was built from
+    VkBuffer occlusion;
+    struct gpu_allocation occlusion_memory;
+    VkDescriptorSet set;
+    // the cull pass has been recorded for this slot, so draws holds a count
+    int recorded;
+};
+
+/**
+ * GPU driven scene drawing: a compute pass culls every object against the
+ * frustum, then against a depth pyramid of the previous frame, and
+ * appends the visible ones to their material's range of an instance
+ * buffer, counting them in that material's indirect draw. The CPU records
+ * one dispatch and one draw per material each frame however many objects
+ * there are; its remaining per-object work is copying the moving objects'
+ * matrices.
+ *
+ * The pyramid is built after the main pass (gpu_cull_build_pyramid),
+ * each level the furthest depth of 2x2 texels of the one below, and read
+ * by the next frame's cull pass with that frame's view. Objects are
+ * tested where they are now against where everything was, so one that
+ * comes out from behind another can be drawn a frame late. Without a
+ * sampleable depth format there is no occlusion culling.
+ *
+ * There is no LOD selection: the scene only draws the built-in cube,
+ * which has no LOD chain (mesh_lod_select covers meshes built with LODs
+ * on the CPU side).
+ */
+struct gpu_cull {
+    VkDescriptorSetLayout set_layouts[SHADER_MAX_SETS];
+    VkPipelineLayout layout;
+    VkPipeline pipeline;
+    VkDescriptorPool descriptor_pool;
+    struct gpu_cull_frame frames[MAX_FRAMES_IN_FLIGHT];
+    uint32_t max_objects;
+    // the scene's chunks, static ones first, gathered again whenever the
+    // world's structure changes
+    std::vector<struct gpu_cull_chunk> chunks;
+    uint32_t static_chunks;
+    uint32_t structure_version;
+    int gathered;
+    // objects uploaded for the frame being recorded, static ones first,
+    // and where each material's range of the instance buffer starts.
+    // Materials are fixed at spawn, so the ranges only move when the
+    // world's structure does
+    uint32_t object_count;
+    uint32_t static_count;
+    uint32_t material_first[SCENE_DEMO_MATERIALS];
+    // drawn entities past max_objects, left out of the object buffer
+    uint32_t dropped;
+    // what the GPU found the last time the current slot was used,
+    // frames_in_flight frames ago
+    uint32_t visible_count;
+    uint32_t frustum_count;
+    uint32_t occluded_count;
+
+    // the depth pyramid: one view per level to build it, one over all of
+    // them to test against, and the pass that builds it
+    int occlusion;
+    VkImage pyramid;
+    struct gpu_allocation pyramid_memory;
+    VkImageView pyramid_view;
+    VkImageView pyramid_levels[GPU_CULL_MAX_PYRAMID_LEVELS];
+    uint32_t pyramid_width;
+    uint32_t pyramid_height;
+    uint32_t pyramid_level_count;
+    VkSampler sampler;
+    VkDescriptorSetLayout pyramid_set_layouts[SHADER_MAX_SETS];
+    VkPipelineLayout pyramid_layout;
+    VkPipeline pyramid_pipeline;
+    VkDescriptorPool pyramid_pool;
+    VkDescriptorSet pyramid_sets[GPU_CULL_MAX_PYRAMID_LEVELS];
+    // the pyramid left VK_IMAGE_LAYOUT_UNDEFINED, and what it was last
+    // built from: the view and the rendered part of the depth buffer
+    int pyramid_initialized;
+    int pyramid_built;
+    struct mat4 pyramid_view_proj;
+    VkExtent2D pyramid_extent;
+};
+
+/**
+ * Create the pipelines and buffers for up to max_objects objects. The
+ * occlusion test needs depth_format to be sampleable, and
+ * gpu_cull_set_depth before the first frame.
+ */
+int gpu_cull_init(struct vk_context* vk, struct gpu_cull* gc, const struct renderer* renderer,
+                  uint32_t max_objects);
+
+/**
+ * Whether depth buffers of depth_format can be sampled, which the depth
+ * pyramid and so occlusion culling need.
+ */
+int gpu_cull_can_occlude(VkPhysicalDevice physical_device, VkFormat depth_format);
+
+/**
+ * Size the pyramid for a width x height depth buffer and build it from
+ * view from now on. Only call while no frame that uses the previous one
+ * is in flight, e.g. after rebuilding the render graph.
+ */
+int gpu_cull_set_depth(struct vk_context* vk, struct gpu_cull* gc, VkImageView view, uint32_t width,
+                       uint32_t height);
+
+/**
+ * Read back the slot's previous visible count and copy the scene's
+ * matrices into it, one job per chunk. Call after renderer_begin_frame
+ * and once the scene update is done; does not allocate unless the
+ * world's structure changed.
+ */
+void gpu_cull_upload(struct gpu_cull* gc, const struct renderer* renderer, struct job_system* jobs,
+                     struct scene* scene);
+
+/**
+ * Record the cull pass into cmd, outside any render pass, with the
+ * barriers that make its results visible to the indirect draws and the
+ * vertex input.
+ */
+void gpu_cull_record(struct gpu_cull* gc, const struct renderer* renderer, VkCommandBuffer cmd,
+                     const struct mat4* view_proj);
+
+/**
+ * Record building the pyramid from the top left extent of the depth
+ * buffer, which view_proj rendered, for the next frame's cull pass. Runs
+ * in a compute pass of the render graph that samples the depth buffer
+ * and writes the pyramid.
+ */
+void gpu_cull_build_pyramid(struct gpu_cull* gc, VkCommandBuffer cmd, const struct mat4* view_proj,
+                            VkExtent2D extent);
+
+void gpu_cull_destroy(struct vk_context* vk, struct gpu_cull* gc);
+
+#endif // ENGINE_GPU_CULL_H
@@ -0,0 +1,384 @@
+#include "gpu_memory.h"
+
+#include <algorithm>
+
+#include "log.h"
+
+void gpu_allocator_init(struct gpu_allocator* allocator, VkPhysicalDevice physical_device,
+                        VkDevice device) {
+    allocator->device = device;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &allocator->memory_properties);
+    for (uint32_t i = 0; i < allocator->memory_properties.memoryHeapCount; i++) {
+        VkDeviceSize heap = allocator->memory_properties.memoryHeaps[i].size;
+        allocator->block_size[i] = heap < (1ull << 30) ? (heap / 8) & ~(GPU_GRANULARITY - 1)
+                                                       : GPU_BLOCK_SIZE;
+    }
+    allocator->blocks.clear();
+    allocator->device_allocations = 0;
+}
+
+static void release_block(struct gpu_allocator* allocator, struct gpu_block* block) {
+    if (block->mapped != nullptr) {
+        vkUnmapMemory(allocator->device, block->memory);
+    }
+    vkFreeMemory(allocator->device, block->memory, nullptr);
+    allocator->device_allocations--;
+    tlsf_destroy(&block->tlsf);
+    allocator->blocks.erase(std::find(allocator->blocks.begin(), allocator->blocks.end(), block));
+    delete block;
+}
+
+void gpu_allocator_destroy(struct gpu_allocator* allocator) {
+    while (!allocator->blocks.empty()) {
+        struct gpu_block* block = allocator->blocks.back();
+        if (block->dedicated || block->tlsf.allocation_count > 0) {
+            LOGW("gpu_memory: %.1f MB still allocated from memory type %u at shutdown",
+                 (double)block->requested / (1 << 20), block->memory_type);
+        }
+        release_block(allocator, block);
+    }
+}
+
+/**
+ * Allocate a device memory block, mapped for its lifetime when host
+ * visible. Returns nullptr when the heap is exhausted.
+ */
+static struct gpu_block* create_block(struct gpu_allocator* allocator, uint32_t memory_type,
+                                      VkDeviceSize size, enum gpu_resource_kind kind, int dedicated,
+                                      const VkMemoryDedicatedAllocateInfo* dedicated_info) {
+    VkMemoryAllocateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    info.pNext = dedicated_info;
+    info.allocationSize = size;
+    info.memoryTypeIndex = memory_type;
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(allocator->device, &info, nullptr, &memory) != VK_SUCCESS) {
+        return nullptr;
+    }
+    void* mapped = nullptr;
+    VkMemoryPropertyFlags flags = allocator->memory_properties.memoryTypes[memory_type].propertyFlags;
+    if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+        vkMapMemory(allocator->device, memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+        vkFreeMemory(allocator->device, memory, nullptr);
+        return nullptr;
+    }
+
+    struct gpu_block* block = new gpu_block{};
+    block->memory = memory;
+    block->size = size;
+    block->memory_type = memory_type;
+    block->kind = kind;
+    block->mapped = (uint8_t*)mapped;
+    block->dedicated = dedicated;
+    if (!block->dedicated) {
+        tlsf_init(&block->tlsf, size, GPU_GRANULARITY);
+    }
+    allocator->blocks.push_back(block);
+    allocator->device_allocations++;
+    return block;
+}
+
+static void fill_allocation(struct gpu_block* block, uint32_t node, VkDeviceSize offset,
+                            VkDeviceSize size, VkDeviceSize alignment,
+                            struct gpu_allocation* allocation) {
+    allocation->block = block;
+    allocation->node = node;
+    allocation->memory = block->memory;
+    allocation->offset = offset;
+    allocation->size = size;
+    allocation->alignment = alignment;
+    allocation->mapped = block->mapped != nullptr ? block->mapped + offset : nullptr;
+}
+
+/**
+ * Sub-allocate from an existing block of memory_type and kind, else from a
+ * new one. Returns 0 on success.
+ */
+static int alloc_from_blocks(struct gpu_allocator* allocator, uint32_t memory_type,
+                             const VkMemoryRequirements* requirements,
+                             enum gpu_resource_kind kind, struct gpu_allocation* allocation) {
+    for (struct gpu_block* block : allocator->blocks) {
+        if (block->dedicated || block->memory_type != memory_type || block->kind != kind) {
+            continue;
+        }
+        uint32_t node = tlsf_alloc(&block->tlsf, requirements->size, requirements->alignment, allocation);
+        if (node != TLSF_NULL) {
+            block->requested += requirements->size;
+            fill_allocation(block, node, tlsf_get(&block->tlsf, node)->offset, requirements->size,
+                            requirements->alignment, allocation);
+            return 0;
+        }
+    }
+    uint32_t heap = allocator->memory_properties.memoryTypes[memory_type].heapIndex;
+    struct gpu_block* block = create_block(allocator, memory_type, allocator->block_size[heap], kind, 0, nullptr);
+    if (block == nullptr) {
+        return -1;
+    }
+    uint32_t node = tlsf_alloc(&block->tlsf, requirements->size, requirements->alignment, allocation);
+    if (node == TLSF_NULL) {
+        release_block(allocator, block);
+        return -1;
+    }
+    block->requested += requirements->size;
+    fill_allocation(block, node, tlsf_get(&block->tlsf, node)->offset, requirements->size,
+                    requirements->alignment, allocation);
+    return 0;
+}
+
+/**
+ * dedicated names the resource when it is known, so the driver can place
+ * its own allocation (and is nullptr for plain gpu_alloc).
+ */
+static int alloc_memory(struct gpu_allocator* allocator, const VkMemoryRequirements* requirements,
+                        VkMemoryPropertyFlags properties, enum gpu_resource_kind kind, uint32_t flags,
+                        const VkMemoryDedicatedAllocateInfo* dedicated,
+                        struct gpu_allocation* allocation) {
+    *allocation = {};
+    allocation->node = TLSF_NULL;
+    const VkPhysicalDeviceMemoryProperties& props = allocator->memory_properties;
+    // first matching type, falling through to the next one when its heap
+    // is full; lazily allocated memory only when asked for
+    for (uint32_t type = 0; type < props.memoryTypeCount; type++) {
+        VkMemoryPropertyFlags type_flags = props.memoryTypes[type].propertyFlags;
+        if (!(requirements->memoryTypeBits & (1u << type)) || (type_flags & properties) != properties ||
+            ((type_flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) &&
+             !(properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))) {
+            continue;
+        }
+        VkDeviceSize block_size = allocator->block_size[props.memoryTypes[type].heapIndex];
+        if ((flags & GPU_ALLOC_DEDICATED) || requirements->size > block_size / 2) {
+            struct gpu_block* block = create_block(allocator, type, requirements->size, kind, 1, dedicated);
+            if (block != nullptr) {
+                block->requested = requirements->size;
+                fill_allocation(block, TLSF_NULL, 0, requirements->size, requirements->alignment, allocation);
+                return 0;
+            }
+        } else if (alloc_from_blocks(allocator, type, requirements, kind, allocation) == 0) {
+            return 0;
+        }
+    }
+    LOGE("gpu_memory: no memory for %llu bytes (types 0x%x, properties 0x%x)",
+         (unsigned long long)requirements->size, requirements->memoryTypeBits, (unsigned)properties);
+    return -1;
+}
+
+int gpu_alloc(struct gpu_allocator* allocator, const VkMemoryRequirements* requirements,
+              VkMemoryPropertyFlags properties, enum gpu_resource_kind kind, uint32_t flags,
+              struct gpu_allocation* allocation) {
+    return alloc_memory(allocator, requirements, properties, kind, flags, nullptr, allocation);
+}
+
+int gpu_alloc_buffer(struct gpu_allocator* allocator, VkBuffer buffer,
+                     VkMemoryPropertyFlags properties, struct gpu_allocation* allocation) {
+    VkBufferMemoryRequirementsInfo2 info{};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+    info.buffer = buffer;
+    VkMemoryDedicatedRequirements dedicated_requirements{};
+    dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+    VkMemoryRequirements2 requirements{};
+    requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    requirements.pNext = &dedicated_requirements;
+    vkGetBufferMemoryRequirements2(allocator->device, &info, &requirements);
+
+    VkMemoryDedicatedAllocateInfo dedicated{};
+    dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicated.buffer = buffer;
+    uint32_t flags = dedicated_requirements.prefersDedicatedAllocation ? GPU_ALLOC_DEDICATED : 0;
+    if (alloc_memory(allocator, &requirements.memoryRequirements, properties, GPU_LINEAR, flags,
+                     &dedicated, allocation) != 0) {
+        return -1;
+    }
+    VkResult result = vkBindBufferMemory(allocator->device, buffer, allocation->memory, allocation->offset);
+    if (result != VK_SUCCESS) {
+        LOGE("vkBindBufferMemory failed: %d", (int)result);
+        gpu_free(allocator, allocation);
+        return -1;
+    }
+    return 0;
+}
+
+int gpu_alloc_image(struct gpu_allocator* allocator, VkImage image, VkImageTiling tiling,
+                    VkMemoryPropertyFlags properties, struct gpu_allocation* allocation) {
+    VkImageMemoryRequirementsInfo2 info{};
+    info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+    info.image = image;
+    VkMemoryDedicatedRequirements dedicated_requirements{};
+    dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+    VkMemoryRequirements2 requirements{};
+    requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    requirements.pNext = &dedicated_requirements;
+    vkGetImageMemoryRequirements2(allocator->device, &info, &requirements);
+
+    VkMemoryDedicatedAllocateInfo dedicated{};
+    dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicated.image = image;
+    uint32_t flags = dedicated_requirements.prefersDedicatedAllocation ? GPU_ALLOC_DEDICATED : 0;
+    enum gpu_resource_kind kind = tiling == VK_IMAGE_TILING_OPTIMAL ? GPU_OPTIMAL : GPU_LINEAR;
+    if (alloc_memory(allocator, &requirements.memoryRequirements, properties, kind, flags,
+                     &dedicated, allocation) != 0) {
+        return -1;
+    }
+    VkResult result = vkBindImageMemory(allocator->device, image, allocation->memory, allocation->offset);
+    if (result != VK_SUCCESS) {
+        LOGE("vkBindImageMemory failed: %d", (int)result);
+        gpu_free(allocator, allocation);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Release a block left empty, unless it is the last one of its memory type
+ * and kind: keeping one avoids reallocating it for the next resource.
+ */
+static void release_if_empty(struct gpu_allocator* allocator, struct gpu_block* block) {
+    if (!block->dedicated) {
+        if (block->tlsf.allocation_count > 0) {
+            return;
+        }
+        bool other = false;
+        for (const struct gpu_block* b : allocator->blocks) {
+            other |= b != block && !b->dedicated && b->memory_type == block->memory_type &&
+                     b->kind == block->kind;
+        }
+        if (!other) {
+            return;
+        }
+    }
+    release_block(allocator, block);
+}
+
+void gpu_free(struct gpu_allocator* allocator, struct gpu_allocation* allocation) {
+    struct gpu_block* block = allocation->block;
+    if (block == nullptr) {
+        return;
+    }
+    if (!block->dedicated) {
+        tlsf_free(&block->tlsf, allocation->node);
+    }
+    block->requested -= allocation->size;
+    release_if_empty(allocator, block);
+    *allocation = {};
+}
+
+void gpu_allocator_stats(struct gpu_allocator* allocator, struct gpu_stats* stats) {
+    *stats = {};
+    stats->heap_count = allocator->memory_properties.memoryHeapCount;
+    stats->device_allocations = allocator->device_allocations;
+    for (const struct gpu_block* block : allocator->blocks) {
+        uint32_t heap = allocator->memory_properties.memoryTypes[block->memory_type].heapIndex;
+        struct gpu_heap_stats* h = &stats->heaps[heap];
+        h->block_bytes += block->size;
+        h->used += block->requested;
+        if (block->dedicated) {
+            h->dedicated++;
+            h->allocations++;
+            continue;
+        }
+        h->blocks++;
+        h->allocations += block->tlsf.allocation_count;
+        h->wasted += block->tlsf.used_bytes - block->requested;
+        h->free += block->size - block->tlsf.used_bytes;
+        h->largest_free = std::max(h->largest_free, tlsf_largest_free(&block->tlsf));
+    }
+}
+
+void gpu_allocator_log(struct gpu_allocator* allocator) {
+    struct gpu_stats stats;
+    gpu_allocator_stats(allocator, &stats);
+    for (uint32_t i = 0; i < stats.heap_count; i++) {
+        const struct gpu_heap_stats& h = stats.heaps[i];
+        if (h.block_bytes == 0) {
+            continue;
+        }
+        LOGI("gpu_memory: heap %u: %.1f MB in %u blocks + %u dedicated, %u allocations, "
+             "%.1f MB used, %.2f MB wasted, %.1f MB free (largest %.1f MB)",
+             i, (double)h.block_bytes / (1 << 20), h.blocks, h.dedicated, h.allocations,
+             (double)h.used / (1 << 20), (double)h.wasted / (1 << 20), (double)h.free / (1 << 20),
+             (double)h.largest_free / (1 << 20));
+    }
+    LOGI("gpu_memory: %u device allocations", stats.device_allocations);
+}
+
+uint32_t gpu_defragment_plan(struct gpu_allocator* allocator, struct gpu_move* moves,
+                             uint32_t max_moves, VkDeviceSize max_bytes) {
+    std::vector<struct gpu_block*> sources;
+    // empty blocks have nothing to evacuate, but can take what does not fit
+    // in denser ones
+    std::vector<struct gpu_block*> empty;
+    for (struct gpu_block* block : allocator->blocks) {
+        if (!block->dedicated) {
+            (block->tlsf.allocation_count > 0 ? sources : empty).push_back(block);
+        }
+    }
+    // emptiest first: they are the cheapest to evacuate
+    std::sort(sources.begin(), sources.end(), [](const struct gpu_block* a, const struct gpu_block* b) {
+        return a->requested < b->requested;
+    });
+
+    uint32_t count = 0;
+    VkDeviceSize bytes = 0;
+    std::vector<struct gpu_block*> targets;
+    std::vector<struct gpu_block*> filled;
+    for (size_t s = 0; s < sources.size() && count < max_moves; s++) {
+        struct gpu_block* source = sources[s];
+        // its new arrivals are still owned by their old blocks
+        if (std::find(filled.begin(), filled.end(), source) != filled.end()) {
+            continue;
+        }
+        // only denser blocks that are not being evacuated themselves
+        for (size_t t = sources.size(); t-- > s + 1;) {
+            if (sources[t]->memory_type == source->memory_type && sources[t]->kind == source->kind) {
+                targets.push_back(sources[t]);
+            }
+        }
+        for (struct gpu_block* block : empty) {
+            if (block->memory_type == source->memory_type && block->kind == source->kind) {
+                targets.push_back(block);
+            }
+        }
+        for (uint32_t index = 0; index < (uint32_t)source->tlsf.nodes.size() && count < max_moves; index++) {
+            const struct tlsf_node* node = tlsf_get(&source->tlsf, index);
+            if (node->free || node->user == nullptr) {
+                continue;
+            }
+            struct gpu_allocation* allocation = (struct gpu_allocation*)node->user;
+            if (bytes + allocation->size > max_bytes) {
+                continue;
+            }
+            for (struct gpu_block* target : targets) {
+                uint32_t dst = tlsf_alloc(&target->tlsf, allocation->size, allocation->alignment, allocation);
+                if (dst == TLSF_NULL) {
+                    continue;
+                }
+                target->requested += allocation->size;
+                filled.push_back(target);
+                struct gpu_move* move = &moves[count++];
+                move->allocation = allocation;
+                move->src_memory = allocation->memory;
+                move->src_offset = allocation->offset;
+                move->dst_memory = target->memory;
+                move->dst_offset = tlsf_get(&target->tlsf, dst)->offset;
+                move->size = allocation->size;
+                move->dst_block = target;
+                move->dst_node = dst;
+                bytes += allocation->size;
+                break;
+            }
+        }
+        targets.clear();
+    }
+    return count;
+}
+
+void gpu_defragment_finish(struct gpu_allocator* allocator, const struct gpu_move* moves,
+                           uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        const struct gpu_move* move = &moves[i];
+        struct gpu_allocation* allocation = move->allocation;
+        struct gpu_allocation old = *allocation;
+        fill_allocation(move->dst_block, move->dst_node, move->dst_offset, old.size, old.alignment,
+                        allocation);
+        gpu_free(allocator, &old);
+    }
+}
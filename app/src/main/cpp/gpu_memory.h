@@ -0,0 +1,159 @@
+#ifndef ENGINE_GPU_MEMORY_H
+#define ENGINE_GPU_MEMORY_H
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "tlsf.h"
+
+/**
+ * Device memory is carved out of large blocks per memory type instead of
+ * one vkAllocateMemory per resource, which is slow and runs into
+ * maxMemoryAllocationCount (as low as 4096 on some drivers). Each block is
+ * managed by a tlsf allocator. Not thread safe: allocate and free on the
+ * render thread.
+ */
+
+// blocks are this size, or an eighth of heaps smaller than 1 GB
+#define GPU_BLOCK_SIZE (64ull << 20)
+// smallest unit handed out; also covers nonCoherentAtomSize for flushes
+#define GPU_GRANULARITY 256ull
+
+/**
+ * Buffers and linear images must not share a bufferImageGranularity page
+ * with optimal images, so the two kinds never share a block.
+ */
+enum gpu_resource_kind {
+    GPU_LINEAR,
+    GPU_OPTIMAL,
+};
+
+enum gpu_alloc_flags {
+    // own VkDeviceMemory: large render targets, or when the driver asks
+    GPU_ALLOC_DEDICATED = 1 << 0,
+};
+
+struct gpu_block {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    uint32_t memory_type;
+    enum gpu_resource_kind kind;
+    // whole block mapped for its lifetime when host visible
+    uint8_t* mapped;
+    struct tlsf tlsf;
+    // requested bytes, without alignment and granularity rounding
+    VkDeviceSize requested;
+    int dedicated;
+};
+
+/**
+ * Lives in the resource that owns it. Defragmentation finds owners through
+ * the block, so an allocation must not be copied to another address while
+ * it is live.
+ */
+struct gpu_allocation {
+    struct gpu_block* block;
+    uint32_t node;
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    VkDeviceSize alignment;
+    // nullptr unless the memory is host visible
+    void* mapped;
+};
+
+struct gpu_allocator {
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    VkDeviceSize block_size[VK_MAX_MEMORY_HEAPS];
+    std::vector<struct gpu_block*> blocks;
+    uint32_t device_allocations;
+};
+
+struct gpu_heap_stats {
+    VkDeviceSize block_bytes;
+    // bytes resources asked for
+    VkDeviceSize used;
+    // alignment and granularity rounding of live allocations
+    VkDeviceSize wasted;
+    VkDeviceSize free;
+    VkDeviceSize largest_free;
+    uint32_t blocks;
+    uint32_t allocations;
+    uint32_t dedicated;
+};
+
+struct gpu_stats {
+    struct gpu_heap_stats heaps[VK_MAX_MEMORY_HEAPS];
+    uint32_t heap_count;
+    uint32_t device_allocations;
+};
+
+/**
+ * A planned relocation. The caller creates a new resource, binds it at
+ * dst_memory/dst_offset, copies size bytes from the old one and, once the
+ * copy has completed on the GPU, calls gpu_defragment_finish.
+ */
+struct gpu_move {
+    struct gpu_allocation* allocation;
+    VkDeviceMemory src_memory;
+    VkDeviceSize src_offset;
+    VkDeviceMemory dst_memory;
+    VkDeviceSize dst_offset;
+    VkDeviceSize size;
+    struct gpu_block* dst_block;
+    uint32_t dst_node;
+};
+
+void gpu_allocator_init(struct gpu_allocator* allocator, VkPhysicalDevice physical_device,
+                        VkDevice device);
+
+/**
+ * Release every block. Allocations still live are reported.
+ */
+void gpu_allocator_destroy(struct gpu_allocator* allocator);
+
+/**
+ * Allocate memory of a type allowed by requirements that has all of
+ * properties. Returns 0 on success.
+ */
+int gpu_alloc(struct gpu_allocator* allocator, const VkMemoryRequirements* requirements,
+              VkMemoryPropertyFlags properties, enum gpu_resource_kind kind, uint32_t flags,
+              struct gpu_allocation* allocation);
+
+/**
+ * Allocate and bind memory for a buffer or image, with a dedicated
+ * allocation when the driver prefers one.
+ */
+int gpu_alloc_buffer(struct gpu_allocator* allocator, VkBuffer buffer,
+                     VkMemoryPropertyFlags properties, struct gpu_allocation* allocation);
+int gpu_alloc_image(struct gpu_allocator* allocator, VkImage image, VkImageTiling tiling,
+                    VkMemoryPropertyFlags properties, struct gpu_allocation* allocation);
+
+/**
+ * Free an allocation; a no-op for one that was never made. An empty block
+ * is released when another block of its type and kind remains.
+ */
+void gpu_free(struct gpu_allocator* allocator, struct gpu_allocation* allocation);
+
+void gpu_allocator_stats(struct gpu_allocator* allocator, struct gpu_stats* stats);
+void gpu_allocator_log(struct gpu_allocator* allocator);
+
+/**
+ * Plan moves that empty the least used blocks into free space elsewhere,
+ * up to max_moves and max_bytes. Destinations are reserved until finished.
+ * Returns the number of moves written.
+ */
+uint32_t gpu_defragment_plan(struct gpu_allocator* allocator, struct gpu_move* moves,
+                             uint32_t max_moves, VkDeviceSize max_bytes);
+
+/**
+ * Point the owners at their new memory and free the old ranges. Blocks
+ * left empty are released.
+ */
+void gpu_defragment_finish(struct gpu_allocator* allocator, const struct gpu_move* moves,
+                           uint32_t count);
+
+#endif // ENGINE_GPU_MEMORY_H
@@ -0,0 +1,62 @@
+#include "gpu_timer.h"
+
+#include "log.h"
+
+int gpu_timer_init(struct vk_context* vk, struct gpu_timer* timer, const struct renderer* renderer) {
+    if (vk->timestamp_valid_bits == 0) {
+        LOGW("gpu_timer: the graphics queue cannot write timestamps");
+        return 0;
+    }
+    VkQueryPoolCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    info.queryCount = GPU_TIMER_MAX_QUERIES * renderer->frames_in_flight;
+    VK_CHECK(vkCreateQueryPool(vk->device, &info, nullptr, &timer->pool));
+    timer->ns_per_tick = (double)vk->properties.limits.timestampPeriod;
+    timer->tick_mask = vk->timestamp_valid_bits >= 64 ? ~0ull : (1ull << vk->timestamp_valid_bits) - 1;
+    LOGI("gpu_timer: %u valid bits, %.2f ns per tick", vk->timestamp_valid_bits, timer->ns_per_tick);
+    return 0;
+}
+
+void gpu_timer_begin_frame(struct vk_context* vk, struct gpu_timer* timer, const struct renderer* renderer,
+                           VkCommandBuffer cmd) {
+    timer->tick_count = 0;
+    if (timer->pool == VK_NULL_HANDLE) {
+        return;
+    }
+    uint32_t first = renderer->frame * GPU_TIMER_MAX_QUERIES;
+    uint32_t written = timer->written[renderer->frame];
+    // the slot's fence has signalled, so its queries are available
+    if (written > 0 &&
+        vkGetQueryPoolResults(vk->device, timer->pool, first, written, sizeof(timer->ticks), timer->ticks,
+                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+        timer->tick_count = written;
+    }
+    vkCmdResetQueryPool(cmd, timer->pool, first, GPU_TIMER_MAX_QUERIES);
+    timer->written[renderer->frame] = 0;
+}
+
+uint32_t gpu_timer_write(struct gpu_timer* timer, const struct renderer* renderer, VkCommandBuffer cmd,
+                         VkPipelineStageFlagBits stage) {
+    uint32_t* written = &timer->written[renderer->frame];
+    if (timer->pool == VK_NULL_HANDLE || *written == GPU_TIMER_MAX_QUERIES) {
+        return RG_NONE;
+    }
+    vkCmdWriteTimestamp(cmd, stage, timer->pool, renderer->frame * GPU_TIMER_MAX_QUERIES + *written);
+    return (*written)++;
+}
+
+int64_t gpu_timer_elapsed_ns(const struct gpu_timer* timer, uint32_t begin, uint32_t end) {
+    if (begin >= timer->tick_count || end >= timer->tick_count) {
+        return 0;
+    }
+    uint64_t ticks = (timer->ticks[end] - timer->ticks[begin]) & timer->tick_mask;
+    return (int64_t)((double)ticks * timer->ns_per_tick);
+}
+
+void gpu_timer_destroy(struct vk_context* vk, struct gpu_timer* timer) {
+    if (timer->pool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(vk->device, timer->pool, nullptr);
+    }
+    *timer = {};
+}
@@ -0,0 +1,61 @@
+#ifndef ENGINE_GPU_TIMER_H
+#define ENGINE_GPU_TIMER_H
+
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "renderer.h"
+#include "vk_context.h"
+
+// timestamps one frame may write
+#define GPU_TIMER_MAX_QUERIES 8
+
+/**
+ * GPU timestamps, a range of GPU_TIMER_MAX_QUERIES queries per frame slot.
+ * A slot's timestamps are read back when the slot comes around again, so
+ * after its fence has signalled and without waiting: what a frame measures
+ * is known frames_in_flight frames later.
+ */
+struct gpu_timer {
+    VkQueryPool pool;
+    double ns_per_tick;
+    uint64_t tick_mask;
+    // timestamps written into each slot by the frame last recorded there
+    uint32_t written[MAX_FRAMES_IN_FLIGHT];
+    // the current slot's previous timestamps, in ticks
+    uint64_t ticks[GPU_TIMER_MAX_QUERIES];
+    uint32_t tick_count;
+};
+
+/**
+ * Returns 0 with no pool when the graphics queue has no timestamps; every
+ * other call is then a no-op and nothing is ever measured.
+ */
+int gpu_timer_init(struct vk_context* vk, struct gpu_timer* timer, const struct renderer* renderer);
+
+/**
+ * Read back the current slot's previous timestamps into ticks and record
+ * the reset of its queries into cmd. Call after renderer_begin_frame,
+ * outside any render pass, before the frame writes timestamps.
+ */
+void gpu_timer_begin_frame(struct vk_context* vk, struct gpu_timer* timer, const struct renderer* renderer,
+                           VkCommandBuffer cmd);
+
+/**
+ * Write the next timestamp of the frame once the commands before it have
+ * got through stage. Returns its index, RG_NONE when there is no room or
+ * no pool.
+ */
+uint32_t gpu_timer_write(struct gpu_timer* timer, const struct renderer* renderer, VkCommandBuffer cmd,
+                         VkPipelineStageFlagBits stage);
+
+/**
+ * Time between two of the timestamps read back by gpu_timer_begin_frame,
+ * 0 when either was not written.
+ */
+int64_t gpu_timer_elapsed_ns(const struct gpu_timer* timer, uint32_t begin, uint32_t end);
+
+void gpu_timer_destroy(struct vk_context* vk, struct gpu_timer* timer);
+
+#endif // ENGINE_GPU_TIMER_H
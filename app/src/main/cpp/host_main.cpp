@@ -0,0 +1,353 @@
+/**
+ * Headless Linux host. Drives the same engine_init/engine_draw/engine_destroy
+ * lifecycle as android_main against an offscreen surface, so frame cost can
+ * be measured on a desktop or CI machine with a software Vulkan driver
+ * (e.g. lavapipe: VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json).
+ */
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "bench.h"
+#include "engine.h"
+#include "frame_stats.h"
+#include "log.h"
+#include "platform.h"
+#include "profiler.h"
+
+struct bench_entry {
+    const char* name;
+    int (*run)();
+};
+
+static const struct bench_entry benches[] = {
+    { "jobs", bench_jobs },
+    { "math", bench_math },
+    { "ecs", bench_ecs },
+    { "input", bench_input },
+    { "pacer", bench_pacer },
+    { "profiler", bench_profiler },
+    { "assets", bench_assets },
+    { "gpu_memory", bench_gpu_memory },
+    { "gpu_defrag", bench_gpu_defrag },
+    { "record", bench_record },
+    { "render_graph", bench_render_graph },
+    { "cull", bench_cull },
+    { "gpu_cull", bench_gpu_cull },
+    { "batching", bench_batching },
+    { "texture_stream", bench_texture_stream },
+    { "lod", bench_lod },
+    { "mesh", bench_mesh },
+    { "dynamic_resolution", bench_dynamic_resolution },
+};
+
+struct host_options {
+    int frames;
+    int warmup;
+    int32_t width;
+    int32_t height;
+    uint32_t frames_in_flight;
+    uint32_t threads;
+    uint32_t record_threads;
+    int gpu_culling;
+    uint32_t entities;
+    float target_hz;
+    float display_hz;
+    const char* bench;
+    const char* trace;
+    // where the pipeline cache is kept: run twice with the same one to
+    // compare a cold cache against a warm one
+    const char* data_dir;
+    const char* assets_dir;
+    uint32_t stream_mb;
+    float gpu_budget_ms;
+    float min_render_scale;
+    float max_render_scale;
+};
+
+static void usage(const char* argv0) {
+    LOGI("usage: %s [--frames N] [--warmup N] [--width W] [--height H] [--frames-in-flight N]\n"
+         "       [--threads N] [--record-threads N] [--gpu-culling 0|1] [--entities N] [--target-hz HZ]\n"
+         "       [--display-hz HZ] [--trace FILE] [--data-dir DIR] [--assets DIR] [--stream-mb MB]\n"
+         "       [--gpu-budget-ms MS] [--min-render-scale S] [--max-render-scale S] [--bench NAME]", argv0);
+    for (const struct bench_entry& bench : benches) {
+        LOGI("  --bench %s", bench.name);
+    }
+}
+
+static int parse_options(int argc, char** argv, struct host_options* options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--frames") == 0 && value) {
+            options->frames = atoi(value);
+        } else if (strcmp(arg, "--warmup") == 0 && value) {
+            options->warmup = atoi(value);
+        } else if (strcmp(arg, "--width") == 0 && value) {
+            options->width = atoi(value);
+        } else if (strcmp(arg, "--height") == 0 && value) {
+            options->height = atoi(value);
+        } else if (strcmp(arg, "--frames-in-flight") == 0 && value) {
+            options->frames_in_flight = (uint32_t)atoi(value);
+        } else if (strcmp(arg, "--threads") == 0 && value) {
+            options->threads = (uint32_t)atoi(value);
+        } else if (strcmp(arg, "--record-threads") == 0 && value) {
+            options->record_threads = (uint32_t)atoi(value);
+        } else if (strcmp(arg, "--gpu-culling") == 0 && value) {
+            options->gpu_culling = atoi(value);
+        } else if (strcmp(arg, "--entities") == 0 && value) {
+            options->entities = (uint32_t)atoi(value);
+        } else if (strcmp(arg, "--target-hz") == 0 && value) {
+            options->target_hz = (float)atof(value);
+        } else if (strcmp(arg, "--display-hz") == 0 && value) {
+            options->display_hz = (float)atof(value);
+        } else if (strcmp(arg, "--trace") == 0 && value) {
+            options->trace = value;
+        } else if (strcmp(arg, "--data-dir") == 0 && value) {
+            options->data_dir = value;
+        } else if (strcmp(arg, "--assets") == 0 && value) {
+            options->assets_dir = value;
+        } else if (strcmp(arg, "--stream-mb") == 0 && value) {
+            options->stream_mb = (uint32_t)atoi(value);
+        } else if (strcmp(arg, "--gpu-budget-ms") == 0 && value) {
+            options->gpu_budget_ms = (float)atof(value);
+        } else if (strcmp(arg, "--min-render-scale") == 0 && value) {
+            options->min_render_scale = (float)atof(value);
+        } else if (strcmp(arg, "--max-render-scale") == 0 && value) {
+            options->max_render_scale = (float)atof(value);
+        } else if (strcmp(arg, "--bench") == 0 && value) {
+            options->bench = value;
+        } else {
+            usage(argv[0]);
+            return -1;
+        }
+        i++;
+    }
+    return 0;
+}
+
+#define STREAM_TEST_BLOCK (64u << 20)
+#define STREAM_TEST_CHUNK (1u << 20)
+
+/**
+ * Synthetic content for --stream-mb: a 64 MB block streamed over and over
+ * in 1 MB requests into a device-local buffer of the same size.
+ */
+struct stream_test {
+    std::vector<uint8_t> source;
+    VkBuffer buffer;
+    struct gpu_allocation memory;
+    uint64_t total;
+    uint64_t queued;
+    uint32_t requests;
+    std::atomic<uint32_t> completed{0};
+    int64_t start_ns;
+    int64_t end_ns;
+};
+
+static int stream_test_init(struct stream_test* test, struct engine* engine, uint32_t megabytes) {
+    test->source.resize(STREAM_TEST_BLOCK);
+    for (size_t i = 0; i < test->source.size(); i++) {
+        test->source[i] = (uint8_t)(i * 2654435761u >> 24);
+    }
+    test->total = (uint64_t)megabytes << 20;
+    return vk_create_buffer(&engine->vk, STREAM_TEST_BLOCK, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &test->buffer, &test->memory);
+}
+
+static bool stream_test_active(const struct stream_test* test) {
+    return test->queued < test->total ||
+           test->completed.load(std::memory_order_acquire) < test->requests;
+}
+
+/**
+ * Keep up to one block of uploads in flight.
+ */
+static void stream_test_feed(struct stream_test* test, struct engine* engine) {
+    if (test->start_ns == 0) {
+        test->start_ns = platform_time_ns();
+    }
+    while (test->queued < test->total && streamer_pending_bytes(&engine->streamer) < STREAM_TEST_BLOCK) {
+        uint64_t offset = test->queued % STREAM_TEST_BLOCK;
+        struct stream_request request{};
+        request.source = test->source.data() + offset;
+        request.size = std::min<uint64_t>(STREAM_TEST_CHUNK, test->total - test->queued);
+        request.buffer = test->buffer;
+        request.offset = offset;
+        request.completed = &test->completed;
+        if (!streamer_queue(&engine->streamer, &request)) {
+            break;
+        }
+        test->queued += request.size;
+        test->requests++;
+    }
+}
+
+static void stream_test_destroy(struct stream_test* test, struct engine* engine) {
+    // let queued uploads land before their source and target go away
+    while (test->completed.load(std::memory_order_acquire) < test->requests) {
+        streamer_update(&engine->streamer);
+        platform_sleep_until_ns(platform_time_ns() + 1000000);
+    }
+    vkDeviceWaitIdle(engine->vk.device);
+    vk_destroy_buffer(&engine->vk, &test->buffer, &test->memory);
+}
+
+int main(int argc, char** argv) {
+    struct host_options options{};
+    options.frames = 1000;
+    options.warmup = 30;
+    options.width = 1280;
+    options.height = 720;
+    if (parse_options(argc, argv, &options) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    if (options.bench != nullptr) {
+        for (const struct bench_entry& bench : benches) {
+            if (strcmp(bench.name, options.bench) == 0) {
+                return bench.run() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+            }
+        }
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    PROFILE_THREAD("main");
+    struct job_system jobs{};
+    job_system_init(&jobs, options.threads);
+
+    struct engine engine{};
+    engine.jobs = &jobs;
+    engine.window = nullptr;
+    engine.data_path = options.data_dir;
+    platform_set_asset_source((void*)options.assets_dir);
+    engine.width = options.width;
+    engine.height = options.height;
+    engine.frames_in_flight = options.frames_in_flight;
+    engine.scene_entities = options.entities;
+    engine.record_threads = options.record_threads;
+    engine.gpu_culling = options.gpu_culling;
+    engine.gpu_budget_ms = options.gpu_budget_ms;
+    engine.min_render_scale = options.min_render_scale;
+    engine.max_render_scale = options.max_render_scale;
+    // off by default so the host measures raw frame cost
+    engine.target_hz = options.target_hz;
+    engine.display_hz = options.display_hz;
+    engine.animating = 1;
+
+    if (engine_init(&engine) != 0) {
+        LOGE("engine_init failed");
+        job_system_shutdown(&jobs);
+        return EXIT_FAILURE;
+    }
+
+    if (options.trace != nullptr) {
+#if !ENGINE_PROFILE
+        LOGW("built without ENGINE_PROFILE, the trace only has frame markers");
+#endif
+        // room for every zone of every frame, sized before the loop so
+        // the capture itself never allocates
+        profiler_begin_capture((uint32_t)(options.warmup + options.frames) * 256u);
+    }
+
+    struct stream_test stream_test{};
+    if (options.stream_mb > 0 && stream_test_init(&stream_test, &engine, options.stream_mb) != 0) {
+        LOGE("cannot create the streaming target buffer");
+        options.stream_mb = 0;
+    }
+
+    struct frame_stats stats;
+    struct frame_stats streaming_stats;
+    struct frame_stats record_stats;
+    struct frame_stats cull_stats;
+    struct frame_stats gpu_stats;
+    stats.samples_ns.reserve((size_t)options.frames);
+    streaming_stats.samples_ns.reserve((size_t)options.frames);
+    record_stats.samples_ns.reserve((size_t)options.frames);
+    cull_stats.samples_ns.reserve((size_t)options.frames);
+    gpu_stats.samples_ns.reserve((size_t)options.frames);
+    double render_scale_sum = 0.0;
+    uint64_t heap_allocations = 0;
+    size_t arena_peak = 0;
+    for (int i = 0; i < options.warmup + options.frames; i++) {
+        bool streaming = options.stream_mb > 0 && i >= options.warmup && stream_test_active(&stream_test);
+        int64_t start = platform_time_ns();
+        if (streaming) {
+            stream_test_feed(&stream_test, &engine);
+        }
+        engine_draw(&engine);
+        int64_t end = platform_time_ns();
+        profiler_frame_mark();
+        if (streaming && !stream_test_active(&stream_test)) {
+            stream_test.end_ns = end;
+        }
+        if (i >= options.warmup) {
+            frame_stats_add(streaming ? &streaming_stats : &stats, end - start);
+            frame_stats_add(&record_stats, engine.stats.record_ns);
+            frame_stats_add(&cull_stats, engine.stats.cull_ns);
+            if (engine.stats.gpu_main_ns > 0) {
+                frame_stats_add(&gpu_stats, engine.stats.gpu_main_ns);
+            }
+            render_scale_sum += engine.stats.resolution.scale;
+            heap_allocations += engine.stats.heap_allocations;
+            arena_peak = std::max(arena_peak, engine.stats.frame_arena_bytes);
+        }
+    }
+    if (options.trace != nullptr) {
+        profiler_end_capture(options.trace);
+    }
+    frame_stats_report(&stats, "engine_draw");
+    frame_stats_report(&record_stats, "main pass recording");
+    frame_stats_report(&cull_stats, "frustum culling");
+    if (!gpu_stats.samples_ns.empty()) {
+        frame_stats_report(&gpu_stats, "main pass on the GPU");
+    }
+    if (engine.gpu_budget_ms > 0.0f) {
+        const struct dynamic_resolution_stats* resolution = &engine.stats.resolution;
+        LOGI("resolution: %ux%u in the last frame, %.2f scale on average; %llu of %llu measured frames over "
+             "the %.2f ms budget, %u scale drops, %u raises", engine.stats.render_width,
+             engine.stats.render_height, options.frames > 0 ? render_scale_sum / options.frames : 1.0,
+             (unsigned long long)resolution->over_budget_frames, (unsigned long long)resolution->frames,
+             (double)resolution->budget_ns * 1e-6, resolution->decreases, resolution->increases);
+    }
+    LOGI("culling: %u of %u objects visible in the last frame%s", engine.stats.visible_objects,
+         engine.gpu_culling ? engine.gpu_cull.object_count : engine.cull.object_count,
+         engine.gpu_culling ? ", counted on the GPU" : "");
+    if (engine.gpu_culling) {
+        LOGI("culling: %u in the frustum, %u of them occluded", engine.gpu_cull.frustum_count,
+             engine.gpu_cull.occluded_count);
+    }
+    const struct draw_batch_stats* batched = &engine.stats.batched;
+    const struct draw_batch_stats* unbatched = &engine.stats.unbatched;
+    LOGI("batching: %u draws, %u pipeline binds, %u material binds in the last frame "
+         "(%u, %u and %u unbatched)", batched->draws, batched->pipeline_binds, batched->material_binds,
+         unbatched->draws, unbatched->pipeline_binds, unbatched->material_binds);
+    if (options.stream_mb > 0) {
+        frame_stats_report(&streaming_stats, "engine_draw while streaming");
+        if (stream_test.end_ns != 0) {
+            double seconds = (double)(stream_test.end_ns - stream_test.start_ns) * 1e-9;
+            LOGI("streamed %u MB in %.2f s (%.0f MB/s), %llu batches",
+                 options.stream_mb, seconds, options.stream_mb / seconds,
+                 (unsigned long long)engine.streamer.batches_submitted.load());
+        } else {
+            LOGW("streaming did not finish within %d frames (%llu of %llu MB queued)", options.frames,
+                 (unsigned long long)(stream_test.queued >> 20), (unsigned long long)(stream_test.total >> 20));
+        }
+        stream_test_destroy(&stream_test, &engine);
+    }
+    LOGI("steady state: %llu heap allocations, frame arena peak %zu bytes",
+         (unsigned long long)heap_allocations, arena_peak);
+    if (heap_allocations != 0) {
+        LOGW("steady-state frames allocated from the general heap");
+    }
+
+    LOGI("startup: pipelines created in %.2f ms", (double)engine.stats.pipeline_create_ns * 1e-6);
+
+    engine_save_caches(&engine);
+    engine_destroy(&engine);
+    job_system_shutdown(&jobs);
+    return EXIT_SUCCESS;
+}
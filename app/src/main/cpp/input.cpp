@@ -0,0 +1,59 @@
+#include "input.h"
+
+bool input_push(struct input_queue* queue, const struct input_event* event) {
+    if (!spsc_push(&queue->ring, *event)) {
+        queue->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    queue->pushed.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+static void apply_event(struct input_state* state, const struct input_event* event) {
+    switch (event->type) {
+        case INPUT_TOUCH_DOWN:
+        case INPUT_TOUCH_MOVE:
+            state->pointer_count = event->pointer_count;
+            for (uint32_t i = 0; i < event->pointer_count; i++) {
+                state->pointers[i] = event->pointers[i];
+            }
+            break;
+        case INPUT_TOUCH_UP: {
+            // the event still lists the lifted pointer, drop it from the state
+            uint32_t n = 0;
+            for (uint32_t i = 0; i < event->pointer_count; i++) {
+                if ((int32_t)i != event->code) {
+                    state->pointers[n++] = event->pointers[i];
+                }
+            }
+            state->pointer_count = n;
+            break;
+        }
+        case INPUT_TOUCH_CANCEL:
+            state->pointer_count = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+void input_update(struct input_queue* queue, struct input_state* state, int64_t now_ns,
+                  void (*on_event)(const struct input_event* event, void* data), void* data) {
+    state->events = 0;
+    state->max_latency_ns = 0;
+
+    struct input_event event;
+    while (spsc_pop(&queue->ring, &event)) {
+        if (state->events == 0) {
+            // events are in order, so the first one has waited the longest
+            state->max_latency_ns = now_ns - event.time_ns;
+        }
+        apply_event(state, &event);
+        if (on_event != nullptr) {
+            on_event(&event, data);
+        }
+        state->last_event_ns = event.time_ns;
+        state->events++;
+    }
+    state->total_events += state->events;
+}
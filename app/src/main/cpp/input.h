@@ -0,0 +1,80 @@
+#ifndef ENGINE_INPUT_H
+#define ENGINE_INPUT_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "spsc_ring.h"
+
+#define INPUT_MAX_POINTERS 10
+// ~1 s of 240 Hz touch samples, enough to ride out a long frame
+#define INPUT_QUEUE_CAPACITY 256
+
+enum input_event_type {
+    INPUT_TOUCH_DOWN,
+    INPUT_TOUCH_MOVE,
+    INPUT_TOUCH_UP,
+    INPUT_TOUCH_CANCEL,
+    INPUT_KEY_DOWN,
+    INPUT_KEY_UP,
+};
+
+struct input_pointer {
+    int32_t id;
+    float x;
+    float y;
+    float pressure;
+};
+
+/**
+ * One sample of the input state. A batched Android motion event becomes
+ * one event per historical sample plus one for the current sample, each
+ * with its own timestamp.
+ */
+struct input_event {
+    // when the hardware sampled it, CLOCK_MONOTONIC
+    int64_t time_ns;
+    uint32_t type;
+    // TOUCH_DOWN/UP: index of the pointer that changed; KEY_*: key code
+    int32_t code;
+    uint32_t pointer_count;
+    struct input_pointer pointers[INPUT_MAX_POINTERS];
+};
+
+/**
+ * Platform thread produces, the simulation consumes.
+ */
+struct input_queue {
+    struct spsc_ring<struct input_event, INPUT_QUEUE_CAPACITY> ring;
+    std::atomic<uint64_t> pushed{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+/**
+ * Producer side. Counts the event as dropped when the queue is full.
+ */
+bool input_push(struct input_queue* queue, const struct input_event* event);
+
+/**
+ * Touch state as seen by the simulation after applying queued events.
+ */
+struct input_state {
+    uint32_t pointer_count;
+    struct input_pointer pointers[INPUT_MAX_POINTERS];
+    // events applied by the last input_update and the age of the oldest
+    // one when it was consumed
+    uint32_t events;
+    int64_t max_latency_ns;
+    int64_t last_event_ns;
+    uint64_t total_events;
+};
+
+/**
+ * Consumer side. Drain the queue into state; now_ns is used to measure how
+ * long events waited. Calls on_event, if given, for every event in order.
+ */
+void input_update(struct input_queue* queue, struct input_state* state, int64_t now_ns,
+                  void (*on_event)(const struct input_event* event, void* data) = nullptr,
+                  void* data = nullptr);
+
+#endif // ENGINE_INPUT_H
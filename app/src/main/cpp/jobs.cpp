@@ -0,0 +1,270 @@
+#include "jobs.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "log.h"
+#include "profiler.h"
+
+static thread_local struct job_system* tls_system = nullptr;
+static thread_local int tls_worker = -1;
+
+static void deque_init(struct job_deque* deque) {
+    deque->top.store(0, std::memory_order_relaxed);
+    deque->bottom.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * Owner only. Returns false when the deque is full.
+ */
+static bool deque_push(struct job_deque* deque, const struct job* job) {
+    int64_t b = deque->bottom.load(std::memory_order_relaxed);
+    int64_t t = deque->top.load(std::memory_order_acquire);
+    if (b - t >= JOB_QUEUE_CAPACITY) {
+        return false;
+    }
+    deque->slots[b & (JOB_QUEUE_CAPACITY - 1)] = *job;
+    std::atomic_thread_fence(std::memory_order_release);
+    deque->bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * Owner only. LIFO end, keeps recently pushed (cache hot) jobs local.
+ */
+static bool deque_pop(struct job_deque* deque, struct job* out) {
+    int64_t b = deque->bottom.load(std::memory_order_relaxed) - 1;
+    deque->bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = deque->top.load(std::memory_order_relaxed);
+    if (t > b) {
+        deque->bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+    *out = deque->slots[b & (JOB_QUEUE_CAPACITY - 1)];
+    bool taken = true;
+    if (t == b) {
+        // last item, race against thieves for it
+        taken = deque->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                   std::memory_order_relaxed);
+        deque->bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return taken;
+}
+
+/**
+ * Any thread. FIFO end, steals the oldest (usually largest) work. The slot
+ * is copied before claiming it; if the owner overwrote it meanwhile, top has
+ * moved and the claim fails, so a torn copy is never used.
+ */
+static bool deque_steal(struct job_deque* deque, struct job* out) {
+    int64_t t = deque->top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = deque->bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+        return false;
+    }
+    *out = deque->slots[t & (JOB_QUEUE_CAPACITY - 1)];
+    return deque->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed);
+}
+
+static void execute(const struct job* job) {
+    job->func(job->data, job->begin, job->end);
+    if (job->counter != nullptr) {
+        job->counter->value.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+static bool find_job(struct job_system* js, uint32_t self, struct job* job) {
+    struct job_worker* worker = &js->workers[self];
+    bool found = deque_pop(&worker->deque, job);
+    if (!found && js->worker_count > 1) {
+        // xorshift, picks a random victim to spread contention
+        uint32_t x = worker->rng;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        worker->rng = x;
+        uint32_t start = x % js->worker_count;
+        for (uint32_t i = 0; i < js->worker_count && !found; i++) {
+            uint32_t victim = (start + i) % js->worker_count;
+            if (victim != self) {
+                found = deque_steal(&js->workers[victim].deque, job);
+            }
+        }
+    }
+    if (found) {
+        js->queued.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return found;
+}
+
+static void worker_main(struct job_system* js, uint32_t index) {
+    tls_system = js;
+    tls_worker = (int)index;
+#if ENGINE_PROFILE
+    char name[16];
+    snprintf(name, sizeof(name), "worker %u", index);
+    PROFILE_THREAD(name);
+#endif
+
+    int idle_spins = 0;
+    while (!js->quit.load(std::memory_order_acquire)) {
+        struct job job;
+        if (find_job(js, index, &job)) {
+            execute(&job);
+            idle_spins = 0;
+            continue;
+        }
+        if (++idle_spins < 64) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(js->mutex);
+        // seq_cst pairs with the push side: either this load sees the new
+        // queued count or the pusher sees sleeping and notifies
+        js->sleeping.fetch_add(1, std::memory_order_seq_cst);
+        js->wake.wait(lock, [js] {
+            return js->queued.load(std::memory_order_seq_cst) > 0 ||
+                   js->quit.load(std::memory_order_relaxed);
+        });
+        js->sleeping.fetch_sub(1, std::memory_order_relaxed);
+        idle_spins = 0;
+    }
+    tls_system = nullptr;
+    tls_worker = -1;
+}
+
+int job_system_init(struct job_system* js, uint32_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    thread_count = std::min(thread_count, (uint32_t)MAX_JOB_WORKERS);
+
+    js->workers = new struct job_worker[thread_count];
+    js->worker_count = thread_count;
+    js->queued.store(0);
+    js->sleeping.store(0);
+    js->quit.store(0);
+    for (uint32_t i = 0; i < thread_count; i++) {
+        deque_init(&js->workers[i].deque);
+        js->workers[i].rng = 0x9E3779B9u * (i + 1);
+    }
+
+    tls_system = js;
+    tls_worker = 0;
+    for (uint32_t i = 1; i < thread_count; i++) {
+        js->workers[i].thread = std::thread(worker_main, js, i);
+    }
+    LOGI("job system: %u threads", thread_count);
+    return 0;
+}
+
+void job_system_shutdown(struct job_system* js) {
+    if (js->workers == nullptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(js->mutex);
+        js->quit.store(1, std::memory_order_release);
+    }
+    js->wake.notify_all();
+    for (uint32_t i = 1; i < js->worker_count; i++) {
+        js->workers[i].thread.join();
+    }
+    delete[] js->workers;
+    js->workers = nullptr;
+    js->worker_count = 0;
+    if (tls_system == js) {
+        tls_system = nullptr;
+        tls_worker = -1;
+    }
+}
+
+void job_run(struct job_system* js, const struct job* jobs, uint32_t count,
+             struct job_counter* counter) {
+    if (tls_system != js) {
+        LOGE("job_run called from a thread outside the job system");
+        return;
+    }
+    struct job_worker* worker = &js->workers[tls_worker];
+    if (counter != nullptr) {
+        counter->value.fetch_add((int32_t)count, std::memory_order_relaxed);
+    }
+
+    uint32_t pushed = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        struct job job = jobs[i];
+        job.counter = counter;
+        if (deque_push(&worker->deque, &job)) {
+            pushed++;
+        } else {
+            // deque full, no point queuing behind thousands of jobs
+            execute(&job);
+        }
+    }
+
+    if (pushed > 0) {
+        // store then load on both sides: relaxed would let both loads see
+        // the old value, and a worker sleep with work queued
+        js->queued.fetch_add(pushed, std::memory_order_seq_cst);
+        if (js->sleeping.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock(js->mutex);
+            if (pushed == 1) {
+                js->wake.notify_one();
+            } else {
+                js->wake.notify_all();
+            }
+        }
+    }
+}
+
+void job_wait(struct job_system* js, struct job_counter* counter) {
+    if (tls_system != js) {
+        while (counter->value.load(std::memory_order_acquire) > 0) {
+            std::this_thread::yield();
+        }
+        return;
+    }
+    uint32_t self = (uint32_t)tls_worker;
+    while (counter->value.load(std::memory_order_acquire) > 0) {
+        struct job job;
+        if (find_job(js, self, &job)) {
+            execute(&job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void job_parallel_for(struct job_system* js, uint32_t count, uint32_t batch_size,
+                      job_func func, void* data) {
+    if (count == 0) {
+        return;
+    }
+    batch_size = std::max(batch_size, 1u);
+    struct job_counter counter;
+    struct job batch{};
+    batch.func = func;
+    batch.data = data;
+
+    // queue in chunks so a huge range cannot overflow the job ring
+    uint32_t begin = 0;
+    while (begin < count) {
+        struct job jobs[64];
+        uint32_t n = 0;
+        while (n < 64 && begin < count) {
+            batch.begin = begin;
+            batch.end = std::min(count, begin + batch_size);
+            jobs[n++] = batch;
+            begin = batch.end;
+        }
+        job_run(js, jobs, n, &counter);
+    }
+    job_wait(js, &counter);
+}
+
+int job_worker_index() {
+    return tls_worker;
+}
@@ -0,0 +1,100 @@
+#ifndef ENGINE_JOBS_H
+#define ENGINE_JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#define MAX_JOB_WORKERS 16
+// per thread, power of two; bounds the number of jobs a thread can have
+// outstanding at once
+#define JOB_QUEUE_CAPACITY 4096
+
+/**
+ * A job runs func(data, begin, end). Single jobs use [0, 1); parallel_for
+ * batches carry their sub-range so no extra allocation is needed.
+ */
+typedef void (*job_func)(void* data, uint32_t begin, uint32_t end);
+
+/**
+ * Counts jobs that have not finished yet. Waiting for a counter is how one
+ * group of jobs depends on another.
+ */
+struct job_counter {
+    std::atomic<int32_t> value{0};
+};
+
+struct job {
+    job_func func;
+    void* data;
+    uint32_t begin;
+    uint32_t end;
+    struct job_counter* counter;
+};
+
+/**
+ * Chase-Lev work-stealing deque holding jobs by value. The owning thread
+ * pushes and pops at the bottom, other threads steal from the top.
+ */
+struct job_deque {
+    alignas(64) std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+    alignas(64) struct job slots[JOB_QUEUE_CAPACITY];
+};
+
+struct job_worker {
+    struct job_deque deque;
+    uint32_t rng;
+    std::thread thread;
+};
+
+/**
+ * Worker 0 is the thread that called job_system_init; it runs jobs while
+ * it waits on counters. Workers 1..N are background threads.
+ */
+struct job_system {
+    struct job_worker* workers;
+    uint32_t worker_count;
+    std::atomic<int64_t> queued;
+    std::atomic<int32_t> sleeping;
+    std::atomic<int32_t> quit;
+    std::mutex mutex;
+    std::condition_variable wake;
+};
+
+/**
+ * Start the scheduler. thread_count counts the calling thread; 0 uses one
+ * thread per hardware core.
+ */
+int job_system_init(struct job_system* js, uint32_t thread_count);
+
+void job_system_shutdown(struct job_system* js);
+
+/**
+ * Queue count jobs on the calling thread's deque. counter, if any, is
+ * incremented by count and decremented as each job finishes. Must be called
+ * from worker 0 or from inside a job.
+ */
+void job_run(struct job_system* js, const struct job* jobs, uint32_t count,
+             struct job_counter* counter);
+
+/**
+ * Run other jobs until counter reaches zero.
+ */
+void job_wait(struct job_system* js, struct job_counter* counter);
+
+/**
+ * Split [0, count) into batches of batch_size, run them on all workers and
+ * wait for completion.
+ */
+void job_parallel_for(struct job_system* js, uint32_t count, uint32_t batch_size,
+                      job_func func, void* data);
+
+/**
+ * Index of the calling worker, or -1 for threads outside the job system.
+ */
+int job_worker_index();
+
+#endif // ENGINE_JOBS_H
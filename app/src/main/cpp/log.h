@@ -0,0 +1,21 @@
+#ifndef ENGINE_LOG_H
+#define ENGINE_LOG_H
+
+/**
+ * Logging macros. Go to logcat on Android and to stdout/stderr on the host.
+ */
+#ifdef __ANDROID__
+#include <android/log.h>
+
+#define LOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO, "native-activity", __VA_ARGS__))
+#define LOGW(...) ((void)__android_log_print(ANDROID_LOG_WARN, "native-activity", __VA_ARGS__))
+#define LOGE(...) ((void)__android_log_print(ANDROID_LOG_ERROR, "native-activity", __VA_ARGS__))
+#else
+#include <cstdio>
+
+#define LOGI(...) ((void)(fprintf(stdout, __VA_ARGS__), fputc('\n', stdout)))
+#define LOGW(...) ((void)(fprintf(stderr, "W: " __VA_ARGS__), fputc('\n', stderr)))
+#define LOGE(...) ((void)(fprintf(stderr, "E: " __VA_ARGS__), fputc('\n', stderr)))
+#endif
+
+#endif // ENGINE_LOG_H
@@ -16,72 +16,78 @@
  */
 
 //BEGIN_INCLUDE(all)
-#include <initializer_list>
-#include <memory>
+#include <algorithm>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <jni.h>
-#include <cerrno>
-#include <cassert>
 
-#include <vulkan/vulkan.h>
-
-//#include <EGL/egl.h>
-//#include <GLES/gl.h>
-
-#include <android/log.h>
 #include <android_native_app_glue.h>
 
-#define LOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO, "native-activity", __VA_ARGS__))
-#define LOGW(...) ((void)__android_log_print(ANDROID_LOG_WARN, "native-activity", __VA_ARGS__))
-
-/**
- * Our saved state data.
- */
-struct saved_state {
-    uint32_t counter;
-    int32_t x;
-    int32_t y;
-};
-
-/**
- * Shared state for our app.
- */
-struct engine {
-    struct android_app* app;
-    //display
-    int animating;
-    int32_t width;
-    int32_t height;
-    struct saved_state state;
-};
+#include "engine.h"
+#include "log.h"
+#include "platform.h"
+#include "profiler.h"
 
 /**
- * Initialize engine
+ * Copy every pointer of one (historical or current) sample of a motion event.
  */
-static int engine_init(struct engine* engine) {
-//    engine->display = display;
-//    engine->context = context;
-//    engine->surface = surface;
-//    engine->width = w;
-//    engine->height = h;
-
-    LOGI("intialized");
-    return 0;
+static void read_motion_sample(const AInputEvent* event, int32_t history, struct input_event* out) {
+    out->pointer_count = std::min((uint32_t)AMotionEvent_getPointerCount(event),
+                                  (uint32_t)INPUT_MAX_POINTERS);
+    for (uint32_t p = 0; p < out->pointer_count; p++) {
+        struct input_pointer* pointer = &out->pointers[p];
+        pointer->id = AMotionEvent_getPointerId(event, p);
+        if (history >= 0) {
+            pointer->x = AMotionEvent_getHistoricalX(event, p, (size_t)history);
+            pointer->y = AMotionEvent_getHistoricalY(event, p, (size_t)history);
+            pointer->pressure = AMotionEvent_getHistoricalPressure(event, p, (size_t)history);
+        } else {
+            pointer->x = AMotionEvent_getX(event, p);
+            pointer->y = AMotionEvent_getY(event, p);
+            pointer->pressure = AMotionEvent_getPressure(event, p);
+        }
+    }
 }
 
 /**
- * Draw frame
+ * Forward a motion event, including the samples Android batched into its
+ * history since the last one, to the simulation's input queue.
  */
-static void engine_draw(struct engine* engine) {
-
-}
+static void push_motion_event(struct engine* engine, const AInputEvent* event) {
+    int32_t action = AMotionEvent_getAction(event);
+    int32_t index = (action & AMOTION_EVENT_ACTION_POINTER_INDEX_MASK) >>
+                    AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT;
 
-/**
- * Destroy engine
- */
-static void engine_destroy(struct engine* engine) {
+    struct input_event sample{};
+    sample.type = INPUT_TOUCH_MOVE;
+    size_t history = AMotionEvent_getHistorySize(event);
+    for (size_t h = 0; h < history; h++) {
+        sample.time_ns = AMotionEvent_getHistoricalEventTime(event, h);
+        read_motion_sample(event, (int32_t)h, &sample);
+        input_push(&engine->input_queue, &sample);
+    }
 
+    switch (action & AMOTION_EVENT_ACTION_MASK) {
+        case AMOTION_EVENT_ACTION_DOWN:
+        case AMOTION_EVENT_ACTION_POINTER_DOWN:
+            sample.type = INPUT_TOUCH_DOWN;
+            break;
+        case AMOTION_EVENT_ACTION_UP:
+        case AMOTION_EVENT_ACTION_POINTER_UP:
+            sample.type = INPUT_TOUCH_UP;
+            break;
+        case AMOTION_EVENT_ACTION_CANCEL:
+            sample.type = INPUT_TOUCH_CANCEL;
+            break;
+        default:
+            sample.type = INPUT_TOUCH_MOVE;
+            break;
+    }
+    sample.code = index;
+    sample.time_ns = AMotionEvent_getEventTime(event);
+    read_motion_sample(event, -1, &sample);
+    input_push(&engine->input_queue, &sample);
 }
 
 /**
@@ -89,14 +95,24 @@ static void engine_destroy(struct engine* engine) {
  */
 static int32_t engine_handle_input(struct android_app* app, AInputEvent* event) {
     auto* engine = (struct engine*)app->userData;
-    if (AInputEvent_getType(event) == AINPUT_EVENT_TYPE_MOTION) {
-        engine->animating = 1;
-        engine->state.counter++;
-        engine->state.x = AMotionEvent_getX(event, 0);
-        engine->state.y = AMotionEvent_getY(event, 0);
-        return 1;
+    switch (AInputEvent_getType(event)) {
+        case AINPUT_EVENT_TYPE_MOTION:
+            engine->animating = 1;
+            push_motion_event(engine, event);
+            return 1;
+        case AINPUT_EVENT_TYPE_KEY: {
+            int32_t code = AKeyEvent_getKeyCode(event);
+            struct input_event key{};
+            key.type = AKeyEvent_getAction(event) == AKEY_EVENT_ACTION_UP ? INPUT_KEY_UP : INPUT_KEY_DOWN;
+            key.code = code;
+            key.time_ns = AKeyEvent_getEventTime(event);
+            input_push(&engine->input_queue, &key);
+            // leave back to the system so the activity can still be closed
+            return code == AKEYCODE_BACK ? 0 : 1;
+        }
+        default:
+            return 0;
     }
-    return 0;
 }
 
 /**
@@ -107,20 +123,38 @@ static void engine_handle_cmd(struct android_app* app, int32_t cmd) {
     switch (cmd) {
         case APP_CMD_SAVE_STATE:
             // The system has asked us to save our current state.  Do so.
-            engine->app->savedState = malloc(sizeof(struct saved_state));
-            *((struct saved_state*)engine->app->savedState) = engine->state;
-            engine->app->savedStateSize = sizeof(struct saved_state);
+            // The glue releases it with free(), so this stays a plain malloc.
+            app->savedState = malloc(sizeof(struct saved_state));
+            *((struct saved_state*)app->savedState) = engine->state;
+            app->savedStateSize = sizeof(struct saved_state);
+            // the process may be killed without another callback
+            engine_save_caches(engine);
             break;
         case APP_CMD_INIT_WINDOW:
             // The window is being shown, get it ready.
-            if (engine->app->window != nullptr) {
+            if (app->window != nullptr) {
+                engine->window = app->window;
+                engine->width = ANativeWindow_getWidth(app->window);
+                engine->height = ANativeWindow_getHeight(app->window);
                 engine_init(engine);
                 engine_draw(engine);
             }
             break;
         case APP_CMD_TERM_WINDOW:
             // The window is being hidden or closed, clean it up.
+            engine_save_caches(engine);
             engine_destroy(engine);
+            engine->window = nullptr;
+            break;
+        case APP_CMD_WINDOW_RESIZED:
+        case APP_CMD_CONFIG_CHANGED:
+            // Rotation or resize, rebuild the swapchain before the next frame.
+            if (engine->initialized && app->window != nullptr) {
+                engine->width = ANativeWindow_getWidth(app->window);
+                engine->height = ANativeWindow_getHeight(app->window);
+                renderer_resize(&engine->renderer, (uint32_t)engine->width,
+                                (uint32_t)engine->height);
+            }
             break;
         case APP_CMD_GAINED_FOCUS:
             // When our app gains focus, we start drawing
@@ -144,11 +178,11 @@ static void engine_handle_cmd(struct android_app* app, int32_t cmd) {
 void android_main(struct android_app* state) {
     struct engine engine{};
 
-    memset(&engine, 0, sizeof(engine));
     state->userData = &engine;
     state->onAppCmd = engine_handle_cmd;
     state->onInputEvent = engine_handle_input;
-    engine.app = state;
+    engine.data_path = state->activity->internalDataPath;
+    platform_set_asset_source(state->activity->assetManager);
 
     if (state->savedState != nullptr) {
         // We are starting with a previous saved state; restore from it.
@@ -159,6 +193,26 @@ void android_main(struct android_app* state) {
         engine.state.counter = 0;
     }
 
+    // Pace to 60 Hz until the driver tells us the real refresh rate.
+    engine.target_hz = 60.0f;
+    engine.display_hz = 60.0f;
+    // and keep the main pass inside that frame, with room for the upscale
+    engine.gpu_budget_ms = 14.0f;
+
+    // The glue thread becomes worker 0 and runs jobs while it waits.
+    struct job_system jobs{};
+    job_system_init(&jobs, 0);
+    engine.jobs = &jobs;
+    PROFILE_THREAD("main");
+
+#if ENGINE_PROFILE
+    // Profiling builds trace the first frames; fetch the result with
+    // adb shell run-as <package> cat files/trace.json
+    const int trace_frames = 600;
+    int traced_frames = 0;
+    profiler_begin_capture(1u << 20);
+#endif
+
     // loop waiting for stuff to do.
 
     while (true)
@@ -181,15 +235,24 @@ void android_main(struct android_app* state) {
             // Check if we are exiting.
             if (state->destroyRequested != 0) {
                 engine_destroy(&engine);
+                job_system_shutdown(&jobs);
                 return;
             }
         }
 
         if (engine.animating)
         {
-            // Drawing is throttled to the screen update rate, so there
-            // is no need to do timing here.
+            // engine_draw paces itself to the target rate; on top of that
+            // the FIFO swapchain and per-frame fences bound queued frames.
             engine_draw(&engine);
+            PROFILE_FRAME();
+#if ENGINE_PROFILE
+            if (++traced_frames == trace_frames) {
+                char path[512];
+                snprintf(path, sizeof(path), "%s/trace.json", state->activity->internalDataPath);
+                profiler_end_capture(path);
+            }
+#endif
         }
     }
 }
@@ -0,0 +1,284 @@
+#include "memory.h"
+
+#include <cstdlib>
+#include <new>
+
+#include "log.h"
+
+static std::atomic<uint64_t> heap_allocations{0};
+static std::atomic<uint64_t> heap_frees{0};
+
+static inline size_t align_up(size_t value, size_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+int arena_init(struct arena* arena, size_t size) {
+    arena->base = (uint8_t*)malloc(size);
+    if (arena->base == nullptr) {
+        LOGE("arena: failed to reserve %zu bytes", size);
+        return -1;
+    }
+    arena->size = size;
+    arena->offset.store(0, std::memory_order_relaxed);
+    arena->high_water = 0;
+    arena->failed.store(0, std::memory_order_relaxed);
+    return 0;
+}
+
+void arena_destroy(struct arena* arena) {
+    free(arena->base);
+    arena->base = nullptr;
+    arena->size = 0;
+    arena->offset.store(0, std::memory_order_relaxed);
+}
+
+void* arena_alloc(struct arena* arena, size_t size, size_t align) {
+    size_t offset = arena->offset.load(std::memory_order_relaxed);
+    size_t begin;
+    do {
+        begin = align_up((size_t)arena->base + offset, align) - (size_t)arena->base;
+        if (begin + size > arena->size) {
+            arena->failed.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+    } while (!arena->offset.compare_exchange_weak(offset, begin + size,
+                                                  std::memory_order_relaxed));
+    return arena->base + begin;
+}
+
+void arena_reset(struct arena* arena) {
+    size_t used = arena->offset.load(std::memory_order_relaxed);
+    if (used > arena->high_water) {
+        arena->high_water = used;
+    }
+    uint32_t failed = arena->failed.exchange(0, std::memory_order_relaxed);
+    if (failed != 0) {
+        LOGW("arena: %u allocations failed, %zu bytes is too small", failed, arena->size);
+    }
+    arena->offset.store(0, std::memory_order_relaxed);
+}
+
+int frame_memory_init(struct frame_memory* memory, size_t arena_size) {
+    for (struct arena& arena : memory->arenas) {
+        if (arena_init(&arena, arena_size) != 0) {
+            return -1;
+        }
+    }
+    memory->current = 0;
+    return 0;
+}
+
+void frame_memory_destroy(struct frame_memory* memory) {
+    for (struct arena& arena : memory->arenas) {
+        arena_destroy(&arena);
+    }
+}
+
+void frame_memory_begin(struct frame_memory* memory, uint64_t frame_index) {
+    memory->current = (uint32_t)(frame_index % FRAME_ARENA_COUNT);
+    arena_reset(&memory->arenas[memory->current]);
+}
+
+int pool_init(struct pool* pool, size_t object_size, uint32_t capacity) {
+    pool->object_size = align_up(object_size < sizeof(void*) ? sizeof(void*) : object_size,
+                                 alignof(std::max_align_t));
+    pool->memory = (uint8_t*)malloc(pool->object_size * capacity);
+    if (pool->memory == nullptr) {
+        return -1;
+    }
+    pool->capacity = capacity;
+    pool->used = 0;
+    // thread the free list through the objects, lowest address first
+    pool->free_list = nullptr;
+    for (uint32_t i = capacity; i-- > 0;) {
+        void* object = pool->memory + i * pool->object_size;
+        *(void**)object = pool->free_list;
+        pool->free_list = object;
+    }
+    return 0;
+}
+
+void pool_destroy(struct pool* pool) {
+    free(pool->memory);
+    *pool = {};
+}
+
+void* pool_alloc(struct pool* pool) {
+    void* object = pool->free_list;
+    if (object != nullptr) {
+        pool->free_list = *(void**)object;
+        pool->used++;
+    }
+    return object;
+}
+
+void pool_free(struct pool* pool, void* object) {
+    if (object == nullptr) {
+        return;
+    }
+    *(void**)object = pool->free_list;
+    pool->free_list = object;
+    pool->used--;
+}
+
+/**
+ * Lazily reserved on first use by each thread, released at thread exit.
+ */
+struct scratch_arena {
+    uint8_t* base = nullptr;
+    size_t offset = 0;
+
+    ~scratch_arena() {
+        free(base);
+    }
+};
+
+static thread_local struct scratch_arena scratch;
+
+size_t scratch_mark() {
+    return scratch.offset;
+}
+
+void* scratch_alloc(size_t size, size_t align) {
+    if (scratch.base == nullptr) {
+        scratch.base = (uint8_t*)malloc(SCRATCH_ARENA_SIZE);
+        if (scratch.base == nullptr) {
+            return nullptr;
+        }
+    }
+    size_t begin = align_up((size_t)scratch.base + scratch.offset, align) - (size_t)scratch.base;
+    if (begin + size > SCRATCH_ARENA_SIZE) {
+        LOGW("scratch: %zu byte allocation does not fit", size);
+        return nullptr;
+    }
+    scratch.offset = begin + size;
+    return scratch.base + begin;
+}
+
+void scratch_release(size_t mark) {
+    scratch.offset = mark;
+}
+
+struct heap_counters memory_heap_counters() {
+    struct heap_counters counters;
+    counters.allocations = heap_allocations.load(std::memory_order_relaxed);
+    counters.frees = heap_frees.load(std::memory_order_relaxed);
+    return counters;
+}
+
+// Counting replacements for the global allocation functions. Anything in the
+// engine that goes through new/delete (containers included) shows up here.
+
+static void* counted_alloc(size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size != 0 ? size : 1);
+    if (p == nullptr) {
+        LOGE("out of memory allocating %zu bytes", size);
+        abort();
+    }
+    return p;
+}
+
+// over-aligned types (alignas(64) BVH nodes, cache-line padded rings)
+// come through the std::align_val_t overloads
+static void* counted_alloc_aligned(size_t size, size_t align, bool abort_on_failure) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = nullptr;
+    if (posix_memalign(&p, align > sizeof(void*) ? align : sizeof(void*), size != 0 ? size : 1) != 0) {
+        p = nullptr;
+    }
+    if (p == nullptr && abort_on_failure) {
+        LOGE("out of memory allocating %zu bytes aligned to %zu", size, align);
+        abort();
+    }
+    return p;
+}
+
+static void counted_free(void* p) {
+    if (p != nullptr) {
+        heap_frees.fetch_add(1, std::memory_order_relaxed);
+        free(p);
+    }
+}
+
+void* operator new(size_t size) {
+    return counted_alloc(size);
+}
+
+void* operator new[](size_t size) {
+    return counted_alloc(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size != 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size != 0 ? size : 1);
+}
+
+void operator delete(void* p) noexcept {
+    counted_free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    counted_free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    counted_free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    counted_free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    counted_free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    counted_free(p);
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+    return counted_alloc_aligned(size, (size_t)align, true);
+}
+
+void* operator new[](size_t size, std::align_val_t align) {
+    return counted_alloc_aligned(size, (size_t)align, true);
+}
+
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return counted_alloc_aligned(size, (size_t)align, false);
+}
+
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return counted_alloc_aligned(size, (size_t)align, false);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    counted_free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    counted_free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    counted_free(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+    counted_free(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    counted_free(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    counted_free(p);
+}
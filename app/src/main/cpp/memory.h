@@ -0,0 +1,112 @@
+#ifndef ENGINE_MEMORY_H
+#define ENGINE_MEMORY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#define FRAME_ARENA_SIZE (4u << 20)
+#define SCRATCH_ARENA_SIZE (1u << 20)
+// at least as many as frames can be in flight (see renderer.h)
+#define FRAME_ARENA_COUNT 3
+
+/**
+ * Bump allocator over one fixed block. Allocation is a lock-free pointer
+ * bump so jobs can share an arena; memory is only released by a reset.
+ */
+struct arena {
+    uint8_t* base;
+    size_t size;
+    std::atomic<size_t> offset;
+    size_t high_water;
+    // allocations that did not fit, counted by whichever job hit the end
+    std::atomic<uint32_t> failed;
+};
+
+int arena_init(struct arena* arena, size_t size);
+
+void arena_destroy(struct arena* arena);
+
+/**
+ * Returns nullptr when the arena is exhausted.
+ */
+void* arena_alloc(struct arena* arena, size_t size, size_t align = 16);
+
+void arena_reset(struct arena* arena);
+
+template <typename T>
+T* arena_alloc_array(struct arena* arena, size_t count) {
+    return (T*)arena_alloc(arena, sizeof(T) * count, alignof(T) > 16 ? alignof(T) : 16);
+}
+
+/**
+ * One arena per frame slot. Memory handed out during frame N stays valid
+ * until frame N + FRAME_ARENA_COUNT begins, so data produced for a frame
+ * can still be read while the next one is simulated.
+ */
+struct frame_memory {
+    struct arena arenas[FRAME_ARENA_COUNT];
+    uint32_t current;
+};
+
+int frame_memory_init(struct frame_memory* memory, size_t arena_size);
+
+void frame_memory_destroy(struct frame_memory* memory);
+
+/**
+ * Reset and select the arena for frame_index.
+ */
+void frame_memory_begin(struct frame_memory* memory, uint64_t frame_index);
+
+inline struct arena* frame_arena(struct frame_memory* memory) {
+    return &memory->arenas[memory->current];
+}
+
+/**
+ * Fixed-size object pool with an intrusive free list. Not thread-safe;
+ * each pool belongs to one subsystem/thread.
+ */
+struct pool {
+    uint8_t* memory;
+    size_t object_size;
+    uint32_t capacity;
+    uint32_t used;
+    void* free_list;
+};
+
+int pool_init(struct pool* pool, size_t object_size, uint32_t capacity);
+
+void pool_destroy(struct pool* pool);
+
+/**
+ * Returns nullptr when the pool is full.
+ */
+void* pool_alloc(struct pool* pool);
+
+void pool_free(struct pool* pool, void* object);
+
+/**
+ * Per-thread scratch memory with stack discipline:
+ *     size_t mark = scratch_mark();
+ *     float* tmp = (float*)scratch_alloc(n * sizeof(float));
+ *     ...
+ *     scratch_release(mark);
+ */
+size_t scratch_mark();
+
+void* scratch_alloc(size_t size, size_t align = 16);
+
+void scratch_release(size_t mark);
+
+/**
+ * Calls to global operator new/delete since startup. The engine reads these
+ * around a frame to prove steady-state frames stay off the general heap.
+ */
+struct heap_counters {
+    uint64_t allocations;
+    uint64_t frees;
+};
+
+struct heap_counters memory_heap_counters();
+
+#endif // ENGINE_MEMORY_H
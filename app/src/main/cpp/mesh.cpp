@@ -0,0 +1,141 @@
+#include "mesh.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "log.h"
+#include "mesh_shader.h"
+
+static_assert(MESH_VERTEX_STRIDE == sizeof(struct mesh_vertex), "mesh.vert inputs must match struct mesh_vertex");
+static_assert(MESH_COLOR_OUTPUTS == 1, "meshes draw into the main pass");
+
+int mesh_parse(const void* data, size_t size, struct mesh_data* mesh) {
+    if (size < sizeof(struct mesh_header)) {
+        LOGE("mesh: %zu bytes is too small", size);
+        return -1;
+    }
+    const auto* header = (const struct mesh_header*)data;
+    if (header->magic != MESH_MAGIC || header->version != MESH_VERSION) {
+        LOGE("mesh: bad magic or version %u", header->version);
+        return -1;
+    }
+    VkIndexType index_type = header->vertex_count > 65536 ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+    size_t index_size = index_type == VK_INDEX_TYPE_UINT32 ? 4 : 2;
+    uint64_t vertices_end = header->vertex_offset + (uint64_t)header->vertex_count * sizeof(struct mesh_vertex);
+    uint64_t indices_end = header->index_offset + (uint64_t)header->index_count * index_size;
+    uint64_t lods_end = header->lod_offset + (uint64_t)header->lod_count * sizeof(struct mesh_lod);
+    if (header->vertex_offset % 4 != 0 || header->index_offset % 4 != 0 || header->lod_offset % 4 != 0 ||
+        vertices_end > size || indices_end > size || lods_end > size || header->index_count % 3 != 0 ||
+        header->lod_count == 0 || header->lod_count > MESH_MAX_LODS) {
+        LOGE("mesh: %u vertices, %u indices and %u LODs do not fit in %zu bytes", header->vertex_count,
+             header->index_count, header->lod_count, size);
+        return -1;
+    }
+    const auto* lods = (const struct mesh_lod*)((const uint8_t*)data + header->lod_offset);
+    for (uint32_t i = 0; i < header->lod_count; i++) {
+        if ((uint64_t)lods[i].first_index + lods[i].index_count > header->index_count ||
+            lods[i].index_count % 3 != 0 || (i > 0 && lods[i].error < lods[i - 1].error)) {
+            LOGE("mesh: LOD %u (%u indices from %u, error %g) is out of range or order", i, lods[i].index_count,
+                 lods[i].first_index, (double)lods[i].error);
+            return -1;
+        }
+    }
+    mesh->header = header;
+    mesh->vertices = (const struct mesh_vertex*)((const uint8_t*)data + header->vertex_offset);
+    mesh->indices = (const uint8_t*)data + header->index_offset;
+    mesh->index_type = index_type;
+    mesh->vertex_count = header->vertex_count;
+    mesh->index_count = header->index_count;
+    mesh->lods = lods;
+    mesh->lod_count = header->lod_count;
+    return 0;
+}
+
+int mesh_load(const struct asset_pack* pack, const char* name, struct mesh_data* mesh) {
+    size_t size;
+    const void* data = asset_pack_get(pack, name, ASSET_MESH, &size);
+    if (data == nullptr) {
+        return -1;
+    }
+    if (mesh_parse(data, size, mesh) != 0) {
+        LOGE("mesh %s is not a mesh built by build_mesh.py", name);
+        return -1;
+    }
+    return 0;
+}
+
+static float half_to_float(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    float value;
+    if (exponent == 0) {
+        value = ldexpf((float)mantissa, -24);
+    } else if (exponent == 31) {
+        value = mantissa != 0 ? NAN : INFINITY;
+    } else {
+        value = ldexpf((float)(mantissa | 0x400), (int)exponent - 25);
+    }
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits |= sign;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static float snorm16_to_float(int16_t v) {
+    return fmaxf((float)v / 32767.0f, -1.0f);
+}
+
+struct vec3 mesh_decode_position(const struct mesh_data* mesh, uint32_t vertex) {
+    const struct mesh_header* h = mesh->header;
+    const uint16_t* p = mesh->vertices[vertex].position;
+    return { h->position_center[0] + half_to_float(p[0]) * h->position_extent[0],
+             h->position_center[1] + half_to_float(p[1]) * h->position_extent[1],
+             h->position_center[2] + half_to_float(p[2]) * h->position_extent[2] };
+}
+
+struct vec3 mesh_decode_normal(const struct mesh_data* mesh, uint32_t vertex) {
+    const int16_t* e = mesh->vertices[vertex].normal;
+    struct vec3 n = { snorm16_to_float(e[0]), snorm16_to_float(e[1]), 0.0f };
+    n.z = 1.0f - fabsf(n.x) - fabsf(n.y);
+    float t = fmaxf(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return vec3_normalize(n);
+}
+
+uint32_t mesh_lod_select(const struct mesh_lod* lods, uint32_t lod_count, uint32_t current, float pixels_per_unit,
+                         float threshold, float hysteresis) {
+    if (lod_count == 0) {
+        return 0;
+    }
+    uint32_t lod = current < lod_count ? current : lod_count - 1;
+    if (lods[lod].error * pixels_per_unit > threshold * (1.0f + hysteresis)) {
+        while (lod > 0 && lods[lod].error * pixels_per_unit > threshold) {
+            lod--;
+        }
+        return lod;
+    }
+    while (lod + 1 < lod_count && lods[lod + 1].error * pixels_per_unit <= threshold * (1.0f - hysteresis)) {
+        lod++;
+    }
+    return lod;
+}
+
+void mesh_push_constants(const struct mesh_data* mesh, const struct mat4* view_proj, const struct mat4* model,
+                         struct mesh_push_constants* push) {
+    const struct mesh_header* h = mesh->header;
+    struct vec3 center = { h->position_center[0], h->position_center[1], h->position_center[2] };
+    struct vec3 extent = { h->position_extent[0], h->position_extent[1], h->position_extent[2] };
+    struct mat4 dequantize = mat4_from_trs(center, quat_identity(), extent);
+    struct mat4 model_from_mesh = mat4_mul(model, &dequantize);
+    push->clip_from_mesh = mat4_mul(view_proj, &model_from_mesh);
+    // columns of inverse(model)^T are the rows of inverse(model)
+    struct mat4 inverse = mat4_inverse(model);
+    struct mat4 normal_matrix = mat4_transpose(&inverse);
+    for (int i = 0; i < 3; i++) {
+        push->normal_matrix[i] = normal_matrix.cols[i];
+    }
+    push->uv_transform = { h->uv_offset[0], h->uv_offset[1], h->uv_scale[0], h->uv_scale[1] };
+}
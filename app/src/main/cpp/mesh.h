@@ -0,0 +1,129 @@
+#ifndef ENGINE_MESH_H
+#define ENGINE_MESH_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "asset_pack.h"
+#include "vecmath.h"
+
+/**
+ * Mesh asset, written by tools/build_mesh.py with triangles already
+ * ordered for the vertex cache and overdraw, and vertices in first-use
+ * order:
+ *
+ *     mesh_header
+ *     mesh_lod[lod_count]           at lod_offset, finest first
+ *     mesh_vertex[vertex_count]     at vertex_offset
+ *     indices[index_count]          at index_offset, 16 bit unless there
+ *                                   are more than 65536 vertices
+ *
+ * LOD 0 is the input mesh, the others are simplified from it and index
+ * the same vertices, each a range of the index buffer. Vertices are
+ * numbered coarsest LOD first, so the vertices of every LOD are a prefix
+ * of the vertex buffer.
+ *
+ * Vertices are quantized to 20 bytes. Positions are half floats in [-1, 1]
+ * across the mesh's bounding box, normals and tangents octahedral snorm16
+ * pairs, uvs unorm16 across the mesh's uv range; shaders/mesh.vert decodes
+ * them with the bounds passed as push constants. All fields are
+ * little-endian.
+ */
+#define MESH_MAGIC 0x48534d45u // "EMSH"
+#define MESH_VERSION 2u
+#define MESH_MAX_LODS 8
+
+struct mesh_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    // position = center + encoded * extent
+    float position_center[3];
+    float position_extent[3];
+    // uv = offset + encoded * scale
+    float uv_offset[2];
+    float uv_scale[2];
+    uint32_t vertex_offset;
+    uint32_t index_offset;
+    uint32_t lod_count;
+    uint32_t lod_offset;
+    uint32_t reserved[2];
+};
+
+struct mesh_lod {
+    uint32_t first_index;
+    uint32_t index_count;
+    // how far the LOD's surface strays from the input's, in mesh units
+    float error;
+    uint32_t reserved;
+};
+
+struct mesh_vertex {
+    // half floats: xyz across the bounds, w the bitangent sign (+-1)
+    uint16_t position[4];
+    int16_t normal[2];
+    int16_t tangent[2];
+    uint16_t uv[2];
+};
+
+static_assert(sizeof(struct mesh_header) == 80, "header layout is part of the file format");
+static_assert(sizeof(struct mesh_lod) == 16, "LOD layout is part of the file format");
+static_assert(sizeof(struct mesh_vertex) == 20, "vertex layout is part of the file format");
+
+/**
+ * A parsed mesh asset, pointing into the asset's memory.
+ */
+struct mesh_data {
+    const struct mesh_header* header;
+    const struct mesh_vertex* vertices;
+    const void* indices;
+    VkIndexType index_type;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    const struct mesh_lod* lods;
+    uint32_t lod_count;
+};
+
+/**
+ * Validate a mesh asset of size bytes and point mesh into it. Returns 0
+ * on success.
+ */
+int mesh_parse(const void* data, size_t size, struct mesh_data* mesh);
+
+/**
+ * Find and parse a mesh in the pack; the data stays in the mapping.
+ */
+int mesh_load(const struct asset_pack* pack, const char* name, struct mesh_data* mesh);
+
+/**
+ * CPU side of the decode shaders/mesh.vert does, for tools and checks.
+ */
+struct vec3 mesh_decode_position(const struct mesh_data* mesh, uint32_t vertex);
+struct vec3 mesh_decode_normal(const struct mesh_data* mesh, uint32_t vertex);
+
+/**
+ * LOD to draw an instance with, where one unit of the mesh covers
+ * pixels_per_unit pixels on screen (the projection's focal length in
+ * pixels over view depth, times the instance's scale): the coarsest whose
+ * error projects to at most threshold pixels. current is the instance's
+ * LOD last frame. It is kept until the projected error crosses the
+ * threshold by hysteresis (a fraction of it), so instances near a switch
+ * point do not pop back and forth. 0 when there are no LODs.
+ */
+uint32_t mesh_lod_select(const struct mesh_lod* lods, uint32_t lod_count, uint32_t current, float pixels_per_unit,
+                         float threshold, float hysteresis);
+
+struct mesh_push_constants;
+
+/**
+ * Push constants (from the generated mesh_shader.h) drawing mesh with the
+ * given model and view_proj; the dequantization is folded into the clip
+ * space matrix.
+ */
+void mesh_push_constants(const struct mesh_data* mesh, const struct mat4* view_proj, const struct mat4* model,
+                         struct mesh_push_constants* push);
+
+#endif // ENGINE_MESH_H
@@ -0,0 +1,112 @@
+#include "pipeline_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static bool read_file(const char* path, std::vector<uint8_t>* data) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    bool ok = size > 0;
+    if (ok) {
+        data->resize((size_t)size);
+        ok = fread(data->data(), 1, data->size(), file) == data->size();
+    }
+    fclose(file);
+    return ok;
+}
+
+// FNV-1a, enough to tell whether the cache changed since it was saved
+static uint64_t data_hash(const uint8_t* data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/**
+ * Some drivers crash, rather than fail, on a cache from another driver
+ * version, so check the header ourselves. Layout (version one): header
+ * size, header version, vendor id, device id, pipeline cache UUID.
+ */
+static bool header_matches(const struct vk_context* vk, const std::vector<uint8_t>& data) {
+    const size_t header_size = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+    if (data.size() < header_size) {
+        return false;
+    }
+    uint32_t fields[4];
+    memcpy(fields, data.data(), sizeof(fields));
+    return fields[0] >= header_size && fields[0] <= data.size() &&
+           fields[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           fields[2] == vk->properties.vendorID &&
+           fields[3] == vk->properties.deviceID &&
+           memcmp(data.data() + sizeof(fields), vk->properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+int pipeline_cache_create(struct vk_context* vk, const char* path, size_t* loaded_bytes) {
+    std::vector<uint8_t> data;
+    *loaded_bytes = 0;
+    if (path != nullptr && read_file(path, &data)) {
+        if (header_matches(vk, data)) {
+            *loaded_bytes = data.size();
+        } else {
+            LOGW("pipeline cache %s is from another device or driver, ignoring it", path);
+        }
+    }
+
+    VkPipelineCacheCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    info.initialDataSize = *loaded_bytes;
+    info.pInitialData = *loaded_bytes > 0 ? data.data() : nullptr;
+    VkResult result = vkCreatePipelineCache(vk->device, &info, nullptr, &vk->pipeline_cache);
+    if (result != VK_SUCCESS && *loaded_bytes > 0) {
+        // the driver rejected the blob after all; start empty
+        LOGW("vkCreatePipelineCache rejected %s: %d", path, (int)result);
+        *loaded_bytes = 0;
+        info.initialDataSize = 0;
+        info.pInitialData = nullptr;
+        result = vkCreatePipelineCache(vk->device, &info, nullptr, &vk->pipeline_cache);
+    }
+    VK_CHECK(result);
+    vk->pipeline_cache_saved_hash = data_hash(data.data(), *loaded_bytes);
+    return 0;
+}
+
+int pipeline_cache_save(struct vk_context* vk, const char* path) {
+    if (vk->pipeline_cache == VK_NULL_HANDLE || path == nullptr) {
+        return 0;
+    }
+    size_t size = 0;
+    VK_CHECK(vkGetPipelineCacheData(vk->device, vk->pipeline_cache, &size, nullptr));
+    std::vector<uint8_t> data(size);
+    VK_CHECK(vkGetPipelineCacheData(vk->device, vk->pipeline_cache, &size, data.data()));
+    // the same size does not mean the same pipelines, so compare contents
+    uint64_t hash = data_hash(data.data(), size);
+    if (hash == vk->pipeline_cache_saved_hash) {
+        return 0;
+    }
+
+    char temp_path[512];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    FILE* file = fopen(temp_path, "wb");
+    if (file == nullptr) {
+        LOGE("cannot write pipeline cache %s", temp_path);
+        return -1;
+    }
+    bool ok = fwrite(data.data(), 1, size, file) == size;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(temp_path, path) != 0) {
+        LOGE("failed to save pipeline cache %s", path);
+        remove(temp_path);
+        return -1;
+    }
+    vk->pipeline_cache_saved_hash = hash;
+    LOGI("pipeline cache: saved %zu bytes to %s", size, path);
+    return 0;
+}
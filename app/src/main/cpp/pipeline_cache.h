@@ -0,0 +1,28 @@
+#ifndef ENGINE_PIPELINE_CACHE_H
+#define ENGINE_PIPELINE_CACHE_H
+
+#include <cstddef>
+
+#include "vk_context.h"
+
+/**
+ * Persistent VkPipelineCache. The cache blob is only trusted when its
+ * header matches this device and driver; otherwise pipelines are compiled
+ * from scratch and the blob is replaced on the next save.
+ */
+
+/**
+ * Create vk->pipeline_cache, seeded from the file at path when it is a
+ * valid cache for this device. loaded_bytes is set to the size of the
+ * seed, 0 on a cold start.
+ */
+int pipeline_cache_create(struct vk_context* vk, const char* path, size_t* loaded_bytes);
+
+/**
+ * Write vk->pipeline_cache to path, through a temporary file so a crash
+ * mid-write never leaves a truncated cache behind. Skipped when the cache
+ * is unchanged since it was loaded or last saved.
+ */
+int pipeline_cache_save(struct vk_context* vk, const char* path);
+
+#endif // ENGINE_PIPELINE_CACHE_H
@@ -0,0 +1,63 @@
+#ifndef ENGINE_PLATFORM_H
+#define ENGINE_PLATFORM_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+/**
+ * Thin layer between the engine core and the OS. Implemented by
+ * platform_android.cpp for the native activity and platform_linux.cpp
+ * for the headless host build.
+ */
+
+/**
+ * Monotonic clock in nanoseconds.
+ */
+int64_t platform_time_ns();
+
+/**
+ * Sleep until the monotonic clock reaches time_ns.
+ */
+void platform_sleep_until_ns(int64_t time_ns);
+
+/**
+ * Instance extensions needed to create a presentation surface.
+ */
+const char* const* platform_vk_instance_extensions(uint32_t* count);
+
+/**
+ * Create a presentation surface for the native window. The headless host
+ * ignores the window and creates a VK_EXT_headless_surface.
+ */
+VkResult platform_create_surface(VkInstance instance, void* window, VkSurfaceKHR* surface);
+
+/**
+ * Read-only view of a packaged asset. data/size cover the asset itself;
+ * base/length cover the page-aligned mapping around it.
+ */
+struct platform_mapping {
+    const void* data;
+    size_t size;
+    void* base;
+    size_t length;
+    // AAsset* kept open when the asset could not be mapped directly
+    void* handle;
+};
+
+/**
+ * Where platform_map_asset looks: the AAssetManager* on Android, a
+ * directory path on the host (the working directory when nullptr).
+ */
+void platform_set_asset_source(void* source);
+
+/**
+ * Map an asset read-only. The pages stay backed by the APK or file, so
+ * nothing is read until it is touched. Returns 0 on success.
+ */
+int platform_map_asset(const char* name, struct platform_mapping* mapping);
+
+void platform_unmap_asset(struct platform_mapping* mapping);
+
+#endif // ENGINE_PLATFORM_H
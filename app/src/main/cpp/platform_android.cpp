@@ -0,0 +1,106 @@
+#include "platform.h"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#include <android/asset_manager.h>
+#include <android/native_window.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vulkan/vulkan_android.h>
+
+#include "log.h"
+
+static AAssetManager* asset_manager = nullptr;
+
+int64_t platform_time_ns() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void platform_sleep_until_ns(int64_t time_ns) {
+    struct timespec ts{};
+    ts.tv_sec = (time_t)(time_ns / 1000000000LL);
+    ts.tv_nsec = (long)(time_ns % 1000000000LL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+}
+
+const char* const* platform_vk_instance_extensions(uint32_t* count) {
+    static const char* const extensions[] = {
+        VK_KHR_SURFACE_EXTENSION_NAME,
+        VK_KHR_ANDROID_SURFACE_EXTENSION_NAME,
+    };
+    *count = sizeof(extensions) / sizeof(extensions[0]);
+    return extensions;
+}
+
+VkResult platform_create_surface(VkInstance instance, void* window, VkSurfaceKHR* surface) {
+    VkAndroidSurfaceCreateInfoKHR info{};
+    info.sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR;
+    info.window = (ANativeWindow*)window;
+    return vkCreateAndroidSurfaceKHR(instance, &info, nullptr, surface);
+}
+
+void platform_set_asset_source(void* source) {
+    asset_manager = (AAssetManager*)source;
+}
+
+int platform_map_asset(const char* name, struct platform_mapping* mapping) {
+    *mapping = {};
+    if (asset_manager == nullptr) {
+        LOGE("asset %s: no asset manager", name);
+        return -1;
+    }
+    AAsset* asset = AAssetManager_open(asset_manager, name, AASSET_MODE_RANDOM);
+    if (asset == nullptr) {
+        LOGW("asset %s: not found", name);
+        return -1;
+    }
+    // Stored (uncompressed) assets are a byte range of the APK, which can
+    // be mapped straight from the APK's file descriptor.
+    off64_t start = 0;
+    off64_t length = 0;
+    int fd = AAsset_openFileDescriptor64(asset, &start, &length);
+    if (fd >= 0) {
+        long page = sysconf(_SC_PAGESIZE);
+        off64_t aligned = start & ~(off64_t)(page - 1);
+        size_t map_length = (size_t)(length + (start - aligned));
+        void* base = mmap64(nullptr, map_length, PROT_READ, MAP_PRIVATE, fd, aligned);
+        close(fd);
+        if (base != MAP_FAILED) {
+            AAsset_close(asset);
+            mapping->data = (const uint8_t*)base + (start - aligned);
+            mapping->size = (size_t)length;
+            mapping->base = base;
+            mapping->length = map_length;
+            return 0;
+        }
+        LOGW("asset %s: mmap failed: %s", name, strerror(errno));
+    } else {
+        LOGW("asset %s is compressed in the APK, add it to noCompress to map it", name);
+    }
+    // fall back to the asset manager's buffer, inflated into memory
+    const void* buffer = AAsset_getBuffer(asset);
+    if (buffer == nullptr) {
+        LOGE("asset %s: cannot read", name);
+        AAsset_close(asset);
+        return -1;
+    }
+    mapping->data = buffer;
+    mapping->size = (size_t)AAsset_getLength64(asset);
+    mapping->handle = asset;
+    return 0;
+}
+
+void platform_unmap_asset(struct platform_mapping* mapping) {
+    if (mapping->base != nullptr) {
+        munmap(mapping->base, mapping->length);
+    }
+    if (mapping->handle != nullptr) {
+        AAsset_close((AAsset*)mapping->handle);
+    }
+    *mapping = {};
+}
@@ -0,0 +1,89 @@
+#include "platform.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log.h"
+
+static const char* asset_directory = nullptr;
+
+int64_t platform_time_ns() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void platform_sleep_until_ns(int64_t time_ns) {
+    struct timespec ts{};
+    ts.tv_sec = (time_t)(time_ns / 1000000000LL);
+    ts.tv_nsec = (long)(time_ns % 1000000000LL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+}
+
+const char* const* platform_vk_instance_extensions(uint32_t* count) {
+    static const char* const extensions[] = {
+        VK_KHR_SURFACE_EXTENSION_NAME,
+        VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME,
+    };
+    *count = sizeof(extensions) / sizeof(extensions[0]);
+    return extensions;
+}
+
+VkResult platform_create_surface(VkInstance instance, void* /*window*/, VkSurfaceKHR* surface) {
+    auto create = (PFN_vkCreateHeadlessSurfaceEXT)
+            vkGetInstanceProcAddr(instance, "vkCreateHeadlessSurfaceEXT");
+    if (create == nullptr) {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+    VkHeadlessSurfaceCreateInfoEXT info{};
+    info.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+    return create(instance, &info, nullptr, surface);
+}
+
+void platform_set_asset_source(void* source) {
+    asset_directory = (const char*)source;
+}
+
+int platform_map_asset(const char* name, struct platform_mapping* mapping) {
+    *mapping = {};
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", asset_directory != nullptr ? asset_directory : ".", name);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOGW("asset %s: %s", path, strerror(errno));
+        return -1;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        LOGE("asset %s: empty or unreadable", path);
+        close(fd);
+        return -1;
+    }
+    void* base = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    close(fd);
+    if (base == MAP_FAILED) {
+        LOGE("asset %s: mmap failed: %s", path, strerror(errno));
+        return -1;
+    }
+    mapping->data = base;
+    mapping->size = (size_t)st.st_size;
+    mapping->base = base;
+    mapping->length = (size_t)st.st_size;
+    return 0;
+}
+
+void platform_unmap_asset(struct platform_mapping* mapping) {
+    if (mapping->base != nullptr) {
+        munmap(mapping->base, mapping->length);
+    }
+    *mapping = {};
+}
@@ -0,0 +1,249 @@
+#include "profiler.h"
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "log.h"
+#include "platform.h"
+#include "spsc_ring.h"
+
+std::atomic<int> profiler_capturing{0};
+
+enum profile_event_type : uint32_t {
+    PROFILE_EVENT_ZONE,
+    PROFILE_EVENT_COUNTER,
+    PROFILE_EVENT_FRAME,
+};
+
+struct profile_event {
+    const char* name;
+    uint64_t begin;
+    union {
+        uint64_t end;
+        double value;
+    };
+    uint32_t type;
+    uint32_t thread;
+};
+
+struct profiler_thread {
+    struct spsc_ring<struct profile_event, PROFILER_RING_CAPACITY> ring;
+    uint32_t id;
+    char name[32];
+    std::atomic<uint32_t> dropped{0};
+};
+
+struct profiler_state {
+    std::mutex mutex;
+    struct profiler_thread* threads[PROFILER_MAX_THREADS];
+    std::atomic<uint32_t> thread_count{0};
+    std::vector<struct profile_event> capture;
+    uint32_t max_events;
+    uint32_t frame;
+    uint64_t start_ticks;
+    int64_t start_ns;
+};
+
+static struct profiler_state profiler;
+static thread_local struct profiler_thread* tls_thread = nullptr;
+static thread_local char tls_thread_name[32];
+
+uint64_t profiler_ticks_fallback() {
+    return (uint64_t)platform_time_ns();
+}
+
+/**
+ * Ring for the calling thread, created on its first event. Threads beyond
+ * PROFILER_MAX_THREADS are not recorded.
+ */
+static struct profiler_thread* profiler_thread_get() {
+    if (tls_thread != nullptr) {
+        return tls_thread;
+    }
+    std::lock_guard<std::mutex> lock(profiler.mutex);
+    uint32_t id = profiler.thread_count.load(std::memory_order_relaxed);
+    if (id == PROFILER_MAX_THREADS) {
+        return nullptr;
+    }
+    struct profiler_thread* thread = new profiler_thread();
+    thread->id = id;
+    if (tls_thread_name[0] != '\0') {
+        memcpy(thread->name, tls_thread_name, sizeof(thread->name));
+    } else {
+        snprintf(thread->name, sizeof(thread->name), "thread %u", id);
+    }
+    profiler.threads[id] = thread;
+    profiler.thread_count.store(id + 1, std::memory_order_release);
+    tls_thread = thread;
+    return thread;
+}
+
+static void profiler_push(struct profile_event* event) {
+    struct profiler_thread* thread = profiler_thread_get();
+    if (thread == nullptr) {
+        return;
+    }
+    event->thread = thread->id;
+    if (!spsc_push(&thread->ring, *event)) {
+        thread->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void profiler_zone(const char* name, uint64_t begin, uint64_t end) {
+    struct profile_event event;
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+    event.type = PROFILE_EVENT_ZONE;
+    profiler_push(&event);
+}
+
+void profiler_counter(const char* name, double value) {
+    if (!profiler_capturing.load(std::memory_order_relaxed)) {
+        return;
+    }
+    struct profile_event event;
+    event.name = name;
+    event.begin = profiler_ticks();
+    event.value = value;
+    event.type = PROFILE_EVENT_COUNTER;
+    profiler_push(&event);
+}
+
+/**
+ * Move every thread's pending events into the capture. The capture is the
+ * only consumer of the rings, so this holds the mutex.
+ */
+static void profiler_collect() {
+    uint32_t thread_count = profiler.thread_count.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < thread_count; i++) {
+        struct profiler_thread* thread = profiler.threads[i];
+        struct profile_event event;
+        while (spsc_pop(&thread->ring, &event)) {
+            if (profiler.capture.size() < profiler.max_events) {
+                profiler.capture.push_back(event);
+            } else {
+                thread->dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+void profiler_frame_mark() {
+    if (!profiler_capturing.load(std::memory_order_relaxed)) {
+        return;
+    }
+    struct profile_event event;
+    event.name = "frame";
+    event.begin = profiler_ticks();
+    event.end = 0;
+    event.type = PROFILE_EVENT_FRAME;
+    profiler_push(&event);
+
+    std::lock_guard<std::mutex> lock(profiler.mutex);
+    profiler.frame++;
+    profiler_collect();
+}
+
+void profiler_set_thread_name(const char* name) {
+    snprintf(tls_thread_name, sizeof(tls_thread_name), "%s", name);
+    if (tls_thread != nullptr) {
+        std::lock_guard<std::mutex> lock(profiler.mutex);
+        snprintf(tls_thread->name, sizeof(tls_thread->name), "%s", name);
+    }
+}
+
+void profiler_begin_capture(uint32_t max_events) {
+    std::lock_guard<std::mutex> lock(profiler.mutex);
+    // discard anything recorded by a previous capture that was not collected
+    profiler.max_events = 0;
+    profiler_collect();
+    profiler.capture.clear();
+    profiler.capture.reserve(max_events);
+    profiler.max_events = max_events;
+    profiler.frame = 0;
+    uint32_t thread_count = profiler.thread_count.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < thread_count; i++) {
+        profiler.threads[i]->dropped.store(0, std::memory_order_relaxed);
+    }
+    profiler.start_ticks = profiler_ticks();
+    profiler.start_ns = platform_time_ns();
+    profiler_capturing.store(1, std::memory_order_relaxed);
+}
+
+static void write_json_string(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+        }
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+int profiler_end_capture(const char* path) {
+    profiler_capturing.store(0, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(profiler.mutex);
+    profiler_collect();
+
+    // calibrate ticks against the monotonic clock over the whole capture
+    uint64_t end_ticks = profiler_ticks();
+    int64_t end_ns = platform_time_ns();
+    double us_per_tick = end_ticks > profiler.start_ticks
+                             ? (double)(end_ns - profiler.start_ns) / 1000.0 /
+                                   (double)(end_ticks - profiler.start_ticks)
+                             : 0.0;
+
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        LOGE("cannot open trace file %s", path);
+        return -1;
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    uint32_t thread_count = profiler.thread_count.load(std::memory_order_acquire);
+    uint64_t dropped = 0;
+    for (uint32_t i = 0; i < thread_count; i++) {
+        fprintf(file, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", i);
+        write_json_string(file, profiler.threads[i]->name);
+        fprintf(file, "}},\n");
+        dropped += profiler.threads[i]->dropped.load(std::memory_order_relaxed);
+    }
+    uint32_t frame = 0;
+    for (const struct profile_event& event : profiler.capture) {
+        if (event.begin < profiler.start_ticks) {
+            continue;
+        }
+        double ts = (double)(event.begin - profiler.start_ticks) * us_per_tick;
+        fprintf(file, "{\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":", event.thread, ts);
+        write_json_string(file, event.name);
+        switch (event.type) {
+            case PROFILE_EVENT_ZONE:
+                fprintf(file, ",\"ph\":\"X\",\"dur\":%.3f},\n",
+                        (double)(event.end - event.begin) * us_per_tick);
+                break;
+            case PROFILE_EVENT_COUNTER:
+                fprintf(file, ",\"ph\":\"C\",\"args\":{\"value\":%g}},\n", event.value);
+                break;
+            case PROFILE_EVENT_FRAME:
+                fprintf(file, ",\"ph\":\"i\",\"s\":\"g\",\"args\":{\"frame\":%u}},\n", frame++);
+                break;
+        }
+    }
+    // closing metadata event so every entry above can end in a comma
+    fprintf(file, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":\"engine\"}}\n]}\n");
+    int result = ferror(file) ? -1 : 0;
+    fclose(file);
+    if (result != 0) {
+        LOGE("failed writing trace file %s", path);
+        return -1;
+    }
+
+    LOGI("trace: %zu events over %u frames written to %s (%llu dropped)", profiler.capture.size(),
+         profiler.frame, path, (unsigned long long)dropped);
+    profiler.capture.clear();
+    profiler.capture.shrink_to_fit();
+    return 0;
+}
@@ -0,0 +1,100 @@
+#ifndef ENGINE_PROFILER_H
+#define ENGINE_PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * CPU profiler. Zones, counters and frame markers go into a per-thread
+ * lock-free ring; once per frame the main thread moves them into the
+ * capture buffer, which is written out as Chrome trace-event JSON (opens in
+ * chrome://tracing and ui.perfetto.dev).
+ *
+ * The macros compile to nothing unless ENGINE_PROFILE is defined (it is in
+ * debug builds). Zone names must be string literals.
+ */
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#if ENGINE_PROFILE
+#define PROFILE_SCOPE(name) struct profile_scope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_FRAME() profiler_frame_mark()
+#define PROFILE_COUNTER(name, value) profiler_counter(name, (double)(value))
+#define PROFILE_THREAD(name) profiler_set_thread_name(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
+
+#define PROFILER_RING_CAPACITY (1u << 14)
+#define PROFILER_MAX_THREADS 32
+
+extern std::atomic<int> profiler_capturing;
+
+uint64_t profiler_ticks_fallback();
+
+/**
+ * Raw timestamp, converted to time only at export. The cycle counters are
+ * several times cheaper than clock_gettime.
+ */
+static inline uint64_t profiler_ticks() {
+#if defined(__aarch64__)
+    uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#elif defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return profiler_ticks_fallback();
+#endif
+}
+
+void profiler_zone(const char* name, uint64_t begin, uint64_t end);
+
+void profiler_counter(const char* name, double value);
+
+/**
+ * Emitted once per frame by the platform main loop. Also moves every
+ * thread's events into the capture.
+ */
+void profiler_frame_mark();
+
+/**
+ * Label the calling thread in the trace. The name is copied.
+ */
+void profiler_set_thread_name(const char* name);
+
+/**
+ * Start recording, keeping at most max_events.
+ */
+void profiler_begin_capture(uint32_t max_events);
+
+/**
+ * Stop recording and write the capture as Chrome trace JSON. Returns 0 on
+ * success.
+ */
+int profiler_end_capture(const char* path);
+
+struct profile_scope {
+    const char* name;
+    uint64_t begin;
+
+    explicit profile_scope(const char* zone_name) {
+        name = profiler_capturing.load(std::memory_order_relaxed) ? zone_name : nullptr;
+        begin = name != nullptr ? profiler_ticks() : 0;
+    }
+
+    ~profile_scope() {
+        if (name != nullptr) {
+            profiler_zone(name, begin, profiler_ticks());
+        }
+    }
+};
+
+#endif // ENGINE_PROFILER_H
@@ -0,0 +1,1057 @@
+#include "render_graph.h"
+
+#include <algorithm>
+
+#include "profiler.h"
+
+static const VkAccessFlags WRITE_ACCESS = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                          VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+struct access_info {
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    VkImageLayout layout;
+    VkImageUsageFlags usage;
+    int write;
+    int attachment;
+};
+
+static struct access_info access_info(enum rg_access access) {
+    const VkPipelineStageFlags fragment_tests = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                                VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    switch (access) {
+        case RG_COLOR_ATTACHMENT:
+            return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                     VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                     VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 1, 1 };
+        case RG_DEPTH_ATTACHMENT:
+            return { fragment_tests,
+                     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                     VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                     VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 1, 1 };
+        case RG_DEPTH_READ:
+            return { fragment_tests, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                     VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                     VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0, 1 };
+        case RG_INPUT_ATTACHMENT:
+            return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
+                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, 0, 1 };
+        case RG_SAMPLED:
+            return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, 0, 0 };
+        case RG_STORAGE_READ:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                     VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, 0, 0 };
+        case RG_STORAGE_WRITE:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                     VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, 1, 0 };
+        case RG_TRANSFER_SRC:
+            return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, 0, 0 };
+        case RG_TRANSFER_DST:
+            return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, 1, 0 };
+    }
+    return {};
+}
+
+static VkImageAspectFlags format_aspect(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+static uint32_t format_bytes(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_R8_UNORM:
+            return 1;
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_R16_SFLOAT:
+            return 2;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return 8;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            return 16;
+        default:
+            return 4;
+    }
+}
+
+static struct access_info use_info(const struct render_graph* graph, const struct rg_pass* pass,
+                                   const struct rg_use* use) {
+    struct access_info info = access_info(use->access);
+    if (use->access == RG_INPUT_ATTACHMENT &&
+        format_aspect(graph->resources[use->resource].format) != VK_IMAGE_ASPECT_COLOR_BIT) {
+        info.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    }
+    // compute passes sample in the compute shader
+    if (use->access == RG_SAMPLED && pass->type == RG_COMPUTE) {
+        info.stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    }
+    return info;
+}
+
+static VkDeviceSize image_bytes(const struct rg_resource* resource) {
+    return (VkDeviceSize)resource->width * resource->height * format_bytes(resource->format);
+}
+
+void render_graph_reset(struct render_graph* graph) {
+    graph->resource_count = 0;
+    graph->pass_count = 0;
+    graph->barrier_count = 0;
+    graph->final_barrier_count = 0;
+    graph->stats = {};
+}
+
+uint32_t rg_import_image(struct render_graph* graph, const char* name, VkFormat format,
+                         uint32_t width, uint32_t height, VkImageLayout initial_layout,
+                         VkPipelineStageFlags initial_stages) {
+    uint32_t index = rg_create_image(graph, name, format, width, height);
+    struct rg_resource* resource = &graph->resources[index];
+    resource->imported = 1;
+    resource->initial_layout = initial_layout;
+    resource->initial_stages = initial_stages;
+    return index;
+}
+
+uint32_t rg_create_image(struct render_graph* graph, const char* name, VkFormat format,
+                         uint32_t width, uint32_t height, VkImageUsageFlags usage) {
+    if (graph->resource_count == RG_MAX_RESOURCES) {
+        LOGE("render graph: more than %d resources", RG_MAX_RESOURCES);
+        return RG_NONE;
+    }
+    struct rg_resource* resource = &graph->resources[graph->resource_count];
+    *resource = {};
+    resource->name = name;
+    resource->format = format;
+    resource->width = width;
+    resource->height = height;
+    resource->usage = usage;
+    resource->initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    return graph->resource_count++;
+}
+
+void rg_mark_output(struct render_graph* graph, uint32_t resource, VkImageLayout final_layout) {
+    graph->resources[resource].output = 1;
+    graph->resources[resource].final_layout = final_layout;
+}
+
+uint32_t rg_add_pass(struct render_graph* graph, const char* name, enum rg_pass_type type,
+                     rg_execute_func execute, void* data) {
+    if (graph->pass_count == RG_MAX_PASSES) {
+        LOGE("render graph: more than %d passes", RG_MAX_PASSES);
+        return RG_NONE;
+    }
+    struct rg_pass* pass = &graph->passes[graph->pass_count];
+    *pass = {};
+    pass->name = name;
+    pass->type = type;
+    pass->execute = execute;
+    pass->data = data;
+    pass->contents = VK_SUBPASS_CONTENTS_INLINE;
+    return graph->pass_count++;
+}
+
+void rg_use(struct render_graph* graph, uint32_t pass_index, uint32_t resource, enum rg_access access,
+            const VkClearValue* clear) {
+    struct rg_pass* pass = &graph->passes[pass_index];
+    if (pass->use_count == RG_MAX_PASS_USES || resource == RG_NONE) {
+        LOGE("render graph: pass %s: bad resource or more than %d uses", pass->name, RG_MAX_PASS_USES);
+        return;
+    }
+    struct rg_use* use = &pass->uses[pass->use_count++];
+    *use = {};
+    use->resource = resource;
+    use->access = access;
+    if (clear != nullptr) {
+        use->clear = 1;
+        use->clear_value = *clear;
+    }
+}
+
+/**
+ * Walk back from the outputs: a pass survives if it writes something still
+ * needed, and then needs everything it reads. A clear ends the dependency
+ * on earlier writers.
+ */
+static void cull_passes(struct render_graph* graph) {
+    bool needed[RG_MAX_RESOURCES];
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        needed[r] = graph->resources[r].output != 0;
+    }
+    for (uint32_t p = graph->pass_count; p-- > 0;) {
+        struct rg_pass* pass = &graph->passes[p];
+        pass->culled = 1;
+        for (uint32_t u = 0; u < pass->use_count; u++) {
+            if (access_info(pass->uses[u].access).write && needed[pass->uses[u].resource]) {
+                pass->culled = 0;
+            }
+        }
+        if (pass->culled) {
+            continue;
+        }
+        for (uint32_t u = 0; u < pass->use_count; u++) {
+            if (pass->uses[u].clear) {
+                needed[pass->uses[u].resource] = false;
+            }
+        }
+        for (uint32_t u = 0; u < pass->use_count; u++) {
+            if (!pass->uses[u].clear) {
+                needed[pass->uses[u].resource] = true;
+            }
+        }
+    }
+}
+
+static uint32_t find_attachment(const struct rg_pass* group, uint32_t resource) {
+    for (uint32_t i = 0; i < group->attachment_count; i++) {
+        if (group->attachments[i].resource == resource) {
+            return i;
+        }
+    }
+    return RG_NONE;
+}
+
+/**
+ * Fold each graphics pass into the render pass of the one before when
+ * that is legal: same size, nothing but attachments used (a sampled read
+ * of an earlier subpass's output would need the whole image), no clear of
+ * an attachment the render pass already has, and room left.
+ */
+static void merge_subpasses(struct render_graph* graph) {
+    uint32_t group = RG_NONE;
+    for (uint32_t p = 0; p < graph->pass_count; p++) {
+        struct rg_pass* pass = &graph->passes[p];
+        pass->group = p;
+        pass->subpass = 0;
+        pass->subpass_count = 1;
+        pass->attachment_count = 0;
+        pass->extent = {};
+        if (pass->culled) {
+            continue;
+        }
+        if (pass->type != RG_GRAPHICS) {
+            group = RG_NONE;
+            continue;
+        }
+
+        struct rg_pass* leader = group != RG_NONE ? &graph->passes[group] : nullptr;
+        bool mergeable = leader != nullptr && leader->subpass_count < RG_MAX_SUBPASSES;
+        uint32_t new_attachments = 0;
+        for (uint32_t u = 0; u < pass->use_count; u++) {
+            const struct rg_use* use = &pass->uses[u];
+            const struct rg_resource* resource = &graph->resources[use->resource];
+            if (!access_info(use->access).attachment) {
+                mergeable = false;
+                continue;
+            }
+            if (pass->extent.width == 0) {
+                pass->extent = { resource->width, resource->height };
+            }
+            bool known = leader != nullptr && find_attachment(leader, use->resource) != RG_NONE;
+            mergeable = mergeable && !(known && use->clear);
+            // nor one the first pass reads some other way
+            for (uint32_t l = 0; mergeable && !known && l < leader->use_count; l++) {
+                mergeable = leader->uses[l].resource != use->resource;
+            }
+            new_attachments += known ? 0 : 1;
+        }
+        mergeable = mergeable && pass->extent.width == leader->extent.width &&
+                    pass->extent.height == leader->extent.height &&
+                    leader->attachment_count + new_attachments <= RG_MAX_ATTACHMENTS;
+        if (mergeable) {
+            pass->group = group;
+            pass->subpass = leader->subpass_count++;
+        } else {
+            group = p;
+            leader = pass;
+        }
+
+        for (uint32_t u = 0; u < pass->use_count; u++) {
+            const struct rg_use* use = &pass->uses[u];
+            if (!access_info(use->access).attachment) {
+                continue;
+            }
+            uint32_t slot = find_attachment(leader, use->resource);
+            if (slot == RG_NONE) {
+                slot = leader->attachment_count++;
+                leader->attachments[slot].resource = use->resource;
+                leader->attachments[slot].first_pass = p;
+                leader->attachments[slot].first_use = u;
+            }
+            leader->attachments[slot].last_pass = p;
+            leader->attachments[slot].last_use = u;
+        }
+    }
+}
+
+/**
+ * Transients only ever used as attachments of one render pass: their
+ * contents are never loaded or stored, so they need no real memory.
+ */
+static void find_tile_only(struct render_graph* graph) {
+    const VkImageUsageFlags attachment_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                               VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                               VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        struct rg_resource* resource = &graph->resources[r];
+        resource->tile_only = !resource->imported && !resource->output && resource->first_pass != RG_NONE &&
+                              (resource->usage & ~attachment_usage) == 0;
+    }
+    for (uint32_t p = 0; p < graph->pass_count; p++) {
+        const struct rg_pass* pass = &graph->passes[p];
+        for (uint32_t u = 0; u < pass->use_count && !pass->culled; u++) {
+            struct rg_resource* resource = &graph->resources[pass->uses[u].resource];
+            if (!access_info(pass->uses[u].access).attachment ||
+                pass->group != graph->passes[resource->first_pass].group) {
+                resource->tile_only = 0;
+            }
+        }
+    }
+}
+
+/**
+ * Transient with a place in the shared allocation.
+ */
+static bool is_shared(const struct render_graph* graph, const struct rg_resource* resource) {
+    return !resource->imported && resource->first_pass != RG_NONE &&
+           !(resource->tile_only && graph->lazy_memory);
+}
+
+static bool lifetimes_overlap(const struct rg_resource* a, const struct rg_resource* b) {
+    return a->first_pass <= b->last_pass && b->first_pass <= a->last_pass;
+}
+
+static bool memory_overlaps(const struct rg_resource* a, const struct rg_resource* b) {
+    return a->offset < b->offset + b->size && b->offset < a->offset + a->size;
+}
+
+/**
+ * Greedy placement, largest first: each transient goes to the lowest
+ * offset that does not collide with a placed transient alive at the same
+ * time. Returns the size of the shared allocation.
+ */
+static VkDeviceSize alias_transients(struct render_graph* graph) {
+    uint32_t order[RG_MAX_RESOURCES];
+    uint32_t count = 0;
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        if (is_shared(graph, &graph->resources[r])) {
+            order[count++] = r;
+        }
+    }
+    std::sort(order, order + count, [graph](uint32_t a, uint32_t b) {
+        return graph->resources[a].size > graph->resources[b].size;
+    });
+
+    VkDeviceSize peak = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        struct rg_resource* resource = &graph->resources[order[i]];
+        VkDeviceSize best = ~0ull;
+        // candidates: the start, or right after any live neighbour
+        for (uint32_t c = 0; c <= i; c++) {
+            VkDeviceSize candidate = 0;
+            if (c < i) {
+                const struct rg_resource* other = &graph->resources[order[c]];
+                if (!lifetimes_overlap(resource, other)) {
+                    continue;
+                }
+                candidate = other->offset + other->size;
+            }
+            candidate = (candidate + resource->alignment - 1) & ~(resource->alignment - 1);
+            resource->offset = candidate;
+            bool fits = true;
+            for (uint32_t o = 0; o < i && fits; o++) {
+                const struct rg_resource* other = &graph->resources[order[o]];
+                fits = !lifetimes_overlap(resource, other) || !memory_overlaps(resource, other);
+            }
+            if (fits) {
+                best = std::min(best, candidate);
+            }
+        }
+        resource->offset = best;
+        peak = std::max(peak, best + resource->size);
+    }
+    return peak;
+}
+
+/**
+ * Contents of resource written up to pass are read by a later alive pass,
+ * or leave the graph.
+ */
+static bool needed_after(const struct render_graph* graph, uint32_t resource, uint32_t pass) {
+    for (uint32_t p = pass + 1; p < graph->pass_count; p++) {
+        const struct rg_pass* later = &graph->passes[p];
+        if (later->culled) {
+            continue;
+        }
+        for (uint32_t u = 0; u < later->use_count; u++) {
+            if (later->uses[u].resource == resource) {
+                return !later->uses[u].clear;
+            }
+        }
+    }
+    return graph->resources[resource].output != 0;
+}
+
+/**
+ * What the last access to a resource left to wait for.
+ */
+struct resource_state {
+    VkImageLayout layout;
+    // last write or layout transition, and reads since
+    VkPipelineStageFlags write_stages;
+    VkAccessFlags write_access;
+    VkPipelineStageFlags read_stages;
+    // stages and accesses the last write has been made visible to
+    VkPipelineStageFlags visible_stages;
+    VkAccessFlags visible_access;
+};
+
+static uint32_t push_barrier(struct render_graph* graph, uint32_t resource, VkImageLayout old_layout,
+                             VkImageLayout new_layout, VkAccessFlags src_access, VkAccessFlags dst_access) {
+    struct rg_barrier* barrier = &graph->barriers[graph->barrier_count];
+    barrier->resource = resource;
+    barrier->old_layout = old_layout;
+    barrier->new_layout = new_layout;
+    barrier->src_access = src_access;
+    barrier->dst_access = dst_access;
+    return graph->barrier_count++;
+}
+
+static void build_barriers(struct render_graph* graph) {
+    struct resource_state states[RG_MAX_RESOURCES] = {};
+    uint32_t first_use[RG_MAX_RESOURCES];
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        const struct rg_resource* resource = &graph->resources[r];
+        states[r].layout = resource->initial_layout;
+        states[r].write_stages = resource->imported ? resource->initial_stages : 0;
+        first_use[r] = RG_NONE;
+    }
+
+    graph->barrier_count = 0;
+    for (uint32_t p = 0; p < graph->pass_count; p++) {
+        struct rg_pass* pass = &graph->passes[p];
+        // merged passes cannot have barriers inside the render pass: theirs
+        // go before it, with the group's
+        struct rg_pass* batch = &graph->passes[pass->group];
+        if (pass->group == p) {
+            pass->first_barrier = graph->barrier_count;
+            pass->barrier_count = 0;
+            pass->src_stages = 0;
+            pass->dst_stages = 0;
+        }
+        if (pass->culled) {
+            continue;
+        }
+        for (uint32_t u = 0; u < pass->use_count; u++) {
+            uint32_t r = pass->uses[u].resource;
+            struct access_info info = use_info(graph, pass, &pass->uses[u]);
+            struct resource_state* state = &states[r];
+            // later uses within one render pass are ordered by its subpass
+            // dependencies and transitioned by its attachment references
+            uint32_t slot = info.attachment ? find_attachment(batch, r) : RG_NONE;
+            bool in_render_pass = slot != RG_NONE && batch->attachments[slot].first_pass != p;
+            bool transition = state->layout != info.layout;
+            VkPipelineStageFlags src = 0;
+            bool needed = false;
+            if (transition) {
+                needed = true;
+                src = state->write_stages | state->read_stages;
+            } else if (info.write) {
+                // write after write, or after reads
+                needed = (state->write_stages | state->read_stages) != 0;
+                src = state->write_stages | state->read_stages;
+            } else {
+                // read after a write not yet visible here
+                needed = state->write_stages != 0 && ((info.stages & ~state->visible_stages) != 0 ||
+                                                      (info.access & ~state->visible_access) != 0);
+                src = state->write_stages;
+            }
+            if (needed && !in_render_pass) {
+                uint32_t barrier = push_barrier(graph, r, state->layout, info.layout,
+                                                state->write_access & WRITE_ACCESS, info.access);
+                if (!graph->resources[r].imported && first_use[r] == RG_NONE) {
+                    first_use[r] = barrier;
+                }
+                batch->src_stages |= src;
+                batch->dst_stages |= info.stages;
+            }
+
+            if (transition || info.write) {
+                state->write_stages = info.stages;
+                state->write_access = info.write ? info.access : 0;
+                state->read_stages = 0;
+                state->visible_stages = info.stages;
+                state->visible_access = info.access;
+            } else {
+                state->read_stages |= info.stages;
+                if (needed) {
+                    state->visible_stages |= info.stages;
+                    state->visible_access |= info.access;
+                }
+            }
+            state->layout = info.layout;
+        }
+        batch->barrier_count = graph->barrier_count - batch->first_barrier;
+    }
+
+    // The graph runs every frame: a transient's first use must wait for
+    // the last use, in the previous frame, of everything sharing its memory
+    // (itself included).
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        if (first_use[r] == RG_NONE) {
+            continue;
+        }
+        const struct rg_resource* resource = &graph->resources[r];
+        struct rg_pass* batch = &graph->passes[graph->passes[resource->first_pass].group];
+        for (uint32_t o = 0; o < graph->resource_count; o++) {
+            const struct rg_resource* other = &graph->resources[o];
+            if (o != r && !(is_shared(graph, resource) && is_shared(graph, other) &&
+                            memory_overlaps(resource, other))) {
+                continue;
+            }
+            graph->barriers[first_use[r]].src_access |= states[o].write_access & WRITE_ACCESS;
+            batch->src_stages |= states[o].write_stages | states[o].read_stages;
+        }
+    }
+
+    graph->final_barrier = graph->barrier_count;
+    graph->final_src_stages = 0;
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        const struct rg_resource* resource = &graph->resources[r];
+        if (!resource->output || resource->first_pass == RG_NONE || states[r].layout == resource->final_layout) {
+            continue;
+        }
+        push_barrier(graph, r, states[r].layout, resource->final_layout,
+                     states[r].write_access & WRITE_ACCESS, 0);
+        graph->final_src_stages |= states[r].write_stages | states[r].read_stages;
+    }
+    graph->final_barrier_count = graph->barrier_count - graph->final_barrier;
+}
+
+int render_graph_compile(struct render_graph* graph) {
+    cull_passes(graph);
+
+    struct rg_stats* stats = &graph->stats;
+    *stats = {};
+    stats->passes = graph->pass_count;
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        graph->resources[r].first_pass = RG_NONE;
+        graph->resources[r].last_pass = RG_NONE;
+    }
+    for (uint32_t p = 0; p < graph->pass_count; p++) {
+        const struct rg_pass* pass = &graph->passes[p];
+        if (pass->culled) {
+            stats->culled_passes++;
+            continue;
+        }
+        for (uint32_t u = 0; u < pass->use_count; u++) {
+            struct rg_resource* resource = &graph->resources[pass->uses[u].resource];
+            if (resource->first_pass == RG_NONE) {
+                resource->first_pass = p;
+            }
+            resource->last_pass = p;
+        }
+    }
+
+    merge_subpasses(graph);
+    find_tile_only(graph);
+
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        struct rg_resource* resource = &graph->resources[r];
+        if (resource->imported || resource->first_pass == RG_NONE) {
+            continue;
+        }
+        stats->transient_images++;
+        stats->tile_only_images += resource->tile_only ? 1 : 0;
+        if (!is_shared(graph, resource)) {
+            continue;
+        }
+        if (resource->size == 0) {
+            // no device: what a driver would typically ask for
+            resource->alignment = 64 << 10;
+            resource->size = image_bytes(resource);
+            resource->size = (resource->size + resource->alignment - 1) & ~(resource->alignment - 1);
+        }
+        stats->transient_bytes += resource->size;
+    }
+    stats->peak_bytes = alias_transients(graph);
+
+    build_barriers(graph);
+    for (uint32_t p = 0; p < graph->pass_count; p++) {
+        struct rg_pass* pass = &graph->passes[p];
+        if (pass->culled) {
+            continue;
+        }
+        if (pass->group == p) {
+            stats->barriers += pass->barrier_count;
+            stats->barrier_batches += pass->barrier_count > 0 ? 1 : 0;
+        }
+        for (uint32_t u = 0; u < pass->use_count; u++) {
+            const struct rg_use* use = &pass->uses[u];
+            const struct rg_resource* resource = &graph->resources[use->resource];
+            bool has_contents = resource->first_pass < p ||
+                                (resource->imported && resource->initial_layout != VK_IMAGE_LAYOUT_UNDEFINED);
+            pass->load_ops[u] = use->clear ? VK_ATTACHMENT_LOAD_OP_CLEAR
+                                : has_contents ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            pass->store_ops[u] = needed_after(graph, use->resource, p) ? VK_ATTACHMENT_STORE_OP_STORE
+                                                                       : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        }
+    }
+    stats->barriers += graph->final_barrier_count;
+    stats->barrier_batches += graph->final_barrier_count > 0 ? 1 : 0;
+
+    for (uint32_t p = 0; p < graph->pass_count; p++) {
+        const struct rg_pass* pass = &graph->passes[p];
+        if (pass->culled || pass->group != p || pass->type != RG_GRAPHICS) {
+            continue;
+        }
+        stats->render_passes++;
+        stats->subpasses += pass->subpass_count;
+        for (uint32_t i = 0; i < pass->attachment_count; i++) {
+            const struct rg_attachment* attachment = &pass->attachments[i];
+            VkDeviceSize bytes = image_bytes(&graph->resources[attachment->resource]);
+            VkAttachmentLoadOp load = graph->passes[attachment->first_pass].load_ops[attachment->first_use];
+            VkAttachmentStoreOp store = graph->passes[attachment->last_pass].store_ops[attachment->last_use];
+            stats->attachment_loads += load == VK_ATTACHMENT_LOAD_OP_LOAD ? 1 : 0;
+            stats->attachment_clears += load == VK_ATTACHMENT_LOAD_OP_CLEAR ? 1 : 0;
+            stats->load_bytes += load == VK_ATTACHMENT_LOAD_OP_LOAD ? bytes : 0;
+            stats->attachment_stores += store == VK_ATTACHMENT_STORE_OP_STORE ? 1 : 0;
+            stats->attachment_discards += store == VK_ATTACHMENT_STORE_OP_DONT_CARE ? 1 : 0;
+            stats->store_bytes += store == VK_ATTACHMENT_STORE_OP_STORE ? bytes : 0;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Order a later subpass after an earlier one, merging with the
+ * dependency already between the two if there is one.
+ */
+static void add_dependency(VkSubpassDependency* dependencies, uint32_t* count, uint32_t src, uint32_t dst,
+                           VkPipelineStageFlags src_stages, VkAccessFlags src_access,
+                           VkPipelineStageFlags dst_stages, VkAccessFlags dst_access) {
+    VkSubpassDependency* dependency = nullptr;
+    for (uint32_t i = 0; i < *count && dependency == nullptr; i++) {
+        if (dependencies[i].srcSubpass == src && dependencies[i].dstSubpass == dst) {
+            dependency = &dependencies[i];
+        }
+    }
+    if (dependency == nullptr) {
+        dependency = &dependencies[(*count)++];
+        *dependency = {};
+        dependency->srcSubpass = src;
+        dependency->dstSubpass = dst;
+        // each pixel only depends on the same pixel of earlier subpasses,
+        // which lets a tiler keep going tile by tile
+        dependency->dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    }
+    dependency->srcStageMask |= src_stages;
+    dependency->srcAccessMask |= src_access;
+    dependency->dstStageMask |= dst_stages;
+    dependency->dstAccessMask |= dst_access;
+}
+
+/**
+ * One VkRenderPass for group and the passes merged into it, one subpass
+ * each. Attachments arrive in the layout of their first use (the graph's
+ * barriers see to that) and are left in the layout of their last.
+ */
+static int create_render_pass(struct vk_context* vk, struct render_graph* graph, uint32_t group) {
+    struct rg_pass* leader = &graph->passes[group];
+    VkAttachmentDescription attachments[RG_MAX_ATTACHMENTS] = {};
+    for (uint32_t i = 0; i < leader->attachment_count; i++) {
+        const struct rg_attachment* attachment = &leader->attachments[i];
+        const struct rg_pass* first = &graph->passes[attachment->first_pass];
+        const struct rg_pass* last = &graph->passes[attachment->last_pass];
+        VkAttachmentDescription* description = &attachments[i];
+        description->format = graph->resources[attachment->resource].format;
+        description->samples = VK_SAMPLE_COUNT_1_BIT;
+        description->loadOp = first->load_ops[attachment->first_use];
+        description->storeOp = last->store_ops[attachment->last_use];
+        description->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        description->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        description->initialLayout = use_info(graph, first, &first->uses[attachment->first_use]).layout;
+        description->finalLayout = use_info(graph, last, &last->uses[attachment->last_use]).layout;
+    }
+
+    VkSubpassDescription subpasses[RG_MAX_SUBPASSES] = {};
+    VkAttachmentReference colors[RG_MAX_SUBPASSES][RG_MAX_PASS_USES];
+    VkAttachmentReference inputs[RG_MAX_SUBPASSES][RG_MAX_PASS_USES];
+    VkAttachmentReference depths[RG_MAX_SUBPASSES];
+    VkSubpassDependency dependencies[RG_MAX_SUBPASSES * RG_MAX_SUBPASSES];
+    uint32_t dependency_count = 0;
+    // the subpass that last touched each attachment, and how
+    struct {
+        uint32_t subpass;
+        struct access_info info;
+    } last_use[RG_MAX_ATTACHMENTS];
+    for (uint32_t i = 0; i < leader->attachment_count; i++) {
+        last_use[i].subpass = RG_NONE;
+    }
+
+    for (uint32_t p = group; p < graph->pass_count; p++) {
+        const struct rg_pass* pass = &graph->passes[p];
+        if (pass->culled || pass->group != group) {
+            continue;
+        }
+        uint32_t s = pass->subpass;
+        VkSubpassDescription* subpass = &subpasses[s];
+        subpass->pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass->pColorAttachments = colors[s];
+        subpass->pInputAttachments = inputs[s];
+        for (uint32_t u = 0; u < pass->use_count; u++) {
+            struct access_info info = use_info(graph, pass, &pass->uses[u]);
+            if (!info.attachment) {
+                continue;
+            }
+            uint32_t slot = find_attachment(leader, pass->uses[u].resource);
+            VkAttachmentReference reference = { slot, info.layout };
+            if (pass->uses[u].access == RG_COLOR_ATTACHMENT) {
+                colors[s][subpass->colorAttachmentCount++] = reference;
+            } else if (pass->uses[u].access == RG_INPUT_ATTACHMENT) {
+                inputs[s][subpass->inputAttachmentCount++] = reference;
+            } else {
+                depths[s] = reference;
+                subpass->pDepthStencilAttachment = &depths[s];
+            }
+
+            const struct access_info* previous = &last_use[slot].info;
+            if (last_use[slot].subpass != RG_NONE && last_use[slot].subpass != s &&
+                (previous->write || info.write || previous->layout != info.layout)) {
+                add_dependency(dependencies, &dependency_count, last_use[slot].subpass, s, previous->stages,
+                               previous->write ? previous->access & WRITE_ACCESS : 0, info.stages,
+                               info.access);
+            }
+            last_use[slot].subpass = s;
+            last_use[slot].info = info;
+        }
+    }
+
+    VkRenderPassCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    info.attachmentCount = leader->attachment_count;
+    info.pAttachments = attachments;
+    info.subpassCount = leader->subpass_count;
+    info.pSubpasses = subpasses;
+    info.dependencyCount = dependency_count;
+    info.pDependencies = dependencies;
+    VK_CHECK(vkCreateRenderPass(vk->device, &info, nullptr, &leader->render_pass));
+
+    // merged passes hand it to secondary command buffers
+    for (uint32_t p = group + 1; p < graph->pass_count; p++) {
+        if (!graph->passes[p].culled && graph->passes[p].group == group) {
+            graph->passes[p].render_pass = leader->render_pass;
+        }
+    }
+    return 0;
+}
+
+static bool has_lazy_memory(const struct vk_context* vk) {
+    const VkPhysicalDeviceMemoryProperties* properties = &vk->allocator.memory_properties;
+    for (uint32_t i = 0; i < properties->memoryTypeCount; i++) {
+        if (properties->memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int render_graph_realize(struct vk_context* vk, struct render_graph* graph) {
+    // first compile finds the transients that survive culling
+    graph->lazy_memory = has_lazy_memory(vk) ? 1 : 0;
+    render_graph_compile(graph);
+
+    VkMemoryRequirements shared{};
+    shared.alignment = 1;
+    shared.memoryTypeBits = ~0u;
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        struct rg_resource* resource = &graph->resources[r];
+        if (resource->imported || resource->first_pass == RG_NONE) {
+            continue;
+        }
+        VkImageUsageFlags usage = resource->usage;
+        for (uint32_t p = resource->first_pass; p <= resource->last_pass; p++) {
+            const struct rg_pass* pass = &graph->passes[p];
+            for (uint32_t u = 0; u < pass->use_count && !pass->culled; u++) {
+                if (pass->uses[u].resource == r) {
+                    usage |= access_info(pass->uses[u].access).usage;
+                }
+            }
+        }
+        if (resource->tile_only) {
+            usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
+        VkImageCreateInfo image{};
+        image.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image.imageType = VK_IMAGE_TYPE_2D;
+        image.format = resource->format;
+        image.extent = { resource->width, resource->height, 1 };
+        image.mipLevels = 1;
+        image.arrayLayers = 1;
+        image.samples = VK_SAMPLE_COUNT_1_BIT;
+        image.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image.usage = usage;
+        image.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VK_CHECK(vkCreateImage(vk->device, &image, nullptr, &resource->image));
+
+        if (!is_shared(graph, resource)) {
+            // backed only when the tiler runs out of tile memory; fall back
+            // to ordinary memory when no lazy type accepts the image
+            if (gpu_alloc_image(&vk->allocator, resource->image, image.tiling,
+                                VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, &resource->lazy) != 0 &&
+                gpu_alloc_image(&vk->allocator, resource->image, image.tiling,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &resource->lazy) != 0) {
+                return -1;
+            }
+            continue;
+        }
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(vk->device, resource->image, &requirements);
+        resource->size = requirements.size;
+        resource->alignment = requirements.alignment;
+        shared.alignment = std::max(shared.alignment, requirements.alignment);
+        shared.memoryTypeBits &= requirements.memoryTypeBits;
+    }
+
+    // again with the real sizes
+    render_graph_compile(graph);
+    if (graph->stats.peak_bytes > 0) {
+        shared.size = graph->stats.peak_bytes;
+        if (gpu_alloc(&vk->allocator, &shared, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GPU_OPTIMAL, 0,
+                      &graph->memory) != 0) {
+            return -1;
+        }
+    }
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        struct rg_resource* resource = &graph->resources[r];
+        if (resource->imported || resource->image == VK_NULL_HANDLE) {
+            continue;
+        }
+        if (is_shared(graph, resource)) {
+            VK_CHECK(vkBindImageMemory(vk->device, resource->image, graph->memory.memory,
+                                       graph->memory.offset + resource->offset));
+        }
+        VkImageViewCreateInfo view{};
+        view.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view.image = resource->image;
+        view.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view.format = resource->format;
+        view.subresourceRange.aspectMask = format_aspect(resource->format) & ~VK_IMAGE_ASPECT_STENCIL_BIT;
+        view.subresourceRange.levelCount = 1;
+        view.subresourceRange.layerCount = 1;
+        VK_CHECK(vkCreateImageView(vk->device, &view, nullptr, &resource->view));
+    }
+
+    for (uint32_t p = 0; p < graph->pass_count; p++) {
+        struct rg_pass* pass = &graph->passes[p];
+        if (!pass->culled && pass->group == p && pass->type == RG_GRAPHICS &&
+            create_render_pass(vk, graph, p) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Framebuffer for the views the render pass of group renders to this
+ * frame, created the first time that combination is seen.
+ */
+static VkFramebuffer pass_framebuffer(struct vk_context* vk, struct render_graph* graph, struct rg_pass* group) {
+    VkImageView views[RG_MAX_ATTACHMENTS] = {};
+    for (uint32_t i = 0; i < group->attachment_count; i++) {
+        views[i] = graph->resources[group->attachments[i].resource].view;
+    }
+    for (uint32_t i = 0; i < RG_MAX_FRAMEBUFFERS; i++) {
+        if (group->framebuffers[i] == VK_NULL_HANDLE) {
+            VkFramebufferCreateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            info.renderPass = group->render_pass;
+            info.attachmentCount = group->attachment_count;
+            info.pAttachments = views;
+            info.width = group->extent.width;
+            info.height = group->extent.height;
+            info.layers = 1;
+            if (vkCreateFramebuffer(vk->device, &info, nullptr, &group->framebuffers[i]) != VK_SUCCESS) {
+                LOGE("render graph: cannot create a framebuffer for %s", group->name);
+                return VK_NULL_HANDLE;
+            }
+            std::copy(views, views + RG_MAX_ATTACHMENTS, group->framebuffer_views[i]);
+            return group->framebuffers[i];
+        }
+        if (std::equal(views, views + RG_MAX_ATTACHMENTS, group->framebuffer_views[i])) {
+            return group->framebuffers[i];
+        }
+    }
+    LOGE("render graph: %s renders to more than %d image combinations", group->name, RG_MAX_FRAMEBUFFERS);
+    return VK_NULL_HANDLE;
+}
+
+static VkExtent2D pass_area(const struct rg_pass* pass) {
+    if (pass->render_area.width == 0 || pass->render_area.height == 0) {
+        return pass->extent;
+    }
+    return { std::min(pass->render_area.width, pass->extent.width),
+             std::min(pass->render_area.height, pass->extent.height) };
+}
+
+static void record_barriers(const struct render_graph* graph, VkCommandBuffer cmd, uint32_t first,
+                            uint32_t count, VkPipelineStageFlags src_stages, VkPipelineStageFlags dst_stages) {
+    if (count == 0) {
+        return;
+    }
+    VkImageMemoryBarrier barriers[RG_MAX_SUBPASSES * RG_MAX_PASS_USES + RG_MAX_RESOURCES];
+    for (uint32_t i = 0; i < count; i++) {
+        const struct rg_barrier* barrier = &graph->barriers[first + i];
+        const struct rg_resource* resource = &graph->resources[barrier->resource];
+        VkImageMemoryBarrier* out = &barriers[i];
+        *out = {};
+        out->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        out->srcAccessMask = barrier->src_access;
+        out->dstAccessMask = barrier->dst_access;
+        out->oldLayout = barrier->old_layout;
+        out->newLayout = barrier->new_layout;
+        out->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        out->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        out->image = resource->image;
+        out->subresourceRange.aspectMask = format_aspect(resource->format);
+        out->subresourceRange.levelCount = 1;
+        out->subresourceRange.layerCount = 1;
+    }
+    vkCmdPipelineBarrier(cmd, src_stages != 0 ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         dst_stages, 0, 0, nullptr, 0, nullptr, count, barriers);
+}
+
+void render_graph_execute(struct vk_context* vk, struct render_graph* graph, VkCommandBuffer cmd) {
+    for (uint32_t p = 0; p < graph->pass_count; p++) {
+        struct rg_pass* pass = &graph->passes[p];
+        if (pass->culled || pass->group != p) {
+            continue;
+        }
+        PROFILE_SCOPE(pass->name);
+        record_barriers(graph, cmd, pass->first_barrier, pass->barrier_count, pass->src_stages,
+                        pass->dst_stages);
+        if (pass->type == RG_COMPUTE) {
+            pass->execute(pass->data, cmd, pass);
+            continue;
+        }
+
+        pass->framebuffer = pass_framebuffer(vk, graph, pass);
+        if (pass->framebuffer == VK_NULL_HANDLE) {
+            continue;
+        }
+        VkClearValue clears[RG_MAX_ATTACHMENTS] = {};
+        for (uint32_t i = 0; i < pass->attachment_count; i++) {
+            const struct rg_attachment* attachment = &pass->attachments[i];
+            clears[i] = graph->passes[attachment->first_pass].uses[attachment->first_use].clear_value;
+        }
+        VkRenderPassBeginInfo begin{};
+        begin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        begin.renderPass = pass->render_pass;
+        begin.framebuffer = pass->framebuffer;
+        begin.renderArea.extent = pass_area(pass);
+        begin.clearValueCount = pass->attachment_count;
+        begin.pClearValues = clears;
+        vkCmdBeginRenderPass(cmd, &begin, pass->contents);
+        if (pass->contents == VK_SUBPASS_CONTENTS_INLINE) {
+            rg_set_viewport(pass, cmd);
+        }
+        pass->execute(pass->data, cmd, pass);
+
+        for (uint32_t m = p + 1; m < graph->pass_count; m++) {
+            struct rg_pass* merged = &graph->passes[m];
+            if (merged->culled) {
+                continue;
+            }
+            if (merged->group != p) {
+                break;
+            }
+            PROFILE_SCOPE(merged->name);
+            merged->framebuffer = pass->framebuffer;
+            vkCmdNextSubpass(cmd, merged->contents);
+            if (merged->contents == VK_SUBPASS_CONTENTS_INLINE) {
+                rg_set_viewport(merged, cmd);
+            }
+            merged->execute(merged->data, cmd, merged);
+        }
+        vkCmdEndRenderPass(cmd);
+    }
+    record_barriers(graph, cmd, graph->final_barrier, graph->final_barrier_count, graph->final_src_stages,
+                    VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    PROFILE_COUNTER("attachment load bytes", graph->stats.load_bytes);
+    PROFILE_COUNTER("attachment store bytes", graph->stats.store_bytes);
+}
+
+void render_graph_release(struct vk_context* vk, struct render_graph* graph) {
+    for (uint32_t p = 0; p < graph->pass_count; p++) {
+        struct rg_pass* pass = &graph->passes[p];
+        for (uint32_t i = 0; i < RG_MAX_FRAMEBUFFERS; i++) {
+            if (pass->framebuffers[i] != VK_NULL_HANDLE) {
+                vkDestroyFramebuffer(vk->device, pass->framebuffers[i], nullptr);
+            }
+            pass->framebuffers[i] = VK_NULL_HANDLE;
+        }
+        // merged passes share their group's
+        if (pass->render_pass != VK_NULL_HANDLE && pass->group == p) {
+            vkDestroyRenderPass(vk->device, pass->render_pass, nullptr);
+        }
+        pass->render_pass = VK_NULL_HANDLE;
+        pass->framebuffer = VK_NULL_HANDLE;
+    }
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        struct rg_resource* resource = &graph->resources[r];
+        if (resource->imported) {
+            continue;
+        }
+        if (resource->view != VK_NULL_HANDLE) {
+            vkDestroyImageView(vk->device, resource->view, nullptr);
+        }
+        if (resource->image != VK_NULL_HANDLE) {
+            vkDestroyImage(vk->device, resource->image, nullptr);
+        }
+        gpu_free(&vk->allocator, &resource->lazy);
+        resource->view = VK_NULL_HANDLE;
+        resource->image = VK_NULL_HANDLE;
+        resource->size = 0;
+    }
+    gpu_free(&vk->allocator, &graph->memory);
+}
+
+void rg_set_viewport(const struct rg_pass* pass, VkCommandBuffer cmd) {
+    VkExtent2D area = pass_area(pass);
+    VkViewport viewport{};
+    viewport.width = (float)area.width;
+    viewport.height = (float)area.height;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    VkRect2D scissor{};
+    scissor.extent = area;
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
+
+void render_graph_log(const struct render_graph* graph) {
+    const struct rg_stats* stats = &graph->stats;
+    LOGI("render graph: %u passes (%u culled) in %u render passes (%u subpasses), %u barriers in %u batches",
+         stats->passes, stats->culled_passes, stats->render_passes, stats->subpasses, stats->barriers,
+         stats->barrier_batches);
+    LOGI("render graph: %u transient images (%u tile only), %.1f MB aliased into %.1f MB",
+         stats->transient_images, stats->tile_only_images, (double)stats->transient_bytes / (1 << 20),
+         (double)stats->peak_bytes / (1 << 20));
+    LOGI("render graph: per frame %u loads, %u clears, %u stores, %u discards: %.1f MB loaded, "
+         "%.1f MB stored",
+         stats->attachment_loads, stats->attachment_clears, stats->attachment_stores,
+         stats->attachment_discards, (double)stats->load_bytes / (1 << 20),
+         (double)stats->store_bytes / (1 << 20));
+}
@@ -0,0 +1,276 @@
+#ifndef ENGINE_RENDER_GRAPH_H
+#define ENGINE_RENDER_GRAPH_H
+
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "vk_context.h"
+
+/**
+ * Frame graph. Passes declare which images they use and how; compiling
+ * the graph culls passes whose results nobody reads, derives every layout
+ * transition and pipeline barrier, picks attachment load/store ops, and
+ * packs transient images whose lifetimes do not overlap into one shared
+ * allocation. The graph is declared and realized once (again on resize)
+ * and executed every frame.
+ *
+ * Consecutive graphics passes of the same size that only touch
+ * attachments become subpasses of one VkRenderPass, so on tilers their
+ * intermediate results stay in tile memory. Transients that never leave
+ * such a render pass get lazily allocated memory where the device has it.
+ */
+
+#define RG_MAX_RESOURCES 16
+#define RG_MAX_PASSES 16
+#define RG_MAX_PASS_USES 8
+#define RG_MAX_SUBPASSES 4
+// distinct attachments of one render pass, across its subpasses
+#define RG_MAX_ATTACHMENTS 8
+#define RG_MAX_BARRIERS (RG_MAX_PASSES * RG_MAX_PASS_USES + RG_MAX_RESOURCES)
+// distinct imported images a pass renders to, e.g. one per swapchain image
+#define RG_MAX_FRAMEBUFFERS 8
+#define RG_NONE 0xffffffffu
+
+enum rg_access {
+    RG_COLOR_ATTACHMENT,
+    RG_DEPTH_ATTACHMENT,
+    RG_DEPTH_READ,
+    // read in the fragment shader at the same pixel, from an earlier
+    // subpass when the passes merge
+    RG_INPUT_ATTACHMENT,
+    RG_SAMPLED,
+    RG_STORAGE_READ,
+    RG_STORAGE_WRITE,
+    RG_TRANSFER_SRC,
+    RG_TRANSFER_DST,
+};
+
+enum rg_pass_type {
+    RG_GRAPHICS,
+    RG_COMPUTE,
+};
+
+struct rg_use {
+    uint32_t resource;
+    enum rg_access access;
+    // attachments only: clear instead of loading the previous contents
+    int clear;
+    VkClearValue clear_value;
+};
+
+struct rg_resource {
+    const char* name;
+    VkFormat format;
+    uint32_t width;
+    uint32_t height;
+    // usage beyond what the declared accesses imply
+    VkImageUsageFlags usage;
+    // imported images (the swapchain) are owned elsewhere and set per frame
+    int imported;
+    VkImageLayout initial_layout;
+    VkPipelineStageFlags initial_stages;
+    // contents are needed after the graph; left in final_layout
+    int output;
+    VkImageLayout final_layout;
+    VkImage image;
+    VkImageView view;
+
+    // set by compile: alive passes using it, and its place in the shared
+    // transient allocation
+    uint32_t first_pass;
+    uint32_t last_pass;
+    VkDeviceSize size;
+    VkDeviceSize alignment;
+    VkDeviceSize offset;
+    // only ever lives in one render pass: TRANSIENT_ATTACHMENT usage, and
+    // its own lazily allocated memory when the graph has lazy_memory
+    int tile_only;
+    struct gpu_allocation lazy;
+};
+
+struct rg_pass;
+
+typedef void (*rg_execute_func)(void* data, VkCommandBuffer cmd, const struct rg_pass* pass);
+
+/**
+ * One layout transition or hazard, recorded before its pass (before the
+ * render pass for merged passes).
+ */
+struct rg_barrier {
+    uint32_t resource;
+    VkImageLayout old_layout;
+    VkImageLayout new_layout;
+    VkAccessFlags src_access;
+    VkAccessFlags dst_access;
+};
+
+/**
+ * Where an attachment of a render pass is first and last used, which
+ * decides its load and store ops.
+ */
+struct rg_attachment {
+    uint32_t resource;
+    uint32_t first_pass;
+    uint32_t first_use;
+    uint32_t last_pass;
+    uint32_t last_use;
+};
+
+struct rg_pass {
+    const char* name;
+    enum rg_pass_type type;
+    struct rg_use uses[RG_MAX_PASS_USES];
+    uint32_t use_count;
+    rg_execute_func execute;
+    void* data;
+    // graphics passes: how execute fills the render pass; may change
+    // between frames
+    VkSubpassContents contents;
+    // graphics passes: the top left part of the attachments that is
+    // rendered to and cleared, all of them when zero; may change between
+    // frames. Passes that merge into one render pass need the same area
+    VkExtent2D render_area;
+
+    // set by compile. group is the pass that begins the render pass this
+    // one is subpass of (itself when not merged); barriers, attachments
+    // and render pass objects live in the group's pass
+    int culled;
+    uint32_t group;
+    uint32_t subpass;
+    uint32_t subpass_count;
+    struct rg_attachment attachments[RG_MAX_ATTACHMENTS];
+    uint32_t attachment_count;
+    uint32_t first_barrier;
+    uint32_t barrier_count;
+    VkPipelineStageFlags src_stages;
+    VkPipelineStageFlags dst_stages;
+    VkAttachmentLoadOp load_ops[RG_MAX_PASS_USES];
+    VkAttachmentStoreOp store_ops[RG_MAX_PASS_USES];
+
+    // set by realize, and framebuffer by execute for the current frame
+    VkExtent2D extent;
+    VkRenderPass render_pass;
+    VkFramebuffer framebuffer;
+    VkFramebuffer framebuffers[RG_MAX_FRAMEBUFFERS];
+    VkImageView framebuffer_views[RG_MAX_FRAMEBUFFERS][RG_MAX_ATTACHMENTS];
+};
+
+struct rg_stats {
+    uint32_t passes;
+    uint32_t culled_passes;
+    uint32_t barriers;
+    // vkCmdPipelineBarrier calls
+    uint32_t barrier_batches;
+    uint32_t render_passes;
+    uint32_t subpasses;
+    // attachment load and store ops per frame, and the bytes moved between
+    // tile and main memory by LOAD and STORE
+    uint32_t attachment_loads;
+    uint32_t attachment_clears;
+    uint32_t attachment_stores;
+    uint32_t attachment_discards;
+    VkDeviceSize load_bytes;
+    VkDeviceSize store_bytes;
+    uint32_t transient_images;
+    uint32_t tile_only_images;
+    // transient bytes without aliasing, and the shared allocation size
+    VkDeviceSize transient_bytes;
+    VkDeviceSize peak_bytes;
+};
+
+struct render_graph {
+    struct rg_resource resources[RG_MAX_RESOURCES];
+    uint32_t resource_count;
+    struct rg_pass passes[RG_MAX_PASSES];
+    uint32_t pass_count;
+    struct rg_barrier barriers[RG_MAX_BARRIERS];
+    uint32_t barrier_count;
+    // transitions of outputs into their final layout after the last pass
+    uint32_t final_barrier;
+    uint32_t final_barrier_count;
+    VkPipelineStageFlags final_src_stages;
+    // the device has lazily allocated memory; set by realize, or by hand to
+    // compile for a tiler
+    int lazy_memory;
+    struct rg_stats stats;
+    struct gpu_allocation memory;
+};
+
+/**
+ * Forget every resource and pass. Call render_graph_release first if the
+ * graph was realized.
+ */
+void render_graph_reset(struct render_graph* graph);
+
+/**
+ * Declare an image owned outside the graph, in initial_layout after
+ * initial_stages (VK_IMAGE_LAYOUT_UNDEFINED discards its contents). The
+ * image itself is set every frame with rg_set_image.
+ */
+uint32_t rg_import_image(struct render_graph* graph, const char* name, VkFormat format,
+                         uint32_t width, uint32_t height, VkImageLayout initial_layout,
+                         VkPipelineStageFlags initial_stages);
+
+/**
+ * Declare an image created by the graph that only lives within a frame.
+ */
+uint32_t rg_create_image(struct render_graph* graph, const char* name, VkFormat format,
+                         uint32_t width, uint32_t height, VkImageUsageFlags usage = 0);
+
+/**
+ * Keep the contents for after the graph, transitioned to final_layout.
+ * Passes that only contribute to non-output images are culled.
+ */
+void rg_mark_output(struct render_graph* graph, uint32_t resource, VkImageLayout final_layout);
+
+uint32_t rg_add_pass(struct render_graph* graph, const char* name, enum rg_pass_type type,
+                     rg_execute_func execute, void* data);
+
+/**
+ * Declare that pass accesses resource. Attachments are bound in the order
+ * their render pass first uses them.
+ */
+void rg_use(struct render_graph* graph, uint32_t pass, uint32_t resource, enum rg_access access,
+            const VkClearValue* clear = nullptr);
+
+inline void rg_set_image(struct render_graph* graph, uint32_t resource, VkImage image, VkImageView view) {
+    graph->resources[resource].image = image;
+    graph->resources[resource].view = view;
+}
+
+/**
+ * Cull, merge subpasses, compute lifetimes, alias transients and derive
+ * barriers and load/store ops. Needs no device: transient sizes come from realize, or
+ * are estimated from the format when compiled on their own. Returns 0 on
+ * success.
+ */
+int render_graph_compile(struct render_graph* graph);
+
+/**
+ * Create the transient images in one shared allocation (tile-only ones in
+ * lazily allocated memory), compile, and create a render pass per group
+ * of merged graphics passes.
+ */
+int render_graph_realize(struct vk_context* vk, struct render_graph* graph);
+
+/**
+ * Record every alive pass with its barriers into cmd. Merged passes are
+ * recorded as consecutive subpasses.
+ */
+void render_graph_execute(struct vk_context* vk, struct render_graph* graph, VkCommandBuffer cmd);
+
+/**
+ * Destroy what realize and execute created; the declarations stay.
+ */
+void render_graph_release(struct vk_context* vk, struct render_graph* graph);
+
+/**
+ * Viewport and scissor covering the pass's render area, for inline and
+ * secondary command buffers.
+ */
+void rg_set_viewport(const struct rg_pass* pass, VkCommandBuffer cmd);
+
+void render_graph_log(const struct render_graph* graph);
+
+#endif // ENGINE_RENDER_GRAPH_H
@@ -0,0 +1,353 @@
+#include "renderer.h"
+
+#include <algorithm>
+
+#include "platform.h"
+#include "profiler.h"
+
+/**
+ * First depth format usable as an optimal-tiling attachment. The spec
+ * guarantees D16_UNORM and one of the 24/32 bit formats.
+ */
+static VkFormat pick_depth_format(struct vk_context* vk) {
+    const VkFormat candidates[] = {
+        VK_FORMAT_D32_SFLOAT,
+        VK_FORMAT_X8_D24_UNORM_PACK32,
+        VK_FORMAT_D16_UNORM,
+    };
+    for (VkFormat format : candidates) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(vk->physical_device, format, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+            return format;
+        }
+    }
+    return VK_FORMAT_D16_UNORM;
+}
+
+static int create_frame_resources(struct vk_context* vk, struct frame_resources* frame,
+                                  uint32_t record_workers) {
+    VkCommandPoolCreateInfo pool{};
+    pool.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    // the whole pool is reset once per frame instead of individual buffers
+    pool.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool.queueFamilyIndex = vk->graphics_family;
+    VK_CHECK(vkCreateCommandPool(vk->device, &pool, nullptr, &frame->command_pool));
+
+    VkCommandBufferAllocateInfo alloc{};
+    alloc.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc.commandPool = frame->command_pool;
+    alloc.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc.commandBufferCount = 1;
+    VK_CHECK(vkAllocateCommandBuffers(vk->device, &alloc, &frame->command_buffer));
+
+    VkFenceCreateInfo fence{};
+    fence.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fence.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    VK_CHECK(vkCreateFence(vk->device, &fence, nullptr, &frame->in_flight));
+
+    VkSemaphoreCreateInfo semaphore{};
+    semaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    VK_CHECK(vkCreateSemaphore(vk->device, &semaphore, nullptr, &frame->image_acquired));
+
+    // command pools are externally synchronized: one per recording worker
+    for (uint32_t i = 0; i < record_workers; i++) {
+        VK_CHECK(vkCreateCommandPool(vk->device, &pool, nullptr, &frame->workers[i].command_pool));
+    }
+    return 0;
+}
+
+static void destroy_frame_resources(struct vk_context* vk, struct frame_resources* frame) {
+    vkDestroySemaphore(vk->device, frame->image_acquired, nullptr);
+    vkDestroyFence(vk->device, frame->in_flight, nullptr);
+    vkDestroyCommandPool(vk->device, frame->command_pool, nullptr);
+    for (struct worker_commands& worker : frame->workers) {
+        if (worker.command_pool != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(vk->device, worker.command_pool, nullptr);
+        }
+    }
+    *frame = {};
+}
+
+static int recreate_swapchain(struct vk_context* vk, struct renderer* renderer) {
+    vkDeviceWaitIdle(vk->device);
+    if (swapchain_create(vk, &renderer->swapchain, renderer->width, renderer->height) != 0) {
+        return -1;
+    }
+    renderer->swapchain_dirty = 0;
+    renderer->swapchain_generation++;
+    return 0;
+}
+
+int renderer_init(struct vk_context* vk, struct renderer* renderer,
+                  uint32_t width, uint32_t height, uint32_t frames_in_flight,
+                  uint32_t record_workers) {
+    renderer->width = width;
+    renderer->height = height;
+    renderer->frames_in_flight = std::clamp(frames_in_flight, 1u, (uint32_t)MAX_FRAMES_IN_FLIGHT);
+    renderer->frame = 0;
+    renderer->record_workers = std::min(record_workers, (uint32_t)MAX_JOB_WORKERS);
+
+    if (swapchain_create(vk, &renderer->swapchain, width, height) != 0) {
+        return -1;
+    }
+    renderer->depth_format = pick_depth_format(vk);
+    for (uint32_t i = 0; i < renderer->frames_in_flight; i++) {
+        if (create_frame_resources(vk, &renderer->frames[i], renderer->record_workers) != 0) {
+            return -1;
+        }
+    }
+    LOGI("renderer: %ux%u, %u swapchain images, %u frames in flight",
+         renderer->swapchain.extent.width, renderer->swapchain.extent.height,
+         renderer->swapchain.image_count, renderer->frames_in_flight);
+    return 0;
+}
+
+VkCommandBuffer renderer_begin_frame(struct vk_context* vk, struct renderer* renderer) {
+    if (renderer->swapchain_dirty && recreate_swapchain(vk, renderer) != 0) {
+        return VK_NULL_HANDLE;
+    }
+    struct frame_resources* frame = &renderer->frames[renderer->frame];
+
+    // Blocks only if the GPU is a full frames_in_flight frames behind.
+    {
+        PROFILE_SCOPE("wait_frame_fence");
+        vkWaitForFences(vk->device, 1, &frame->in_flight, VK_TRUE, UINT64_MAX);
+    }
+
+    VkResult result;
+    {
+        PROFILE_SCOPE("acquire_image");
+        result = vkAcquireNextImageKHR(vk->device, renderer->swapchain.handle, UINT64_MAX,
+                                       frame->image_acquired, VK_NULL_HANDLE, &renderer->image_index);
+    }
+    renderer->acquired_ns = platform_time_ns();
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        renderer->swapchain_dirty = 1;
+        return VK_NULL_HANDLE;
+    }
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        LOGE("vkAcquireNextImageKHR failed: %d", (int)result);
+        return VK_NULL_HANDLE;
+    }
+
+    // Only reset the fence once we know this frame will be submitted.
+    vkResetFences(vk->device, 1, &frame->in_flight);
+    vkResetCommandPool(vk->device, frame->command_pool, 0);
+    for (uint32_t i = 0; i < renderer->record_workers; i++) {
+        if (frame->workers[i].used > 0) {
+            vkResetCommandPool(vk->device, frame->workers[i].command_pool, 0);
+            frame->workers[i].used = 0;
+        }
+    }
+
+    VkCommandBufferBeginInfo begin{};
+    begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(frame->command_buffer, &begin);
+    return frame->command_buffer;
+}
+
+struct record_batch_params {
+    struct vk_context* vk;
+    struct renderer* renderer;
+    const struct rg_pass* pass;
+    uint32_t batch_size;
+    renderer_record_func func;
+    void* data;
+    VkCommandBuffer buffers[RENDER_MAX_SECONDARY];
+};
+
+/**
+ * Next secondary command buffer of the calling worker for this frame,
+ * allocated the first time a slot needs that many.
+ */
+static VkCommandBuffer worker_command_buffer(struct vk_context* vk, struct worker_commands* worker) {
+    if (worker->used == RENDER_MAX_SECONDARY) {
+        LOGE("more than %d secondary command buffers on one worker", RENDER_MAX_SECONDARY);
+        return VK_NULL_HANDLE;
+    }
+    if (worker->used == worker->allocated) {
+        VkCommandBufferAllocateInfo alloc{};
+        alloc.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc.commandPool = worker->command_pool;
+        alloc.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        alloc.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(vk->device, &alloc, &worker->buffers[worker->allocated]) != VK_SUCCESS) {
+            LOGE("cannot allocate a secondary command buffer");
+            return VK_NULL_HANDLE;
+        }
+        worker->allocated++;
+    }
+    return worker->buffers[worker->used++];
+}
+
+static void record_batch(void* data, uint32_t begin, uint32_t end) {
+    PROFILE_SCOPE("record_batch");
+    auto* params = (struct record_batch_params*)data;
+    struct renderer* renderer = params->renderer;
+    struct frame_resources* frame = &renderer->frames[renderer->frame];
+    uint32_t batch = begin / params->batch_size;
+    int worker = job_worker_index();
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    if (worker >= 0 && (uint32_t)worker < renderer->record_workers) {
+        cmd = worker_command_buffer(params->vk, &frame->workers[worker]);
+    } else {
+        LOGE("record_batch: worker %d has no command pool, only %u workers record", worker,
+             renderer->record_workers);
+    }
+    params->buffers[batch] = cmd;
+    if (cmd == VK_NULL_HANDLE) {
+        return;
+    }
+
+    VkCommandBufferInheritanceInfo inheritance{};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.renderPass = params->pass->render_pass;
+    inheritance.subpass = params->pass->subpass;
+    inheritance.framebuffer = params->pass->framebuffer;
+    VkCommandBufferBeginInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    info.pInheritanceInfo = &inheritance;
+    vkBeginCommandBuffer(cmd, &info);
+    // every pipeline takes viewport and scissor as dynamic state, which
+    // secondary command buffers do not inherit
+    rg_set_viewport(params->pass, cmd);
+    params->func(params->data, cmd, begin, end);
+    vkEndCommandBuffer(cmd);
+}
+
+void renderer_record_parallel(struct vk_context* vk, struct renderer* renderer,
+                              struct job_system* jobs, const struct rg_pass* pass, uint32_t count,
+                              uint32_t batches, renderer_record_func func, void* data) {
+    if (count == 0) {
+        return;
+    }
+    batches = std::clamp(batches, 1u, (uint32_t)RENDER_MAX_SECONDARY);
+    struct record_batch_params params;
+    params.vk = vk;
+    params.renderer = renderer;
+    params.pass = pass;
+    params.batch_size = (count + batches - 1) / batches;
+    params.func = func;
+    params.data = data;
+    job_parallel_for(jobs, count, params.batch_size, record_batch, &params);
+
+    // executed in batch order, so draw order does not depend on which
+    // worker recorded what
+    uint32_t recorded = (count + params.batch_size - 1) / params.batch_size;
+    uint32_t valid = 0;
+    for (uint32_t i = 0; i < recorded; i++) {
+        if (params.buffers[i] != VK_NULL_HANDLE) {
+            params.buffers[valid++] = params.buffers[i];
+        }
+    }
+    if (valid < recorded) {
+        LOGE("%u of %u secondary command buffers were not recorded, their draws are missing",
+             recorded - valid, recorded);
+    }
+    if (valid > 0) {
+        vkCmdExecuteCommands(renderer->frames[renderer->frame].command_buffer, valid, params.buffers);
+    }
+}
+
+void renderer_end_frame(struct vk_context* vk, struct renderer* renderer,
+                        int64_t desired_present_ns) {
+    PROFILE_SCOPE("submit_present");
+    struct frame_resources* frame = &renderer->frames[renderer->frame];
+    VkSemaphore present_ready = renderer->swapchain.present_ready[renderer->image_index];
+
+    vkEndCommandBuffer(frame->command_buffer);
+
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VkSubmitInfo submit{};
+    submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit.waitSemaphoreCount = 1;
+    submit.pWaitSemaphores = &frame->image_acquired;
+    submit.pWaitDstStageMask = &wait_stage;
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &frame->command_buffer;
+    submit.signalSemaphoreCount = 1;
+    submit.pSignalSemaphores = &present_ready;
+    VkResult result = vkQueueSubmit(vk->graphics_queue, 1, &submit, frame->in_flight);
+    if (result != VK_SUCCESS) {
+        LOGE("vkQueueSubmit failed: %d", (int)result);
+    }
+
+    VkPresentInfoKHR present{};
+    present.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    present.waitSemaphoreCount = 1;
+    present.pWaitSemaphores = &present_ready;
+    present.swapchainCount = 1;
+    present.pSwapchains = &renderer->swapchain.handle;
+    present.pImageIndices = &renderer->image_index;
+
+    VkPresentTimeGOOGLE time{};
+    VkPresentTimesInfoGOOGLE times{};
+    if (vk->has_display_timing) {
+        time.presentID = renderer->next_present_id++;
+        time.desiredPresentTime = desired_present_ns > 0 ? (uint64_t)desired_present_ns : 0;
+        times.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+        times.swapchainCount = 1;
+        times.pTimes = &time;
+        present.pNext = &times;
+    }
+    result = vkQueuePresentKHR(vk->graphics_queue, &present);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+        renderer->swapchain_dirty = 1;
+    } else if (result != VK_SUCCESS) {
+        LOGE("vkQueuePresentKHR failed: %d", (int)result);
+    }
+
+    renderer->frame = (renderer->frame + 1) % renderer->frames_in_flight;
+}
+
+int64_t renderer_refresh_duration(struct vk_context* vk, struct renderer* renderer) {
+    if (!vk->has_display_timing) {
+        return 0;
+    }
+    VkRefreshCycleDurationGOOGLE refresh{};
+    if (vk->get_refresh_cycle_duration(vk->device, renderer->swapchain.handle, &refresh) != VK_SUCCESS) {
+        return 0;
+    }
+    return (int64_t)refresh.refreshDuration;
+}
+
+uint32_t renderer_past_presents(struct vk_context* vk, struct renderer* renderer,
+                                int64_t* present_ns, uint32_t max_count) {
+    if (!vk->has_display_timing) {
+        return 0;
+    }
+    VkPastPresentationTimingGOOGLE timings[8];
+    uint32_t count = std::min(max_count, (uint32_t)(sizeof(timings) / sizeof(timings[0])));
+    VkResult result = vk->get_past_presentation_timing(vk->device, renderer->swapchain.handle,
+                                                       &count, timings);
+    if (result != VK_SUCCESS && result != VK_INCOMPLETE) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        present_ns[i] = (int64_t)timings[i].actualPresentTime;
+    }
+    return count;
+}
+
+void renderer_resize(struct renderer* renderer, uint32_t width, uint32_t height) {
+    renderer->width = width;
+    renderer->height = height;
+    renderer->swapchain_dirty = 1;
+}
+
+void renderer_destroy(struct vk_context* vk, struct renderer* renderer) {
+    if (vk->device == VK_NULL_HANDLE) {
+        return;
+    }
+    vkDeviceWaitIdle(vk->device);
+    for (struct frame_resources& frame : renderer->frames) {
+        if (frame.command_pool != VK_NULL_HANDLE) {
+            destroy_frame_resources(vk, &frame);
+        }
+    }
+    swapchain_destroy(vk, &renderer->swapchain);
+    *renderer = {};
+}
@@ -0,0 +1,126 @@
+#ifndef ENGINE_RENDERER_H
+#define ENGINE_RENDERER_H
+
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "jobs.h"
+#include "render_graph.h"
+#include "swapchain.h"
+#include "vk_context.h"
+
+#define MAX_FRAMES_IN_FLIGHT 3
+#define DEFAULT_FRAMES_IN_FLIGHT 2
+// secondary command buffers one renderer_record_parallel call can split into
+#define RENDER_MAX_SECONDARY 64
+
+/**
+ * Secondary command buffers of one worker thread for one frame slot. The
+ * pool is only touched by its worker while recording and by the render
+ * thread when the slot is reset, so no locking is needed.
+ */
+struct worker_commands {
+    VkCommandPool command_pool;
+    VkCommandBuffer buffers[RENDER_MAX_SECONDARY];
+    uint32_t allocated;
+    uint32_t used;
+};
+
+/**
+ * Everything the CPU touches to record one frame. A frame slot is only
+ * reused after its fence signals, so the CPU can record frame N+1 while
+ * the GPU is still executing frame N.
+ */
+struct frame_resources {
+    VkCommandPool command_pool;
+    VkCommandBuffer command_buffer;
+    VkFence in_flight;
+    VkSemaphore image_acquired;
+    struct worker_commands workers[MAX_JOB_WORKERS];
+};
+
+/**
+ * Records draws [begin, end) into cmd, which is inside a graph pass with
+ * viewport and scissor set.
+ */
+typedef void (*renderer_record_func)(void* data, VkCommandBuffer cmd, uint32_t begin, uint32_t end);
+
+struct renderer {
+    struct swapchain swapchain;
+    // bumped whenever the swapchain is recreated, so whatever renders into
+    // its images knows to rebuild
+    uint32_t swapchain_generation;
+    // depth attachment format supported by the device
+    VkFormat depth_format;
+    struct frame_resources frames[MAX_FRAMES_IN_FLIGHT];
+    uint32_t frames_in_flight;
+    // job workers that may record secondary command buffers
+    uint32_t record_workers;
+    // slot in frames[] used by the frame being recorded
+    uint32_t frame;
+    // swapchain image acquired for the frame being recorded
+    uint32_t image_index;
+    uint32_t width;
+    uint32_t height;
+    int swapchain_dirty;
+    // VK_GOOGLE_display_timing present ids, and when the last acquire
+    // returned (the vsync estimate used without display timing)
+    uint32_t next_present_id;
+    int64_t acquired_ns;
+};
+
+/**
+ * Create the swapchain and per-frame resources.
+ * frames_in_flight is clamped to [1, MAX_FRAMES_IN_FLIGHT]; each of
+ * record_workers job workers gets a command pool per frame slot.
+ */
+int renderer_init(struct vk_context* vk, struct renderer* renderer,
+                  uint32_t width, uint32_t height, uint32_t frames_in_flight,
+                  uint32_t record_workers);
+
+/**
+ * Wait for the next frame slot, acquire a swapchain image and begin its
+ * command buffer. Returns VK_NULL_HANDLE when no frame can be drawn right
+ * now (e.g. while the swapchain is recreated).
+ */
+VkCommandBuffer renderer_begin_frame(struct vk_context* vk, struct renderer* renderer);
+
+/**
+ * Split draws [0, count) into up to batches secondary command buffers,
+ * recorded by func on the job workers, and execute them in order from
+ * pass. Call from the pass's execute callback, with the pass contents set
+ * to VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+ */
+void renderer_record_parallel(struct vk_context* vk, struct renderer* renderer,
+                              struct job_system* jobs, const struct rg_pass* pass, uint32_t count,
+                              uint32_t batches, renderer_record_func func, void* data);
+
+/**
+ * Submit and present the frame started by renderer_begin_frame. With
+ * VK_GOOGLE_display_timing, a non-zero desired_present_ns asks the display
+ * not to show the frame before that time.
+ */
+void renderer_end_frame(struct vk_context* vk, struct renderer* renderer,
+                        int64_t desired_present_ns = 0);
+
+/**
+ * Display refresh period reported by the driver, 0 if unknown.
+ */
+int64_t renderer_refresh_duration(struct vk_context* vk, struct renderer* renderer);
+
+/**
+ * Actual present times of frames that reached the display since the last
+ * call. Returns 0 without VK_GOOGLE_display_timing.
+ */
+uint32_t renderer_past_presents(struct vk_context* vk, struct renderer* renderer,
+                                int64_t* present_ns, uint32_t max_count);
+
+/**
+ * Mark the swapchain for recreation at the start of the next frame.
+ */
+void renderer_resize(struct renderer* renderer, uint32_t width, uint32_t height);
+
+void renderer_destroy(struct vk_context* vk, struct renderer* renderer);
+
+#endif // ENGINE_RENDERER_H
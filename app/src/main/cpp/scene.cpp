@@ -0,0 +1,116 @@
+#include "scene.h"
+
+#include "log.h"
+#include "profiler.h"
+
+int scene_init(struct scene* scene) {
+    if (ecs_world_init(&scene->world) != 0) {
+        return -1;
+    }
+    // order must match enum component_id
+    ecs_register_component(&scene->world, sizeof(struct transform), alignof(struct transform));
+    ecs_register_component(&scene->world, sizeof(struct velocity), alignof(struct velocity));
+    ecs_register_component(&scene->world, sizeof(struct spin), alignof(struct spin));
+    ecs_register_component(&scene->world, sizeof(struct local_to_world), alignof(struct local_to_world));
+    ecs_register_component(&scene->world, sizeof(struct renderable), alignof(struct renderable));
+    scene->bounds = 50.0f;
+    return 0;
+}
+
+void scene_destroy(struct scene* scene) {
+    ecs_world_destroy(&scene->world);
+}
+
+static float random_float(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return (float)(*state >> 8) / 16777216.0f;
+}
+
+void scene_spawn_demo(struct scene* scene, uint32_t count, uint32_t seed) {
+    const ecs_mask fixed = ECS_BIT(COMPONENT_TRANSFORM) | ECS_BIT(COMPONENT_LOCAL_TO_WORLD) |
+                           ECS_BIT(COMPONENT_RENDERABLE);
+    const ecs_mask moving = fixed | ECS_BIT(COMPONENT_VELOCITY) | ECS_BIT(COMPONENT_SPIN);
+    uint32_t rng = seed;
+    float b = scene->bounds;
+
+    for (uint32_t i = 0; i < count; i++) {
+        // every fourth entity is static scenery
+        bool is_static = (i & 3) == 0;
+        entity e = ecs_create(&scene->world, is_static ? fixed : moving);
+        if (e == ECS_NULL_ENTITY) {
+            LOGW("scene: spawned %u of %u entities", i, count);
+            return;
+        }
+        auto* t = ecs_get<struct transform>(&scene->world, e, COMPONENT_TRANSFORM);
+        t->position = { (random_float(&rng) * 2.0f - 1.0f) * b,
+                        (random_float(&rng) * 2.0f - 1.0f) * b,
+                        (random_float(&rng) * 2.0f - 1.0f) * b };
+        t->rotation = quat_identity();
+        t->scale = 0.5f + random_float(&rng);
+        auto* m = ecs_get<struct local_to_world>(&scene->world, e, COMPONENT_LOCAL_TO_WORLD);
+        m->matrix = mat4_from_trs(t->position, t->rotation, { t->scale, t->scale, t->scale });
+        auto* r = ecs_get<struct renderable>(&scene->world, e, COMPONENT_RENDERABLE);
+        r->mesh = 0;
+        r->material = (uint16_t)(random_float(&rng) * SCENE_DEMO_MATERIALS);
+        if (is_static) {
+            continue;
+        }
+        auto* v = ecs_get<struct velocity>(&scene->world, e, COMPONENT_VELOCITY);
+        v->linear = { random_float(&rng) * 4.0f - 2.0f,
+                      random_float(&rng) * 4.0f - 2.0f,
+                      random_float(&rng) * 4.0f - 2.0f };
+        auto* s = ecs_get<struct spin>(&scene->world, e, COMPONENT_SPIN);
+        s->axis = vec3_normalize({ random_float(&rng) - 0.5f, 1.0f, random_float(&rng) - 0.5f });
+        s->radians_per_second = random_float(&rng) * 3.0f;
+    }
+}
+
+struct update_params {
+    float dt;
+    float bounds;
+};
+
+// one axis against walls at +-bounds: what overshot is put back on the
+// wall and only turned around when still heading out, so a long frame
+// cannot leave it outside flipping direction every frame
+static inline void bounce(float* position, float* velocity, float bounds) {
+    if (*position > bounds) {
+        *position = bounds;
+        if (*velocity > 0.0f) *velocity = -*velocity;
+    } else if (*position < -bounds) {
+        *position = -bounds;
+        if (*velocity < 0.0f) *velocity = -*velocity;
+    }
+}
+
+static void update_chunk(struct ecs_chunk* chunk, void* data) {
+    PROFILE_SCOPE("update_chunk");
+    auto* params = (const struct update_params*)data;
+    struct transform* transforms = ecs_column<struct transform>(chunk, COMPONENT_TRANSFORM);
+    struct velocity* velocities = ecs_column<struct velocity>(chunk, COMPONENT_VELOCITY);
+    struct spin* spins = ecs_column<struct spin>(chunk, COMPONENT_SPIN);
+    struct local_to_world* matrices = ecs_column<struct local_to_world>(chunk, COMPONENT_LOCAL_TO_WORLD);
+    float b = params->bounds;
+
+    for (uint32_t i = 0; i < chunk->count; i++) {
+        struct transform* t = &transforms[i];
+        struct velocity* v = &velocities[i];
+        t->position = vec3_add(t->position, vec3_scale(v->linear, params->dt));
+        // bounce off the walls of the box
+        bounce(&t->position.x, &v->linear.x, b);
+        bounce(&t->position.y, &v->linear.y, b);
+        bounce(&t->position.z, &v->linear.z, b);
+
+        struct quat delta = quat_from_axis_angle(spins[i].axis, spins[i].radians_per_second * params->dt);
+        t->rotation = quat_normalize(quat_mul(delta, t->rotation));
+        matrices[i].matrix = mat4_from_trs(t->position, t->rotation, { t->scale, t->scale, t->scale });
+    }
+}
+
+void scene_update(struct scene* scene, struct job_system* jobs, float dt) {
+    PROFILE_SCOPE("scene_update");
+    const ecs_mask moving = ECS_BIT(COMPONENT_TRANSFORM) | ECS_BIT(COMPONENT_VELOCITY) |
+                            ECS_BIT(COMPONENT_SPIN) | ECS_BIT(COMPONENT_LOCAL_TO_WORLD);
+    struct update_params params{ dt, scene->bounds };
+    ecs_parallel_for_chunks(&scene->world, jobs, moving, 0, update_chunk, &params);
+}
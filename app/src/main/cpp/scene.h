@@ -0,0 +1,77 @@
+#ifndef ENGINE_SCENE_H
+#define ENGINE_SCENE_H
+
+#include <cstdint>
+
+#include "ecs.h"
+#include "jobs.h"
+#include "vecmath.h"
+
+/**
+ * Component ids, registered in this order by scene_init.
+ */
+enum component_id {
+    COMPONENT_TRANSFORM,
+    COMPONENT_VELOCITY,
+    COMPONENT_SPIN,
+    COMPONENT_LOCAL_TO_WORLD,
+    COMPONENT_RENDERABLE,
+    COMPONENT_COUNT
+};
+
+struct transform {
+    struct quat rotation;
+    struct vec3 position;
+    float scale;
+};
+
+struct velocity {
+    struct vec3 linear;
+};
+
+struct spin {
+    struct vec3 axis;
+    float radians_per_second;
+};
+
+struct local_to_world {
+    struct mat4 matrix;
+};
+
+// materials scene_spawn_demo hands out; the scene renderer defines them
+#define SCENE_DEMO_MATERIALS 8
+
+/**
+ * What an entity is drawn with, indices into the scene renderer's tables.
+ */
+struct renderable {
+    uint16_t mesh;
+    uint16_t material;
+};
+
+/**
+ * Simulation state: everything that used to be a field of struct engine
+ * and describes the world rather than the app lives here as entities.
+ */
+struct scene {
+    struct ecs_world world;
+    // half extent of the box the demo entities bounce around in
+    float bounds;
+};
+
+int scene_init(struct scene* scene);
+
+void scene_destroy(struct scene* scene);
+
+/**
+ * Populate the world with count moving, spinning entities.
+ */
+void scene_spawn_demo(struct scene* scene, uint32_t count, uint32_t seed);
+
+/**
+ * Advance the simulation by dt seconds and refresh local_to_world matrices,
+ * one job per chunk.
+ */
+void scene_update(struct scene* scene, struct job_system* jobs, float dt);
+
+#endif // ENGINE_SCENE_H
@@ -0,0 +1,292 @@
+#include "scene_renderer.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "gpu_cull.h"
+#include "profiler.h"
+#include "scene_shader.h"
+
+static_assert(SCENE_VERTEX_STRIDE == sizeof(struct local_to_world),
+              "scene.vert instance attributes must match struct local_to_world");
+static_assert(SCENE_COLOR_OUTPUTS == 1, "the main pass has one color attachment");
+static_assert(SCENE_PIPELINE_COUNT <= DRAW_MAX_PIPELINES && SCENE_DEMO_MATERIALS <= DRAW_MAX_MATERIALS,
+              "scene pipelines and materials must fit their sort key fields");
+
+static const struct scene_material demo_materials[SCENE_DEMO_MATERIALS] = {
+    { SCENE_PIPELINE_OPAQUE, { 1.0f, 1.0f, 1.0f, 1.0f } },
+    { SCENE_PIPELINE_OPAQUE, { 1.0f, 0.45f, 0.35f, 1.0f } },
+    { SCENE_PIPELINE_OPAQUE, { 0.4f, 0.9f, 0.45f, 1.0f } },
+    { SCENE_PIPELINE_OPAQUE, { 0.35f, 0.55f, 1.0f, 1.0f } },
+    { SCENE_PIPELINE_OPAQUE, { 1.0f, 0.85f, 0.3f, 1.0f } },
+    { SCENE_PIPELINE_OPAQUE, { 0.75f, 0.4f, 1.0f, 1.0f } },
+    { SCENE_PIPELINE_TWO_SIDED, { 0.3f, 0.95f, 0.95f, 1.0f } },
+    { SCENE_PIPELINE_TWO_SIDED, { 0.6f, 0.6f, 0.6f, 1.0f } },
+};
+
+static int create_pipelines(struct vk_context* vk, struct scene_renderer* sr, VkRenderPass render_pass) {
+    if (shader_program_create_layout(vk, &scene_program, sr->set_layouts, &sr->layout) != 0) {
+        return -1;
+    }
+
+    VkShaderModule modules[SHADER_MAX_STAGES];
+    VkPipelineShaderStageCreateInfo stages[SHADER_MAX_STAGES];
+    if (shader_program_create_stages(vk, &scene_program, modules, stages) != 0) {
+        return -1;
+    }
+
+    // one mat4 per instance, fed as four vec4 columns
+    VkVertexInputBindingDescription binding{};
+    binding.binding = 0;
+    binding.stride = scene_program.vertex_stride;
+    binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    VkPipelineVertexInputStateCreateInfo vertex_input{};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input.vertexBindingDescriptionCount = 1;
+    vertex_input.pVertexBindingDescriptions = &binding;
+    vertex_input.vertexAttributeDescriptionCount = scene_program.attribute_count;
+    vertex_input.pVertexAttributeDescriptions = scene_program.attributes;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly{};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewport{};
+    viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+
+    // the projection flips y, which keeps counter-clockwise faces in front
+    VkPipelineRasterizationStateCreateInfo raster{};
+    raster.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    raster.polygonMode = VK_POLYGON_MODE_FILL;
+    raster.cullMode = VK_CULL_MODE_BACK_BIT;
+    raster.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    raster.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample{};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineDepthStencilStateCreateInfo depth{};
+    depth.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth.depthTestEnable = VK_TRUE;
+    depth.depthWriteEnable = VK_TRUE;
+    depth.depthCompareOp = VK_COMPARE_OP_LESS;
+
+    VkPipelineColorBlendAttachmentState blend_attachment{};
+    blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo blend{};
+    blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    blend.attachmentCount = 1;
+    blend.pAttachments = &blend_attachment;
+
+    const VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic{};
+    dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic.dynamicStateCount = 2;
+    dynamic.pDynamicStates = dynamic_states;
+
+    VkGraphicsPipelineCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    info.stageCount = scene_program.stage_count;
+    info.pStages = stages;
+    info.pVertexInputState = &vertex_input;
+    info.pInputAssemblyState = &input_assembly;
+    info.pViewportState = &viewport;
+    info.pRasterizationState = &raster;
+    info.pMultisampleState = &multisample;
+    info.pDepthStencilState = &depth;
+    info.pColorBlendState = &blend;
+    info.pDynamicState = &dynamic;
+    info.layout = sr->layout;
+    info.renderPass = render_pass;
+    info.subpass = 0;
+
+    // the variants only differ in rasterization state
+    VkPipelineRasterizationStateCreateInfo two_sided = raster;
+    two_sided.cullMode = VK_CULL_MODE_NONE;
+    VkGraphicsPipelineCreateInfo infos[SCENE_PIPELINE_COUNT] = { info, info };
+    infos[SCENE_PIPELINE_TWO_SIDED].pRasterizationState = &two_sided;
+    VkResult result = vkCreateGraphicsPipelines(vk->device, vk->pipeline_cache, SCENE_PIPELINE_COUNT, infos,
+                                                nullptr, sr->pipelines);
+    shader_program_destroy_modules(vk, &scene_program, modules);
+    VK_CHECK(result);
+    return 0;
+}
+
+void scene_renderer_init_batching(struct scene_renderer* sr, uint32_t max_instances) {
+    for (uint32_t i = 0; i < SCENE_DEMO_MATERIALS; i++) {
+        sr->materials[i] = demo_materials[i];
+    }
+    sr->max_instances = max_instances > 0 ? max_instances : 1;
+    draw_batcher_reserve(&sr->batcher, sr->max_instances);
+}
+
+int scene_renderer_init(struct vk_context* vk, struct scene_renderer* sr,
+                        const struct renderer* renderer, VkRenderPass render_pass,
+                        uint32_t max_instances) {
+    if (create_pipelines(vk, sr, render_pass) != 0) {
+        return -1;
+    }
+    scene_renderer_init_batching(sr, max_instances);
+    VkDeviceSize size = (VkDeviceSize)sr->max_instances * sizeof(struct local_to_world);
+    for (uint32_t i = 0; i < renderer->frames_in_flight; i++) {
+        struct instance_buffer* instances = &sr->instances[i];
+        if (vk_create_buffer(vk, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             &instances->buffer, &instances->memory) != 0) {
+            return -1;
+        }
+        instances->mapped = instances->memory.mapped;
+    }
+    return 0;
+}
+
+struct key_params {
+    struct scene_renderer* sr;
+    const struct scene_cull* cull;
+    // view depth of a point, the clip space w row of view_proj
+    struct vec4 depth_row;
+};
+
+static void make_keys(void* data, uint32_t begin, uint32_t end) {
+    auto* params = (const struct key_params*)data;
+    const struct scene_material* materials = params->sr->materials;
+    const uint32_t* visible = params->cull->visible.data();
+    const struct local_to_world* const* matrices = params->cull->matrices.data();
+    const struct renderable* const* renderables = params->cull->renderables.data();
+    uint64_t* keys = params->sr->batcher.keys.data();
+    uint32_t* items = params->sr->batcher.items.data();
+    struct vec4 row = params->depth_row;
+    for (uint32_t i = begin; i < end; i++) {
+        uint32_t object = visible[i];
+        const struct renderable* renderable = renderables[object];
+        uint32_t material = renderable->material < SCENE_DEMO_MATERIALS ? renderable->material : 0;
+        const struct vec4* position = &matrices[object]->matrix.cols[3];
+        float depth = row.x * position->x + row.y * position->y + row.z * position->z + row.w;
+        keys[i] = draw_key_make(SCENE_PASS_MAIN, materials[material].pipeline, material, renderable->mesh,
+                                draw_depth_bucket(depth));
+        items[i] = object;
+    }
+}
+
+void scene_renderer_sort(struct scene_renderer* sr, struct job_system* jobs, const struct scene_cull* cull,
+                         const struct mat4* view_proj, struct arena* scratch) {
+    struct key_params params{};
+    params.sr = sr;
+    params.cull = cull;
+    params.depth_row = { view_proj->cols[0].w, view_proj->cols[1].w, view_proj->cols[2].w,
+                         view_proj->cols[3].w };
+    uint32_t count = std::min(cull->visible_count, sr->max_instances);
+    job_parallel_for(jobs, count, 4096, make_keys, &params);
+    draw_batcher_sort(&sr->batcher, count, scratch);
+    sr->instance_count = count;
+}
+
+struct upload_params {
+    struct local_to_world* out;
+    const uint32_t* items;
+    const struct local_to_world* const* matrices;
+};
+
+static void upload_instances(void* data, uint32_t begin, uint32_t end) {
+    auto* params = (const struct upload_params*)data;
+    for (uint32_t i = begin; i < end; i++) {
+        params->out[i] = *params->matrices[params->items[i]];
+    }
+}
+
+void scene_renderer_upload(struct scene_renderer* sr, const struct renderer* renderer,
+                           struct job_system* jobs, const struct scene_cull* cull,
+                           const struct mat4* view_proj, struct arena* scratch) {
+    PROFILE_SCOPE("scene_upload");
+    scene_renderer_sort(sr, jobs, cull, view_proj, scratch);
+    struct upload_params params{};
+    params.out = (struct local_to_world*)sr->instances[renderer->frame].mapped;
+    params.items = sr->batcher.items.data();
+    params.matrices = cull->matrices.data();
+    job_parallel_for(jobs, sr->instance_count, 4096, upload_instances, &params);
+}
+
+void scene_renderer_draw(struct scene_renderer* sr, const struct renderer* renderer,
+                         VkCommandBuffer cmd, const struct mat4* view_proj,
+                         uint32_t begin, uint32_t end) {
+    if (begin >= end) {
+        return;
+    }
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(cmd, 0, 1, &sr->instances[renderer->frame].buffer, &offset);
+    // every pipeline shares the layout, so the constants survive rebinds
+    vkCmdPushConstants(cmd, sr->layout, VK_SHADER_STAGE_VERTEX_BIT,
+                       offsetof(struct scene_push_constants, view_proj), sizeof(*view_proj), view_proj);
+    const struct draw_batch* batches = sr->batcher.batches.data();
+    uint32_t pipeline = UINT32_MAX;
+    uint32_t material = UINT32_MAX;
+    for (uint32_t i = begin; i < end; i++) {
+        const struct draw_batch* batch = &batches[i];
+        if (batch->pipeline != pipeline) {
+            pipeline = batch->pipeline;
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, sr->pipelines[pipeline]);
+        }
+        if (batch->material != material) {
+            material = batch->material;
+            vkCmdPushConstants(cmd, sr->layout, VK_SHADER_STAGE_VERTEX_BIT,
+                               offsetof(struct scene_push_constants, tint), sizeof(struct vec4),
+                               &sr->materials[material].tint);
+        }
+        vkCmdDraw(cmd, 36, batch->instance_count, 0, batch->first_instance);
+    }
+}
+
+struct draw_batch_stats scene_renderer_draw_indirect(struct vk_context* vk, struct scene_renderer* sr,
+                                                     VkCommandBuffer cmd, const struct mat4* view_proj,
+                                                     VkBuffer instances, VkBuffer draws) {
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(cmd, 0, 1, &instances, &offset);
+    vkCmdPushConstants(cmd, sr->layout, VK_SHADER_STAGE_VERTEX_BIT,
+                       offsetof(struct scene_push_constants, view_proj), sizeof(*view_proj), view_proj);
+    struct draw_batch_stats stats{};
+    for (uint32_t pipeline = 0; pipeline < SCENE_PIPELINE_COUNT; pipeline++) {
+        bool bound = false;
+        for (uint32_t material = 0; material < SCENE_DEMO_MATERIALS; material++) {
+            if (sr->materials[material].pipeline != pipeline) {
+                continue;
+            }
+            if (!bound) {
+                vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, sr->pipelines[pipeline]);
+                stats.pipeline_binds++;
+                bound = true;
+            }
+            vkCmdPushConstants(cmd, sr->layout, VK_SHADER_STAGE_VERTEX_BIT,
+                               offsetof(struct scene_push_constants, tint), sizeof(struct vec4),
+                               &sr->materials[material].tint);
+            stats.material_binds++;
+            VkDeviceSize command = gpu_cull_draws_offset(material);
+            if (vk->has_draw_indirect_count) {
+                vk->cmd_draw_indirect_count(cmd, draws, command, draws, command + sizeof(VkDrawIndirectCommand),
+                                            1, sizeof(struct gpu_cull_draws));
+            } else {
+                // a command with no instances when none of the material's
+                // objects are visible
+                vkCmdDrawIndirect(cmd, draws, command, 1, sizeof(struct gpu_cull_draws));
+            }
+            stats.draws++;
+        }
+    }
+    return stats;
+}
+
+void scene_renderer_destroy(struct vk_context* vk, struct scene_renderer* sr) {
+    for (struct instance_buffer& instances : sr->instances) {
+        vk_destroy_buffer(vk, &instances.buffer, &instances.memory);
+    }
+    for (VkPipeline pipeline : sr->pipelines) {
+        if (pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(vk->device, pipeline, nullptr);
+        }
+    }
+    shader_program_destroy_layout(vk, &scene_program, sr->set_layouts, sr->layout);
+    *sr = {};
+}
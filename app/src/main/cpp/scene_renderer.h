@@ -0,0 +1,119 @@
+#ifndef ENGINE_SCENE_RENDERER_H
+#define ENGINE_SCENE_RENDERER_H
+
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "cull.h"
+#include "draw_batch.h"
+#include "jobs.h"
+#include "renderer.h"
+#include "scene.h"
+#include "shader_program.h"
+#include "vecmath.h"
+#include "vk_context.h"
+
+/**
+ * Host visible per-instance data for one frame slot. Rewritten every frame
+ * once the slot's fence has signalled.
+ */
+struct instance_buffer {
+    VkBuffer buffer;
+    struct gpu_allocation memory;
+    void* mapped;
+};
+
+// the only pass scene draws go into so far
+#define SCENE_PASS_MAIN 0
+
+enum scene_pipeline {
+    SCENE_PIPELINE_OPAQUE,
+    // no backface culling
+    SCENE_PIPELINE_TWO_SIDED,
+    SCENE_PIPELINE_COUNT
+};
+
+/**
+ * Materials are a pipeline plus a color pushed as a constant; there are no
+ * per-material descriptor sets yet.
+ */
+struct scene_material {
+    enum scene_pipeline pipeline;
+    struct vec4 tint;
+};
+
+/**
+ * Draws the entities that survived frustum culling as instanced cubes.
+ * Every visible entity gets a draw_batch sort key; after sorting, entities
+ * sharing pipeline, material and mesh are one instanced draw.
+ */
+struct scene_renderer {
+    VkDescriptorSetLayout set_layouts[SHADER_MAX_SETS];
+    VkPipelineLayout layout;
+    VkPipeline pipelines[SCENE_PIPELINE_COUNT];
+    struct scene_material materials[SCENE_DEMO_MATERIALS];
+    struct instance_buffer instances[MAX_FRAMES_IN_FLIGHT];
+    uint32_t max_instances;
+    // instances and batches for the frame being recorded, sized for the
+    // worst case at init
+    uint32_t instance_count;
+    struct draw_batcher batcher;
+};
+
+/**
+ * Create the pipeline (through vk->pipeline_cache) and instance buffers.
+ * The pipeline stays usable with any render pass compatible with
+ * render_pass, so it survives the render graph being rebuilt.
+ */
+int scene_renderer_init(struct vk_context* vk, struct scene_renderer* sr,
+                        const struct renderer* renderer, VkRenderPass render_pass,
+                        uint32_t max_instances);
+
+/**
+ * Set up the materials and size the batcher for max_instances; the part
+ * of scene_renderer_init that needs no device.
+ */
+void scene_renderer_init_batching(struct scene_renderer* sr, uint32_t max_instances);
+
+/**
+ * Key the visible entities by pipeline, material, mesh and view depth,
+ * sort them and merge them into batches. Touches no Vulkan object, so it
+ * also runs without a device.
+ */
+void scene_renderer_sort(struct scene_renderer* sr, struct job_system* jobs, const struct scene_cull* cull,
+                         const struct mat4* view_proj, struct arena* scratch);
+
+/**
+ * Sort the visible entities, then copy their local_to_world matrices into
+ * the current frame slot in sorted order, spread over the job workers.
+ * Call after renderer_begin_frame and once culling is done.
+ */
+void scene_renderer_upload(struct scene_renderer* sr, const struct renderer* renderer,
+                           struct job_system* jobs, const struct scene_cull* cull,
+                           const struct mat4* view_proj, struct arena* scratch);
+
+/**
+ * Record batches [begin, end) into the main pass, binding all the state
+ * they need so each range can go into its own secondary command buffer,
+ * and only rebinding pipeline and material when they change.
+ */
+void scene_renderer_draw(struct scene_renderer* sr, const struct renderer* renderer,
+                         VkCommandBuffer cmd, const struct mat4* view_proj,
+                         uint32_t begin, uint32_t end);
+
+/**
+ * Record the draws the GPU culling pass filled in, one per material:
+ * instances come from instances, the commands and their counts from
+ * draws, laid out as gpu_cull_draws_offset describes. Materials are drawn
+ * grouped by pipeline. Uses vkCmdDrawIndirectCount where available, so
+ * materials with nothing visible are not drawn at all. Returns the draws
+ * and binds recorded.
+ */
+struct draw_batch_stats scene_renderer_draw_indirect(struct vk_context* vk, struct scene_renderer* sr,
+                                                     VkCommandBuffer cmd, const struct mat4* view_proj,
+                                                     VkBuffer instances, VkBuffer draws);
+
+void scene_renderer_destroy(struct vk_context* vk, struct scene_renderer* sr);
+
+#endif // ENGINE_SCENE_RENDERER_H
@@ -0,0 +1,93 @@
+#include "shader_program.h"
+
+int shader_program_create_layout(struct vk_context* vk, const struct shader_program* program,
+                                 VkDescriptorSetLayout* set_layouts, VkPipelineLayout* layout) {
+    if (program->set_count > SHADER_MAX_SETS) {
+        LOGE("%s: %u descriptor sets, at most %d supported", program->name, program->set_count,
+             SHADER_MAX_SETS);
+        return -1;
+    }
+    for (uint32_t set = 0; set < program->set_count; set++) {
+        // gaps in the set numbering get empty layouts
+        VkDescriptorSetLayoutBinding bindings[SHADER_MAX_BINDINGS];
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < program->binding_count; i++) {
+            const struct shader_binding* binding = &program->bindings[i];
+            if (binding->set != set) {
+                continue;
+            }
+            if (count == SHADER_MAX_BINDINGS) {
+                LOGE("%s: more than %d bindings in set %u", program->name, SHADER_MAX_BINDINGS, set);
+                return -1;
+            }
+            bindings[count] = {};
+            bindings[count].binding = binding->binding;
+            bindings[count].descriptorType = binding->type;
+            bindings[count].descriptorCount = binding->count;
+            bindings[count].stageFlags = binding->stages;
+            count++;
+        }
+        VkDescriptorSetLayoutCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        info.bindingCount = count;
+        info.pBindings = bindings;
+        VK_CHECK(vkCreateDescriptorSetLayout(vk->device, &info, nullptr, &set_layouts[set]));
+    }
+
+    VkPipelineLayoutCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    info.setLayoutCount = program->set_count;
+    info.pSetLayouts = set_layouts;
+    info.pushConstantRangeCount = program->push_constant_count;
+    info.pPushConstantRanges = program->push_constants;
+    VK_CHECK(vkCreatePipelineLayout(vk->device, &info, nullptr, layout));
+    return 0;
+}
+
+void shader_program_destroy_layout(struct vk_context* vk, const struct shader_program* program,
+                                   VkDescriptorSetLayout* set_layouts, VkPipelineLayout layout) {
+    if (layout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(vk->device, layout, nullptr);
+    }
+    for (uint32_t set = 0; set < program->set_count && set < SHADER_MAX_SETS; set++) {
+        if (set_layouts[set] != VK_NULL_HANDLE) {
+            vkDestroyDescriptorSetLayout(vk->device, set_layouts[set], nullptr);
+            set_layouts[set] = VK_NULL_HANDLE;
+        }
+    }
+}
+
+int shader_program_create_stages(struct vk_context* vk, const struct shader_program* program,
+                                 VkShaderModule* modules, VkPipelineShaderStageCreateInfo* stages) {
+    for (uint32_t i = 0; i < program->stage_count; i++) {
+        modules[i] = VK_NULL_HANDLE;
+    }
+    for (uint32_t i = 0; i < program->stage_count; i++) {
+        VkShaderModuleCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        info.codeSize = program->stages[i].size;
+        info.pCode = program->stages[i].code;
+        VkResult result = vkCreateShaderModule(vk->device, &info, nullptr, &modules[i]);
+        if (result != VK_SUCCESS) {
+            LOGE("%s: vkCreateShaderModule failed: %d", program->name, (int)result);
+            shader_program_destroy_modules(vk, program, modules);
+            return -1;
+        }
+        stages[i] = {};
+        stages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[i].stage = program->stages[i].stage;
+        stages[i].module = modules[i];
+        stages[i].pName = "main";
+    }
+    return 0;
+}
+
+void shader_program_destroy_modules(struct vk_context* vk, const struct shader_program* program,
+                                    VkShaderModule* modules) {
+    for (uint32_t i = 0; i < program->stage_count; i++) {
+        if (modules[i] != VK_NULL_HANDLE) {
+            vkDestroyShaderModule(vk->device, modules[i], nullptr);
+            modules[i] = VK_NULL_HANDLE;
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef ENGINE_SHADER_PROGRAM_H
+#define ENGINE_SHADER_PROGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "vk_context.h"
+
+/**
+ * Shader programs are compiled and reflected at build time by
+ * tools/shader_reflect.py into <name>_shader.h, which defines a
+ * <name>_program plus layout constants (<NAME>_PUSH_CONSTANTS_SIZE,
+ * <NAME>_VERTEX_STRIDE, ...) that C++ code static_asserts against.
+ */
+#define SHADER_MAX_STAGES 5
+#define SHADER_MAX_SETS 4
+#define SHADER_MAX_BINDINGS 16
+
+struct shader_stage {
+    VkShaderStageFlagBits stage;
+    const uint32_t* code;
+    size_t size;
+};
+
+struct shader_binding {
+    uint32_t set;
+    uint32_t binding;
+    VkDescriptorType type;
+    uint32_t count;
+    VkShaderStageFlags stages;
+};
+
+struct shader_program {
+    const char* name;
+    const struct shader_stage* stages;
+    uint32_t stage_count;
+    const struct shader_binding* bindings;
+    uint32_t binding_count;
+    uint32_t set_count;
+    const VkPushConstantRange* push_constants;
+    uint32_t push_constant_count;
+    // all attributes live in binding 0, tightly packed
+    const VkVertexInputAttributeDescription* attributes;
+    uint32_t attribute_count;
+    uint32_t vertex_stride;
+};
+
+/**
+ * Descriptor set layouts and pipeline layout straight from the reflected
+ * constants. set_layouts must have room for SHADER_MAX_SETS entries.
+ */
+int shader_program_create_layout(struct vk_context* vk, const struct shader_program* program,
+                                 VkDescriptorSetLayout* set_layouts, VkPipelineLayout* layout);
+
+void shader_program_destroy_layout(struct vk_context* vk, const struct shader_program* program,
+                                   VkDescriptorSetLayout* set_layouts, VkPipelineLayout layout);
+
+/**
+ * Shader modules and stage infos for pipeline creation. The modules can be
+ * destroyed as soon as the pipeline exists. Both arrays need room for
+ * SHADER_MAX_STAGES entries.
+ */
+int shader_program_create_stages(struct vk_context* vk, const struct shader_program* program,
+                                 VkShaderModule* modules, VkPipelineShaderStageCreateInfo* stages);
+
+void shader_program_destroy_modules(struct vk_context* vk, const struct shader_program* program,
+                                    VkShaderModule* modules);
+
+#endif // ENGINE_SHADER_PROGRAM_H
@@ -0,0 +1,51 @@
+#version 450
+
+// Meshes built by tools/build_mesh.py, 20 bytes per vertex. The packed
+// attributes arrive as raw words and are unpacked here, see mesh.h.
+layout(location = 0) in uvec2 packed_position; // 4 x half: xyz in the mesh bounds, w bitangent sign
+layout(location = 1) in uint packed_normal;    // 2 x snorm16, octahedral
+layout(location = 2) in uint packed_tangent;   // 2 x snorm16, octahedral
+layout(location = 3) in uint packed_uv;        // 2 x unorm16 in the uv bounds
+
+layout(push_constant) uniform push_constants {
+    // view_proj * model * the mesh bounds, so positions go straight from
+    // their [-1, 1] encoding to clip space
+    mat4 clip_from_mesh;
+    // inverse transpose of the model matrix's upper 3x3; tangents use it
+    // too, which is exact for rotations and uniform scale
+    vec4 normal_matrix[3];
+    // uv offset in xy, scale in zw
+    vec4 uv_transform;
+} pc;
+
+layout(location = 0) out vec3 out_color;
+
+const vec3 light_dir = vec3(0.38, 0.84, 0.38);
+
+vec3 oct_decode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main() {
+    vec4 position = vec4(unpackHalf2x16(packed_position.x), unpackHalf2x16(packed_position.y));
+    vec3 normal = oct_decode(unpackSnorm2x16(packed_normal));
+    vec3 tangent = oct_decode(unpackSnorm2x16(packed_tangent));
+    vec2 uv = pc.uv_transform.xy + unpackUnorm2x16(packed_uv) * pc.uv_transform.zw;
+
+    gl_Position = pc.clip_from_mesh * vec4(position.xyz, 1.0);
+
+    mat3 normal_matrix = mat3(pc.normal_matrix[0].xyz, pc.normal_matrix[1].xyz, pc.normal_matrix[2].xyz);
+    vec3 world_normal = normalize(normal_matrix * normal);
+    vec3 world_tangent = normalize(normal_matrix * tangent);
+    vec3 world_bitangent = cross(world_normal, world_tangent) * position.w;
+    // a procedural ripple in tangent space, so the tangent frame and uvs
+    // show up on screen
+    vec2 ripple = 0.2 * cos(uv * 40.0);
+    vec3 shading_normal = normalize(world_normal + ripple.x * world_tangent + ripple.y * world_bitangent);
+    float light = 0.25 + 0.75 * max(dot(shading_normal, light_dir), 0.0);
+    out_color = vec3(light);
+}
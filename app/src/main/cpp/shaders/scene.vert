@@ -0,0 +1,46 @@
+#version 450
+
+// Unit cube expanded from gl_VertexIndex, so no vertex buffer is needed.
+// Each instance is one entity; its local-to-world matrix arrives as four
+// per-instance column attributes.
+layout(location = 0) in vec4 model_col0;
+layout(location = 1) in vec4 model_col1;
+layout(location = 2) in vec4 model_col2;
+layout(location = 3) in vec4 model_col3;
+
+layout(push_constant) uniform push_constants {
+    mat4 view_proj;
+    // the material's color
+    vec4 tint;
+} pc;
+
+layout(location = 0) out vec3 out_color;
+
+// corner i has x, y, z set by bits 0, 1, 2
+const int indices[36] = int[36](
+    1, 3, 7, 1, 7, 5,   // +x
+    0, 4, 6, 0, 6, 2,   // -x
+    2, 6, 7, 2, 7, 3,   // +y
+    0, 1, 5, 0, 5, 4,   // -y
+    4, 5, 7, 4, 7, 6,   // +z
+    0, 2, 3, 0, 3, 1);  // -z
+
+const vec3 normals[6] = vec3[6](
+    vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0),
+    vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0),
+    vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+
+const vec3 light_dir = vec3(0.38, 0.84, 0.38);
+
+void main() {
+    int corner = indices[gl_VertexIndex];
+    vec3 position = vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) - 0.5;
+    vec3 normal = normals[gl_VertexIndex / 6];
+
+    mat4 model = mat4(model_col0, model_col1, model_col2, model_col3);
+    gl_Position = pc.view_proj * model * vec4(position, 1.0);
+
+    vec3 world_normal = normalize(mat3(model) * normal);
+    float light = 0.25 + 0.75 * max(dot(world_normal, light_dir), 0.0);
+    out_color = (normal * 0.35 + 0.65) * light * pc.tint.rgb;
+}
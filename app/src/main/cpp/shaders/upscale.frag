@@ -0,0 +1,19 @@
+#version 450
+
+// Stretches the part of the scene image the main pass rendered over the
+// whole target, filtered bilinearly.
+layout(set = 0, binding = 0) uniform sampler2D scene_color;
+
+layout(push_constant) uniform push_constants {
+    // size of the rendered part in uv in xy; in zw the furthest uv whose
+    // filter footprint stays inside it
+    vec4 uv_rect;
+} pc;
+
+layout(location = 0) in vec2 in_uv;
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+    out_color = texture(scene_color, min(in_uv * pc.uv_rect.xy, pc.uv_rect.zw));
+}
@@ -0,0 +1,11 @@
+#version 450
+
+// One triangle covering the target, expanded from gl_VertexIndex, with uv
+// running from 0 to 1 across the target.
+layout(location = 0) out vec2 out_uv;
+
+void main() {
+    vec2 corner = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    out_uv = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
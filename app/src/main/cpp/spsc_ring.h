@@ -0,0 +1,58 @@
+#ifndef ENGINE_SPSC_RING_H
+#define ENGINE_SPSC_RING_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Bounded lock-free ring for exactly one producer thread and one consumer
+ * thread. Capacity must be a power of two. Head and tail are free-running
+ * counters; their difference is the fill level.
+ */
+template <typename T, uint32_t Capacity>
+struct spsc_ring {
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+    // written by the consumer
+    alignas(64) std::atomic<uint32_t> head{0};
+    // written by the producer
+    alignas(64) std::atomic<uint32_t> tail{0};
+    alignas(64) T items[Capacity];
+};
+
+/**
+ * Producer only. Returns false, leaving the ring untouched, when it is full.
+ */
+template <typename T, uint32_t Capacity>
+bool spsc_push(struct spsc_ring<T, Capacity>* ring, const T& item) {
+    uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint32_t head = ring->head.load(std::memory_order_acquire);
+    if (tail - head == Capacity) {
+        return false;
+    }
+    ring->items[tail & (Capacity - 1)] = item;
+    ring->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * Consumer only. Returns false when the ring is empty.
+ */
+template <typename T, uint32_t Capacity>
+bool spsc_pop(struct spsc_ring<T, Capacity>* ring, T* item) {
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    uint32_t tail = ring->tail.load(std::memory_order_acquire);
+    if (head == tail) {
+        return false;
+    }
+    *item = ring->items[head & (Capacity - 1)];
+    ring->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T, uint32_t Capacity>
+uint32_t spsc_size(const struct spsc_ring<T, Capacity>* ring) {
+    return ring->tail.load(std::memory_order_acquire) - ring->head.load(std::memory_order_acquire);
+}
+
+#endif // ENGINE_SPSC_RING_H
@@ -0,0 +1,304 @@
+#include "streamer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "log.h"
+#include "profiler.h"
+
+// copies never get smaller than this unless the request itself is, so a
+// nearly full ring waits for space instead of issuing tiny copies
+#define STREAM_MIN_COPY (64u << 10)
+
+static struct stream_batch* current_batch(struct streamer* s) {
+    if (s->batch_count == 0) {
+        return nullptr;
+    }
+    struct stream_batch* last = &s->batches[(s->batch_first + s->batch_count - 1) % STREAM_MAX_BATCHES];
+    return last->state.load(std::memory_order_relaxed) == STREAM_BATCH_RECORDING ? last : nullptr;
+}
+
+/**
+ * Retire the oldest batch if its copies have finished, waiting up to
+ * timeout_ns for it. Returns true when a batch was retired.
+ */
+static bool retire_oldest(struct streamer* s, uint64_t timeout_ns) {
+    if (s->batch_count == 0) {
+        return false;
+    }
+    struct stream_batch* batch = &s->batches[s->batch_first];
+    if (batch->state.load(std::memory_order_acquire) != STREAM_BATCH_SUBMITTED) {
+        // still recording, or waiting for the render thread to submit it
+        if (timeout_ns > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        return false;
+    }
+    VkResult result = timeout_ns > 0
+                      ? vkWaitForFences(s->vk->device, 1, &batch->fence, VK_TRUE, timeout_ns)
+                      : vkGetFenceStatus(s->vk->device, batch->fence);
+    if (result != VK_SUCCESS) {
+        return false;
+    }
+    vkResetFences(s->vk->device, 1, &batch->fence);
+    for (uint32_t i = 0; i < batch->completed_count; i++) {
+        batch->completed[i]->fetch_add(1, std::memory_order_release);
+    }
+    s->ring_tail = batch->ring_end;
+    s->bytes_completed.fetch_add(batch->bytes, std::memory_order_release);
+    batch->state.store(STREAM_BATCH_FREE, std::memory_order_relaxed);
+    s->batch_first = (s->batch_first + 1) % STREAM_MAX_BATCHES;
+    s->batch_count--;
+    return true;
+}
+
+static void submit_batch(struct streamer* s, struct stream_batch* batch) {
+    vkEndCommandBuffer(batch->command_buffer);
+    s->batches_submitted.fetch_add(1, std::memory_order_relaxed);
+    if (s->vk->transfer_queue_shared) {
+        // only the render thread may touch the graphics queue
+        batch->state.store(STREAM_BATCH_READY, std::memory_order_release);
+        spsc_push(&s->ready, (uint32_t)(batch - s->batches));
+        return;
+    }
+    VkSubmitInfo submit{};
+    submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &batch->command_buffer;
+    VkResult result = vkQueueSubmit(s->vk->transfer_queue, 1, &submit, batch->fence);
+    if (result != VK_SUCCESS) {
+        LOGE("streamer: transfer submit failed: %d", (int)result);
+    }
+    batch->state.store(STREAM_BATCH_SUBMITTED, std::memory_order_release);
+}
+
+static struct stream_batch* open_batch(struct streamer* s) {
+    if (s->batch_count == STREAM_MAX_BATCHES) {
+        return nullptr;
+    }
+    struct stream_batch* batch = &s->batches[(s->batch_first + s->batch_count) % STREAM_MAX_BATCHES];
+    s->batch_count++;
+    batch->bytes = 0;
+    batch->completed_count = 0;
+    batch->state.store(STREAM_BATCH_RECORDING, std::memory_order_relaxed);
+    vkResetCommandBuffer(batch->command_buffer, 0);
+    VkCommandBufferBeginInfo begin{};
+    begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(batch->command_buffer, &begin);
+    return batch;
+}
+
+/**
+ * Reserve up to want contiguous bytes of the staging ring. Returns the
+ * number of bytes reserved, 0 when the ring is too full right now.
+ */
+static VkDeviceSize ring_reserve(struct streamer* s, VkDeviceSize want, VkDeviceSize* offset) {
+    want = (want + 15) & ~(VkDeviceSize)15;
+    uint64_t position = s->ring_head % STREAM_STAGING_SIZE;
+    uint64_t free_bytes = STREAM_STAGING_SIZE - (s->ring_head - s->ring_tail);
+    uint64_t contiguous = std::min<uint64_t>(free_bytes, STREAM_STAGING_SIZE - position);
+    VkDeviceSize minimum = std::min<VkDeviceSize>(want, STREAM_MIN_COPY);
+    if (contiguous < minimum) {
+        // skip the tail end of the ring and start over at 0
+        uint64_t skip = STREAM_STAGING_SIZE - position;
+        if (free_bytes - std::min(free_bytes, skip) < minimum) {
+            return 0;
+        }
+        s->ring_head += skip;
+        position = 0;
+        contiguous = free_bytes - skip;
+    }
+    VkDeviceSize size = std::min<VkDeviceSize>(want, contiguous);
+    *offset = position;
+    s->ring_head += size;
+    return size;
+}
+
+/**
+ * Stage and record as much of request as fits. Returns false when there
+ * is no batch or staging space left; the caller retires a batch and retries.
+ */
+static bool stream_copy(struct streamer* s, struct stream_request* request) {
+    struct stream_batch* batch = current_batch(s);
+    if (batch == nullptr && (batch = open_batch(s)) == nullptr) {
+        return false;
+    }
+    VkDeviceSize budget = STREAM_BATCH_BYTES - std::min<VkDeviceSize>(batch->bytes, STREAM_BATCH_BYTES);
+    VkDeviceSize staging_offset = 0;
+    VkDeviceSize reserved = ring_reserve(s, std::min(request->size, std::max<VkDeviceSize>(budget, 16)),
+                                         &staging_offset);
+    if (reserved == 0) {
+        if (batch->bytes > 0) {
+            submit_batch(s, batch);
+        }
+        return false;
+    }
+    VkDeviceSize size = std::min(reserved, request->size);
+    {
+        PROFILE_SCOPE("stream_copy");
+        memcpy(s->staging_mapped + staging_offset, request->source, (size_t)size);
+    }
+    VkBufferCopy region{ staging_offset, request->offset, size };
+    vkCmdCopyBuffer(batch->command_buffer, s->staging, request->buffer, 1, &region);
+    batch->bytes += size;
+    batch->ring_end = s->ring_head;
+
+    request->source = (const uint8_t*)request->source + size;
+    request->offset += size;
+    request->size -= size;
+    if (request->size == 0 && request->completed != nullptr) {
+        batch->completed[batch->completed_count++] = request->completed;
+    }
+    if (batch->bytes >= STREAM_BATCH_BYTES || batch->completed_count == STREAM_BATCH_REQUESTS) {
+        submit_batch(s, batch);
+    }
+    return true;
+}
+
+static void streamer_main(struct streamer* s) {
+    PROFILE_THREAD("streamer");
+    struct stream_request request{};
+    bool has_request = false;
+    while (!s->quit.load(std::memory_order_acquire)) {
+        while (retire_oldest(s, 0)) {
+        }
+        if (!has_request) {
+            has_request = spsc_pop(&s->requests, &request);
+        }
+        if (has_request) {
+            if (!stream_copy(s, &request)) {
+                PROFILE_SCOPE("stream_wait");
+                retire_oldest(s, 1000000);
+            } else if (request.size == 0) {
+                has_request = false;
+            }
+            continue;
+        }
+        // out of work: flush the partial batch so it does not wait for more
+        struct stream_batch* batch = current_batch(s);
+        if (batch != nullptr && batch->bytes > 0) {
+            submit_batch(s, batch);
+            continue;
+        }
+        // an empty batch left open stays for the next request
+        if (s->batch_count > (batch != nullptr ? 1u : 0u)) {
+            retire_oldest(s, 1000000);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(s->mutex);
+        s->wake.wait_for(lock, std::chrono::milliseconds(100), [s] {
+            return s->quit.load(std::memory_order_acquire) || spsc_size(&s->requests) > 0;
+        });
+    }
+}
+
+int streamer_init(struct vk_context* vk, struct streamer* s) {
+    s->vk = vk;
+    if (vk_create_buffer(vk, STREAM_STAGING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                         &s->staging, &s->staging_memory) != 0) {
+        return -1;
+    }
+    s->staging_mapped = (uint8_t*)s->staging_memory.mapped;
+
+    VkCommandPoolCreateInfo pool{};
+    pool.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool.queueFamilyIndex = vk->transfer_family;
+    VK_CHECK(vkCreateCommandPool(vk->device, &pool, nullptr, &s->command_pool));
+
+    VkCommandBuffer buffers[STREAM_MAX_BATCHES];
+    VkCommandBufferAllocateInfo alloc{};
+    alloc.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc.commandPool = s->command_pool;
+    alloc.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc.commandBufferCount = STREAM_MAX_BATCHES;
+    VK_CHECK(vkAllocateCommandBuffers(vk->device, &alloc, buffers));
+    for (uint32_t i = 0; i < STREAM_MAX_BATCHES; i++) {
+        s->batches[i].command_buffer = buffers[i];
+        VkFenceCreateInfo fence{};
+        fence.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VK_CHECK(vkCreateFence(vk->device, &fence, nullptr, &s->batches[i].fence));
+    }
+
+    s->quit.store(0);
+    s->thread = std::thread(streamer_main, s);
+    return 0;
+}
+
+void streamer_destroy(struct streamer* s) {
+    if (s->vk == nullptr) {
+        return;
+    }
+    if (s->thread.joinable()) {
+        s->quit.store(1, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(s->mutex);
+            s->wake.notify_one();
+        }
+        s->thread.join();
+    }
+    VkDevice device = s->vk->device;
+    if (device != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(device);
+        for (struct stream_batch& batch : s->batches) {
+            if (batch.fence != VK_NULL_HANDLE) {
+                vkDestroyFence(device, batch.fence, nullptr);
+            }
+            batch.fence = VK_NULL_HANDLE;
+            batch.state.store(STREAM_BATCH_FREE);
+        }
+        if (s->command_pool != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(device, s->command_pool, nullptr);
+        }
+        vk_destroy_buffer(s->vk, &s->staging, &s->staging_memory);
+    }
+    s->vk = nullptr;
+    s->command_pool = VK_NULL_HANDLE;
+    s->staging_mapped = nullptr;
+    s->ring_head = s->ring_tail = 0;
+    s->batch_first = s->batch_count = 0;
+    // drop requests that never started
+    struct stream_request request;
+    while (spsc_pop(&s->requests, &request)) {
+    }
+    uint32_t index;
+    while (spsc_pop(&s->ready, &index)) {
+    }
+    s->bytes_queued.store(0);
+    s->bytes_completed.store(0);
+}
+
+bool streamer_queue(struct streamer* s, const struct stream_request* request) {
+    if (request->size == 0) {
+        if (request->completed != nullptr) {
+            request->completed->fetch_add(1, std::memory_order_release);
+        }
+        return true;
+    }
+    if (!spsc_push(&s->requests, *request)) {
+        return false;
+    }
+    s->bytes_queued.fetch_add(request->size, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(s->mutex);
+    s->wake.notify_one();
+    return true;
+}
+
+void streamer_update(struct streamer* s) {
+    uint32_t index;
+    while (spsc_pop(&s->ready, &index)) {
+        struct stream_batch* batch = &s->batches[index];
+        VkSubmitInfo submit{};
+        submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit.commandBufferCount = 1;
+        submit.pCommandBuffers = &batch->command_buffer;
+        VkResult result = vkQueueSubmit(s->vk->graphics_queue, 1, &submit, batch->fence);
+        if (result != VK_SUCCESS) {
+            LOGE("streamer: upload submit failed: %d", (int)result);
+        }
+        batch->state.store(STREAM_BATCH_SUBMITTED, std::memory_order_release);
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef ENGINE_STREAMER_H
+#define ENGINE_STREAMER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include <vulkan/vulkan.h>
+
+#include "spsc_ring.h"
+#include "vk_context.h"
+
+// persistent host-visible ring every upload is staged through
+#define STREAM_STAGING_SIZE (32u << 20)
+// a batch is submitted once it holds this much, so no single submission
+// occupies the copy engine (or, when shared, the graphics queue) for long
+#define STREAM_BATCH_BYTES (4u << 20)
+#define STREAM_MAX_BATCHES 4
+#define STREAM_BATCH_REQUESTS 64
+#define STREAM_QUEUE_CAPACITY 1024
+
+/**
+ * Copy size bytes from source (typically a pointer into an asset_pack
+ * mapping) to buffer at offset. source must stay valid until completed is
+ * incremented, which happens once the copy has finished on the GPU.
+ */
+struct stream_request {
+    const void* source;
+    VkDeviceSize size;
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    std::atomic<uint32_t>* completed;
+};
+
+enum stream_batch_state {
+    STREAM_BATCH_FREE,
+    STREAM_BATCH_RECORDING,
+    // recorded, waiting for streamer_update to submit it on the shared queue
+    STREAM_BATCH_READY,
+    STREAM_BATCH_SUBMITTED,
+};
+
+struct stream_batch {
+    VkCommandBuffer command_buffer;
+    VkFence fence;
+    std::atomic<uint32_t> state;
+    // staging ring position after this batch's last copy
+    uint64_t ring_end;
+    VkDeviceSize bytes;
+    uint32_t completed_count;
+    std::atomic<uint32_t>* completed[STREAM_BATCH_REQUESTS];
+};
+
+/**
+ * Uploads run on their own thread: it pulls requests, touches the source
+ * (the page faults of a mapped pack happen here, not on the render
+ * thread), copies into the staging ring and records transfer commands.
+ * Batches are retired in submission order when their fence signals, which
+ * frees their part of the ring.
+ */
+struct streamer {
+    struct vk_context* vk;
+    VkCommandPool command_pool;
+    VkBuffer staging;
+    struct gpu_allocation staging_memory;
+    uint8_t* staging_mapped;
+    // free-running byte positions; [ring_tail, ring_head) is in flight
+    uint64_t ring_head;
+    uint64_t ring_tail;
+    struct stream_batch batches[STREAM_MAX_BATCHES];
+    // oldest batch that is not free, and how many are not free
+    uint32_t batch_first;
+    uint32_t batch_count;
+
+    struct spsc_ring<struct stream_request, STREAM_QUEUE_CAPACITY> requests;
+    // batch indices for the render thread when the queue is shared
+    struct spsc_ring<uint32_t, STREAM_MAX_BATCHES> ready;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<int32_t> quit;
+
+    std::atomic<uint64_t> bytes_queued;
+    std::atomic<uint64_t> bytes_completed;
+    std::atomic<uint64_t> batches_submitted;
+};
+
+/**
+ * Create the staging ring and start the upload thread. Returns 0 on success.
+ */
+int streamer_init(struct vk_context* vk, struct streamer* streamer);
+
+/**
+ * Stop the thread and wait for uploads in flight. Queued requests that
+ * have not started are dropped.
+ */
+void streamer_destroy(struct streamer* streamer);
+
+/**
+ * Queue an upload from the render thread (the single producer). Returns
+ * false when the request queue is full; try again next frame.
+ */
+bool streamer_queue(struct streamer* streamer, const struct stream_request* request);
+
+/**
+ * Called once per frame on the render thread. Submits recorded batches
+ * when uploads share the graphics queue; a no-op otherwise.
+ */
+void streamer_update(struct streamer* streamer);
+
+/**
+ * Bytes queued but not yet on the GPU.
+ */
+inline uint64_t streamer_pending_bytes(const struct streamer* streamer) {
+    return streamer->bytes_queued.load(std::memory_order_relaxed) -
+           streamer->bytes_completed.load(std::memory_order_acquire);
+}
+
+#endif // ENGINE_STREAMER_H
@@ -0,0 +1,129 @@
+#include "swapchain.h"
+
+#include <algorithm>
+#include <vector>
+
+static VkSurfaceFormatKHR choose_format(const std::vector<VkSurfaceFormatKHR>& formats) {
+    for (const VkSurfaceFormatKHR& format : formats) {
+        if (format.format == VK_FORMAT_R8G8B8A8_UNORM ||
+            format.format == VK_FORMAT_B8G8R8A8_UNORM) {
+            return format;
+        }
+    }
+    return formats[0];
+}
+
+static VkCompositeAlphaFlagBitsKHR choose_composite_alpha(VkCompositeAlphaFlagsKHR supported) {
+    const VkCompositeAlphaFlagBitsKHR preferred[] = {
+        VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+        VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR,
+        VK_COMPOSITE_ALPHA_PRE_MULTIPLIED_BIT_KHR,
+        VK_COMPOSITE_ALPHA_POST_MULTIPLIED_BIT_KHR,
+    };
+    for (VkCompositeAlphaFlagBitsKHR flag : preferred) {
+        if (supported & flag) {
+            return flag;
+        }
+    }
+    return VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+}
+
+static void destroy_images(struct vk_context* vk, struct swapchain* swapchain) {
+    for (uint32_t i = 0; i < swapchain->image_count; i++) {
+        vkDestroyImageView(vk->device, swapchain->views[i], nullptr);
+        vkDestroySemaphore(vk->device, swapchain->present_ready[i], nullptr);
+        swapchain->views[i] = VK_NULL_HANDLE;
+        swapchain->present_ready[i] = VK_NULL_HANDLE;
+    }
+    swapchain->image_count = 0;
+}
+
+int swapchain_create(struct vk_context* vk, struct swapchain* swapchain,
+                     uint32_t width, uint32_t height) {
+    VkSurfaceCapabilitiesKHR caps;
+    VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vk->physical_device, vk->surface, &caps));
+
+    uint32_t format_count = 0;
+    VK_CHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(vk->physical_device, vk->surface,
+                                                  &format_count, nullptr));
+    std::vector<VkSurfaceFormatKHR> formats(format_count);
+    VK_CHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(vk->physical_device, vk->surface,
+                                                  &format_count, formats.data()));
+    if (formats.empty()) {
+        LOGE("surface reports no formats");
+        return -1;
+    }
+    VkSurfaceFormatKHR format = choose_format(formats);
+
+    VkExtent2D extent = caps.currentExtent;
+    if (extent.width == 0xFFFFFFFFu) {
+        extent.width = std::clamp(width, caps.minImageExtent.width, caps.maxImageExtent.width);
+        extent.height = std::clamp(height, caps.minImageExtent.height, caps.maxImageExtent.height);
+    }
+
+    uint32_t image_count = caps.minImageCount + 1;
+    if (caps.maxImageCount > 0 && image_count > caps.maxImageCount) {
+        image_count = caps.maxImageCount;
+    }
+    image_count = std::min(image_count, (uint32_t)MAX_SWAPCHAIN_IMAGES);
+
+    VkSwapchainKHR old_swapchain = swapchain->handle;
+
+    VkSwapchainCreateInfoKHR info{};
+    info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    info.surface = vk->surface;
+    info.minImageCount = image_count;
+    info.imageFormat = format.format;
+    info.imageColorSpace = format.colorSpace;
+    info.imageExtent = extent;
+    info.imageArrayLayers = 1;
+    info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.preTransform = (caps.supportedTransforms & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR)
+                        ? VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR : caps.currentTransform;
+    info.compositeAlpha = choose_composite_alpha(caps.supportedCompositeAlpha);
+    // FIFO is the only mode every implementation has to support
+    info.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    info.clipped = VK_TRUE;
+    info.oldSwapchain = old_swapchain;
+    VK_CHECK(vkCreateSwapchainKHR(vk->device, &info, nullptr, &swapchain->handle));
+
+    destroy_images(vk, swapchain);
+    if (old_swapchain != VK_NULL_HANDLE) {
+        vkDestroySwapchainKHR(vk->device, old_swapchain, nullptr);
+    }
+
+    swapchain->format = format.format;
+    swapchain->extent = extent;
+
+    VK_CHECK(vkGetSwapchainImagesKHR(vk->device, swapchain->handle, &image_count, nullptr));
+    image_count = std::min(image_count, (uint32_t)MAX_SWAPCHAIN_IMAGES);
+    VK_CHECK(vkGetSwapchainImagesKHR(vk->device, swapchain->handle, &image_count,
+                                     swapchain->images));
+
+    for (uint32_t i = 0; i < image_count; i++) {
+        VkImageViewCreateInfo view{};
+        view.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view.image = swapchain->images[i];
+        view.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view.format = format.format;
+        view.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        view.subresourceRange.levelCount = 1;
+        view.subresourceRange.layerCount = 1;
+        VK_CHECK(vkCreateImageView(vk->device, &view, nullptr, &swapchain->views[i]));
+
+        VkSemaphoreCreateInfo semaphore{};
+        semaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        VK_CHECK(vkCreateSemaphore(vk->device, &semaphore, nullptr, &swapchain->present_ready[i]));
+        swapchain->image_count = i + 1;
+    }
+    return 0;
+}
+
+void swapchain_destroy(struct vk_context* vk, struct swapchain* swapchain) {
+    destroy_images(vk, swapchain);
+    if (swapchain->handle != VK_NULL_HANDLE) {
+        vkDestroySwapchainKHR(vk->device, swapchain->handle, nullptr);
+    }
+    *swapchain = {};
+}
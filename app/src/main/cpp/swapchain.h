@@ -0,0 +1,36 @@
+#ifndef ENGINE_SWAPCHAIN_H
+#define ENGINE_SWAPCHAIN_H
+
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "vk_context.h"
+
+#define MAX_SWAPCHAIN_IMAGES 8
+
+/**
+ * Swapchain images plus one present semaphore per image. The semaphore is
+ * per image rather than per frame because an image cannot be acquired again
+ * until the presentation that waited on its semaphore has completed.
+ */
+struct swapchain {
+    VkSwapchainKHR handle;
+    VkFormat format;
+    VkExtent2D extent;
+    uint32_t image_count;
+    VkImage images[MAX_SWAPCHAIN_IMAGES];
+    VkImageView views[MAX_SWAPCHAIN_IMAGES];
+    VkSemaphore present_ready[MAX_SWAPCHAIN_IMAGES];
+};
+
+/**
+ * Create or recreate the swapchain. width/height are only used when the
+ * surface leaves the extent up to the application (headless surfaces).
+ */
+int swapchain_create(struct vk_context* vk, struct swapchain* swapchain,
+                     uint32_t width, uint32_t height);
+
+void swapchain_destroy(struct vk_context* vk, struct swapchain* swapchain);
+
+#endif // ENGINE_SWAPCHAIN_H
@@ -0,0 +1,129 @@
+#include "texture.h"
+
+#include "log.h"
+
+struct texture_format_info {
+    const char* name;
+    VkFormat unorm;
+    VkFormat srgb;
+    // 1 for uncompressed formats, where a block is a pixel
+    uint32_t block_size;
+    uint32_t block_bytes;
+};
+
+static const struct texture_format_info FORMATS[TEXTURE_FORMAT_COUNT] = {
+    { "rgba8", VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_SRGB, 1, 4 },
+    { "astc 4x4", VK_FORMAT_ASTC_4x4_UNORM_BLOCK, VK_FORMAT_ASTC_4x4_SRGB_BLOCK, 4, 16 },
+    { "etc2 rgb8", VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK, 4, 8 },
+    { "etc2 rgba8", VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK, 4, 16 },
+    { "bc1", VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGB_SRGB_BLOCK, 4, 8 },
+    { "bc3", VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK, 4, 16 },
+};
+
+const char* texture_format_name(enum texture_format format) {
+    return format < TEXTURE_FORMAT_COUNT ? FORMATS[format].name : "unknown";
+}
+
+VkFormat texture_vk_format(enum texture_format format, bool srgb) {
+    return srgb ? FORMATS[format].srgb : FORMATS[format].unorm;
+}
+
+uint64_t texture_level_size(enum texture_format format, uint32_t width, uint32_t height) {
+    const struct texture_format_info* info = &FORMATS[format];
+    uint64_t blocks_x = (width + info->block_size - 1) / info->block_size;
+    uint64_t blocks_y = (height + info->block_size - 1) / info->block_size;
+    return blocks_x * blocks_y * info->block_bytes;
+}
+
+/**
+ * Bytes of a whole mip chain, what every variant must hold.
+ */
+static uint64_t texture_chain_size(enum texture_format format, const struct texture_header* header) {
+    uint64_t size = 0;
+    for (uint32_t level = 0; level < header->mip_count; level++) {
+        uint32_t width = header->width >> level;
+        uint32_t height = header->height >> level;
+        size += texture_level_size(format, width > 0 ? width : 1, height > 0 ? height : 1);
+    }
+    return size;
+}
+
+int texture_parse(const void* data, size_t size, struct texture_data* texture) {
+    if (size < sizeof(struct texture_header)) {
+        LOGE("texture: %zu bytes is too small", size);
+        return -1;
+    }
+    const auto* header = (const struct texture_header*)data;
+    if (header->magic != TEXTURE_MAGIC || header->version != TEXTURE_VERSION) {
+        LOGE("texture: bad magic or version %u", header->version);
+        return -1;
+    }
+    uint32_t largest = header->width > header->height ? header->width : header->height;
+    uint32_t full_chain = 1;
+    while (largest >> full_chain != 0) {
+        full_chain++;
+    }
+    if (header->width == 0 || header->height == 0 || header->mip_count == 0 || header->mip_count > full_chain ||
+        sizeof(struct texture_header) + (uint64_t)header->variant_count * sizeof(struct texture_variant) > size) {
+        LOGE("texture: %ux%u with %u mips and %u variants does not fit in %zu bytes", header->width,
+             header->height, header->mip_count, header->variant_count, size);
+        return -1;
+    }
+    const auto* variants = (const struct texture_variant*)(header + 1);
+    for (uint32_t i = 0; i < header->variant_count; i++) {
+        const struct texture_variant* variant = &variants[i];
+        if (variant->format >= TEXTURE_FORMAT_COUNT || variant->offset % 64 != 0 ||
+            (uint64_t)variant->offset + variant->size > size ||
+            variant->size != texture_chain_size((enum texture_format)variant->format, header)) {
+            LOGE("texture: variant %u (format %u, %u bytes at %u) does not match %ux%u with %u mips", i,
+                 variant->format, variant->size, variant->offset, header->width, header->height,
+                 header->mip_count);
+            return -1;
+        }
+    }
+    texture->header = header;
+    texture->variants = variants;
+    texture->base = (const uint8_t*)data;
+    return 0;
+}
+
+int texture_load(const struct asset_pack* pack, const char* name, struct texture_data* texture) {
+    size_t size;
+    const void* data = asset_pack_get(pack, name, ASSET_TEXTURE, &size);
+    if (data == nullptr) {
+        return -1;
+    }
+    if (texture_parse(data, size, texture) != 0) {
+        LOGE("texture %s is not a texture built by build_texture.py", name);
+        return -1;
+    }
+    return 0;
+}
+
+void texture_query_support(VkPhysicalDevice physical_device, struct texture_support* support) {
+    const VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                                        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    support->unorm = 0;
+    support->srgb = 0;
+    for (uint32_t format = 0; format < TEXTURE_FORMAT_COUNT; format++) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physical_device, FORMATS[format].unorm, &properties);
+        if ((properties.optimalTilingFeatures & needed) == needed) {
+            support->unorm |= 1u << format;
+        }
+        vkGetPhysicalDeviceFormatProperties(physical_device, FORMATS[format].srgb, &properties);
+        if ((properties.optimalTilingFeatures & needed) == needed) {
+            support->srgb |= 1u << format;
+        }
+    }
+}
+
+int texture_select(const struct texture_data* texture, const struct texture_support* support) {
+    uint32_t supported = (texture->header->flags & TEXTURE_FLAG_SRGB) != 0 ? support->srgb : support->unorm;
+    for (uint32_t i = 0; i < texture->header->variant_count; i++) {
+        if ((supported & (1u << texture->variants[i].format)) != 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,109 @@
+#ifndef ENGINE_TEXTURE_H
+#define ENGINE_TEXTURE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "asset_pack.h"
+
+/**
+ * Texture asset, written by tools/build_texture.py: one mip chain encoded
+ * in several formats, so a single pack serves every GPU.
+ *
+ *     texture_header
+ *     texture_variant[variant_count]   most preferred first
+ *     variant data, each at a multiple of 64 bytes: every mip from the
+ *                                      largest down to 1x1, tightly packed
+ *
+ * Mip sizes follow from the format's block size, see texture_level_size.
+ * All fields are little-endian.
+ */
+#define TEXTURE_MAGIC 0x58455445u // "ETEX"
+#define TEXTURE_VERSION 1u
+
+// color is sRGB encoded; otherwise data such as normals, sampled as UNORM
+#define TEXTURE_FLAG_SRGB 1u
+#define TEXTURE_FLAG_ALPHA 2u
+
+enum texture_format : uint32_t {
+    TEXTURE_RGBA8 = 0,
+    TEXTURE_ASTC_4X4 = 1,
+    TEXTURE_ETC2_RGB8 = 2,
+    TEXTURE_ETC2_RGBA8 = 3,
+    TEXTURE_BC1 = 4,
+    TEXTURE_BC3 = 5,
+    TEXTURE_FORMAT_COUNT,
+};
+
+struct texture_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_count;
+    uint32_t variant_count;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+struct texture_variant {
+    uint32_t format;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(struct texture_header) == 32, "header layout is part of the file format");
+static_assert(sizeof(struct texture_variant) == 16, "variant layout is part of the file format");
+
+/**
+ * A parsed texture asset, pointing into the asset's memory.
+ */
+struct texture_data {
+    const struct texture_header* header;
+    const struct texture_variant* variants;
+    const uint8_t* base;
+};
+
+/**
+ * Validate a texture asset of size bytes and point texture into it.
+ * Returns 0 on success.
+ */
+int texture_parse(const void* data, size_t size, struct texture_data* texture);
+
+/**
+ * Find and parse a texture in the pack; the data stays in the mapping.
+ */
+int texture_load(const struct asset_pack* pack, const char* name, struct texture_data* texture);
+
+const char* texture_format_name(enum texture_format format);
+
+VkFormat texture_vk_format(enum texture_format format, bool srgb);
+
+/**
+ * Bytes of one width x height mip in format, whole blocks.
+ */
+uint64_t texture_level_size(enum texture_format format, uint32_t width, uint32_t height);
+
+/**
+ * Formats the device can sample with linear filtering from optimally tiled
+ * images, as 1 << texture_format bits, for UNORM and sRGB separately.
+ */
+struct texture_support {
+    uint32_t unorm;
+    uint32_t srgb;
+};
+
+/**
+ * Ask vkGetPhysicalDeviceFormatProperties about every texture_format.
+ */
+void texture_query_support(VkPhysicalDevice physical_device, struct texture_support* support);
+
+/**
+ * The first variant of texture the device supports, -1 when none is.
+ */
+int texture_select(const struct texture_data* texture, const struct texture_support* support);
+
+#endif // ENGINE_TEXTURE_H
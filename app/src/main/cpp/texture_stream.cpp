@@ -0,0 +1,218 @@
+#include "texture_stream.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "log.h"
+#include "profiler.h"
+
+void texture_streamer_init(struct texture_streamer* streamer, uint64_t budget_bytes,
+                           uint64_t upload_bytes_per_frame) {
+    texture_streamer_destroy(streamer);
+    streamer->upload_bytes_per_frame = upload_bytes_per_frame;
+    streamer->stats.budget_bytes = budget_bytes;
+}
+
+void texture_streamer_destroy(struct texture_streamer* streamer) {
+    *streamer = {};
+}
+
+uint32_t texture_streamer_add(struct texture_streamer* streamer, enum texture_format format, uint32_t width,
+                              uint32_t height, uint32_t mip_count, const void* data) {
+    if (mip_count == 0) {
+        LOGE("texture_stream: a %ux%u texture without mips", width, height);
+        return TEXTURE_STREAM_NONE;
+    }
+    struct streamed_texture t{};
+    t.data = (const uint8_t*)data;
+    t.format = format;
+    t.width = width;
+    t.height = height;
+    t.mip_count = std::min<uint32_t>(mip_count, TEXTURE_STREAM_MAX_MIPS);
+    t.tail = t.mip_count - 1;
+    for (uint32_t level = 0; level < t.mip_count; level++) {
+        uint32_t w = std::max(width >> level, 1u);
+        uint32_t h = std::max(height >> level, 1u);
+        if (level < t.tail && std::max(w, h) <= TEXTURE_STREAM_TAIL_SIZE) {
+            t.tail = level;
+        }
+        t.level_offset[level + 1] = t.level_offset[level] + texture_level_size(format, w, h);
+    }
+    t.resident = t.mip_count;
+    t.loading = TEXTURE_STREAM_NONE;
+    t.requested = TEXTURE_STREAM_NONE;
+    t.wanted = t.tail;
+
+    streamer->textures.push_back(t);
+    streamer->stats.textures++;
+    streamer->stats.full_bytes += t.level_offset[t.mip_count];
+    // at most one load per texture and update
+    streamer->loads.resize(streamer->textures.size());
+    streamer->wanting.reserve(streamer->textures.size());
+    streamer->evictable.reserve(streamer->textures.size());
+    return (uint32_t)streamer->textures.size() - 1;
+}
+
+static uint64_t levels_size(const struct streamed_texture* t, uint32_t first, uint32_t end) {
+    return t->level_offset[end] - t->level_offset[first];
+}
+
+static void issue_load(struct texture_streamer* streamer, uint32_t index, uint32_t first, uint32_t end) {
+    struct streamed_texture* t = &streamer->textures[index];
+    struct texture_stream_load* load = &streamer->loads[streamer->load_count++];
+    load->texture = index;
+    load->first_level = first;
+    load->level_count = end - first;
+    load->source = t->data != nullptr ? t->data + t->level_offset[first] : nullptr;
+    load->size = levels_size(t, first, end);
+    t->loading = first;
+
+    struct texture_stream_stats* stats = &streamer->stats;
+    stats->pending_bytes += load->size;
+    stats->peak_bytes = std::max(stats->peak_bytes, stats->resident_bytes + stats->pending_bytes);
+    stats->loads++;
+    stats->load_bytes += load->size;
+}
+
+/**
+ * The level a texture may be evicted down to: its tail, or what it asked
+ * for when it is in use this frame.
+ */
+static uint32_t evict_floor(const struct texture_streamer* streamer, const struct streamed_texture* t) {
+    return t->last_used == streamer->frame ? std::min(t->wanted, t->tail) : t->tail;
+}
+
+struct evict_cursor {
+    // evictable is filled on the first eviction of an update
+    bool sorted;
+    size_t next;
+};
+
+/**
+ * Make room for size more bytes, evicting the finest levels of the least
+ * recently used textures. Returns false when even that is not enough.
+ */
+static bool reserve(struct texture_streamer* streamer, struct evict_cursor* cursor, uint64_t size) {
+    struct texture_stream_stats* stats = &streamer->stats;
+    if (stats->resident_bytes + stats->pending_bytes + size <= stats->budget_bytes) {
+        return true;
+    }
+    std::vector<uint64_t>& candidates = streamer->evictable;
+    if (!cursor->sorted) {
+        candidates.clear();
+        for (uint32_t i = 0; i < (uint32_t)streamer->textures.size(); i++) {
+            const struct streamed_texture* t = &streamer->textures[i];
+            if (t->loading == TEXTURE_STREAM_NONE && t->resident < evict_floor(streamer, t)) {
+                candidates.push_back(t->last_used << 32 | i);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        cursor->sorted = true;
+        cursor->next = 0;
+    }
+    while (stats->resident_bytes + stats->pending_bytes + size > stats->budget_bytes) {
+        if (cursor->next == candidates.size()) {
+            return false;
+        }
+        struct streamed_texture* t = &streamer->textures[(uint32_t)candidates[cursor->next]];
+        if (t->loading != TEXTURE_STREAM_NONE || t->resident >= evict_floor(streamer, t)) {
+            cursor->next++;
+            continue;
+        }
+        uint64_t level = levels_size(t, t->resident, t->resident + 1);
+        stats->resident_bytes -= level;
+        stats->evicted_bytes += level;
+        stats->evictions++;
+        t->resident++;
+    }
+    return true;
+}
+
+void texture_streamer_update(struct texture_streamer* streamer) {
+    PROFILE_SCOPE("texture_streamer_update");
+    struct texture_stream_stats* stats = &streamer->stats;
+    streamer->frame++;
+    streamer->load_count = 0;
+    stats->loads = 0;
+    stats->load_bytes = 0;
+    stats->evictions = 0;
+    stats->missing_levels = 0;
+    stats->over_budget = 0;
+
+    uint32_t count = (uint32_t)streamer->textures.size();
+    for (uint32_t i = 0; i < count; i++) {
+        struct streamed_texture* t = &streamer->textures[i];
+        if (t->requested != TEXTURE_STREAM_NONE) {
+            t->wanted = std::min(t->requested, t->mip_count - 1);
+            t->requested = TEXTURE_STREAM_NONE;
+            t->last_used = streamer->frame;
+            if (t->wanted < t->resident) {
+                stats->missing_levels += t->resident - t->wanted;
+            }
+        }
+    }
+
+    struct evict_cursor cursor{};
+    // tails first and whatever the upload budget: nothing can be drawn
+    // without them
+    for (uint32_t i = 0; i < count; i++) {
+        struct streamed_texture* t = &streamer->textures[i];
+        if (t->resident == t->mip_count && t->loading == TEXTURE_STREAM_NONE) {
+            if (!reserve(streamer, &cursor, levels_size(t, t->tail, t->mip_count))) {
+                stats->over_budget = 1;
+            }
+            issue_load(streamer, i, t->tail, t->mip_count);
+        }
+    }
+
+    // then the textures in use furthest from the level they want, one
+    // level each so the coarse ones arrive first everywhere
+    std::vector<uint64_t>& wanting = streamer->wanting;
+    wanting.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        const struct streamed_texture* t = &streamer->textures[i];
+        if (t->last_used == streamer->frame && t->loading == TEXTURE_STREAM_NONE && t->wanted < t->resident &&
+            t->resident <= t->tail) {
+            wanting.push_back((uint64_t)(TEXTURE_STREAM_MAX_MIPS - (t->resident - t->wanted)) << 32 | i);
+        }
+    }
+    std::sort(wanting.begin(), wanting.end());
+    uint64_t issued = stats->load_bytes;
+    for (size_t c = 0; c < wanting.size(); c++) {
+        uint32_t index = (uint32_t)wanting[c];
+        struct streamed_texture* t = &streamer->textures[index];
+        uint64_t size = levels_size(t, t->resident - 1, t->resident);
+        if (stats->load_bytes > issued && stats->load_bytes - issued + size > streamer->upload_bytes_per_frame) {
+            break;
+        }
+        if (!reserve(streamer, &cursor, size)) {
+            stats->over_budget = 1;
+            break;
+        }
+        issue_load(streamer, index, t->resident - 1, t->resident);
+    }
+    PROFILE_COUNTER("texture resident bytes", stats->resident_bytes);
+    PROFILE_COUNTER("texture upload bytes", stats->load_bytes);
+}
+
+void texture_streamer_complete(struct texture_streamer* streamer, const struct texture_stream_load* load) {
+    struct streamed_texture* t = &streamer->textures[load->texture];
+    t->resident = load->first_level;
+    t->loading = TEXTURE_STREAM_NONE;
+    struct texture_stream_stats* stats = &streamer->stats;
+    stats->pending_bytes -= load->size;
+    stats->resident_bytes += load->size;
+    stats->uploaded_bytes += load->size;
+}
+
+uint32_t texture_stream_mip_for_size(uint32_t width, uint32_t height, uint32_t mip_count, float pixels,
+                                     float bias) {
+    if (!(pixels > 0.0f)) {
+        return mip_count - 1;
+    }
+    float mip = floorf(log2f((float)std::max(width, height) / pixels) + bias);
+    if (!(mip > 0.0f)) {
+        return 0;
+    }
+    return std::min((uint32_t)mip, mip_count - 1);
+}
@@ -0,0 +1,143 @@
+#ifndef ENGINE_TEXTURE_STREAM_H
+#define ENGINE_TEXTURE_STREAM_H
+
+#include <cstdint>
+#include <vector>
+
+#include "texture.h"
+
+// enough for a 32768 texel texture
+#define TEXTURE_STREAM_MAX_MIPS 16
+// mips this size and smaller are loaded with the texture and never evicted
+#define TEXTURE_STREAM_TAIL_SIZE 64
+#define TEXTURE_STREAM_NONE 0xffffffffu
+
+/**
+ * Load levels [first_level, first_level + level_count) of a texture:
+ * size bytes at source, tightly packed from the largest level down. The
+ * memory is already counted against the budget; report completion with
+ * texture_streamer_complete.
+ */
+struct texture_stream_load {
+    uint32_t texture;
+    uint32_t first_level;
+    uint32_t level_count;
+    const uint8_t* source;
+    uint64_t size;
+};
+
+/**
+ * Residency of one texture: levels [resident, mip_count) are loaded, the
+ * next finer one may be on its way. Levels are only ever added or dropped
+ * at the fine end, so the resident levels stay one contiguous chain.
+ */
+struct streamed_texture {
+    const uint8_t* data;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_count;
+    // first level of the tail that stays resident
+    uint32_t tail;
+    uint32_t resident;
+    uint32_t loading;
+    // finest level asked for since the last update, and the one the last
+    // frame that used the texture asked for
+    uint32_t requested;
+    uint32_t wanted;
+    uint64_t last_used;
+    uint64_t level_offset[TEXTURE_STREAM_MAX_MIPS + 1];
+};
+
+struct texture_stream_stats {
+    uint32_t textures;
+    uint64_t budget_bytes;
+    // loaded, and counted but still being uploaded
+    uint64_t resident_bytes;
+    uint64_t pending_bytes;
+    uint64_t peak_bytes;
+    // every level of every texture, what keeping it all resident would take
+    uint64_t full_bytes;
+    // totals since init
+    uint64_t uploaded_bytes;
+    uint64_t evicted_bytes;
+    // the last update: loads issued and their bytes, levels evicted,
+    // levels wanted by textures in use that are not resident, and whether
+    // a wanted load did not fit in the budget
+    uint32_t loads;
+    uint64_t load_bytes;
+    uint32_t evictions;
+    uint32_t missing_levels;
+    int over_budget;
+};
+
+/**
+ * Mip residency under a memory budget. Textures start with only their
+ * tail; every frame the caller requests the level each visible texture
+ * needs (see texture_stream_mip_for_size) and texture_streamer_update
+ * issues loads toward it, coarsest first and one level per texture at a
+ * time, within a per-frame upload budget. When a load does not fit in the
+ * memory budget, levels are evicted from the textures used longest ago,
+ * and from textures in use that hold finer levels than they now need.
+ * Nothing is dropped just because a texture got smaller on screen, so
+ * levels do not thrash while there is room. Holds no device objects; the
+ * caller performs the loads.
+ */
+struct texture_streamer {
+    std::vector<struct streamed_texture> textures;
+    std::vector<struct texture_stream_load> loads;
+    uint32_t load_count;
+    uint64_t upload_bytes_per_frame;
+    uint64_t frame;
+    struct texture_stream_stats stats;
+    // sort keys of the textures to load and to evict from, sized by
+    // texture_streamer_add so updates do not allocate
+    std::vector<uint64_t> wanting;
+    std::vector<uint64_t> evictable;
+};
+
+void texture_streamer_init(struct texture_streamer* streamer, uint64_t budget_bytes,
+                           uint64_t upload_bytes_per_frame);
+
+void texture_streamer_destroy(struct texture_streamer* streamer);
+
+/**
+ * Register a mip chain laid out like a texture variant and queue its tail
+ * for loading. data may be nullptr when the caller does not read the
+ * sources. Returns the texture's id, or TEXTURE_STREAM_NONE when
+ * mip_count is 0.
+ */
+uint32_t texture_streamer_add(struct texture_streamer* streamer, enum texture_format format, uint32_t width,
+                              uint32_t height, uint32_t mip_count, const void* data);
+
+/**
+ * The texture is drawn this frame and needs level mip; the finest request
+ * of the frame wins.
+ */
+inline void texture_streamer_request(struct texture_streamer* streamer, uint32_t texture, uint32_t mip) {
+    struct streamed_texture* t = &streamer->textures[texture];
+    if (mip < t->requested) {
+        t->requested = mip;
+    }
+}
+
+/**
+ * Apply this frame's requests: evict what has to go and fill
+ * loads[0, load_count) with what to upload. Call once per frame.
+ */
+void texture_streamer_update(struct texture_streamer* streamer);
+
+/**
+ * An upload from loads has landed; its levels become resident.
+ */
+void texture_streamer_complete(struct texture_streamer* streamer, const struct texture_stream_load* load);
+
+/**
+ * Level of a width x height texture to sample where it covers pixels
+ * pixels across the screen: the coarsest with at least a texel per pixel.
+ * bias shifts the choice, positive is blurrier.
+ */
+uint32_t texture_stream_mip_for_size(uint32_t width, uint32_t height, uint32_t mip_count, float pixels,
+                                     float bias);
+
+#endif // ENGINE_TEXTURE_STREAM_H
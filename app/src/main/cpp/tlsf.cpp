@@ -0,0 +1,229 @@
+#include "tlsf.h"
+
+#include <algorithm>
+
+static inline uint32_t fls64(uint64_t value) {
+    return 63u - (uint32_t)__builtin_clzll(value);
+}
+
+static inline uint32_t ffs32(uint32_t value) {
+    return (uint32_t)__builtin_ctz(value);
+}
+
+static inline uint32_t ffs64(uint64_t value) {
+    return (uint32_t)__builtin_ctzll(value);
+}
+
+/**
+ * Size class a free range of this size is filed under.
+ */
+static void mapping_insert(uint64_t size, uint32_t* fl, uint32_t* sl) {
+    *fl = fls64(size);
+    *sl = (uint32_t)(size >> (*fl - TLSF_SL_BITS)) & (TLSF_SL_COUNT - 1);
+}
+
+/**
+ * First size class whose every range is at least size bytes.
+ */
+static void mapping_search(uint64_t size, uint32_t* fl, uint32_t* sl) {
+    size += (1ull << (fls64(size) - TLSF_SL_BITS)) - 1;
+    mapping_insert(size, fl, sl);
+}
+
+static void insert_free(struct tlsf* tlsf, uint32_t index) {
+    struct tlsf_node* node = &tlsf->nodes[index];
+    uint32_t fl, sl;
+    mapping_insert(node->size, &fl, &sl);
+    node->free = 1;
+    node->prev_free = TLSF_NULL;
+    node->next_free = tlsf->heads[fl][sl];
+    if (node->next_free != TLSF_NULL) {
+        tlsf->nodes[node->next_free].prev_free = index;
+    }
+    tlsf->heads[fl][sl] = index;
+    tlsf->fl_bitmap |= 1ull << fl;
+    tlsf->sl_bitmap[fl] |= 1u << sl;
+}
+
+static void remove_free(struct tlsf* tlsf, uint32_t index) {
+    struct tlsf_node* node = &tlsf->nodes[index];
+    uint32_t fl, sl;
+    mapping_insert(node->size, &fl, &sl);
+    if (node->prev_free != TLSF_NULL) {
+        tlsf->nodes[node->prev_free].next_free = node->next_free;
+    } else {
+        tlsf->heads[fl][sl] = node->next_free;
+        if (node->next_free == TLSF_NULL) {
+            tlsf->sl_bitmap[fl] &= ~(1u << sl);
+            if (tlsf->sl_bitmap[fl] == 0) {
+                tlsf->fl_bitmap &= ~(1ull << fl);
+            }
+        }
+    }
+    if (node->next_free != TLSF_NULL) {
+        tlsf->nodes[node->next_free].prev_free = node->prev_free;
+    }
+    node->free = 0;
+}
+
+static uint32_t new_node(struct tlsf* tlsf) {
+    if (tlsf->unused_nodes != TLSF_NULL) {
+        uint32_t index = tlsf->unused_nodes;
+        tlsf->unused_nodes = tlsf->nodes[index].next_free;
+        return index;
+    }
+    tlsf->nodes.push_back({});
+    return (uint32_t)tlsf->nodes.size() - 1;
+}
+
+static void release_node(struct tlsf* tlsf, uint32_t index) {
+    tlsf->nodes[index] = {};
+    tlsf->nodes[index].next_free = tlsf->unused_nodes;
+    tlsf->unused_nodes = index;
+}
+
+/**
+ * Split the tail of node off into a new free node at offset + size.
+ */
+static void split_tail(struct tlsf* tlsf, uint32_t index, uint64_t size) {
+    uint32_t rest = new_node(tlsf);
+    struct tlsf_node* node = &tlsf->nodes[index];
+    struct tlsf_node* tail = &tlsf->nodes[rest];
+    tail->offset = node->offset + size;
+    tail->size = node->size - size;
+    tail->prev_phys = index;
+    tail->next_phys = node->next_phys;
+    if (node->next_phys != TLSF_NULL) {
+        tlsf->nodes[node->next_phys].prev_phys = rest;
+    }
+    node->next_phys = rest;
+    node->size = size;
+    insert_free(tlsf, rest);
+}
+
+void tlsf_init(struct tlsf* tlsf, uint64_t size, uint64_t granularity) {
+    tlsf->size = size & ~(granularity - 1);
+    tlsf->granularity = granularity;
+    tlsf->fl_bitmap = 0;
+    std::fill(tlsf->sl_bitmap, tlsf->sl_bitmap + TLSF_FL_COUNT, 0u);
+    for (auto& row : tlsf->heads) {
+        std::fill(row, row + TLSF_SL_COUNT, TLSF_NULL);
+    }
+    tlsf->nodes.clear();
+    tlsf->nodes.reserve(64);
+    tlsf->unused_nodes = TLSF_NULL;
+    tlsf->used_bytes = 0;
+    tlsf->allocation_count = 0;
+
+    uint32_t index = new_node(tlsf);
+    struct tlsf_node* node = &tlsf->nodes[index];
+    node->offset = 0;
+    node->size = tlsf->size;
+    node->prev_phys = TLSF_NULL;
+    node->next_phys = TLSF_NULL;
+    insert_free(tlsf, index);
+}
+
+void tlsf_destroy(struct tlsf* tlsf) {
+    tlsf->nodes = std::vector<struct tlsf_node>();
+    tlsf->size = 0;
+    tlsf->fl_bitmap = 0;
+    tlsf->used_bytes = 0;
+    tlsf->allocation_count = 0;
+}
+
+uint32_t tlsf_alloc(struct tlsf* tlsf, uint64_t size, uint64_t alignment, void* user) {
+    uint64_t granularity = tlsf->granularity;
+    size = std::max((size + granularity - 1) & ~(granularity - 1), granularity);
+    alignment = std::max(alignment, granularity);
+    // over-ask so any range from the class found can be aligned in place
+    uint64_t search = size + alignment - granularity;
+    if (search > tlsf->size) {
+        return TLSF_NULL;
+    }
+
+    uint32_t fl, sl;
+    mapping_search(search, &fl, &sl);
+    if (fl >= TLSF_FL_COUNT) {
+        return TLSF_NULL;
+    }
+    uint32_t sl_map = tlsf->sl_bitmap[fl] & (~0u << sl);
+    if (sl_map == 0) {
+        uint64_t fl_map = tlsf->fl_bitmap & (~0ull << (fl + 1));
+        if (fl_map == 0) {
+            return TLSF_NULL;
+        }
+        fl = ffs64(fl_map);
+        sl_map = tlsf->sl_bitmap[fl];
+    }
+    sl = ffs32(sl_map);
+    uint32_t index = tlsf->heads[fl][sl];
+    remove_free(tlsf, index);
+
+    // alignment padding in front becomes its own free range; the original
+    // node keeps the lower address so node 0 stays at offset 0
+    uint64_t offset = tlsf->nodes[index].offset;
+    uint64_t padding = ((offset + alignment - 1) & ~(alignment - 1)) - offset;
+    if (padding > 0) {
+        split_tail(tlsf, index, padding);
+        uint32_t front = index;
+        index = tlsf->nodes[front].next_phys;
+        remove_free(tlsf, index);
+        insert_free(tlsf, front);
+    }
+    if (tlsf->nodes[index].size > size) {
+        split_tail(tlsf, index, size);
+    }
+    struct tlsf_node* node = &tlsf->nodes[index];
+    node->user = user;
+    tlsf->used_bytes += node->size;
+    tlsf->allocation_count++;
+    return index;
+}
+
+void tlsf_free(struct tlsf* tlsf, uint32_t index) {
+    struct tlsf_node* node = &tlsf->nodes[index];
+    tlsf->used_bytes -= node->size;
+    tlsf->allocation_count--;
+    node->user = nullptr;
+
+    uint32_t next = node->next_phys;
+    if (next != TLSF_NULL && tlsf->nodes[next].free) {
+        remove_free(tlsf, next);
+        node = &tlsf->nodes[index];
+        node->size += tlsf->nodes[next].size;
+        node->next_phys = tlsf->nodes[next].next_phys;
+        if (node->next_phys != TLSF_NULL) {
+            tlsf->nodes[node->next_phys].prev_phys = index;
+        }
+        release_node(tlsf, next);
+    }
+    uint32_t prev = tlsf->nodes[index].prev_phys;
+    if (prev != TLSF_NULL && tlsf->nodes[prev].free) {
+        remove_free(tlsf, prev);
+        struct tlsf_node* merged = &tlsf->nodes[prev];
+        merged->size += tlsf->nodes[index].size;
+        merged->next_phys = tlsf->nodes[index].next_phys;
+        if (merged->next_phys != TLSF_NULL) {
+            tlsf->nodes[merged->next_phys].prev_phys = prev;
+        }
+        release_node(tlsf, index);
+        index = prev;
+    }
+    insert_free(tlsf, index);
+}
+
+uint64_t tlsf_largest_free(const struct tlsf* tlsf) {
+    if (tlsf->fl_bitmap == 0) {
+        return 0;
+    }
+    // ranges in the top class differ by less than its subdivision, so
+    // scan that one list
+    uint32_t fl = fls64(tlsf->fl_bitmap);
+    uint32_t sl = 31u - (uint32_t)__builtin_clz(tlsf->sl_bitmap[fl]);
+    uint64_t largest = 0;
+    for (uint32_t index = tlsf->heads[fl][sl]; index != TLSF_NULL; index = tlsf->nodes[index].next_free) {
+        largest = std::max(largest, tlsf->nodes[index].size);
+    }
+    return largest;
+}
@@ -0,0 +1,73 @@
+#ifndef ENGINE_TLSF_H
+#define ENGINE_TLSF_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Two-level segregated fit allocator over an abstract range [0, size).
+ * It only hands out offsets, so the same code manages GPU memory blocks
+ * (gpu_memory.h) and can be exercised without a device. Allocation and
+ * free are O(1): two bitmap scans find a free range at least as large as
+ * the request, and freed ranges merge with free physical neighbours.
+ */
+
+#define TLSF_SL_BITS 4
+#define TLSF_SL_COUNT (1u << TLSF_SL_BITS)
+// ranges up to 2^48 bytes
+#define TLSF_FL_COUNT 48
+#define TLSF_NULL 0xffffffffu
+
+struct tlsf_node {
+    uint64_t offset;
+    uint64_t size;
+    // neighbours by address, and links of the free list this node is on
+    uint32_t prev_phys;
+    uint32_t next_phys;
+    uint32_t prev_free;
+    uint32_t next_free;
+    uint32_t free;
+    // caller data for allocated nodes (gpu_memory keeps the owner here)
+    void* user;
+};
+
+struct tlsf {
+    uint64_t size;
+    // every offset and size is a multiple of this power of two
+    uint64_t granularity;
+    uint64_t fl_bitmap;
+    uint32_t sl_bitmap[TLSF_FL_COUNT];
+    uint32_t heads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+    // node 0 always starts at offset 0; unused slots are chained through
+    // next_free from unused_nodes
+    std::vector<struct tlsf_node> nodes;
+    uint32_t unused_nodes;
+    uint64_t used_bytes;
+    uint32_t allocation_count;
+};
+
+/**
+ * granularity must be a power of two of at least 16.
+ */
+void tlsf_init(struct tlsf* tlsf, uint64_t size, uint64_t granularity);
+
+void tlsf_destroy(struct tlsf* tlsf);
+
+/**
+ * Allocate size bytes at a multiple of alignment (a power of two).
+ * Returns the node index, or TLSF_NULL when no free range fits.
+ */
+uint32_t tlsf_alloc(struct tlsf* tlsf, uint64_t size, uint64_t alignment, void* user = nullptr);
+
+void tlsf_free(struct tlsf* tlsf, uint32_t node);
+
+inline const struct tlsf_node* tlsf_get(const struct tlsf* tlsf, uint32_t node) {
+    return &tlsf->nodes[node];
+}
+
+/**
+ * Size of the largest free range; free bytes minus this is fragmentation.
+ */
+uint64_t tlsf_largest_free(const struct tlsf* tlsf);
+
+#endif // ENGINE_TLSF_H
@@ -0,0 +1,149 @@
+#include "upscaler.h"
+
+#include "upscale_shader.h"
+
+static_assert(UPSCALE_COLOR_OUTPUTS == 1, "the upscale pass has one color attachment");
+static_assert(UPSCALE_DESCRIPTOR_SET_COUNT == 1, "upscale.frag uses one descriptor set");
+
+static int create_pipeline(struct vk_context* vk, struct upscaler* up, VkRenderPass render_pass) {
+    if (shader_program_create_layout(vk, &upscale_program, up->set_layouts, &up->layout) != 0) {
+        return -1;
+    }
+    VkShaderModule modules[SHADER_MAX_STAGES];
+    VkPipelineShaderStageCreateInfo stages[SHADER_MAX_STAGES];
+    if (shader_program_create_stages(vk, &upscale_program, modules, stages) != 0) {
+        return -1;
+    }
+
+    // the triangle comes from gl_VertexIndex
+    VkPipelineVertexInputStateCreateInfo vertex_input{};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly{};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewport{};
+    viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo raster{};
+    raster.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    raster.polygonMode = VK_POLYGON_MODE_FILL;
+    raster.cullMode = VK_CULL_MODE_NONE;
+    raster.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    raster.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample{};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState blend_attachment{};
+    blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo blend{};
+    blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    blend.attachmentCount = 1;
+    blend.pAttachments = &blend_attachment;
+
+    const VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic{};
+    dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic.dynamicStateCount = 2;
+    dynamic.pDynamicStates = dynamic_states;
+
+    VkGraphicsPipelineCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    info.stageCount = upscale_program.stage_count;
+    info.pStages = stages;
+    info.pVertexInputState = &vertex_input;
+    info.pInputAssemblyState = &input_assembly;
+    info.pViewportState = &viewport;
+    info.pRasterizationState = &raster;
+    info.pMultisampleState = &multisample;
+    info.pColorBlendState = &blend;
+    info.pDynamicState = &dynamic;
+    info.layout = up->layout;
+    info.renderPass = render_pass;
+    info.subpass = 0;
+    VkResult result = vkCreateGraphicsPipelines(vk->device, vk->pipeline_cache, 1, &info, nullptr, &up->pipeline);
+    shader_program_destroy_modules(vk, &upscale_program, modules);
+    VK_CHECK(result);
+    return 0;
+}
+
+int upscaler_init(struct vk_context* vk, struct upscaler* up, VkRenderPass render_pass) {
+    if (create_pipeline(vk, up, render_pass) != 0) {
+        return -1;
+    }
+    VkSamplerCreateInfo sampler{};
+    sampler.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler.magFilter = VK_FILTER_LINEAR;
+    sampler.minFilter = VK_FILTER_LINEAR;
+    sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    VK_CHECK(vkCreateSampler(vk->device, &sampler, nullptr, &up->sampler));
+
+    VkDescriptorPoolSize pool_size{};
+    pool_size.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pool_size.descriptorCount = 1;
+    VkDescriptorPoolCreateInfo pool{};
+    pool.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool.maxSets = 1;
+    pool.poolSizeCount = 1;
+    pool.pPoolSizes = &pool_size;
+    VK_CHECK(vkCreateDescriptorPool(vk->device, &pool, nullptr, &up->descriptor_pool));
+
+    VkDescriptorSetAllocateInfo allocate{};
+    allocate.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate.descriptorPool = up->descriptor_pool;
+    allocate.descriptorSetCount = 1;
+    allocate.pSetLayouts = &up->set_layouts[0];
+    VK_CHECK(vkAllocateDescriptorSets(vk->device, &allocate, &up->set));
+    return 0;
+}
+
+void upscaler_set_source(struct vk_context* vk, struct upscaler* up, VkImageView view) {
+    VkDescriptorImageInfo image{};
+    image.sampler = up->sampler;
+    image.imageView = view;
+    image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = up->set;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &image;
+    vkUpdateDescriptorSets(vk->device, 1, &write, 0, nullptr);
+}
+
+void upscaler_draw(const struct upscaler* up, VkCommandBuffer cmd, uint32_t source_width, uint32_t source_height,
+                   VkExtent2D rendered) {
+    float width = (float)source_width;
+    float height = (float)source_height;
+    struct upscale_push_constants push{};
+    push.uv_rect = { (float)rendered.width / width, (float)rendered.height / height,
+                     ((float)rendered.width - 0.5f) / width, ((float)rendered.height - 0.5f) / height };
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, up->pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, up->layout, 0, 1, &up->set, 0, nullptr);
+    vkCmdPushConstants(cmd, up->layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), &push);
+    vkCmdDraw(cmd, 3, 1, 0, 0);
+}
+
+void upscaler_destroy(struct vk_context* vk, struct upscaler* up) {
+    if (up->descriptor_pool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(vk->device, up->descriptor_pool, nullptr);
+    }
+    if (up->sampler != VK_NULL_HANDLE) {
+        vkDestroySampler(vk->device, up->sampler, nullptr);
+    }
+    if (up->pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(vk->device, up->pipeline, nullptr);
+    }
+    shader_program_destroy_layout(vk, &upscale_program, up->set_layouts, up->layout);
+    *up = {};
+}
@@ -0,0 +1,42 @@
+#ifndef ENGINE_UPSCALER_H
+#define ENGINE_UPSCALER_H
+
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "shader_program.h"
+#include "vk_context.h"
+
+/**
+ * Composites the scene into the swapchain image: a fullscreen triangle
+ * that stretches the top left part of the scene image the main pass
+ * rendered at its dynamic resolution over the whole target, bilinearly.
+ */
+struct upscaler {
+    VkDescriptorSetLayout set_layouts[SHADER_MAX_SETS];
+    VkPipelineLayout layout;
+    VkPipeline pipeline;
+    VkSampler sampler;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet set;
+};
+
+int upscaler_init(struct vk_context* vk, struct upscaler* up, VkRenderPass render_pass);
+
+/**
+ * Sample view from now on. Only call while no frame that reads the
+ * previous one is in flight, e.g. after rebuilding the render graph.
+ */
+void upscaler_set_source(struct vk_context* vk, struct upscaler* up, VkImageView view);
+
+/**
+ * Draw the rendered part of a source_width x source_height image over the
+ * target, inside a graph pass with viewport and scissor set.
+ */
+void upscaler_draw(const struct upscaler* up, VkCommandBuffer cmd, uint32_t source_width, uint32_t source_height,
+                   VkExtent2D rendered);
+
+void upscaler_destroy(struct vk_context* vk, struct upscaler* up);
+
+#endif // ENGINE_UPSCALER_H
@@ -0,0 +1,213 @@
+#include "vecmath.h"
+
+struct mat4 mat4_identity() {
+    struct mat4 m{};
+    m.cols[0].x = 1.0f;
+    m.cols[1].y = 1.0f;
+    m.cols[2].z = 1.0f;
+    m.cols[3].w = 1.0f;
+    return m;
+}
+
+struct mat4 mat4_translation(struct vec3 t) {
+    struct mat4 m = mat4_identity();
+    m.cols[3] = { t.x, t.y, t.z, 1.0f };
+    return m;
+}
+
+struct mat4 mat4_scaling(struct vec3 s) {
+    struct mat4 m{};
+    m.cols[0].x = s.x;
+    m.cols[1].y = s.y;
+    m.cols[2].z = s.z;
+    m.cols[3].w = 1.0f;
+    return m;
+}
+
+struct mat4 mat4_transpose(const struct mat4* m) {
+    const float* a = &m->cols[0].x;
+    struct mat4 r;
+    float* o = &r.cols[0].x;
+    for (int c = 0; c < 4; c++) {
+        for (int row = 0; row < 4; row++) {
+            o[c * 4 + row] = a[row * 4 + c];
+        }
+    }
+    return r;
+}
+
+struct mat4 mat4_perspective(float fovy, float aspect, float znear, float zfar) {
+    float f = 1.0f / tanf(fovy * 0.5f);
+    struct mat4 m{};
+    m.cols[0].x = f / aspect;
+    // Vulkan clip space has y pointing down
+    m.cols[1].y = -f;
+    m.cols[2].z = zfar / (znear - zfar);
+    m.cols[2].w = -1.0f;
+    m.cols[3].z = znear * zfar / (znear - zfar);
+    return m;
+}
+
+struct mat4 mat4_look_at(struct vec3 eye, struct vec3 target, struct vec3 up) {
+    struct vec3 f = vec3_normalize(vec3_sub(target, eye));
+    struct vec3 s = vec3_normalize(vec3_cross(f, up));
+    struct vec3 u = vec3_cross(s, f);
+    struct mat4 m;
+    m.cols[0] = { s.x, u.x, -f.x, 0.0f };
+    m.cols[1] = { s.y, u.y, -f.y, 0.0f };
+    m.cols[2] = { s.z, u.z, -f.z, 0.0f };
+    m.cols[3] = { -vec3_dot(s, eye), -vec3_dot(u, eye), vec3_dot(f, eye), 1.0f };
+    return m;
+}
+
+struct mat4 mat4_inverse(const struct mat4* m) {
+    const float* a = &m->cols[0].x;
+    float inv[16];
+    inv[0] = a[5] * a[10] * a[15] - a[5] * a[11] * a[14] - a[9] * a[6] * a[15] +
+             a[9] * a[7] * a[14] + a[13] * a[6] * a[11] - a[13] * a[7] * a[10];
+    inv[4] = -a[4] * a[10] * a[15] + a[4] * a[11] * a[14] + a[8] * a[6] * a[15] -
+             a[8] * a[7] * a[14] - a[12] * a[6] * a[11] + a[12] * a[7] * a[10];
+    inv[8] = a[4] * a[9] * a[15] - a[4] * a[11] * a[13] - a[8] * a[5] * a[15] +
+             a[8] * a[7] * a[13] + a[12] * a[5] * a[11] - a[12] * a[7] * a[9];
+    inv[12] = -a[4] * a[9] * a[14] + a[4] * a[10] * a[13] + a[8] * a[5] * a[14] -
+              a[8] * a[6] * a[13] - a[12] * a[5] * a[10] + a[12] * a[6] * a[9];
+    inv[1] = -a[1] * a[10] * a[15] + a[1] * a[11] * a[14] + a[9] * a[2] * a[15] -
+             a[9] * a[3] * a[14] - a[13] * a[2] * a[11] + a[13] * a[3] * a[10];
+    inv[5] = a[0] * a[10] * a[15] - a[0] * a[11] * a[14] - a[8] * a[2] * a[15] +
+             a[8] * a[3] * a[14] + a[12] * a[2] * a[11] - a[12] * a[3] * a[10];
+    inv[9] = -a[0] * a[9] * a[15] + a[0] * a[11] * a[13] + a[8] * a[1] * a[15] -
+             a[8] * a[3] * a[13] - a[12] * a[1] * a[11] + a[12] * a[3] * a[9];
+    inv[13] = a[0] * a[9] * a[14] - a[0] * a[10] * a[13] - a[8] * a[1] * a[14] +
+              a[8] * a[2] * a[13] + a[12] * a[1] * a[10] - a[12] * a[2] * a[9];
+    inv[2] = a[1] * a[6] * a[15] - a[1] * a[7] * a[14] - a[5] * a[2] * a[15] +
+             a[5] * a[3] * a[14] + a[13] * a[2] * a[7] - a[13] * a[3] * a[6];
+    inv[6] = -a[0] * a[6] * a[15] + a[0] * a[7] * a[14] + a[4] * a[2] * a[15] -
+             a[4] * a[3] * a[14] - a[12] * a[2] * a[7] + a[12] * a[3] * a[6];
+    inv[10] = a[0] * a[5] * a[15] - a[0] * a[7] * a[13] - a[4] * a[1] * a[15] +
+              a[4] * a[3] * a[13] + a[12] * a[1] * a[7] - a[12] * a[3] * a[5];
+    inv[14] = -a[0] * a[5] * a[14] + a[0] * a[6] * a[13] + a[4] * a[1] * a[14] -
+              a[4] * a[2] * a[13] - a[12] * a[1] * a[6] + a[12] * a[2] * a[5];
+    inv[3] = -a[1] * a[6] * a[11] + a[1] * a[7] * a[10] + a[5] * a[2] * a[11] -
+             a[5] * a[3] * a[10] - a[9] * a[2] * a[7] + a[9] * a[3] * a[6];
+    inv[7] = a[0] * a[6] * a[11] - a[0] * a[7] * a[10] - a[4] * a[2] * a[11] +
+             a[4] * a[3] * a[10] + a[8] * a[2] * a[7] - a[8] * a[3] * a[6];
+    inv[11] = -a[0] * a[5] * a[11] + a[0] * a[7] * a[9] + a[4] * a[1] * a[11] -
+              a[4] * a[3] * a[9] - a[8] * a[1] * a[7] + a[8] * a[3] * a[5];
+    inv[15] = a[0] * a[5] * a[10] - a[0] * a[6] * a[9] - a[4] * a[1] * a[10] +
+              a[4] * a[2] * a[9] + a[8] * a[1] * a[6] - a[8] * a[2] * a[5];
+
+    float det = a[0] * inv[0] + a[1] * inv[4] + a[2] * inv[8] + a[3] * inv[12];
+    if (det == 0.0f) {
+        return mat4_identity();
+    }
+    float inv_det = 1.0f / det;
+    struct mat4 r;
+    float* o = &r.cols[0].x;
+    for (int i = 0; i < 16; i++) {
+        o[i] = inv[i] * inv_det;
+    }
+    return r;
+}
+
+struct mat4 mat4_from_quat(struct quat q) {
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    struct mat4 m;
+    m.cols[0] = { 1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f };
+    m.cols[1] = { 2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f };
+    m.cols[2] = { 2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f };
+    m.cols[3] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    return m;
+}
+
+struct mat4 mat4_from_trs(struct vec3 t, struct quat r, struct vec3 s) {
+    struct mat4 m = mat4_from_quat(r);
+    m.cols[0] = vec4_scale(m.cols[0], s.x);
+    m.cols[1] = vec4_scale(m.cols[1], s.y);
+    m.cols[2] = vec4_scale(m.cols[2], s.z);
+    m.cols[3] = { t.x, t.y, t.z, 1.0f };
+    return m;
+}
+
+struct quat quat_slerp(struct quat a, struct quat b, float t) {
+    float cos_theta = quat_dot(a, b);
+    if (cos_theta < 0.0f) {
+        b = { -b.x, -b.y, -b.z, -b.w };
+        cos_theta = -cos_theta;
+    }
+    // nearly parallel, sin(theta) would lose precision
+    if (cos_theta > 0.9995f) {
+        return quat_nlerp(a, b, t);
+    }
+    float theta = acosf(cos_theta);
+    float inv_sin = 1.0f / sinf(theta);
+    float wa = sinf((1.0f - t) * theta) * inv_sin;
+    float wb = sinf(t * theta) * inv_sin;
+    return { a.x * wa + b.x * wb, a.y * wa + b.y * wb, a.z * wa + b.z * wb, a.w * wa + b.w * wb };
+}
+
+void mat4_transform_vec4(const struct mat4* m, const struct vec4* in, struct vec4* out, size_t n) {
+    simd4 c0 = vec4_load(&m->cols[0]);
+    simd4 c1 = vec4_load(&m->cols[1]);
+    simd4 c2 = vec4_load(&m->cols[2]);
+    simd4 c3 = vec4_load(&m->cols[3]);
+    for (size_t i = 0; i < n; i++) {
+        simd4 p = vec4_load(&in[i]);
+        simd4 r = simd_mul(c0, simd_splat<0>(p));
+        r = simd_madd(r, c1, simd_splat<1>(p));
+        r = simd_madd(r, c2, simd_splat<2>(p));
+        r = simd_madd(r, c3, simd_splat<3>(p));
+        vec4_store(&out[i], r);
+    }
+}
+
+void mat4_transform_points(const struct mat4* m, const struct vec3* in, struct vec4* out, size_t n) {
+    simd4 c0 = vec4_load(&m->cols[0]);
+    simd4 c1 = vec4_load(&m->cols[1]);
+    simd4 c2 = vec4_load(&m->cols[2]);
+    simd4 c3 = vec4_load(&m->cols[3]);
+    for (size_t i = 0; i < n; i++) {
+        // w = 1, so the translation column seeds the accumulator
+        simd4 r = simd_madd(c3, c0, simd_set1(in[i].x));
+        r = simd_madd(r, c1, simd_set1(in[i].y));
+        r = simd_madd(r, c2, simd_set1(in[i].z));
+        vec4_store(&out[i], r);
+    }
+}
+
+void mat4_transform_vec4_scalar(const struct mat4* m, const struct vec4* in, struct vec4* out, size_t n) {
+    const float* a = &m->cols[0].x;
+    for (size_t i = 0; i < n; i++) {
+        struct vec4 v = in[i];
+        out[i].x = a[0] * v.x + a[4] * v.y + a[8] * v.z + a[12] * v.w;
+        out[i].y = a[1] * v.x + a[5] * v.y + a[9] * v.z + a[13] * v.w;
+        out[i].z = a[2] * v.x + a[6] * v.y + a[10] * v.z + a[14] * v.w;
+        out[i].w = a[3] * v.x + a[7] * v.y + a[11] * v.z + a[15] * v.w;
+    }
+}
+
+void mat4_transform_points_scalar(const struct mat4* m, const struct vec3* in, struct vec4* out, size_t n) {
+    const float* a = &m->cols[0].x;
+    for (size_t i = 0; i < n; i++) {
+        struct vec3 v = in[i];
+        out[i].x = a[0] * v.x + a[4] * v.y + a[8] * v.z + a[12];
+        out[i].y = a[1] * v.x + a[5] * v.y + a[9] * v.z + a[13];
+        out[i].z = a[2] * v.x + a[6] * v.y + a[10] * v.z + a[14];
+        out[i].w = a[3] * v.x + a[7] * v.y + a[11] * v.z + a[15];
+    }
+}
+
+struct mat4 mat4_mul_scalar(const struct mat4* a, const struct mat4* b) {
+    const float* x = &a->cols[0].x;
+    const float* y = &b->cols[0].x;
+    struct mat4 r;
+    float* o = &r.cols[0].x;
+    for (int c = 0; c < 4; c++) {
+        for (int row = 0; row < 4; row++) {
+            o[c * 4 + row] = x[row] * y[c * 4] + x[4 + row] * y[c * 4 + 1] +
+                             x[8 + row] * y[c * 4 + 2] + x[12 + row] * y[c * 4 + 3];
+        }
+    }
+    return r;
+}
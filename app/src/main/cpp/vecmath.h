@@ -0,0 +1,327 @@
+#ifndef ENGINE_VECMATH_H
+#define ENGINE_VECMATH_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Vector, matrix and quaternion math. vec4/mat4/quat operations use NEON on
+ * the ARM ABIs and SSE on x86/x86_64, with a scalar fallback everywhere
+ * else (or when VECMATH_FORCE_SCALAR is defined). Matrices are
+ * column-major, projection follows Vulkan conventions (depth 0..1, y down
+ * in clip space).
+ */
+#if defined(VECMATH_FORCE_SCALAR)
+#define VECMATH_SCALAR 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VECMATH_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VECMATH_SSE 1
+#else
+#define VECMATH_SCALAR 1
+#endif
+
+struct vec3 {
+    float x, y, z;
+};
+
+struct alignas(16) vec4 {
+    float x, y, z, w;
+};
+
+struct alignas(16) quat {
+    float x, y, z, w;
+};
+
+struct alignas(16) mat4 {
+    struct vec4 cols[4];
+};
+
+// --- 4-wide register abstraction -------------------------------------------
+
+#if VECMATH_NEON
+typedef float32x4_t simd4;
+
+static inline simd4 simd_load(const float* p) { return vld1q_f32(p); }
+static inline void simd_store(float* p, simd4 v) { vst1q_f32(p, v); }
+static inline simd4 simd_set1(float s) { return vdupq_n_f32(s); }
+static inline simd4 simd_set(float x, float y, float z, float w) {
+    const float v[4] = { x, y, z, w };
+    return vld1q_f32(v);
+}
+static inline simd4 simd_add(simd4 a, simd4 b) { return vaddq_f32(a, b); }
+static inline simd4 simd_sub(simd4 a, simd4 b) { return vsubq_f32(a, b); }
+static inline simd4 simd_mul(simd4 a, simd4 b) { return vmulq_f32(a, b); }
+// a + b * c
+static inline simd4 simd_madd(simd4 a, simd4 b, simd4 c) { return vmlaq_f32(a, b, c); }
+static inline simd4 simd_min(simd4 a, simd4 b) { return vminq_f32(a, b); }
+static inline simd4 simd_max(simd4 a, simd4 b) { return vmaxq_f32(a, b); }
+static inline float simd_hsum(simd4 v) {
+#if defined(__aarch64__)
+    return vaddvq_f32(v);
+#else
+    float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+#endif
+}
+// bit i set where a[i] < b[i]
+static inline int simd_lt_mask(simd4 a, simd4 b) {
+    static const uint32_t lane_bits[4] = { 1, 2, 4, 8 };
+    uint32x4_t bits = vandq_u32(vcltq_f32(a, b), vld1q_u32(lane_bits));
+#if defined(__aarch64__)
+    return (int)vaddvq_u32(bits);
+#else
+    uint32x2_t s = vorr_u32(vget_low_u32(bits), vget_high_u32(bits));
+    return (int)(vget_lane_u32(s, 0) | vget_lane_u32(s, 1));
+#endif
+}
+template <int lane>
+static inline simd4 simd_splat(simd4 v) {
+    if constexpr (lane < 2) {
+        return vdupq_lane_f32(vget_low_f32(v), lane);
+    } else {
+        return vdupq_lane_f32(vget_high_f32(v), lane - 2);
+    }
+}
+#elif VECMATH_SSE
+typedef __m128 simd4;
+
+static inline simd4 simd_load(const float* p) { return _mm_load_ps(p); }
+static inline void simd_store(float* p, simd4 v) { _mm_store_ps(p, v); }
+static inline simd4 simd_set1(float s) { return _mm_set1_ps(s); }
+static inline simd4 simd_set(float x, float y, float z, float w) { return _mm_setr_ps(x, y, z, w); }
+static inline simd4 simd_add(simd4 a, simd4 b) { return _mm_add_ps(a, b); }
+static inline simd4 simd_sub(simd4 a, simd4 b) { return _mm_sub_ps(a, b); }
+static inline simd4 simd_mul(simd4 a, simd4 b) { return _mm_mul_ps(a, b); }
+static inline simd4 simd_madd(simd4 a, simd4 b, simd4 c) { return _mm_add_ps(a, _mm_mul_ps(b, c)); }
+static inline simd4 simd_min(simd4 a, simd4 b) { return _mm_min_ps(a, b); }
+static inline simd4 simd_max(simd4 a, simd4 b) { return _mm_max_ps(a, b); }
+static inline float simd_hsum(simd4 v) {
+    __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuf);
+    shuf = _mm_movehl_ps(shuf, sums);
+    return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+}
+static inline int simd_lt_mask(simd4 a, simd4 b) { return _mm_movemask_ps(_mm_cmplt_ps(a, b)); }
+template <int lane>
+static inline simd4 simd_splat(simd4 v) {
+    return _mm_shuffle_ps(v, v, _MM_SHUFFLE(lane, lane, lane, lane));
+}
+#else
+struct simd4 {
+    float v[4];
+};
+
+static inline simd4 simd_load(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+static inline void simd_store(float* p, simd4 a) {
+    p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; p[3] = a.v[3];
+}
+static inline simd4 simd_set1(float s) { return { { s, s, s, s } }; }
+static inline simd4 simd_set(float x, float y, float z, float w) { return { { x, y, z, w } }; }
+static inline simd4 simd_add(simd4 a, simd4 b) {
+    return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } };
+}
+static inline simd4 simd_sub(simd4 a, simd4 b) {
+    return { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } };
+}
+static inline simd4 simd_mul(simd4 a, simd4 b) {
+    return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } };
+}
+static inline simd4 simd_madd(simd4 a, simd4 b, simd4 c) { return simd_add(a, simd_mul(b, c)); }
+static inline simd4 simd_min(simd4 a, simd4 b) {
+    return { { fminf(a.v[0], b.v[0]), fminf(a.v[1], b.v[1]),
+               fminf(a.v[2], b.v[2]), fminf(a.v[3], b.v[3]) } };
+}
+static inline simd4 simd_max(simd4 a, simd4 b) {
+    return { { fmaxf(a.v[0], b.v[0]), fmaxf(a.v[1], b.v[1]),
+               fmaxf(a.v[2], b.v[2]), fmaxf(a.v[3], b.v[3]) } };
+}
+static inline float simd_hsum(simd4 a) { return (a.v[0] + a.v[1]) + (a.v[2] + a.v[3]); }
+static inline int simd_lt_mask(simd4 a, simd4 b) {
+    return (a.v[0] < b.v[0] ? 1 : 0) | (a.v[1] < b.v[1] ? 2 : 0) | (a.v[2] < b.v[2] ? 4 : 0) |
+           (a.v[3] < b.v[3] ? 8 : 0);
+}
+template <int lane>
+static inline simd4 simd_splat(simd4 a) { return simd_set1(a.v[lane]); }
+#endif
+
+static inline simd4 vec4_load(const struct vec4* v) { return simd_load(&v->x); }
+static inline void vec4_store(struct vec4* v, simd4 r) { simd_store(&v->x, r); }
+
+// --- vec3 ------------------------------------------------------------------
+
+static inline struct vec3 vec3_make(float x, float y, float z) { return { x, y, z }; }
+static inline struct vec3 vec3_add(struct vec3 a, struct vec3 b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+static inline struct vec3 vec3_sub(struct vec3 a, struct vec3 b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+static inline struct vec3 vec3_mul(struct vec3 a, struct vec3 b) { return { a.x * b.x, a.y * b.y, a.z * b.z }; }
+static inline struct vec3 vec3_scale(struct vec3 a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+static inline struct vec3 vec3_min(struct vec3 a, struct vec3 b) {
+    return { fminf(a.x, b.x), fminf(a.y, b.y), fminf(a.z, b.z) };
+}
+static inline struct vec3 vec3_max(struct vec3 a, struct vec3 b) {
+    return { fmaxf(a.x, b.x), fmaxf(a.y, b.y), fmaxf(a.z, b.z) };
+}
+static inline float vec3_dot(struct vec3 a, struct vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static inline struct vec3 vec3_cross(struct vec3 a, struct vec3 b) {
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+static inline float vec3_length(struct vec3 a) { return sqrtf(vec3_dot(a, a)); }
+static inline struct vec3 vec3_normalize(struct vec3 a) {
+    float len = vec3_length(a);
+    return len > 0.0f ? vec3_scale(a, 1.0f / len) : a;
+}
+static inline struct vec3 vec3_lerp(struct vec3 a, struct vec3 b, float t) {
+    return vec3_add(a, vec3_scale(vec3_sub(b, a), t));
+}
+
+// --- vec4 ------------------------------------------------------------------
+
+static inline struct vec4 vec4_make(float x, float y, float z, float w) { return { x, y, z, w }; }
+static inline struct vec4 vec4_from_vec3(struct vec3 v, float w) { return { v.x, v.y, v.z, w }; }
+
+static inline struct vec4 vec4_add(struct vec4 a, struct vec4 b) {
+    struct vec4 r;
+    vec4_store(&r, simd_add(vec4_load(&a), vec4_load(&b)));
+    return r;
+}
+static inline struct vec4 vec4_sub(struct vec4 a, struct vec4 b) {
+    struct vec4 r;
+    vec4_store(&r, simd_sub(vec4_load(&a), vec4_load(&b)));
+    return r;
+}
+static inline struct vec4 vec4_mul(struct vec4 a, struct vec4 b) {
+    struct vec4 r;
+    vec4_store(&r, simd_mul(vec4_load(&a), vec4_load(&b)));
+    return r;
+}
+static inline struct vec4 vec4_scale(struct vec4 a, float s) {
+    struct vec4 r;
+    vec4_store(&r, simd_mul(vec4_load(&a), simd_set1(s)));
+    return r;
+}
+static inline float vec4_dot(struct vec4 a, struct vec4 b) {
+    return simd_hsum(simd_mul(vec4_load(&a), vec4_load(&b)));
+}
+static inline float vec4_length(struct vec4 a) { return sqrtf(vec4_dot(a, a)); }
+
+// --- mat4 ------------------------------------------------------------------
+
+struct mat4 mat4_identity();
+struct mat4 mat4_translation(struct vec3 t);
+struct mat4 mat4_scaling(struct vec3 s);
+struct mat4 mat4_transpose(const struct mat4* m);
+struct mat4 mat4_perspective(float fovy, float aspect, float znear, float zfar);
+struct mat4 mat4_look_at(struct vec3 eye, struct vec3 target, struct vec3 up);
+/**
+ * General inverse; returns identity for singular matrices.
+ */
+struct mat4 mat4_inverse(const struct mat4* m);
+/**
+ * Translation * rotation * scale, the usual object-to-world transform.
+ */
+struct mat4 mat4_from_trs(struct vec3 t, struct quat r, struct vec3 s);
+
+static inline struct vec4 mat4_mul_vec4(const struct mat4* m, struct vec4 v) {
+    simd4 p = vec4_load(&v);
+    simd4 r = simd_mul(vec4_load(&m->cols[0]), simd_splat<0>(p));
+    r = simd_madd(r, vec4_load(&m->cols[1]), simd_splat<1>(p));
+    r = simd_madd(r, vec4_load(&m->cols[2]), simd_splat<2>(p));
+    r = simd_madd(r, vec4_load(&m->cols[3]), simd_splat<3>(p));
+    struct vec4 out;
+    vec4_store(&out, r);
+    return out;
+}
+
+static inline struct vec3 mat4_mul_point(const struct mat4* m, struct vec3 p) {
+    struct vec4 r = mat4_mul_vec4(m, vec4_from_vec3(p, 1.0f));
+    return { r.x, r.y, r.z };
+}
+
+static inline struct mat4 mat4_mul(const struct mat4* a, const struct mat4* b) {
+    struct mat4 r;
+    for (int i = 0; i < 4; i++) {
+        r.cols[i] = mat4_mul_vec4(a, b->cols[i]);
+    }
+    return r;
+}
+
+/**
+ * out[i] = m * in[i] for n vectors.
+ */
+void mat4_transform_vec4(const struct mat4* m, const struct vec4* in, struct vec4* out, size_t n);
+
+/**
+ * out[i] = m * (in[i], 1) for n points, e.g. object space to clip space.
+ */
+void mat4_transform_points(const struct mat4* m, const struct vec3* in, struct vec4* out, size_t n);
+
+/**
+ * Plain scalar versions of the batch kernels, the reference the SIMD paths
+ * are benchmarked and checked against.
+ */
+void mat4_transform_vec4_scalar(const struct mat4* m, const struct vec4* in, struct vec4* out, size_t n);
+void mat4_transform_points_scalar(const struct mat4* m, const struct vec3* in, struct vec4* out, size_t n);
+struct mat4 mat4_mul_scalar(const struct mat4* a, const struct mat4* b);
+
+// --- quat ------------------------------------------------------------------
+
+static inline struct quat quat_identity() { return { 0.0f, 0.0f, 0.0f, 1.0f }; }
+
+static inline struct quat quat_from_axis_angle(struct vec3 axis, float angle) {
+    struct vec3 a = vec3_scale(vec3_normalize(axis), sinf(angle * 0.5f));
+    return { a.x, a.y, a.z, cosf(angle * 0.5f) };
+}
+
+static inline struct quat quat_mul(struct quat a, struct quat b) {
+    return {
+        a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+        a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+        a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+    };
+}
+
+static inline float quat_dot(struct quat a, struct quat b) {
+    return simd_hsum(simd_mul(simd_load(&a.x), simd_load(&b.x)));
+}
+
+static inline struct quat quat_normalize(struct quat q) {
+    float len = sqrtf(quat_dot(q, q));
+    float inv = len > 0.0f ? 1.0f / len : 0.0f;
+    struct quat r;
+    simd_store(&r.x, simd_mul(simd_load(&q.x), simd_set1(inv)));
+    return r;
+}
+
+static inline struct quat quat_conjugate(struct quat q) { return { -q.x, -q.y, -q.z, q.w }; }
+
+/**
+ * Rotate v by unit quaternion q (v' = v + 2w(u x v) + 2u x (u x v)).
+ */
+static inline struct vec3 quat_rotate(struct quat q, struct vec3 v) {
+    struct vec3 u = { q.x, q.y, q.z };
+    struct vec3 t = vec3_scale(vec3_cross(u, v), 2.0f);
+    return vec3_add(vec3_add(v, vec3_scale(t, q.w)), vec3_cross(u, t));
+}
+
+/**
+ * Normalized lerp along the shortest arc; cheap and good enough for
+ * animation blending at frame-rate step sizes.
+ */
+static inline struct quat quat_nlerp(struct quat a, struct quat b, float t) {
+    float sign = quat_dot(a, b) < 0.0f ? -1.0f : 1.0f;
+    simd4 va = simd_load(&a.x);
+    simd4 vb = simd_mul(simd_load(&b.x), simd_set1(sign));
+    struct quat r;
+    simd_store(&r.x, simd_madd(va, simd_sub(vb, va), simd_set1(t)));
+    return quat_normalize(r);
+}
+
+struct quat quat_slerp(struct quat a, struct quat b, float t);
+
+struct mat4 mat4_from_quat(struct quat q);
+
+#endif // ENGINE_VECMATH_H
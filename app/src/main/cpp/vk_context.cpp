@@ -0,0 +1,261 @@
+#include "vk_context.h"
+
+#include <cstring>
+#include <vector>
+
+#include "platform.h"
+
+static int create_instance(struct vk_context* vk) {
+    uint32_t extension_count = 0;
+    const char* const* extensions = platform_vk_instance_extensions(&extension_count);
+
+    VkApplicationInfo app{};
+    app.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    app.pApplicationName = "native-activity";
+    app.pEngineName = "Engine";
+    app.apiVersion = VK_API_VERSION_1_1;
+
+    VkInstanceCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    info.pApplicationInfo = &app;
+    info.enabledExtensionCount = extension_count;
+    info.ppEnabledExtensionNames = extensions;
+    VK_CHECK(vkCreateInstance(&info, nullptr, &vk->instance));
+    return 0;
+}
+
+/**
+ * Pick the first device with a queue family that can both draw and present.
+ * Discrete and integrated GPUs win over CPU implementations such as lavapipe.
+ */
+static int pick_physical_device(struct vk_context* vk) {
+    uint32_t count = 0;
+    VK_CHECK(vkEnumeratePhysicalDevices(vk->instance, &count, nullptr));
+    std::vector<VkPhysicalDevice> devices(count);
+    VK_CHECK(vkEnumeratePhysicalDevices(vk->instance, &count, devices.data()));
+
+    int best_score = -1;
+    for (VkPhysicalDevice device : devices) {
+        uint32_t family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count, nullptr);
+        std::vector<VkQueueFamilyProperties> families(family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count, families.data());
+
+        for (uint32_t i = 0; i < family_count; i++) {
+            VkBool32 present = VK_FALSE;
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, vk->surface, &present);
+            if (!(families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) || !present) {
+                continue;
+            }
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(device, &properties);
+            int score = properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU ? 0 : 1;
+            if (score > best_score) {
+                best_score = score;
+                vk->physical_device = device;
+                vk->graphics_family = i;
+                vk->timestamp_valid_bits = families[i].timestampValidBits;
+            }
+            break;
+        }
+    }
+    if (best_score < 0) {
+        LOGE("no Vulkan device can present to the surface");
+        return -1;
+    }
+    vkGetPhysicalDeviceProperties(vk->physical_device, &vk->properties);
+    vkGetPhysicalDeviceMemoryProperties(vk->physical_device, &vk->memory_properties);
+    LOGI("using %s", vk->properties.deviceName);
+    return 0;
+}
+
+/**
+ * Prefer a family that only does transfers (a DMA engine on discrete GPUs),
+ * then one without graphics, then a second queue of the graphics family.
+ */
+static void pick_transfer_queue(struct vk_context* vk, uint32_t* queue_index) {
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(vk->physical_device, &count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(vk->physical_device, &count, families.data());
+
+    int best = -1;
+    int best_score = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        VkQueueFlags flags = families[i].queueFlags;
+        if (i == vk->graphics_family || families[i].queueCount == 0 ||
+            !(flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            continue;
+        }
+        int score = (flags & VK_QUEUE_GRAPHICS_BIT) ? 1 : (flags & VK_QUEUE_COMPUTE_BIT) ? 2 : 3;
+        if (score > best_score) {
+            best_score = score;
+            best = (int)i;
+        }
+    }
+    *queue_index = 0;
+    vk->transfer_queue_shared = 0;
+    if (best >= 0) {
+        vk->transfer_family = (uint32_t)best;
+    } else {
+        vk->transfer_family = vk->graphics_family;
+        if (families[vk->graphics_family].queueCount > 1) {
+            *queue_index = 1;
+        } else {
+            vk->transfer_queue_shared = 1;
+        }
+    }
+}
+
+static bool has_extension(const std::vector<VkExtensionProperties>& available, const char* name) {
+    for (const VkExtensionProperties& extension : available) {
+        if (strcmp(extension.extensionName, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int create_device(struct vk_context* vk) {
+    uint32_t available_count = 0;
+    VK_CHECK(vkEnumerateDeviceExtensionProperties(vk->physical_device, nullptr, &available_count, nullptr));
+    std::vector<VkExtensionProperties> available(available_count);
+    VK_CHECK(vkEnumerateDeviceExtensionProperties(vk->physical_device, nullptr, &available_count,
+                                                  available.data()));
+
+    uint32_t transfer_index = 0;
+    pick_transfer_queue(vk, &transfer_index);
+
+    // uploads run at lower priority than rendering
+    const float priorities[] = { 1.0f, 0.5f };
+    VkDeviceQueueCreateInfo queues[2]{};
+    uint32_t queue_count = 1;
+    queues[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queues[0].queueFamilyIndex = vk->graphics_family;
+    queues[0].queueCount = transfer_index + 1;
+    queues[0].pQueuePriorities = priorities;
+    if (vk->transfer_family != vk->graphics_family) {
+        queues[1].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queues[1].queueFamilyIndex = vk->transfer_family;
+        queues[1].queueCount = 1;
+        queues[1].pQueuePriorities = &priorities[1];
+        queue_count = 2;
+    }
+
+    std::vector<const char*> extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+    // actual present timestamps and desired present times for frame pacing
+    vk->has_display_timing = has_extension(available, VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+    if (vk->has_display_timing) {
+        extensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+    }
+    vk->has_draw_indirect_count = has_extension(available, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    if (vk->has_draw_indirect_count) {
+        extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+
+    // compressed formats can only be sampled with their feature enabled;
+    // texture.h checks which of them the device actually supports
+    VkPhysicalDeviceFeatures supported{};
+    vkGetPhysicalDeviceFeatures(vk->physical_device, &supported);
+    VkPhysicalDeviceFeatures features{};
+    features.textureCompressionETC2 = supported.textureCompressionETC2;
+    features.textureCompressionASTC_LDR = supported.textureCompressionASTC_LDR;
+    features.textureCompressionBC = supported.textureCompressionBC;
+
+    VkDeviceCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    info.queueCreateInfoCount = queue_count;
+    info.pQueueCreateInfos = queues;
+    info.enabledExtensionCount = (uint32_t)extensions.size();
+    info.ppEnabledExtensionNames = extensions.data();
+    info.pEnabledFeatures = &features;
+    VK_CHECK(vkCreateDevice(vk->physical_device, &info, nullptr, &vk->device));
+
+    if (vk->has_display_timing) {
+        vk->get_refresh_cycle_duration = (PFN_vkGetRefreshCycleDurationGOOGLE)
+                vkGetDeviceProcAddr(vk->device, "vkGetRefreshCycleDurationGOOGLE");
+        vk->get_past_presentation_timing = (PFN_vkGetPastPresentationTimingGOOGLE)
+                vkGetDeviceProcAddr(vk->device, "vkGetPastPresentationTimingGOOGLE");
+        vk->has_display_timing = vk->get_refresh_cycle_duration != nullptr &&
+                                 vk->get_past_presentation_timing != nullptr;
+    }
+
+    if (vk->has_draw_indirect_count) {
+        vk->cmd_draw_indirect_count = (PFN_vkCmdDrawIndirectCountKHR)
+                vkGetDeviceProcAddr(vk->device, "vkCmdDrawIndirectCountKHR");
+        vk->has_draw_indirect_count = vk->cmd_draw_indirect_count != nullptr;
+    }
+
+    vkGetDeviceQueue(vk->device, vk->graphics_family, 0, &vk->graphics_queue);
+    vkGetDeviceQueue(vk->device, vk->transfer_family, transfer_index, &vk->transfer_queue);
+    LOGI("uploads: %s", vk->transfer_family != vk->graphics_family ? "dedicated transfer queue"
+                        : vk->transfer_queue_shared ? "graphics queue (shared)" : "second graphics queue");
+    return 0;
+}
+
+int vk_context_init(struct vk_context* vk, void* window) {
+    if (create_instance(vk) != 0) {
+        return -1;
+    }
+    VK_CHECK(platform_create_surface(vk->instance, window, &vk->surface));
+    if (pick_physical_device(vk) != 0) {
+        return -1;
+    }
+    if (create_device(vk) != 0) {
+        return -1;
+    }
+    gpu_allocator_init(&vk->allocator, vk->physical_device, vk->device);
+    return 0;
+}
+
+void vk_context_destroy(struct vk_context* vk) {
+    if (vk->device != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(vk->device);
+        gpu_allocator_destroy(&vk->allocator);
+        if (vk->pipeline_cache != VK_NULL_HANDLE) {
+            vkDestroyPipelineCache(vk->device, vk->pipeline_cache, nullptr);
+        }
+        vkDestroyDevice(vk->device, nullptr);
+    }
+    if (vk->surface != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(vk->instance, vk->surface, nullptr);
+    }
+    if (vk->instance != VK_NULL_HANDLE) {
+        vkDestroyInstance(vk->instance, nullptr);
+    }
+    *vk = {};
+}
+
+int vk_create_buffer(struct vk_context* vk, VkDeviceSize size, VkBufferUsageFlags usage,
+                     VkMemoryPropertyFlags properties, VkBuffer* buffer,
+                     struct gpu_allocation* allocation) {
+    VkBufferCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = size;
+    info.usage = usage;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    // concurrent sharing instead of queue family ownership transfers, so
+    // streamed data needs no acquire barrier on the graphics queue
+    const uint32_t families[] = { vk->graphics_family, vk->transfer_family };
+    if ((usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) && vk->transfer_family != vk->graphics_family) {
+        info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        info.queueFamilyIndexCount = 2;
+        info.pQueueFamilyIndices = families;
+    }
+    VK_CHECK(vkCreateBuffer(vk->device, &info, nullptr, buffer));
+
+    if (gpu_alloc_buffer(&vk->allocator, *buffer, properties, allocation) != 0) {
+        vkDestroyBuffer(vk->device, *buffer, nullptr);
+        *buffer = VK_NULL_HANDLE;
+        return -1;
+    }
+    return 0;
+}
+
+void vk_destroy_buffer(struct vk_context* vk, VkBuffer* buffer, struct gpu_allocation* allocation) {
+    if (*buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(vk->device, *buffer, nullptr);
+    }
+    gpu_free(&vk->allocator, allocation);
+    *buffer = VK_NULL_HANDLE;
+}
@@ -0,0 +1,83 @@
+#ifndef ENGINE_VK_CONTEXT_H
+#define ENGINE_VK_CONTEXT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "gpu_memory.h"
+#include "log.h"
+
+/**
+ * Log and bail out of an int-returning init function on Vulkan errors.
+ */
+#define VK_CHECK(call)                                                   \
+    do {                                                                 \
+        VkResult vk_check_result_ = (call);                              \
+        if (vk_check_result_ != VK_SUCCESS) {                            \
+            LOGE("%s failed: %d (%s:%d)", #call, (int)vk_check_result_,  \
+                 __FILE__, __LINE__);                                    \
+            return -1;                                                   \
+        }                                                                \
+    } while (0)
+
+/**
+ * Instance, device and queues shared by every renderer subsystem.
+ */
+struct vk_context {
+    VkInstance instance;
+    VkSurfaceKHR surface;
+    VkPhysicalDevice physical_device;
+    VkPhysicalDeviceProperties properties;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    VkDevice device;
+    uint32_t graphics_family;
+    VkQueue graphics_queue;
+    // meaningful bits of timestamps written on the graphics queue, 0 when
+    // it cannot write them
+    uint32_t timestamp_valid_bits;
+    // Uploads go to a transfer-only family when there is one, else to a
+    // second graphics queue. With neither, transfer_queue is graphics_queue
+    // and transfer_queue_shared tells users to submit from the render thread.
+    uint32_t transfer_family;
+    VkQueue transfer_queue;
+    int transfer_queue_shared;
+    // shared by every pipeline creation, persisted by pipeline_cache.h
+    VkPipelineCache pipeline_cache;
+    // FNV-1a of the cache data as last loaded or saved
+    uint64_t pipeline_cache_saved_hash;
+    // every buffer and image is sub-allocated from here
+    struct gpu_allocator allocator;
+
+    // optional device extensions that were found and enabled
+    int has_display_timing;
+    PFN_vkGetRefreshCycleDurationGOOGLE get_refresh_cycle_duration;
+    PFN_vkGetPastPresentationTimingGOOGLE get_past_presentation_timing;
+    // indirect draws whose count the GPU writes, for GPU driven culling
+    int has_draw_indirect_count;
+    PFN_vkCmdDrawIndirectCountKHR cmd_draw_indirect_count;
+};
+
+/**
+ * Create instance, surface and logical device for the given native window.
+ */
+int vk_context_init(struct vk_context* vk, void* window);
+
+/**
+ * Destroy everything created by vk_context_init.
+ */
+void vk_context_destroy(struct vk_context* vk);
+
+/**
+ * Create a buffer bound to memory from vk->allocator; host visible memory
+ * comes back mapped in allocation->mapped. Buffers that can be a transfer
+ * destination are shared with the transfer family.
+ */
+int vk_create_buffer(struct vk_context* vk, VkDeviceSize size, VkBufferUsageFlags usage,
+                     VkMemoryPropertyFlags properties, VkBuffer* buffer,
+                     struct gpu_allocation* allocation);
+
+void vk_destroy_buffer(struct vk_context* vk, VkBuffer* buffer, struct gpu_allocation* allocation);
+
+#endif // ENGINE_VK_CONTEXT_H
@@ -0,0 +1,793 @@
+#!/usr/bin/env python3
+"""Optimize and quantize a triangle mesh into the engine's .mesh format.
+
+Usage: build_mesh.py --output NAME.mesh [--lods N] (INPUT.obj | --demo torus)
+       build_mesh.py --output NAME_mesh.h --embed NAME [--lods N] (INPUT.obj | --demo torus)
+
+The triangles are reordered for the post-transform vertex cache (Forsyth's
+linear-speed algorithm), then split into clusters that are sorted so the
+outward facing ones draw first, which cuts overdraw while keeping most of
+the cache ordering. Vertices are then renumbered in the order the index
+buffer first uses them, so vertex fetch walks memory forwards.
+
+Attributes are quantized to 20 bytes per vertex:
+
+    position  4 x half   xyz across the mesh bounds, w the bitangent sign
+    normal    2 x snorm16 octahedral
+    tangent   2 x snorm16 octahedral
+    uv        2 x unorm16 across the mesh's uv bounds
+
+Coarser LODs are made with a quadric error edge collapse simplifier, each
+with about half the triangles of the one before by default. They reuse the
+vertex buffer, each LOD is a range of the index buffer, and vertices are
+numbered so every LOD's vertices are a prefix of it. The simplifier only
+moves vertices onto their neighbours, so no new vertices are needed.
+
+shaders/mesh.vert decodes them; the layout is described in
+app/src/main/cpp/mesh.h. With --embed the mesh is written as a C++ header
+instead, so checks can build against what the tool produces. Bytes per vertex, ACMR (cache misses per
+triangle), ATVR (misses per vertex) and vertex fetch overfetch are printed
+before and after.
+"""
+
+import argparse
+import heapq
+import math
+import os
+import random
+import struct
+import sys
+from collections import OrderedDict
+
+MAGIC = 0x48534D45  # "EMSH"
+VERSION = 2
+HEADER = struct.Struct("<IIII3f3f2f2fIIIIII")
+VERTEX = struct.Struct("<4e2h2h2H")
+# first index, index count, error, reserved
+LOD = struct.Struct("<IIfI")
+# float position, normal, tangent with sign, uv
+UNQUANTIZED_STRIDE = 48
+
+FORSYTH_CACHE = 32
+# FIFO caches the ACMR is measured with, roughly what mobile GPUs have
+MEASURE_CACHES = (16, 32)
+FETCH_CACHE_BYTES = 16 * 1024
+FETCH_LINE_BYTES = 64
+OVERDRAW_THRESHOLD = 1.05
+
+
+class MeshError(Exception):
+    pass
+
+
+# ---------------------------------------------------------------------------
+# input
+
+
+def load_obj(path):
+    """Triangles of an OBJ file as (positions, normals, uvs, indices), one
+    vertex per distinct v/vt/vn triple. Missing normals and uvs are None."""
+    positions, normals, uvs = [], [], []
+    vertex_ids = {}
+    out_positions, out_normals, out_uvs, indices = [], [], [], []
+    has_normals = has_uvs = True
+    with open(path, "r") as f:
+        for line_number, line in enumerate(f, 1):
+            parts = line.split()
+            if not parts:
+                continue
+            if parts[0] == "v":
+                positions.append(tuple(float(x) for x in parts[1:4]))
+            elif parts[0] == "vn":
+                normals.append(tuple(float(x) for x in parts[1:4]))
+            elif parts[0] == "vt":
+                uvs.append((float(parts[1]), float(parts[2]) if len(parts) > 2 else 0.0))
+            elif parts[0] == "f":
+                face = []
+                for corner in parts[1:]:
+                    refs = (corner.split("/") + ["", ""])[:3]
+                    try:
+                        ids = tuple(resolve(int(r), n) if r else None for r, n in
+                                    zip(refs, (len(positions), len(uvs), len(normals))))
+                    except (ValueError, IndexError):
+                        raise MeshError("%s:%d: bad face corner '%s'" % (path, line_number, corner))
+                    if ids not in vertex_ids:
+                        vertex_ids[ids] = len(out_positions)
+                        out_positions.append(positions[ids[0]])
+                        has_uvs = has_uvs and ids[1] is not None
+                        has_normals = has_normals and ids[2] is not None
+                        out_uvs.append(uvs[ids[1]] if ids[1] is not None else (0.0, 0.0))
+                        out_normals.append(normals[ids[2]] if ids[2] is not None else (0.0, 0.0, 0.0))
+                    face.append(vertex_ids[ids])
+                # fan triangulation
+                for i in range(1, len(face) - 1):
+                    indices.extend((face[0], face[i], face[i + 1]))
+    if not indices:
+        raise MeshError("%s: no triangles" % path)
+    return out_positions, out_normals if has_normals else None, out_uvs if has_uvs else None, indices
+
+
+def resolve(index, count):
+    resolved = index - 1 if index > 0 else count + index
+    if not 0 <= resolved < count:
+        raise IndexError(index)
+    return resolved
+
+
+def demo_torus(rings=96, sides=48, major=1.0, minor=0.35, seed=1):
+    """A torus with its triangles and vertices shuffled, like the output of
+    an exporter that does not care about order."""
+    positions, normals, uvs = [], [], []
+    for i in range(rings + 1):
+        u = i / rings
+        a = u * 2.0 * math.pi
+        for j in range(sides + 1):
+            v = j / sides
+            b = v * 2.0 * math.pi
+            n = (math.cos(a) * math.cos(b), math.sin(b), math.sin(a) * math.cos(b))
+            positions.append(((major + minor * math.cos(b)) * math.cos(a), minor * math.sin(b),
+                              (major + minor * math.cos(b)) * math.sin(a)))
+            normals.append(n)
+            uvs.append((u * 4.0, v))
+    triangles = []
+    for i in range(rings):
+        for j in range(sides):
+            a = i * (sides + 1) + j
+            b = a + sides + 1
+            triangles.append((a, a + 1, b))
+            triangles.append((b, a + 1, b + 1))
+    rng = random.Random(seed)
+    rng.shuffle(triangles)
+    order = list(range(len(positions)))
+    rng.shuffle(order)
+    remap = [0] * len(order)
+    for new, old in enumerate(order):
+        remap[old] = new
+    indices = [remap[v] for t in triangles for v in t]
+    return ([positions[i] for i in order], [normals[i] for i in order], [uvs[i] for i in order], indices)
+
+
+# ---------------------------------------------------------------------------
+# vector helpers
+
+
+def sub(a, b):
+    return (a[0] - b[0], a[1] - b[1], a[2] - b[2])
+
+
+def add(a, b):
+    return (a[0] + b[0], a[1] + b[1], a[2] + b[2])
+
+
+def scale(a, s):
+    return (a[0] * s, a[1] * s, a[2] * s)
+
+
+def dot(a, b):
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]
+
+
+def cross(a, b):
+    return (a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0])
+
+
+def normalize(a, fallback=(0.0, 0.0, 1.0)):
+    length = math.sqrt(dot(a, a))
+    return scale(a, 1.0 / length) if length > 1e-20 else fallback
+
+
+# ---------------------------------------------------------------------------
+# attributes
+
+
+def compute_normals(positions, indices):
+    normals = [(0.0, 0.0, 0.0)] * len(positions)
+    for t in range(0, len(indices), 3):
+        a, b, c = indices[t:t + 3]
+        # area weighted
+        n = cross(sub(positions[b], positions[a]), sub(positions[c], positions[a]))
+        for v in (a, b, c):
+            normals[v] = add(normals[v], n)
+    return [normalize(n) for n in normals]
+
+
+def compute_tangents(positions, normals, uvs, indices):
+    """Per-vertex tangents from the uv gradients, Gram-Schmidt
+    orthogonalized against the normal, with the bitangent's handedness."""
+    tangents = [(0.0, 0.0, 0.0)] * len(positions)
+    bitangents = [(0.0, 0.0, 0.0)] * len(positions)
+    for t in range(0, len(indices), 3):
+        a, b, c = indices[t:t + 3]
+        e1, e2 = sub(positions[b], positions[a]), sub(positions[c], positions[a])
+        du1, dv1 = uvs[b][0] - uvs[a][0], uvs[b][1] - uvs[a][1]
+        du2, dv2 = uvs[c][0] - uvs[a][0], uvs[c][1] - uvs[a][1]
+        det = du1 * dv2 - du2 * dv1
+        if abs(det) < 1e-20:
+            continue
+        r = 1.0 / det
+        tangent = scale(sub(scale(e1, dv2), scale(e2, dv1)), r)
+        bitangent = scale(sub(scale(e2, du1), scale(e1, du2)), r)
+        for v in (a, b, c):
+            tangents[v] = add(tangents[v], tangent)
+            bitangents[v] = add(bitangents[v], bitangent)
+    result = []
+    for n, t, b in zip(normals, tangents, bitangents):
+        t = sub(t, scale(n, dot(n, t)))
+        # any direction perpendicular to the normal when the uvs are degenerate
+        fallback = normalize(cross(n, (1.0, 0.0, 0.0) if abs(n[0]) < 0.9 else (0.0, 1.0, 0.0)))
+        t = normalize(t, fallback)
+        sign = -1.0 if dot(cross(n, t), b) < 0.0 else 1.0
+        result.append((t, sign))
+    return result
+
+
+# ---------------------------------------------------------------------------
+# analysis
+
+
+def acmr(indices, vertex_count, cache_size):
+    """Misses per triangle and per vertex of a FIFO post-transform cache."""
+    cache = []
+    in_cache = set()
+    misses = 0
+    for v in indices:
+        if v in in_cache:
+            continue
+        misses += 1
+        cache.append(v)
+        in_cache.add(v)
+        if len(cache) > cache_size:
+            in_cache.discard(cache.pop(0))
+    return misses / (len(indices) // 3), misses / vertex_count
+
+
+def overfetch(indices, vertex_count, stride):
+    """Bytes pulled through a small LRU cache of memory lines, against the
+    size of the vertex buffer; 1 is every byte fetched exactly once."""
+    lines = OrderedDict()
+    capacity = FETCH_CACHE_BYTES // FETCH_LINE_BYTES
+    fetched = 0
+    for v in indices:
+        first = v * stride // FETCH_LINE_BYTES
+        last = (v * stride + stride - 1) // FETCH_LINE_BYTES
+        for line in range(first, last + 1):
+            if line in lines:
+                lines.move_to_end(line)
+                continue
+            fetched += FETCH_LINE_BYTES
+            lines[line] = True
+            if len(lines) > capacity:
+                lines.popitem(last=False)
+    return fetched / (vertex_count * stride)
+
+
+# ---------------------------------------------------------------------------
+# optimization
+
+
+def forsyth_score(cache_position, live):
+    if live == 0:
+        return -1.0
+    score = 0.0
+    if cache_position >= 0:
+        if cache_position < 3:
+            # the triangle just drawn; slightly less attractive, so strips
+            # do not keep turning back on themselves
+            score = 0.75
+        else:
+            score = (1.0 - (cache_position - 3) / (FORSYTH_CACHE - 3)) ** 1.5
+    # prefer finishing vertices with few triangles left
+    return score + 2.0 * live ** -0.5
+
+
+def optimize_vertex_cache(indices, vertex_count):
+    """Forsyth's linear-speed vertex cache optimization: greedily emit the
+    triangle whose vertices score best in a simulated LRU cache."""
+    triangle_count = len(indices) // 3
+    adjacency = [[] for _ in range(vertex_count)]
+    for t in range(triangle_count):
+        for v in indices[3 * t:3 * t + 3]:
+            adjacency[v].append(t)
+    live = [len(a) for a in adjacency]
+    cache_position = [-1] * vertex_count
+    vertex_scores = [forsyth_score(-1, live[v]) for v in range(vertex_count)]
+    triangle_scores = [sum(vertex_scores[v] for v in indices[3 * t:3 * t + 3]) for t in range(triangle_count)]
+    emitted = [False] * triangle_count
+
+    cache = []
+    result = []
+    next_unemitted = 0
+    best = max(range(triangle_count), key=lambda t: triangle_scores[t]) if triangle_count else -1
+    while len(result) < len(indices):
+        if best < 0:
+            # dead end: nothing in the cache has triangles left
+            while emitted[next_unemitted]:
+                next_unemitted += 1
+            best = next_unemitted
+        triangle = indices[3 * best:3 * best + 3]
+        result.extend(triangle)
+        emitted[best] = True
+        for v in triangle:
+            live[v] -= 1
+            adjacency[v].remove(best)
+            if v in cache:
+                cache.remove(v)
+            cache.insert(0, v)
+        evicted = cache[FORSYTH_CACHE:]
+        del cache[FORSYTH_CACHE:]
+        for v in evicted:
+            cache_position[v] = -1
+            vertex_scores[v] = forsyth_score(-1, live[v])
+        touched = set(evicted)
+        for position, v in enumerate(cache):
+            cache_position[v] = position
+            vertex_scores[v] = forsyth_score(position, live[v])
+            touched.add(v)
+        best, best_score = -1, -1.0
+        for v in touched:
+            for t in adjacency[v]:
+                score = sum(vertex_scores[u] for u in indices[3 * t:3 * t + 3])
+                triangle_scores[t] = score
+                if v in cache and score > best_score:
+                    best, best_score = t, score
+    return result
+
+
+def optimize_overdraw(indices, positions, cache_size):
+    """Sander et al.'s fast triangle reordering: cut the cache optimized
+    order into clusters where little cache efficiency is lost, then draw
+    clusters facing away from the mesh center first, so outer surfaces
+    occlude inner ones."""
+    triangle_count = len(indices) // 3
+    if triangle_count == 0:
+        return indices
+
+    # hard boundaries: triangles that miss on all three vertices start
+    # over anyway
+    def misses_of(start, end, on_triangle=None):
+        cache, in_cache, misses = [], set(), 0
+        for t in range(start, end):
+            triangle_misses = 0
+            for v in indices[3 * t:3 * t + 3]:
+                if v not in in_cache:
+                    triangle_misses += 1
+                    cache.append(v)
+                    in_cache.add(v)
+                    if len(cache) > cache_size:
+                        in_cache.discard(cache.pop(0))
+            misses += triangle_misses
+            if on_triangle is not None:
+                on_triangle(t, triangle_misses, misses)
+        return misses
+
+    hard = [0]
+    misses_of(0, triangle_count, lambda t, m, _: hard.append(t) if m == 3 and t > 0 else None)
+    hard.append(triangle_count)
+
+    # soft boundaries: split a hard cluster once its running ACMR is back
+    # down to the cluster's own, within the threshold
+    boundaries = []
+    for start, end in zip(hard, hard[1:]):
+        if end <= start:
+            continue
+        cluster_acmr = misses_of(start, end) / (end - start)
+        boundaries.append(start)
+        sub_start = start
+        cache, in_cache, misses = [], set(), 0
+        for t in range(start, end):
+            for v in indices[3 * t:3 * t + 3]:
+                if v not in in_cache:
+                    misses += 1
+                    cache.append(v)
+                    in_cache.add(v)
+                    if len(cache) > cache_size:
+                        in_cache.discard(cache.pop(0))
+            if t + 1 < end and misses / (t + 1 - sub_start) <= cluster_acmr * OVERDRAW_THRESHOLD:
+                boundaries.append(t + 1)
+                sub_start = t + 1
+                cache, in_cache, misses = [], set(), 0
+    boundaries.append(triangle_count)
+
+    mesh_centroid = (0.0, 0.0, 0.0)
+    mesh_area = 0.0
+    clusters = []
+    for start, end in zip(boundaries, boundaries[1:]):
+        centroid, normal, area = (0.0, 0.0, 0.0), (0.0, 0.0, 0.0), 0.0
+        for t in range(start, end):
+            a, b, c = (positions[v] for v in indices[3 * t:3 * t + 3])
+            n = cross(sub(b, a), sub(c, a))
+            weight = math.sqrt(dot(n, n))
+            centroid = add(centroid, scale(add(add(a, b), c), weight / 3.0))
+            normal = add(normal, n)
+            area += weight
+        mesh_centroid = add(mesh_centroid, centroid)
+        mesh_area += area
+        clusters.append((start, end, scale(centroid, 1.0 / area) if area > 0.0 else centroid, normal))
+    if mesh_area > 0.0:
+        mesh_centroid = scale(mesh_centroid, 1.0 / mesh_area)
+
+    def facing(cluster):
+        return dot(sub(cluster[2], mesh_centroid), normalize(cluster[3], (0.0, 0.0, 0.0)))
+
+    result = []
+    for start, end, _, _ in sorted(clusters, key=facing, reverse=True):
+        result.extend(indices[3 * start:3 * end])
+    return result
+
+
+def optimize_vertex_fetch(indices, vertex_count):
+    """Renumber vertices in first-use order; returns (remap, indices) where
+    remap[old] is the new index, or None for unused vertices."""
+    remap = [None] * vertex_count
+    next_index = 0
+    for v in indices:
+        if remap[v] is None:
+            remap[v] = next_index
+            next_index += 1
+    return remap, [remap[v] for v in indices]
+
+
+# ---------------------------------------------------------------------------
+# simplification
+
+
+def plane_quadric(a, b, c):
+    """Area weighted quadric of the plane through a triangle, as the upper
+    triangle of the 4x4 matrix: aa ab ac ad bb bc bd cc cd dd."""
+    n = cross(sub(b, a), sub(c, a))
+    length = math.sqrt(dot(n, n))
+    if length < 1e-20:
+        return None
+    area = length * 0.5
+    nx, ny, nz = n[0] / length, n[1] / length, n[2] / length
+    d = -dot((nx, ny, nz), a)
+    return [area * x for x in (nx * nx, nx * ny, nx * nz, nx * d, ny * ny, ny * nz, ny * d,
+                               nz * nz, nz * d, d * d)], area
+
+
+def quadric_error(q, p):
+    x, y, z = p
+    return (q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x +
+            q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y + q[7] * z * z + 2.0 * q[8] * z + q[9])
+
+
+def simplify_lods(positions, indices, targets):
+    """Garland and Heckbert's quadric error edge collapse, reduced to
+    half-edge collapses (a vertex moves onto a neighbour) so every LOD
+    indexes the original vertices. Boundary and attribute seam vertices
+    (edges with one triangle, e.g. where uvs split a vertex) never move,
+    which keeps the mesh closed. Collapses that would flip a triangle or
+    make the surface non-manifold are skipped.
+
+    Returns (indices, error) for each target triangle count reached, one
+    simplification run snapshotted as it passes each. error is the square
+    root of the worst collapse's mean squared distance to the original
+    planes, in mesh units."""
+    vertex_count = len(positions)
+    triangles = [list(indices[t:t + 3]) for t in range(0, len(indices), 3)]
+    alive = [True] * len(triangles)
+    vertex_triangles = [set() for _ in range(vertex_count)]
+    quadrics = [[0.0] * 10 for _ in range(vertex_count)]
+    weights = [0.0] * vertex_count
+    edge_use = {}
+    for t, (a, b, c) in enumerate(triangles):
+        for v in (a, b, c):
+            vertex_triangles[v].add(t)
+        plane = plane_quadric(positions[a], positions[b], positions[c])
+        if plane is not None:
+            q, area = plane
+            for v in (a, b, c):
+                quadrics[v] = [x + y for x, y in zip(quadrics[v], q)]
+                weights[v] += area
+        for u, v in ((a, b), (b, c), (c, a)):
+            key = (min(u, v), max(u, v))
+            edge_use[key] = edge_use.get(key, 0) + 1
+    locked = [False] * vertex_count
+    for (u, v), uses in edge_use.items():
+        if uses != 2:
+            locked[u] = locked[v] = True
+
+    def neighbours(v):
+        result = set()
+        for t in vertex_triangles[v]:
+            result.update(triangles[t])
+        result.discard(v)
+        return result
+
+    def cost(u, v):
+        """Error of moving u onto v, None when u may not move."""
+        if locked[u]:
+            return None
+        q = [x + y for x, y in zip(quadrics[u], quadrics[v])]
+        weight = weights[u] + weights[v]
+        return math.sqrt(max(quadric_error(q, positions[v]), 0.0) / weight) if weight > 0.0 else 0.0
+
+    def collapse_ok(u, v):
+        shared = vertex_triangles[u] & vertex_triangles[v]
+        # link condition: the only common neighbours are the opposite
+        # corners of the triangles the edge removes
+        if len(neighbours(u) & neighbours(v)) != len(shared):
+            return False
+        for t in vertex_triangles[u] - shared:
+            corners = triangles[t]
+            before = cross(sub(positions[corners[1]], positions[corners[0]]),
+                           sub(positions[corners[2]], positions[corners[0]]))
+            moved = [v if x == u else x for x in corners]
+            after = cross(sub(positions[moved[1]], positions[moved[0]]),
+                          sub(positions[moved[2]], positions[moved[0]]))
+            if dot(before, after) <= 0.25 * math.sqrt(dot(before, before) * dot(after, after)):
+                return False
+        return True
+
+    stamps = [0] * vertex_count
+    heap = []
+
+    def push_edges(v):
+        for w in neighbours(v):
+            for a, b in ((v, w), (w, v)):
+                c = cost(a, b)
+                if c is not None:
+                    heapq.heappush(heap, (c, a, b, stamps[a], stamps[b]))
+
+    for v in range(vertex_count):
+        for w in neighbours(v):
+            if v < w:
+                for a, b in ((v, w), (w, v)):
+                    c = cost(a, b)
+                    if c is not None:
+                        heap.append((c, a, b, 0, 0))
+    heapq.heapify(heap)
+
+    lods = []
+    live = len(triangles)
+    max_error = 0.0
+    targets = sorted(targets, reverse=True)
+    while targets:
+        if live <= targets[0] or not heap:
+            if live < len(triangles):
+                lods.append(([v for t, corners in enumerate(triangles) if alive[t] for v in corners], max_error))
+            if not heap:
+                break
+            targets.pop(0)
+            continue
+        c, u, v, stamp_u, stamp_v = heapq.heappop(heap)
+        if stamp_u != stamps[u] or stamp_v != stamps[v] or not vertex_triangles[u] or not collapse_ok(u, v):
+            continue
+        max_error = max(max_error, c)
+        for t in list(vertex_triangles[u]):
+            if v in triangles[t]:
+                alive[t] = False
+                live -= 1
+                for x in triangles[t]:
+                    vertex_triangles[x].discard(t)
+            else:
+                triangles[t] = [v if x == u else x for x in triangles[t]]
+                vertex_triangles[v].add(t)
+        vertex_triangles[u] = set()
+        quadrics[v] = [x + y for x, y in zip(quadrics[u], quadrics[v])]
+        weights[v] += weights[u]
+        stamps[u] += 1
+        stamps[v] += 1
+        push_edges(v)
+    return lods
+
+
+# ---------------------------------------------------------------------------
+# quantization
+
+
+def to_snorm16(x):
+    return int(round(max(-1.0, min(1.0, x)) * 32767.0))
+
+
+def oct_encode(n):
+    """Octahedral mapping of a unit vector to [-1, 1]^2."""
+    l1 = abs(n[0]) + abs(n[1]) + abs(n[2])
+    x, y = n[0] / l1, n[1] / l1
+    if n[2] < 0.0:
+        x, y = ((1.0 - abs(y)) * (1.0 if x >= 0.0 else -1.0),
+                (1.0 - abs(x)) * (1.0 if y >= 0.0 else -1.0))
+    return x, y
+
+
+def oct_decode(x, y):
+    n = (x, y, 1.0 - abs(x) - abs(y))
+    t = max(-n[2], 0.0)
+    return normalize((n[0] - t if n[0] >= 0.0 else n[0] + t, n[1] - t if n[1] >= 0.0 else n[1] + t, n[2]))
+
+
+def half_round_trip(x):
+    return struct.unpack("<e", struct.pack("<e", x))[0]
+
+
+def quantize(positions, normals, tangents, uvs):
+    """Vertex bytes plus the bounds the shader needs to decode them, and
+    the largest errors introduced."""
+    lo = [min(p[i] for p in positions) for i in range(3)]
+    hi = [max(p[i] for p in positions) for i in range(3)]
+    center = [(lo[i] + hi[i]) * 0.5 for i in range(3)]
+    extent = [max((hi[i] - lo[i]) * 0.5, 1e-8) for i in range(3)]
+    uv_lo = [min(uv[i] for uv in uvs) for i in range(2)]
+    uv_scale = [max(max(uv[i] for uv in uvs) - uv_lo[i], 1e-8) for i in range(2)]
+
+    data = bytearray()
+    position_error = 0.0
+    normal_error = 0.0
+    for p, n, (t, sign), uv in zip(positions, normals, tangents, uvs):
+        q = [(p[i] - center[i]) / extent[i] for i in range(3)]
+        for i in range(3):
+            position_error = max(position_error, abs(half_round_trip(q[i]) - q[i]) * extent[i])
+        nx, ny = oct_encode(n)
+        tx, ty = oct_encode(t)
+        qn = (to_snorm16(nx), to_snorm16(ny))
+        decoded = oct_decode(qn[0] / 32767.0, qn[1] / 32767.0)
+        normal_error = max(normal_error, math.degrees(math.acos(max(-1.0, min(1.0, dot(decoded, n))))))
+        qu = [int(round(max(0.0, min(1.0, (uv[i] - uv_lo[i]) / uv_scale[i])) * 65535.0)) for i in range(2)]
+        data += VERTEX.pack(q[0], q[1], q[2], sign, qn[0], qn[1], to_snorm16(tx), to_snorm16(ty), qu[0], qu[1])
+    bounds = (center, extent, uv_lo, uv_scale)
+    return bytes(data), bounds, position_error, normal_error
+
+
+# ---------------------------------------------------------------------------
+
+
+def report(label, indices, vertex_count, stride):
+    parts = []
+    for size in MEASURE_CACHES:
+        per_triangle, per_vertex = acmr(indices, vertex_count, size)
+        parts.append("ACMR(%d) %.3f ATVR(%d) %.3f" % (size, per_triangle, size, per_vertex))
+    print("build_mesh: %-10s %s, overfetch %.2f" % (label, ", ".join(parts),
+                                                  overfetch(indices, vertex_count, stride)))
+
+
+def build_lods(positions, indices, lods, ratio, max_error, verbose):
+    """Index lists of LOD 0 (the input) and up to lods - 1 simplified ones,
+    each with about ratio times the triangles of the one before, with their
+    errors. Stops early at max_error (a fraction of the bounding radius) or
+    when simplification stalls."""
+    result = [(indices, 0.0)]
+    if lods < 2:
+        return result
+    lo = [min(p[i] for p in positions) for i in range(3)]
+    hi = [max(p[i] for p in positions) for i in range(3)]
+    radius = math.sqrt(sum((hi[i] - lo[i]) ** 2 for i in range(3))) * 0.5
+    triangles = len(indices) // 3
+    targets = [int(triangles * ratio ** level) for level in range(1, lods)]
+    for lod_indices, error in simplify_lods(positions, indices, targets):
+        if error > max_error * radius:
+            if verbose:
+                print("build_mesh: stopping at %d LODs, the next one is off by %.2g%% of the radius" %
+                      (len(result), 100.0 * error / radius))
+            break
+        # a stalled run hands back the same triangles again
+        if len(lod_indices) > 0.9 * len(result[-1][0]):
+            if verbose:
+                print("build_mesh: stopping at %d LODs, simplification stalls at %d triangles" %
+                      (len(result), len(lod_indices) // 3))
+            break
+        result.append((lod_indices, error))
+    return result
+
+
+def build(positions, normals, uvs, indices, optimize=True, verbose=True, lods=1, lod_ratio=0.5,
+          lod_max_error=0.05):
+    vertex_count = len(positions)
+    if vertex_count == 0 or len(indices) % 3 != 0:
+        raise MeshError("need whole triangles")
+    if normals is None:
+        normals = compute_normals(positions, indices)
+    normals = [normalize(n) for n in normals]
+    if uvs is None:
+        uvs = [(0.0, 0.0)] * vertex_count
+    tangents = compute_tangents(positions, normals, uvs, indices)
+
+    if verbose:
+        print("build_mesh: %d vertices, %d triangles" % (vertex_count, len(indices) // 3))
+        report("input", indices, vertex_count, UNQUANTIZED_STRIDE)
+    chain = build_lods(positions, indices, lods, lod_ratio, lod_max_error, verbose)
+    levels = []
+    for level, (lod_indices, error) in enumerate(chain):
+        if optimize:
+            lod_indices = optimize_vertex_cache(lod_indices, vertex_count)
+            if verbose and level == 0:
+                report("vcache", lod_indices, vertex_count, UNQUANTIZED_STRIDE)
+            lod_indices = optimize_overdraw(lod_indices, positions, MEASURE_CACHES[0])
+            if verbose and level == 0:
+                report("overdraw", lod_indices, vertex_count, UNQUANTIZED_STRIDE)
+        levels.append((lod_indices, error))
+    # Numbering vertices by first use from the coarsest LOD up makes the
+    # vertices of every LOD a prefix of the buffer: collapses only remove
+    # vertices, so each LOD uses a subset of the finer one's.
+    concatenated = [v for lod_indices, _ in reversed(levels) for v in lod_indices]
+    remap, _ = optimize_vertex_fetch(concatenated, vertex_count)
+    levels = [([remap[v] for v in lod_indices], error) for lod_indices, error in levels]
+    order = [None] * vertex_count
+    for old, new in enumerate(remap):
+        if new is not None:
+            order[new] = old
+    order = [old for old in order if old is not None]
+    if len(order) != vertex_count and verbose:
+        print("build_mesh: dropped %d unused vertices" % (vertex_count - len(order)))
+    vertex_count = len(order)
+
+    vertices, bounds, position_error, normal_error = quantize(
+        [positions[i] for i in order], [normals[i] for i in order],
+        [tangents[i] for i in order], [uvs[i] for i in order])
+    if verbose:
+        report("output", levels[0][0], vertex_count, VERTEX.size)
+        print("build_mesh: %d -> %d bytes per vertex, max error %.2g units (position), %.3f degrees "
+              "(normal)" % (UNQUANTIZED_STRIDE, VERTEX.size, position_error, normal_error))
+        for level, (lod_indices, error) in enumerate(levels[1:], 1):
+            used = max(lod_indices) + 1
+            print("build_mesh: lod %d: %d triangles, %d vertices, error %.3g units" %
+                  (level, len(lod_indices) // 3, used, error))
+            report("lod %d" % level, lod_indices, used, VERTEX.size)
+
+    wide = vertex_count > 65536
+    indices = [v for lod_indices, _ in levels for v in lod_indices]
+    index_data = struct.pack("<%d%s" % (len(indices), "I" if wide else "H"), *indices)
+    lod_offset = HEADER.size
+    lod_data = bytearray()
+    first = 0
+    for lod_indices, error in levels:
+        lod_data += LOD.pack(first, len(lod_indices), error, 0)
+        first += len(lod_indices)
+    vertex_offset = lod_offset + len(lod_data)
+    index_offset = vertex_offset + len(vertices)
+    center, extent, uv_offset, uv_scale = bounds
+    header = HEADER.pack(MAGIC, VERSION, vertex_count, len(indices), *center, *extent, *uv_offset, *uv_scale,
+                         vertex_offset, index_offset, len(levels), lod_offset, 0, 0)
+    return header + bytes(lod_data) + vertices + index_data
+
+
+def emit_header(name, data, source):
+    out = ["// Generated by tools/build_mesh.py from %s. Do not edit." % source,
+           "#ifndef ENGINE_MESH_%s_H" % name.upper(),
+           "#define ENGINE_MESH_%s_H" % name.upper(),
+           "",
+           "#include <cstdint>",
+           "",
+           "// %d bytes, a .mesh file as described in mesh.h" % len(data),
+           "alignas(16) static const uint8_t %s_mesh[%d] = {" % (name, len(data))]
+    for i in range(0, len(data), 16):
+        out.append("    " + " ".join("0x%02x," % b for b in data[i:i + 16]))
+    out += ["};", "", "#endif // ENGINE_MESH_%s_H" % name.upper()]
+    return ("\n".join(out) + "\n").encode()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--output", required=True, help=".mesh file to write")
+    parser.add_argument("--embed", metavar="NAME", help="write a C++ header defining NAME_mesh instead")
+    parser.add_argument("--demo", choices=("torus",), help="build a generated mesh instead of an input")
+    parser.add_argument("--no-optimize", action="store_true", help="keep the input triangle order")
+    parser.add_argument("--lods", type=int, default=4, help="LODs to build including the input, 1 for none")
+    parser.add_argument("--lod-ratio", type=float, default=0.5,
+                        help="triangles of each LOD relative to the one before")
+    parser.add_argument("--lod-max-error", type=float, default=0.05,
+                        help="largest error a LOD may have, as a fraction of the bounding radius")
+    parser.add_argument("input", nargs="?", help="Wavefront .obj file")
+    args = parser.parse_args()
+    if (args.input is None) == (args.demo is None):
+        parser.error("give either an input or --demo")
+
+    try:
+        mesh = demo_torus() if args.demo else load_obj(args.input)
+        data = build(*mesh, optimize=not args.no_optimize, lods=args.lods, lod_ratio=args.lod_ratio,
+                     lod_max_error=args.lod_max_error)
+    except (MeshError, OSError) as error:
+        sys.stderr.write("build_mesh: error: %s\n" % error)
+        return 1
+
+    if args.embed:
+        data = emit_header(args.embed, data, "--demo " + args.demo if args.demo else os.path.basename(args.input))
+    temp = args.output + ".tmp"
+    with open(temp, "wb") as f:
+        f.write(data)
+    os.replace(temp, args.output)
+    print("build_mesh: %s: %d bytes" % (args.output, len(data)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,823 @@
+#!/usr/bin/env python3
+"""Build a mip chain and encode it into the engine's .tex format.
+
+Usage: build_texture.py --output NAME.tex [--formats astc,etc2,bc] [--linear]
+                        (INPUT.png | --demo)
+
+Mips are box filtered in linear space (unless --linear says the image is
+data, such as a normal map, rather than sRGB color) down to 1x1. The chain
+is then encoded once per requested format, in the order given, which is the
+order of preference: the engine samples the first one the device supports.
+
+    astc   ASTC 4x4, 8 bits per pixel
+    etc2   ETC2 RGB8 (4 bpp), or ETC2 RGBA8 with EAC alpha (8 bpp)
+    bc     BC1 (4 bpp), or BC3 (8 bpp) with alpha, for x86 emulator images
+    rgba8  uncompressed, 32 bpp, sampleable on every device
+
+Images with any alpha below 255 get the alpha variants. The encoders are
+simple, not exhaustive searches: ETC2 only uses the ETC1 compatible modes
+and ASTC one block mode (a single partition of RGB or RGBA endpoints with
+8 or 4 weight levels). Size, bits per pixel and PSNR against the source
+mips are printed for every format.
+
+PSNR is measured through the tool's own decoders. The ASTC one is checked
+against blocks decoded by hand before every ASTC build and, when astcenc
+is on the PATH, against astcenc decoding the top mip.
+
+The layout is described in app/src/main/cpp/texture.h.
+"""
+
+import argparse
+import math
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+import zlib
+
+MAGIC = 0x58455445  # "ETEX"
+VERSION = 1
+HEADER = struct.Struct("<8I")
+VARIANT = struct.Struct("<4I")
+FLAG_SRGB = 1
+FLAG_ALPHA = 2
+# data of every variant starts this aligned, like the pack aligns the file
+VARIANT_ALIGNMENT = 64
+
+# enum texture_format
+RGBA8, ASTC_4X4, ETC2_RGB8, ETC2_RGBA8, BC1, BC3 = range(6)
+FORMAT_NAMES = {RGBA8: "rgba8", ASTC_4X4: "astc 4x4", ETC2_RGB8: "etc2 rgb8", ETC2_RGBA8: "etc2 rgba8",
+                BC1: "bc1", BC3: "bc3"}
+# --formats name -> (opaque, alpha) format
+FAMILIES = {"astc": (ASTC_4X4, ASTC_4X4), "etc2": (ETC2_RGB8, ETC2_RGBA8), "bc": (BC1, BC3),
+            "rgba8": (RGBA8, RGBA8)}
+BLOCK_BYTES = {RGBA8: 4, ASTC_4X4: 16, ETC2_RGB8: 8, ETC2_RGBA8: 16, BC1: 8, BC3: 16}
+
+
+class TextureError(Exception):
+    pass
+
+
+# ---------------------------------------------------------------------------
+# input
+
+
+def paeth(a, b, c):
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    return b if pb <= pc else c
+
+
+def load_png(path):
+    """8-bit, non-interlaced PNG as (width, height, rgba bytearray)."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        raise TextureError("%s: not a PNG file" % path)
+    pos, idat, palette, header = 8, [], None, None
+    while pos + 8 <= len(data):
+        length, kind = struct.unpack(">I4s", data[pos:pos + 8])
+        body = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if kind == b"IHDR":
+            header = struct.unpack(">IIBBBBB", body)
+        elif kind == b"PLTE":
+            palette = body
+        elif kind == b"IDAT":
+            idat.append(body)
+        elif kind == b"IEND":
+            break
+    if header is None:
+        raise TextureError("%s: no IHDR chunk" % path)
+    width, height, depth, color, _, _, interlace = header
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}.get(color)
+    if depth != 8 or interlace != 0 or channels is None or (color == 3 and palette is None):
+        raise TextureError("%s: only 8-bit non-interlaced PNGs are supported" % path)
+
+    raw = zlib.decompress(b"".join(idat))
+    stride = width * channels
+    if len(raw) < (stride + 1) * height:
+        raise TextureError("%s: truncated image data" % path)
+    rows, previous = [], bytearray(stride)
+    for y in range(height):
+        start = y * (stride + 1)
+        kind = raw[start]
+        row = bytearray(raw[start + 1:start + 1 + stride])
+        for i in range(stride):
+            a = row[i - channels] if i >= channels else 0
+            b = previous[i]
+            c = previous[i - channels] if i >= channels else 0
+            if kind == 1:
+                row[i] = (row[i] + a) & 0xFF
+            elif kind == 2:
+                row[i] = (row[i] + b) & 0xFF
+            elif kind == 3:
+                row[i] = (row[i] + ((a + b) >> 1)) & 0xFF
+            elif kind == 4:
+                row[i] = (row[i] + paeth(a, b, c)) & 0xFF
+            elif kind != 0:
+                raise TextureError("%s: bad filter type %d" % (path, kind))
+        rows.append(row)
+        previous = row
+
+    rgba = bytearray(width * height * 4)
+    for y, row in enumerate(rows):
+        for x in range(width):
+            s = row[x * channels:(x + 1) * channels]
+            if color == 0:
+                p = (s[0], s[0], s[0], 255)
+            elif color == 2:
+                p = (s[0], s[1], s[2], 255)
+            elif color == 3:
+                p = tuple(palette[s[0] * 3:s[0] * 3 + 3]) + (255,)
+            elif color == 4:
+                p = (s[0], s[0], s[0], s[1])
+            else:
+                p = tuple(s)
+            rgba[(y * width + x) * 4:(y * width + x) * 4 + 4] = bytes(p)
+    return width, height, rgba
+
+
+def demo_image(size=256):
+    """Smooth gradients, a hard-edged checker and a disc with a soft alpha
+    edge: what the block encoders find easy, hard and what needs alpha."""
+    rgba = bytearray(size * size * 4)
+    for y in range(size):
+        for x in range(size):
+            u, v = x / (size - 1), y / (size - 1)
+            r = 0.5 + 0.5 * math.sin(u * 6.0 + v * 2.0)
+            g = 0.5 + 0.5 * math.cos(v * 5.0 - u * 3.0)
+            b = u * v
+            if x < size // 2 and y >= size // 2 and ((x // 8) + (y // 8)) % 2 == 0:
+                r, g, b = 0.9, 0.85, 0.2
+            d = math.hypot(u - 0.7, v - 0.7) / 0.25
+            a = max(0.0, min(1.0, (1.2 - d) * 4.0)) if d < 1.2 else 0.15
+            if x < size // 2:
+                a = 1.0
+            i = (y * size + x) * 4
+            rgba[i:i + 4] = bytes(int(c * 255.0 + 0.5) for c in (r, g, b, a))
+    return size, size, rgba
+
+
+# ---------------------------------------------------------------------------
+# mips
+
+
+SRGB_TO_LINEAR = [(c / 255.0) / 12.92 if c <= 10 else ((c / 255.0 + 0.055) / 1.055) ** 2.4 for c in range(256)]
+
+
+def linear_to_srgb(x):
+    x = min(max(x, 0.0), 1.0)
+    s = x * 12.92 if x <= 0.0031308 else 1.055 * x ** (1.0 / 2.4) - 0.055
+    return int(s * 255.0 + 0.5)
+
+
+def build_mips(width, height, rgba, srgb):
+    """Every level from width x height down to 1x1 as (width, height, rgba
+    bytearray). Filtering works on linear floats so each level is made
+    from the unquantized one above it."""
+    to_linear = SRGB_TO_LINEAR if srgb else [c / 255.0 for c in range(256)]
+    to_color = linear_to_srgb if srgb else (lambda x: int(min(max(x, 0.0), 1.0) * 255.0 + 0.5))
+    level = [to_linear[rgba[i]] if i % 4 != 3 else rgba[i] / 255.0 for i in range(len(rgba))]
+    mips = [(width, height, bytearray(rgba))]
+    w, h = width, height
+    while w > 1 or h > 1:
+        nw, nh = max(1, w // 2), max(1, h // 2)
+        next_level = [0.0] * (nw * nh * 4)
+        for y in range(nh):
+            y0, y1 = min(2 * y, h - 1), min(2 * y + 1, h - 1)
+            for x in range(nw):
+                x0, x1 = min(2 * x, w - 1), min(2 * x + 1, w - 1)
+                for c in range(4):
+                    next_level[(y * nw + x) * 4 + c] = 0.25 * (
+                        level[(y0 * w + x0) * 4 + c] + level[(y0 * w + x1) * 4 + c] +
+                        level[(y1 * w + x0) * 4 + c] + level[(y1 * w + x1) * 4 + c])
+        out = bytearray(nw * nh * 4)
+        for i, value in enumerate(next_level):
+            out[i] = to_color(value) if i % 4 != 3 else int(min(max(value, 0.0), 1.0) * 255.0 + 0.5)
+        mips.append((nw, nh, out))
+        level, w, h = next_level, nw, nh
+    return mips
+
+
+def block_pixels(width, height, rgba, bx, by):
+    """The 16 pixels of a 4x4 block in row-major order, edges repeated
+    past the image."""
+    pixels = []
+    for y in range(4):
+        row = min(by * 4 + y, height - 1) * width
+        for x in range(4):
+            i = (row + min(bx * 4 + x, width - 1)) * 4
+            pixels.append((rgba[i], rgba[i + 1], rgba[i + 2], rgba[i + 3]))
+    return pixels
+
+
+# ---------------------------------------------------------------------------
+# shared endpoint fitting
+
+
+def clamp8(x):
+    return 0 if x < 0 else 255 if x > 255 else int(x + 0.5)
+
+
+def principal_endpoints(pixels, channels):
+    """Extremes of the pixels along their principal axis."""
+    n = float(len(pixels))
+    mean = [sum(p[c] for p in pixels) / n for c in range(channels)]
+    cov = [[0.0] * channels for _ in range(channels)]
+    for p in pixels:
+        d = [p[c] - mean[c] for c in range(channels)]
+        for i in range(channels):
+            for j in range(i, channels):
+                cov[i][j] += d[i] * d[j]
+    for i in range(channels):
+        for j in range(i):
+            cov[i][j] = cov[j][i]
+    axis = [1.0] * channels
+    for _ in range(8):
+        axis = [sum(cov[i][j] * axis[j] for j in range(channels)) for i in range(channels)]
+        length = math.sqrt(sum(a * a for a in axis))
+        if length < 1e-9:
+            return list(mean), list(mean)
+        axis = [a / length for a in axis]
+    t = [sum((p[c] - mean[c]) * axis[c] for c in range(channels)) for p in pixels]
+    lo, hi = min(t), max(t)
+    return [mean[c] + axis[c] * lo for c in range(channels)], [mean[c] + axis[c] * hi for c in range(channels)]
+
+
+def refit_endpoints(pixels, weights, channels):
+    """Least squares endpoints for fixed interpolation weights in [0, 1],
+    None when the weights do not pin them down."""
+    aa = bb = ab = 0.0
+    ax = [0.0] * channels
+    bx = [0.0] * channels
+    for p, w in zip(pixels, weights):
+        a, b = 1.0 - w, w
+        aa += a * a
+        bb += b * b
+        ab += a * b
+        for c in range(channels):
+            ax[c] += a * p[c]
+            bx[c] += b * p[c]
+    det = aa * bb - ab * ab
+    if abs(det) < 1e-9:
+        return None
+    return ([(ax[c] * bb - bx[c] * ab) / det for c in range(channels)],
+            [(bx[c] * aa - ax[c] * ab) / det for c in range(channels)])
+
+
+def block_error(a, b, channels):
+    return sum((x[c] - y[c]) ** 2 for x, y in zip(a, b) for c in range(channels))
+
+
+def nearest(value, palette, channels):
+    best, best_error = 0, None
+    for i, entry in enumerate(palette):
+        error = sum((value[c] - entry[c]) ** 2 for c in range(channels))
+        if best_error is None or error < best_error:
+            best, best_error = i, error
+    return best
+
+
+# ---------------------------------------------------------------------------
+# BC1 / BC3
+
+
+def to565(c):
+    return (clamp8(c[0]) * 31 + 127) // 255 << 11 | (clamp8(c[1]) * 63 + 127) // 255 << 5 | \
+        (clamp8(c[2]) * 31 + 127) // 255
+
+
+def from565(v):
+    r, g, b = v >> 11, (v >> 5) & 63, v & 31
+    return ((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2))
+
+
+def bc1_palette(c0, c1):
+    a, b = from565(c0), from565(c1)
+    return [a, b, tuple((2 * x + y) // 3 for x, y in zip(a, b)), tuple((x + 2 * y) // 3 for x, y in zip(a, b))]
+
+
+def bc1_pack(pixels, e0, e1):
+    c0, c1 = to565(e0), to565(e1)
+    if c0 < c1:
+        c0, c1 = c1, c0
+    palette = bc1_palette(c0, c1)
+    indices = [0] * 16 if c0 == c1 else [nearest(p, palette, 3) for p in pixels]
+    bits = 0
+    for i, index in enumerate(indices):
+        bits |= index << (2 * i)
+    return struct.pack("<HHI", c0, c1, bits), [palette[i] for i in indices]
+
+
+def bc1_encode(pixels):
+    e0, e1 = principal_endpoints(pixels, 3)
+    block, decoded = bc1_pack(pixels, e0, e1)
+    c0, c1 = struct.unpack_from("<HH", block)
+    palette = bc1_palette(c0, c1)
+    weights = []
+    for p in decoded:
+        weights.append((0.0, 1.0, 1.0 / 3.0, 2.0 / 3.0)[palette.index(p)])
+    refit = refit_endpoints(pixels, weights, 3)
+    if refit is not None:
+        refit_block, refit_decoded = bc1_pack(pixels, *refit)
+        if block_error(refit_decoded, pixels, 3) < block_error(decoded, pixels, 3):
+            return refit_block
+    return block
+
+
+def bc1_decode(block):
+    c0, c1, bits = struct.unpack("<HHI", block)
+    palette = bc1_palette(c0, c1)
+    if c0 <= c1:
+        palette[2] = tuple((x + y) // 2 for x, y in zip(palette[0], palette[1]))
+        palette[3] = (0, 0, 0)
+    return [palette[(bits >> (2 * i)) & 3] + (255,) for i in range(16)]
+
+
+def bc4_encode(values):
+    hi, lo = max(values), min(values)
+    if hi == lo:
+        return bytes((hi, lo)) + bytes(6)
+    palette = [hi, lo] + [((7 - i) * hi + i * lo) // 7 for i in range(1, 7)]
+    bits = 0
+    for i, v in enumerate(values):
+        bits |= min(range(8), key=lambda k: abs(palette[k] - v)) << (3 * i)
+    return bytes((hi, lo)) + bits.to_bytes(6, "little")
+
+
+def bc4_decode(block):
+    a0, a1 = block[0], block[1]
+    if a0 > a1:
+        palette = [a0, a1] + [((7 - i) * a0 + i * a1) // 7 for i in range(1, 7)]
+    else:
+        palette = [a0, a1] + [((5 - i) * a0 + i * a1) // 5 for i in range(1, 5)] + [0, 255]
+    bits = int.from_bytes(block[2:8], "little")
+    return [palette[(bits >> (3 * i)) & 7] for i in range(16)]
+
+
+def bc3_encode(pixels):
+    return bc4_encode([p[3] for p in pixels]) + bc1_encode(pixels)
+
+
+def bc3_decode(block):
+    alpha = bc4_decode(block[:8])
+    # the color half of BC3 always uses four colors
+    c0, c1, bits = struct.unpack("<HHI", block[8:])
+    palette = bc1_palette(c0, c1)
+    return [palette[(bits >> (2 * i)) & 3] + (a,) for i, a in enumerate(alpha)]
+
+
+# ---------------------------------------------------------------------------
+# ETC2, ETC1 compatible modes, and EAC alpha
+
+
+ETC_MODIFIERS = ((2, 8), (5, 17), (9, 29), (13, 42), (18, 60), (24, 80), (33, 106), (47, 183))
+# pixel index value -> modifier: +a, +b, -a, -b
+ETC_SIGNS = ((0, 1), (1, 1), (0, -1), (1, -1))
+EAC_MODIFIERS = (
+    (-3, -6, -9, -15, 2, 5, 8, 14), (-3, -7, -10, -13, 2, 6, 9, 12), (-2, -5, -8, -13, 1, 4, 7, 12),
+    (-2, -4, -6, -13, 1, 3, 5, 12), (-3, -6, -8, -12, 2, 5, 7, 11), (-3, -7, -9, -11, 2, 6, 8, 10),
+    (-4, -7, -8, -11, 3, 6, 7, 10), (-3, -5, -8, -11, 2, 4, 7, 10), (-2, -6, -8, -10, 1, 5, 7, 9),
+    (-2, -5, -8, -10, 1, 4, 7, 9), (-2, -4, -8, -10, 1, 3, 7, 9), (-2, -5, -7, -10, 1, 4, 6, 9),
+    (-3, -4, -7, -10, 2, 3, 6, 9), (-1, -2, -3, -10, 0, 1, 2, 9), (-4, -6, -8, -9, 3, 5, 7, 8),
+    (-3, -5, -7, -9, 2, 4, 6, 8))
+
+
+def etc_subblock(flip, sub):
+    """(x, y) of the pixels in one half: 2x4 halves side by side, or 4x2
+    halves on top of each other when flipped."""
+    if flip:
+        return [(x, y) for y in range(2 * sub, 2 * sub + 2) for x in range(4)]
+    return [(x, y) for y in range(4) for x in range(2 * sub, 2 * sub + 2)]
+
+
+def etc_fit_table(base, pixels):
+    """Best modifier table for pixels around base: (error, table, pixel
+    index values). Each pixel takes the modifier closest to its mean
+    offset from base, which is exact when nothing clamps."""
+    offsets = [sum(p[c] - base[c] for c in range(3)) / 3.0 for p in pixels]
+    best = None
+    for table, (a, b) in enumerate(ETC_MODIFIERS):
+        error, values = 0, []
+        for p, d in zip(pixels, offsets):
+            value = min(range(4), key=lambda v: abs(d - ETC_SIGNS[v][1] * (a, b)[ETC_SIGNS[v][0]]))
+            m = ETC_SIGNS[value][1] * (a, b)[ETC_SIGNS[value][0]]
+            error += sum((clamp8(base[c] + m) - p[c]) ** 2 for c in range(3))
+            values.append(value)
+        if best is None or error < best[0]:
+            best = (error, table, values)
+    return best
+
+
+def etc_expand(q, bits):
+    return (q << 4) | q if bits == 4 else (q << 3) | (q >> 2)
+
+
+def etc_encode(pixels):
+    best = None
+    for flip in (0, 1):
+        halves = [etc_subblock(flip, sub) for sub in (0, 1)]
+        means = [[sum(pixels[y * 4 + x][c] for x, y in half) / 8.0 for c in range(3)] for half in halves]
+        q5 = [[min(31, int(m * 31.0 / 255.0 + 0.5)) for m in mean] for mean in means]
+        deltas = [q5[1][c] - q5[0][c] for c in range(3)]
+        modes = [(0, [[min(15, int(m * 15.0 / 255.0 + 0.5)) for m in mean] for mean in means], 4)]
+        if all(-4 <= d <= 3 for d in deltas):
+            modes.append((1, q5, 5))
+        for diff, quantized, bits in modes:
+            fits = []
+            for half, q in zip(halves, quantized):
+                base = [etc_expand(v, bits) for v in q]
+                fits.append(etc_fit_table(base, [pixels[y * 4 + x] for x, y in half]))
+            error = fits[0][0] + fits[1][0]
+            if best is None or error < best[0]:
+                best = (error, flip, diff, quantized, halves, fits)
+
+    _, flip, diff, quantized, halves, fits = best
+    if diff:
+        high = 0
+        for c in range(3):
+            high |= (quantized[0][c] << 3 | (quantized[1][c] - quantized[0][c]) & 7) << (24 - 8 * c)
+    else:
+        high = 0
+        for c in range(3):
+            high |= (quantized[0][c] << 4 | quantized[1][c]) << (24 - 8 * c)
+    high |= fits[0][1] << 5 | fits[1][1] << 2 | diff << 1 | flip
+    low = 0
+    for half, fit in zip(halves, fits):
+        for (x, y), value in zip(half, fit[2]):
+            i = x * 4 + y
+            low |= (value >> 1) << (16 + i) | (value & 1) << i
+    return struct.pack(">II", high, low)
+
+
+def etc_decode(block):
+    high, low = struct.unpack(">II", block)
+    diff, flip = (high >> 1) & 1, high & 1
+    bases = [[0] * 3, [0] * 3]
+    for c in range(3):
+        byte = (high >> (24 - 8 * c)) & 0xFF
+        if diff:
+            q0 = byte >> 3
+            delta = byte & 7
+            q1 = q0 + (delta - 8 if delta >= 4 else delta)
+            bases[0][c], bases[1][c] = etc_expand(q0, 5), etc_expand(q1, 5)
+        else:
+            bases[0][c], bases[1][c] = etc_expand(byte >> 4, 4), etc_expand(byte & 15, 4)
+    tables = ((high >> 5) & 7, (high >> 2) & 7)
+    out = [None] * 16
+    for sub in (0, 1):
+        a, b = ETC_MODIFIERS[tables[sub]]
+        for x, y in etc_subblock(flip, sub):
+            i = x * 4 + y
+            value = ((low >> (16 + i)) & 1) << 1 | ((low >> i) & 1)
+            m = ETC_SIGNS[value][1] * (a, b)[ETC_SIGNS[value][0]]
+            out[y * 4 + x] = tuple(clamp8(bases[sub][c] + m) for c in range(3)) + (255,)
+    return out
+
+
+def eac_encode(values):
+    """EAC alpha: a base, a multiplier and one of 16 modifier tables."""
+    lo, hi = min(values), max(values)
+    if lo == hi:
+        # table 13 has a zero modifier at index 4
+        bits = 0
+        for _ in range(16):
+            bits = bits << 3 | 4
+        return bytes((lo, 1 << 4 | 13)) + bits.to_bytes(6, "big")
+    best = None
+    for table, modifiers in enumerate(EAC_MODIFIERS):
+        span = modifiers[7] - modifiers[3]
+        multiplier = max(1, min(15, int((hi - lo) / float(span) + 0.5)))
+        base = clamp8((lo + hi) / 2.0 - multiplier * (modifiers[7] + modifiers[3]) / 2.0)
+        palette = [clamp8(base + m * multiplier) for m in modifiers]
+        error, indices = 0, []
+        for v in values:
+            index = min(range(8), key=lambda k: abs(palette[k] - v))
+            error += (palette[index] - v) ** 2
+            indices.append(index)
+        if best is None or error < best[0]:
+            best = (error, table, multiplier, base, indices)
+    _, table, multiplier, base, indices = best
+    bits = 0
+    # pixels in column-major order, the first in the highest bits
+    for x in range(4):
+        for y in range(4):
+            bits = bits << 3 | indices[y * 4 + x]
+    return bytes((base, multiplier << 4 | table)) + bits.to_bytes(6, "big")
+
+
+def eac_decode(block):
+    base, multiplier, table = block[0], block[1] >> 4, block[1] & 15
+    bits = int.from_bytes(block[2:8], "big")
+    out = [0] * 16
+    for i in range(16):
+        x, y = i // 4, i % 4
+        index = (bits >> (45 - 3 * i)) & 7
+        out[y * 4 + x] = clamp8(base + EAC_MODIFIERS[table][index] * multiplier)
+    return out
+
+
+def etc2_rgba_encode(pixels):
+    return eac_encode([p[3] for p in pixels]) + etc_encode(pixels)
+
+
+def etc2_rgba_decode(block):
+    alpha = eac_decode(block[:8])
+    return [p[:3] + (a,) for p, a in zip(etc_decode(block[8:]), alpha)]
+
+
+# ---------------------------------------------------------------------------
+# ASTC 4x4, one block mode: a single partition with LDR RGB (endpoint mode
+# 8) and 8 weight levels, or LDR RGBA (mode 12) and 4 weight levels. The 4x4
+# weight grid and 8-bit endpoints fit the 128 bits either way.
+
+
+ASTC_RGB = (0x053, 8, 3, 3)  # block mode, endpoint mode, weight bits, channels
+ASTC_RGBA = (0x042, 12, 2, 4)
+
+
+def astc_unquantize_weight(value, bits):
+    replicated = 0
+    for shift in range(6 - bits, -bits, -bits):
+        replicated |= value << shift if shift >= 0 else value >> -shift
+    replicated &= 63
+    return replicated + 1 if replicated > 32 else replicated
+
+
+def astc_interpolate(e0, e1, weight, srgb):
+    # endpoints widen to 16 bits by replication, or for sRGB with 0x80
+    # below them; the top 8 bits of the result are the texel
+    c0, c1 = (e0 << 8 | 0x80, e1 << 8 | 0x80) if srgb else (e0 * 257, e1 * 257)
+    return ((c0 * (64 - weight) + c1 * weight + 32) >> 6) >> 8
+
+
+def astc_weights(pixels, e0, e1, bits, channels):
+    levels = (1 << bits) - 1
+    axis = [e1[c] - e0[c] for c in range(channels)]
+    length = sum(a * a for a in axis)
+    weights = []
+    for p in pixels:
+        t = sum((p[c] - e0[c]) * axis[c] for c in range(channels)) / length if length > 0 else 0.0
+        weights.append(int(min(max(t, 0.0), 1.0) * levels + 0.5))
+    return weights
+
+
+def astc_pack(pixels, e0, e1, mode):
+    block_mode, endpoint_mode, bits, channels = mode
+    e0 = [clamp8(v) for v in e0]
+    e1 = [clamp8(v) for v in e1]
+    # e1 must not sum lower than e0 over RGB, or the decoder applies blue
+    # contraction; swapping the endpoints and inverting the weights is free
+    if sum(e1[:3]) < sum(e0[:3]):
+        e0, e1 = e1, e0
+    weights = astc_weights(pixels, e0, e1, bits, channels)
+    value = block_mode | endpoint_mode << 13
+    for c in range(channels):
+        value |= e0[c] << (17 + 16 * c) | e1[c] << (25 + 16 * c)
+    # the weights are stored bit reversed from the top of the block
+    for i, w in enumerate(weights):
+        for k in range(bits):
+            value |= ((w >> k) & 1) << (127 - (i * bits + k))
+    return value.to_bytes(16, "little")
+
+
+def astc_encode(pixels, mode, srgb):
+    channels = mode[3]
+    e0, e1 = principal_endpoints(pixels, channels)
+    block = astc_pack(pixels, e0, e1, mode)
+    decoded = astc_decode(block, srgb)
+    bits = mode[2]
+    value = int.from_bytes(block, "little")
+    weights = [astc_unquantize_weight(astc_read_weight(value, i, bits), bits) / 64.0 for i in range(16)]
+    refit = refit_endpoints(pixels, weights, channels)
+    if refit is not None:
+        refit_block = astc_pack(pixels, refit[0], refit[1], mode)
+        if block_error(astc_decode(refit_block, srgb), pixels, channels) < block_error(decoded, pixels, channels):
+            return refit_block
+    return block
+
+
+def astc_read_weight(value, i, bits):
+    w = 0
+    for k in range(bits):
+        w |= ((value >> (127 - (i * bits + k))) & 1) << k
+    return w
+
+
+def astc_decode(block, srgb):
+    """Decoder for the blocks astc_encode writes, nothing more."""
+    value = int.from_bytes(block, "little")
+    endpoint_mode = (value >> 13) & 15
+    mode = ASTC_RGB if endpoint_mode == ASTC_RGB[1] else ASTC_RGBA
+    if value & 0x7FF != mode[0] or (value >> 11) & 3 != 0:
+        raise TextureError("unexpected ASTC block mode")
+    bits, channels = mode[2], mode[3]
+    v = [(value >> (17 + 8 * i)) & 0xFF for i in range(2 * channels)]
+    e0 = [v[2 * c] for c in range(channels)] + [255] * (4 - channels)
+    e1 = [v[2 * c + 1] for c in range(channels)] + [255] * (4 - channels)
+    out = []
+    for i in range(16):
+        w = astc_unquantize_weight(astc_read_weight(value, i, bits), bits)
+        out.append(tuple(astc_interpolate(e0[c], e1[c], w, srgb) for c in range(4)))
+    return out
+
+
+# Blocks laid out bit by bit from the specification, with their texels
+# worked out by hand from its weight unquantization and interpolation. The
+# RGB block has endpoints (0, 64, 200) and (255, 128, 40) and texel i takes
+# weight i % 8, which unquantizes to 0, 9, 18, 27, 37, 46, 55, 64; the RGBA
+# one has (10, 20, 30, 255) and (250, 240, 230, 0) with weight 3 * i % 4, so
+# 0, 64, 43, 21. The texels repeat with the weights.
+ASTC_KNOWN_ANSWERS = [
+    (bytes.fromhex("530001fe8100915100005f63115f6311"), False,
+     [(0, 64, 200, 255), (36, 73, 178, 255), (72, 82, 155, 255), (108, 91, 133, 255),
+      (147, 101, 107, 255), (183, 110, 85, 255), (219, 119, 62, 255), (255, 128, 40, 255)]),
+    (bytes.fromhex("530001fe8100915100005f63115f6311"), True,
+     [(0, 64, 200, 255), (36, 73, 178, 255), (72, 82, 155, 255), (108, 91, 133, 255),
+      (147, 101, 108, 255), (183, 110, 85, 255), (219, 119, 63, 255), (255, 128, 40, 255)]),
+    (bytes.fromhex("428015f429e03dccff01000036363636"), False,
+     [(10, 20, 30, 255), (250, 240, 230, 0), (171, 168, 165, 84), (89, 92, 96, 171)]),
+    (bytes.fromhex("428015f429e03dccff01000036363636"), True,
+     [(10, 20, 30, 255), (250, 240, 230, 0), (171, 168, 164, 84), (89, 92, 96, 171)]),
+]
+
+
+def astc_check_known_answers():
+    for block, srgb, texels in ASTC_KNOWN_ANSWERS:
+        decoded = astc_decode(block, srgb)
+        for i, texel in enumerate(decoded):
+            if texel != texels[i % len(texels)]:
+                raise TextureError("ASTC decoder: %s block %s texel %d is %s, not %s" % (
+                    "srgb" if srgb else "linear", block.hex(), i, texel, texels[i % len(texels)]))
+
+
+def astcenc_check(width, height, data, srgb):
+    """Decode the top mip of an ASTC chain with astcenc and return how far
+    its texels are from astc_decode's, or None without astcenc. astcenc
+    interpolates sRGB blocks at 8 bits rather than 16, which can round a
+    texel one step off the specification."""
+    tool = shutil.which("astcenc") or shutil.which("astcenc-avx2") or shutil.which("astcenc-sse4.1")
+    if tool is None:
+        return None
+    blocks_x, blocks_y = (width + 3) // 4, (height + 3) // 4
+    top = data[:blocks_x * blocks_y * 16]
+    # .astc: magic, block size, then the image size in 24-bit fields
+    header = struct.pack("<I3B", 0x5CA1AB13, 4, 4, 1) + b"".join(
+        v.to_bytes(3, "little") for v in (width, height, 1))
+    with tempfile.TemporaryDirectory() as directory:
+        source = os.path.join(directory, "top.astc")
+        output = os.path.join(directory, "top.png")
+        with open(source, "wb") as f:
+            f.write(header + top)
+        try:
+            subprocess.run([tool, "-ds" if srgb else "-dl", source, output], check=True, capture_output=True)
+        except subprocess.CalledProcessError as error:
+            raise TextureError("%s failed: %s" % (tool, error.stderr.decode(errors="replace").strip()))
+        decoded_width, decoded_height, rgba = load_png(output)
+    if (decoded_width, decoded_height) != (width, height):
+        raise TextureError("astcenc decoded a %dx%d top mip as %dx%d" % (width, height, decoded_width,
+                                                                          decoded_height))
+    worst = 0
+    for by in range(blocks_y):
+        for bx in range(blocks_x):
+            i = (by * blocks_x + bx) * 16
+            decoded = astc_decode(top[i:i + 16], srgb)
+            for y in range(min(4, height - by * 4)):
+                for x in range(min(4, width - bx * 4)):
+                    p = ((by * 4 + y) * width + bx * 4 + x) * 4
+                    worst = max(worst, max(abs(rgba[p + c] - decoded[y * 4 + x][c]) for c in range(4)))
+    return worst
+
+
+# ---------------------------------------------------------------------------
+
+
+# encoder(pixels, alpha, srgb), decoder(block, srgb); only ASTC decodes
+# sRGB differently
+CODECS = {
+    ASTC_4X4: (lambda p, alpha, srgb: astc_encode(p, ASTC_RGBA if alpha else ASTC_RGB, srgb), astc_decode),
+    ETC2_RGB8: (lambda p, alpha, srgb: etc_encode(p), lambda b, srgb: etc_decode(b)),
+    ETC2_RGBA8: (lambda p, alpha, srgb: etc2_rgba_encode(p), lambda b, srgb: etc2_rgba_decode(b)),
+    BC1: (lambda p, alpha, srgb: bc1_encode(p), lambda b, srgb: bc1_decode(b)),
+    BC3: (lambda p, alpha, srgb: bc3_encode(p), lambda b, srgb: bc3_decode(b)),
+}
+
+
+def psnr(squared_error, samples):
+    if squared_error == 0:
+        return float("inf")
+    return 10.0 * math.log10(255.0 * 255.0 * samples / squared_error)
+
+
+def encode(mips, fmt, alpha, srgb):
+    """Encode every mip, returning the data and the RGB and alpha squared
+    error against the source, for the whole chain and for the top mip."""
+    data = bytearray()
+    errors = [[0, 0], [0, 0]]
+    if fmt == RGBA8:
+        for _, _, rgba in mips:
+            data += rgba
+        return bytes(data), errors
+    encoder, decoder = CODECS[fmt]
+    for level, (width, height, rgba) in enumerate(mips):
+        for by in range((height + 3) // 4):
+            for bx in range((width + 3) // 4):
+                pixels = block_pixels(width, height, rgba, bx, by)
+                block = encoder(pixels, alpha, srgb)
+                data += block
+                decoded = decoder(block, srgb)
+                for y in range(min(4, height - by * 4)):
+                    for x in range(min(4, width - bx * 4)):
+                        p, d = pixels[y * 4 + x], decoded[y * 4 + x]
+                        rgb = sum((p[c] - d[c]) ** 2 for c in range(3))
+                        a = (p[3] - d[3]) ** 2
+                        errors[0][0] += rgb
+                        errors[0][1] += a
+                        if level == 0:
+                            errors[1][0] += rgb
+                            errors[1][1] += a
+    return bytes(data), errors
+
+
+def build(width, height, rgba, families, srgb=True, verbose=True):
+    if width == 0 or height == 0:
+        raise TextureError("empty image")
+    alpha = any(rgba[i] != 255 for i in range(3, len(rgba), 4))
+    mips = build_mips(width, height, rgba, srgb)
+    pixels = sum(w * h for w, h, _ in mips)
+    if verbose:
+        print("build_texture: %dx%d, %d mips, %s%s" % (width, height, len(mips), "srgb" if srgb else "linear",
+                                                      ", alpha" if alpha else ""))
+    if "astc" in families:
+        astc_check_known_answers()
+    variants = []
+    for family in families:
+        fmt = FAMILIES[family][1 if alpha else 0]
+        start = time.time()
+        data, errors = encode(mips, fmt, alpha, srgb)
+        if verbose:
+            line = "build_texture: %-10s %8d bytes, %5.2f bpp, PSNR rgb %5.2f dB (top mip %5.2f)" % (
+                FORMAT_NAMES[fmt], len(data), 8.0 * len(data) / pixels, psnr(errors[0][0], 3 * pixels),
+                psnr(errors[1][0], 3 * width * height))
+            if alpha:
+                line += ", alpha %5.2f dB" % psnr(errors[0][1], pixels)
+            print(line + ", %.1f s" % (time.time() - start))
+        if fmt == ASTC_4X4:
+            worst = astcenc_check(width, height, data, srgb)
+            if worst is not None and worst > 1:
+                raise TextureError("astcenc decodes the top mip up to %d off astc_decode" % worst)
+            if worst is not None and verbose:
+                print("build_texture: astcenc decodes the top mip within %d of astc_decode" % worst)
+        variants.append((fmt, data))
+
+    flags = (FLAG_SRGB if srgb else 0) | (FLAG_ALPHA if alpha else 0)
+    offset = HEADER.size + VARIANT.size * len(variants)
+    table, body = bytearray(), bytearray()
+    for fmt, data in variants:
+        start = (offset + VARIANT_ALIGNMENT - 1) // VARIANT_ALIGNMENT * VARIANT_ALIGNMENT
+        body += bytes(start - offset) + data
+        table += VARIANT.pack(fmt, start, len(data), 0)
+        offset = start + len(data)
+    header = HEADER.pack(MAGIC, VERSION, width, height, len(mips), len(variants), flags, 0)
+    return bytes(header + table + body)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--output", required=True, help=".tex file to write")
+    parser.add_argument("--formats", default="astc,etc2,bc",
+                        help="comma separated, most preferred first, from %s" % ",".join(FAMILIES))
+    parser.add_argument("--linear", action="store_true", help="the image is data, not sRGB color")
+    parser.add_argument("--demo", action="store_true", help="build a generated image instead of an input")
+    parser.add_argument("input", nargs="?", help="8-bit PNG")
+    args = parser.parse_args()
+    if (args.input is None) == (not args.demo):
+        parser.error("give either an input or --demo")
+    families = [f for f in args.formats.split(",") if f]
+    unknown = [f for f in families if f not in FAMILIES]
+    if unknown or not families or len(set(families)) != len(families):
+        parser.error("--formats takes distinct names from %s" % ",".join(FAMILIES))
+
+    try:
+        image = demo_image() if args.demo else load_png(args.input)
+        data = build(*image, families, srgb=not args.linear)
+    except (TextureError, OSError, zlib.error) as error:
+        sys.stderr.write("build_texture: error: %s\n" % error)
+        return 1
+
+    temp = args.output + ".tmp"
+    with open(temp, "wb") as f:
+        f.write(data)
+    os.replace(temp, args.output)
+    print("build_texture: %s: %d bytes" % (args.output, len(data)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""Build an asset pack for the engine's asset_pack loader.
+
+Usage: pack_assets.py --output engine.pak [NAME=]FILE[:TYPE] ...
+
+NAME defaults to the file name and must fit in 31 bytes. TYPE is one of
+blob, mesh, texture, shader; by default it follows the extension (.spv is
+a shader, .mesh a mesh, .tex/.ktx/.ktx2 a texture, anything else a blob).
+Meshes and textures start on 64 byte boundaries, everything else on 16,
+so the engine can hand out pointers into the mapped file without copying.
+
+The layout is described in app/src/main/cpp/asset_pack.h.
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+MAGIC = 0x4B415045  # "EPAK"
+VERSION = 1
+NAME_SIZE = 32
+HEADER = struct.Struct("<IIIIQQ")
+ENTRY = struct.Struct("<QQQII%ds" % NAME_SIZE)
+
+TYPES = {"blob": 0, "mesh": 1, "texture": 2, "shader": 3}
+EXTENSION_TYPES = {
+    ".spv": "shader",
+    ".mesh": "mesh",
+    ".tex": "texture",
+    ".ktx": "texture",
+    ".ktx2": "texture",
+}
+ALIGNMENT = {"blob": 16, "mesh": 64, "texture": 64, "shader": 16}
+
+
+class PackError(Exception):
+    pass
+
+
+def name_hash(name):
+    """FNV-1a 64, matches asset_name_hash()."""
+    h = 0xCBF29CE484222325
+    for byte in name.encode("utf-8"):
+        h = ((h ^ byte) * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+    return h
+
+
+def parse_input(arg):
+    name, sep, rest = arg.partition("=")
+    if not sep:
+        name, rest = None, arg
+    path, type_name = rest, None
+    head, sep, tail = rest.rpartition(":")
+    if sep and tail in TYPES:
+        path, type_name = head, tail
+    if name is None:
+        name = os.path.basename(path)
+    if type_name is None:
+        type_name = EXTENSION_TYPES.get(os.path.splitext(path)[1].lower(), "blob")
+    if len(name.encode("utf-8")) >= NAME_SIZE:
+        raise PackError("asset name '%s' is longer than %d bytes" % (name, NAME_SIZE - 1))
+    return name, path, type_name
+
+
+def align(value, alignment):
+    return (value + alignment - 1) & ~(alignment - 1)
+
+
+def build(inputs):
+    assets = []
+    seen = {}
+    for name, path, type_name in inputs:
+        h = name_hash(name)
+        if h in seen:
+            raise PackError("'%s' and '%s' have the same name hash" % (name, seen[h]))
+        seen[h] = name
+        with open(path, "rb") as f:
+            assets.append((h, name, type_name, f.read()))
+    assets.sort(key=lambda asset: asset[0])
+
+    offset = HEADER.size + ENTRY.size * len(assets)
+    entries = []
+    blobs = []
+    for h, name, type_name, data in assets:
+        alignment = ALIGNMENT[type_name]
+        start = align(offset, alignment)
+        blobs.append(b"\0" * (start - offset) + data)
+        entries.append(ENTRY.pack(h, start, len(data), TYPES[type_name], alignment,
+                                  name.encode("utf-8")))
+        offset = start + len(data)
+
+    header = HEADER.pack(MAGIC, VERSION, len(assets), 0, offset, 0)
+    return header + b"".join(entries) + b"".join(blobs)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--output", required=True, help="pack to write")
+    parser.add_argument("inputs", nargs="*", help="[NAME=]FILE[:TYPE]")
+    args = parser.parse_args()
+
+    try:
+        pack = build([parse_input(arg) for arg in args.inputs])
+    except (PackError, OSError) as error:
+        sys.stderr.write("pack_assets: error: %s\n" % error)
+        return 1
+
+    # write next to the destination and rename, so a running host never
+    # maps a half written pack
+    temp = args.output + ".tmp"
+    with open(temp, "wb") as f:
+        f.write(pack)
+    os.replace(temp, args.output)
+    print("pack_assets: %s: %d assets, %d bytes" % (args.output, len(args.inputs), len(pack)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
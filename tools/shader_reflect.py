@@ -0,0 +1,659 @@
+#!/usr/bin/env python3
+"""Reflect a shader program's SPIR-V into a C++ header.
+
+Usage: shader_reflect.py --name NAME --output HEADER STAGE.spv:REFLECT.spv ...
+
+Each argument pairs the SPIR-V that is embedded (usually optimized) with the
+SPIR-V that is reflected (unoptimized, so names and the declared interface
+survive). The header holds the code, descriptor bindings, push constant
+ranges with a matching C struct, and vertex input attributes, so pipeline
+layouts are built from constants instead of parsing SPIR-V at startup.
+
+Layout errors fail the build: stage interfaces that do not line up,
+descriptor bindings or push constants that disagree between stages, and
+overlapping vertex input locations.
+"""
+
+import argparse
+import struct
+import sys
+
+SPIRV_MAGIC = 0x07230203
+
+# opcodes
+OP_NAME = 5
+OP_MEMBER_NAME = 6
+OP_ENTRY_POINT = 15
+OP_TYPE_BOOL = 20
+OP_TYPE_INT = 21
+OP_TYPE_FLOAT = 22
+OP_TYPE_VECTOR = 23
+OP_TYPE_MATRIX = 24
+OP_TYPE_IMAGE = 25
+OP_TYPE_SAMPLER = 26
+OP_TYPE_SAMPLED_IMAGE = 27
+OP_TYPE_ARRAY = 28
+OP_TYPE_RUNTIME_ARRAY = 29
+OP_TYPE_STRUCT = 30
+OP_TYPE_POINTER = 32
+OP_CONSTANT = 43
+OP_VARIABLE = 59
+OP_DECORATE = 71
+OP_MEMBER_DECORATE = 72
+
+# decorations
+DEC_BLOCK = 2
+DEC_BUFFER_BLOCK = 3
+DEC_ARRAY_STRIDE = 6
+DEC_MATRIX_STRIDE = 7
+DEC_BUILTIN = 11
+DEC_LOCATION = 30
+DEC_BINDING = 33
+DEC_DESCRIPTOR_SET = 34
+DEC_OFFSET = 35
+
+# storage classes
+SC_UNIFORM_CONSTANT = 0
+SC_INPUT = 1
+SC_UNIFORM = 2
+SC_OUTPUT = 3
+SC_PUSH_CONSTANT = 9
+SC_STORAGE_BUFFER = 12
+
+DIM_BUFFER = 5
+DIM_SUBPASS_DATA = 6
+
+# execution model -> (stage flag, pipeline order)
+STAGES = {
+    0: ("VK_SHADER_STAGE_VERTEX_BIT", 0),
+    1: ("VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT", 1),
+    2: ("VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT", 2),
+    3: ("VK_SHADER_STAGE_GEOMETRY_BIT", 3),
+    4: ("VK_SHADER_STAGE_FRAGMENT_BIT", 4),
+    5: ("VK_SHADER_STAGE_COMPUTE_BIT", 5),
+}
+
+
+class ReflectError(Exception):
+    pass
+
+
+class Module:
+    """The subset of a SPIR-V module that describes its interface."""
+
+    def __init__(self, path, words):
+        self.path = path
+        self.size = len(words) * 4
+        self.names = {}
+        self.member_names = {}
+        self.types = {}
+        self.constants = {}
+        self.variables = []
+        self.decorations = {}
+        self.member_decorations = {}
+        self.execution_model = None
+        self.parse(words)
+
+    def parse(self, words):
+        if len(words) < 5 or words[0] != SPIRV_MAGIC:
+            raise ReflectError("%s: not a SPIR-V module" % self.path)
+        i = 5
+        while i < len(words):
+            count = words[i] >> 16
+            op = words[i] & 0xFFFF
+            if count == 0:
+                raise ReflectError("%s: malformed instruction" % self.path)
+            args = words[i + 1:i + count]
+            i += count
+
+            if op == OP_NAME:
+                self.names[args[0]] = decode_string(args[1:])
+            elif op == OP_MEMBER_NAME:
+                self.member_names[(args[0], args[1])] = decode_string(args[2:])
+            elif op == OP_ENTRY_POINT:
+                if self.execution_model is not None:
+                    raise ReflectError("%s: one entry point per module is supported" % self.path)
+                self.execution_model = args[0]
+            elif op == OP_TYPE_BOOL:
+                self.types[args[0]] = ("bool",)
+            elif op == OP_TYPE_INT:
+                self.types[args[0]] = ("int", args[1], args[2])
+            elif op == OP_TYPE_FLOAT:
+                self.types[args[0]] = ("float", args[1])
+            elif op == OP_TYPE_VECTOR:
+                self.types[args[0]] = ("vector", args[1], args[2])
+            elif op == OP_TYPE_MATRIX:
+                self.types[args[0]] = ("matrix", args[1], args[2])
+            elif op == OP_TYPE_IMAGE:
+                # sampled type, dim, depth, arrayed, ms, sampled
+                self.types[args[0]] = ("image", args[2], args[6])
+            elif op == OP_TYPE_SAMPLER:
+                self.types[args[0]] = ("sampler",)
+            elif op == OP_TYPE_SAMPLED_IMAGE:
+                self.types[args[0]] = ("sampled_image", args[1])
+            elif op == OP_TYPE_ARRAY:
+                self.types[args[0]] = ("array", args[1], args[2])
+            elif op == OP_TYPE_RUNTIME_ARRAY:
+                self.types[args[0]] = ("runtime_array", args[1])
+            elif op == OP_TYPE_STRUCT:
+                self.types[args[0]] = ("struct", list(args[1:]))
+            elif op == OP_TYPE_POINTER:
+                self.types[args[0]] = ("pointer", args[1], args[2])
+            elif op == OP_CONSTANT:
+                self.constants[args[1]] = args[2]
+            elif op == OP_VARIABLE:
+                self.variables.append((args[1], args[0], args[2]))
+            elif op == OP_DECORATE:
+                self.decorations.setdefault(args[0], {})[args[1]] = args[2:]
+            elif op == OP_MEMBER_DECORATE:
+                self.member_decorations.setdefault((args[0], args[1]), {})[args[2]] = args[3:]
+        if self.execution_model not in STAGES:
+            raise ReflectError("%s: no supported entry point" % self.path)
+
+    def decoration(self, target, decoration):
+        values = self.decorations.get(target, {}).get(decoration)
+        return values[0] if values else None
+
+    def has_decoration(self, target, decoration):
+        return decoration in self.decorations.get(target, {})
+
+    def member_decoration(self, struct_id, member, decoration):
+        values = self.member_decorations.get((struct_id, member), {}).get(decoration)
+        return values[0] if values else None
+
+    def stage(self):
+        return STAGES[self.execution_model][0]
+
+    def order(self):
+        return STAGES[self.execution_model][1]
+
+
+def decode_string(words):
+    data = struct.pack("<%dI" % len(words), *words)
+    return data.split(b"\0", 1)[0].decode("utf-8")
+
+
+def read_words(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) % 4 != 0:
+        raise ReflectError("%s: size is not a multiple of 4" % path)
+    return list(struct.unpack("<%dI" % (len(data) // 4), data))
+
+
+def type_signature(module, type_id):
+    """Comparable description of a type, independent of ids and names."""
+    t = module.types[type_id]
+    kind = t[0]
+    if kind in ("vector", "matrix", "sampled_image", "runtime_array"):
+        return (kind,) + tuple(type_signature(module, t[1]) if i == 0 else x
+                               for i, x in enumerate(t[1:]))
+    if kind == "array":
+        return ("array", type_signature(module, t[1]), module.constants.get(t[2]))
+    if kind == "struct":
+        return ("struct", tuple(type_signature(module, m) for m in t[1]))
+    return t
+
+
+def type_name(module, type_id):
+    t = module.types[type_id]
+    kind = t[0]
+    if kind == "float":
+        return "float" if t[1] == 32 else "float%d" % t[1]
+    if kind == "int":
+        return ("int" if t[2] else "uint") + ("" if t[1] == 32 else str(t[1]))
+    if kind == "bool":
+        return "bool"
+    if kind == "vector":
+        return "%s%d" % (type_name(module, t[1]), t[2])
+    if kind == "matrix":
+        column = module.types[t[1]]
+        return "mat%dx%d" % (t[2], column[2])
+    if kind == "array":
+        return "%s[%d]" % (type_name(module, t[1]), module.constants.get(t[2], 0))
+    if kind == "struct":
+        return module.names.get(type_id, "struct")
+    return kind
+
+
+def pointee(module, pointer_type):
+    t = module.types[pointer_type]
+    if t[0] != "pointer":
+        raise ReflectError("%s: variable without pointer type" % module.path)
+    return t[2]
+
+
+def is_builtin_block(module, type_id):
+    t = module.types.get(type_id)
+    if t is None:
+        return False
+    if t[0] == "array":
+        return is_builtin_block(module, t[1])
+    if t[0] != "struct":
+        return False
+    return any(module.member_decoration(type_id, i, DEC_BUILTIN) is not None
+               for i in range(len(t[1])))
+
+
+def location_count(module, type_id):
+    t = module.types[type_id]
+    if t[0] == "matrix":
+        return t[2]
+    if t[0] == "array":
+        return module.constants.get(t[2], 1) * location_count(module, t[1])
+    if t[0] == "vector" and t[2] > 2 and module.types[t[1]][1] == 64:
+        return 2
+    return 1
+
+
+def interface(module, storage_class):
+    """{location: (name, type id, signature)} for the stage inputs or outputs."""
+    result = {}
+    for var, ptr, sc in module.variables:
+        if sc != storage_class or module.has_decoration(var, DEC_BUILTIN):
+            continue
+        type_id = pointee(module, ptr)
+        if is_builtin_block(module, type_id):
+            continue
+        location = module.decoration(var, DEC_LOCATION)
+        name = module.names.get(var, "%" + str(var))
+        if location is None:
+            raise ReflectError("%s: interface variable %s has no location" % (module.path, name))
+        for i in range(location_count(module, type_id)):
+            if location + i in result:
+                raise ReflectError("%s: %s and %s overlap at location %d"
+                                   % (module.path, result[location + i][0], name, location + i))
+            result[location + i] = (name, type_id, type_signature(module, type_id))
+    return result
+
+
+def type_size(module, type_id, matrix_stride=None, array_stride=None):
+    """Byte size of a type inside an explicitly laid out block."""
+    t = module.types[type_id]
+    kind = t[0]
+    if kind in ("int", "float"):
+        return t[1] // 8
+    if kind == "bool":
+        return 4
+    if kind == "vector":
+        return t[2] * type_size(module, t[1])
+    if kind == "matrix":
+        column_size = type_size(module, t[1])
+        return t[2] * (matrix_stride or column_size)
+    if kind == "array":
+        stride = array_stride or module.decoration(type_id, DEC_ARRAY_STRIDE)
+        return module.constants.get(t[2], 0) * stride
+    if kind == "struct":
+        size = 0
+        for i, member in enumerate(t[1]):
+            offset = module.member_decoration(type_id, i, DEC_OFFSET) or 0
+            size = max(size, offset + member_size(module, type_id, i, member))
+        return size
+    raise ReflectError("%s: cannot size type %s" % (module.path, kind))
+
+
+def member_size(module, struct_id, index, member_type):
+    return type_size(module, member_type,
+                     matrix_stride=module.member_decoration(struct_id, index, DEC_MATRIX_STRIDE))
+
+
+def descriptor_type(module, var, type_id, storage_class):
+    count = 1
+    t = module.types[type_id]
+    if t[0] == "array":
+        count = module.constants.get(t[2], 1)
+        type_id = t[1]
+        t = module.types[type_id]
+    elif t[0] == "runtime_array":
+        raise ReflectError("%s: runtime descriptor arrays are not supported (%s)"
+                           % (module.path, module.names.get(var, var)))
+
+    kind = t[0]
+    if storage_class == SC_STORAGE_BUFFER:
+        return "VK_DESCRIPTOR_TYPE_STORAGE_BUFFER", count
+    if storage_class == SC_UNIFORM:
+        if module.has_decoration(type_id, DEC_BUFFER_BLOCK):
+            return "VK_DESCRIPTOR_TYPE_STORAGE_BUFFER", count
+        return "VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER", count
+    if kind == "sampled_image":
+        image = module.types[t[1]]
+        if image[1] == DIM_BUFFER:
+            return "VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER", count
+        return "VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER", count
+    if kind == "sampler":
+        return "VK_DESCRIPTOR_TYPE_SAMPLER", count
+    if kind == "image":
+        dim, sampled = t[1], t[2]
+        if dim == DIM_SUBPASS_DATA:
+            return "VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT", count
+        if dim == DIM_BUFFER:
+            return ("VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER" if sampled == 2
+                    else "VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER"), count
+        return ("VK_DESCRIPTOR_TYPE_STORAGE_IMAGE" if sampled == 2
+                else "VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE"), count
+    raise ReflectError("%s: unsupported descriptor type %s" % (module.path, kind))
+
+
+def vertex_format(module, type_id):
+    t = module.types[type_id]
+    if t[0] == "matrix":
+        return vertex_format(module, t[1])
+    components = 1
+    if t[0] == "vector":
+        components = t[2]
+        t = module.types[t[1]]
+    if t[1] != 32:
+        raise ReflectError("%s: only 32 bit vertex inputs are supported" % module.path)
+    suffix = "SFLOAT" if t[0] == "float" else ("SINT" if t[2] else "UINT")
+    channels = "RGBA"[:components]
+    return "VK_FORMAT_" + "".join("%s32" % c for c in channels) + "_" + suffix, components * 4
+
+
+class Program:
+    def __init__(self, name, modules):
+        self.name = name
+        self.modules = sorted(modules, key=lambda m: m.order())
+        self.bindings = {}
+        self.push_members = {}
+        self.push_block = None
+        self.push_stages = set()
+        self.attributes = []
+        self.stride = 0
+        self.color_outputs = 0
+
+        orders = [m.order() for m in self.modules]
+        if len(set(orders)) != len(orders):
+            raise ReflectError("%s: two shaders for the same stage" % name)
+        self.reflect_descriptors()
+        self.reflect_push_constants()
+        self.check_interfaces()
+        self.reflect_vertex_inputs()
+        self.reflect_fragment_outputs()
+
+    def reflect_descriptors(self):
+        for module in self.modules:
+            for var, ptr, sc in module.variables:
+                if sc not in (SC_UNIFORM_CONSTANT, SC_UNIFORM, SC_STORAGE_BUFFER):
+                    continue
+                set_index = module.decoration(var, DEC_DESCRIPTOR_SET)
+                binding = module.decoration(var, DEC_BINDING)
+                name = module.names.get(var, "%" + str(var))
+                if set_index is None or binding is None:
+                    raise ReflectError("%s: %s needs set and binding decorations" % (module.path, name))
+                dtype, count = descriptor_type(module, var, pointee(module, ptr), sc)
+                key = (set_index, binding)
+                existing = self.bindings.get(key)
+                if existing is None:
+                    self.bindings[key] = [dtype, count, {module.stage()}, name, module.path]
+                elif existing[0] != dtype or existing[1] != count:
+                    raise ReflectError(
+                        "set %d binding %d is %s[%d] (%s) in %s but %s[%d] (%s) in %s"
+                        % (set_index, binding, existing[0], existing[1], existing[3], existing[4],
+                           dtype, count, name, module.path))
+                else:
+                    existing[2].add(module.stage())
+
+    def reflect_push_constants(self):
+        for module in self.modules:
+            for var, ptr, sc in module.variables:
+                if sc != SC_PUSH_CONSTANT:
+                    continue
+                block = pointee(module, ptr)
+                members = module.types[block][1]
+                self.push_stages.add(module.stage())
+                if self.push_block is None:
+                    self.push_block = module.names.get(block, "push_constants")
+                for i, member in enumerate(members):
+                    offset = module.member_decoration(block, i, DEC_OFFSET)
+                    size = member_size(module, block, i, member)
+                    name = module.member_names.get((block, i), "member%d" % i)
+                    signature = (type_signature(module, member), size,
+                                 module.member_decoration(block, i, DEC_MATRIX_STRIDE))
+                    cpp = cpp_member(module, member, size,
+                                     module.member_decoration(block, i, DEC_MATRIX_STRIDE))
+                    existing = self.push_members.get(offset)
+                    if existing is None:
+                        for other_offset, other in self.push_members.items():
+                            if offset < other_offset + other[2] and other_offset < offset + size:
+                                raise ReflectError(
+                                    "push constant %s in %s overlaps %s at offset %d"
+                                    % (name, module.path, other[0], other_offset))
+                        self.push_members[offset] = (name, signature, size, cpp, module.path)
+                    elif existing[1] != signature:
+                        raise ReflectError(
+                            "push constant at offset %d is %s in %s but %s in %s"
+                            % (offset, existing[0], existing[4], name, module.path))
+
+    def check_interfaces(self):
+        # tessellation and geometry inputs are per-vertex arrays, so only
+        # the last stage feeding the fragment shader is compared
+        graphics = [m for m in self.modules if m.order() < 5]
+        for producer, consumer in zip(graphics, graphics[1:]):
+            if consumer.order() != 4:
+                continue
+            outputs = interface(producer, SC_OUTPUT)
+            inputs = interface(consumer, SC_INPUT)
+            for location, (name, _, signature) in sorted(inputs.items()):
+                output = outputs.get(location)
+                if output is None:
+                    raise ReflectError("%s reads location %d (%s) but %s never writes it"
+                                       % (consumer.path, location, name, producer.path))
+                if output[2] != signature:
+                    raise ReflectError(
+                        "location %d is %s %s in %s but %s %s in %s"
+                        % (location, type_name(producer, output[1]), output[0], producer.path,
+                           type_name(consumer, inputs[location][1]), name, consumer.path))
+
+    def reflect_vertex_inputs(self):
+        vertex = [m for m in self.modules if m.order() == 0]
+        if not vertex:
+            return
+        module = vertex[0]
+        offset = 0
+        for location, (name, type_id, _) in sorted(interface(module, SC_INPUT).items()):
+            fmt, size = vertex_format(module, type_id)
+            self.attributes.append((location, fmt, offset, name))
+            offset += size
+        self.stride = offset
+
+    def reflect_fragment_outputs(self):
+        fragment = [m for m in self.modules if m.order() == 4]
+        if fragment:
+            self.color_outputs = len(interface(fragment[0], SC_OUTPUT))
+
+    def push_size(self):
+        return max((offset + m[2] for offset, m in self.push_members.items()), default=0)
+
+    def push_offset(self):
+        return min(self.push_members, default=0)
+
+
+C_SIZES = {
+    "float": 4,
+    "int32_t": 4,
+    "uint32_t": 4,
+    "struct vec3": 12,
+    "struct vec4": 16,
+    "struct mat4": 64,
+}
+
+
+def cpp_member(module, type_id, size, matrix_stride):
+    """C++ declaration for a push constant member as (type, array suffix)."""
+    t = module.types[type_id]
+    if t[0] == "float" and t[1] == 32:
+        return ("float", "")
+    if t[0] == "int" and t[1] == 32:
+        return ("int32_t" if t[2] else "uint32_t", "")
+    if t[0] == "vector":
+        component = module.types[t[1]]
+        if component == ("float", 32) and t[2] == 3:
+            return ("struct vec3", "")
+        if component == ("float", 32) and t[2] == 4:
+            return ("struct vec4", "")
+    if t[0] == "matrix" and t[2] == 4 and module.types[t[1]][2] == 4 and matrix_stride == 16:
+        return ("struct mat4", "")
+    if t[0] == "array" and module.constants.get(t[2]):
+        # arrays keep their element type when the C type has the same stride
+        count = module.constants[t[2]]
+        element = cpp_member(module, t[1], size // count, matrix_stride)
+        if not element[1] and C_SIZES.get(element[0]) == size // count:
+            return (element[0], "[%d]" % count)
+    # anything else is carried as raw words
+    return ("uint32_t", "[%d]" % (size // 4))
+
+
+def c_words(words):
+    lines = []
+    for i in range(0, len(words), 8):
+        lines.append("    " + ", ".join("0x%08x" % w for w in words[i:i + 8]) + ",")
+    return "\n".join(lines)
+
+
+def stage_suffix(stage):
+    return {
+        "VK_SHADER_STAGE_VERTEX_BIT": "vert",
+        "VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT": "tesc",
+        "VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT": "tese",
+        "VK_SHADER_STAGE_GEOMETRY_BIT": "geom",
+        "VK_SHADER_STAGE_FRAGMENT_BIT": "frag",
+        "VK_SHADER_STAGE_COMPUTE_BIT": "comp",
+    }[stage]
+
+
+def emit(program, code, sources):
+    name = program.name
+    upper = name.upper()
+    out = []
+    w = out.append
+    w("// Generated by tools/shader_reflect.py from %s. Do not edit." % ", ".join(sources))
+    w("#ifndef ENGINE_SHADER_%s_H" % upper)
+    w("#define ENGINE_SHADER_%s_H" % upper)
+    w("")
+    w("#include <cstddef>")
+    w("#include <cstdint>")
+    w("")
+    w("#include \"shader_program.h\"")
+    w("#include \"vecmath.h\"")
+    w("")
+
+    for module in program.modules:
+        suffix = stage_suffix(module.stage())
+        words = code[module]
+        w("// %s: %d bytes, %d unoptimized" % (suffix, len(words) * 4, module.size))
+        w("static const uint32_t %s_%s_spv[%d] = {" % (name, suffix, len(words)))
+        w(c_words(words))
+        w("};")
+        w("")
+    w("static const struct shader_stage %s_stages[] = {" % name)
+    for module in program.modules:
+        suffix = stage_suffix(module.stage())
+        w("    { %s, %s_%s_spv, sizeof(%s_%s_spv) }," % (module.stage(), name, suffix, name, suffix))
+    w("};")
+    w("")
+
+    sets = sorted({key[0] for key in program.bindings})
+    w("#define %s_DESCRIPTOR_SET_COUNT %d" % (upper, sets[-1] + 1 if sets else 0))
+    if program.bindings:
+        w("")
+        w("static const struct shader_binding %s_bindings[] = {" % name)
+        for (set_index, binding), (dtype, count, stages, var, _) in sorted(program.bindings.items()):
+            w("    { %d, %d, %s, %d, %s }, // %s" % (set_index, binding, dtype, count,
+                                                  " | ".join(sorted(stages)), var))
+        w("};")
+    w("")
+
+    w("#define %s_PUSH_CONSTANTS_SIZE %d" % (upper, program.push_size()))
+    if program.push_members:
+        struct_name = "%s_%s" % (name, program.push_block)
+        w("")
+        w("struct %s {" % struct_name)
+        offset = 0
+        padding = 0
+        for member_offset in sorted(program.push_members):
+            member = program.push_members[member_offset]
+            if member_offset > offset:
+                w("    uint8_t padding%d[%d];" % (padding, member_offset - offset))
+                padding += 1
+            w("    %s %s%s;" % (member[3][0], member[0], member[3][1]))
+            offset = member_offset + member[2]
+        w("};")
+        for member_offset in sorted(program.push_members):
+            member = program.push_members[member_offset]
+            w("static_assert(offsetof(struct %s, %s) == %d, \"%s layout\");"
+              % (struct_name, member[0], member_offset, struct_name))
+        w("static_assert(sizeof(struct %s) == %s_PUSH_CONSTANTS_SIZE, \"%s layout\");"
+          % (struct_name, upper, struct_name))
+        w("")
+        w("static const VkPushConstantRange %s_push_constant_ranges[] = {" % name)
+        w("    { %s, %d, %d }," % (" | ".join(sorted(program.push_stages)), program.push_offset(),
+                                  program.push_size() - program.push_offset()))
+        w("};")
+    w("")
+
+    w("#define %s_VERTEX_STRIDE %d" % (upper, program.stride))
+    if program.attributes:
+        w("")
+        w("// packed into binding 0 in location order")
+        w("static const VkVertexInputAttributeDescription %s_vertex_attributes[] = {" % name)
+        for location, fmt, offset, var in program.attributes:
+            w("    { %d, 0, %s, %d }, // %s" % (location, fmt, offset, var))
+        w("};")
+    w("")
+    w("#define %s_COLOR_OUTPUTS %d" % (upper, program.color_outputs))
+    w("")
+
+    w("static const struct shader_program %s_program = {" % name)
+    w("    \"%s\"," % name)
+    w("    %s_stages, %d," % (name, len(program.modules)))
+    if program.bindings:
+        w("    %s_bindings, %d, %s_DESCRIPTOR_SET_COUNT," % (name, len(program.bindings), upper))
+    else:
+        w("    nullptr, 0, 0,")
+    if program.push_members:
+        w("    %s_push_constant_ranges, 1," % name)
+    else:
+        w("    nullptr, 0,")
+    if program.attributes:
+        w("    %s_vertex_attributes, %d, %s_VERTEX_STRIDE," % (name, len(program.attributes), upper))
+    else:
+        w("    nullptr, 0, 0,")
+    w("};")
+    w("")
+    w("#endif // ENGINE_SHADER_%s_H" % upper)
+    return "\n".join(out) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--name", required=True, help="program name, prefixes every symbol")
+    parser.add_argument("--output", required=True, help="header to write")
+    parser.add_argument("stages", nargs="+", help="EMBED.spv:REFLECT.spv per stage")
+    args = parser.parse_args()
+
+    try:
+        modules = []
+        code = {}
+        sources = []
+        for stage in args.stages:
+            embed_path, _, reflect_path = stage.partition(":")
+            module = Module(reflect_path or embed_path, read_words(reflect_path or embed_path))
+            embedded = Module(embed_path, read_words(embed_path))
+            if embedded.execution_model != module.execution_model:
+                raise ReflectError("%s and %s are different stages" % (embed_path, reflect_path))
+            modules.append(module)
+            code[module] = read_words(embed_path)
+            sources.append(embed_path.replace("\\", "/").rsplit("/", 1)[-1].replace(".spv", ""))
+        program = Program(args.name, modules)
+    except ReflectError as error:
+        sys.stderr.write("shader_reflect: %s: error: %s\n" % (args.name, error))
+        return 1
+
+    header = emit(program, code, sources)
+    with open(args.output, "w") as f:
+        f.write(header)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())